@@ -0,0 +1,145 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//
+// Measures how the stream of decoded messages and the polls of Gps::poll and
+// Gps::read affect each other in CallbackHandlers.
+//
+// Usage: callback_benchmark [max_pollers [callback_us]]
+//
+// A synthetic 20 Hz NavPVT, RxmRAWX and NavRELPOSNED9 stream is decoded on
+// the reading thread while 0 to max_pollers threads, 4 by default, keep
+// reading MonVER with a timeout of zero. The callbacks serialize the messages
+// like ros::Publisher::publish does and then busy wait for callback_us, 50 by
+// default, to stand in for a slow subscriber. For each number of pollers the
+// throughput of the stream and the latency of registering and removing the
+// one-shot handler of the polls is printed.
+//
+
+#include <ublox_gps/gps.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <ros/serialization.h>
+
+#include "synthetic_log.h"
+
+using namespace ublox_gps;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//! The time each callback spends after serializing the message
+Clock::duration callback_time;
+
+/**
+ * @brief Serialize the message like a publisher & keep the thread busy.
+ */
+template <typename T>
+void publish(const T& message) {
+  ros::SerializedMessage serialized =
+      ros::serialization::serializeMessage(message);
+  Clock::time_point end = Clock::now() + callback_time;
+  while (Clock::now() < end) {}
+}
+
+/**
+ * @brief Keep polling a message which is not in the stream.
+ * @param latencies the time of each poll in microseconds
+ */
+void pollVersion(CallbackHandlers* handlers, const boost::atomic<bool>* stop,
+                 std::vector<double>* latencies) {
+  ublox_msgs::MonVER version;
+  while (!stop->load(boost::memory_order_relaxed)) {
+    Clock::time_point start = Clock::now();
+    handlers->read(version, boost::posix_time::milliseconds(0));
+    latencies->push_back(std::chrono::duration<double, std::micro>(
+        Clock::now() - start).count());
+  }
+}
+
+/**
+ * @brief Get the given percentile of the sorted values.
+ */
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  return sorted[std::min(sorted.size() - 1,
+                         static_cast<std::size_t>(p * sorted.size()))];
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ros::Time::init();
+  std::size_t max_pollers = argc > 1 ? atoi(argv[1]) : 4;
+  callback_time = std::chrono::microseconds(argc > 2 ? atoi(argv[2]) : 50);
+  std::vector<uint8_t> log;
+  benchmark::syntheticLog(log, false);
+
+  printf("pollers    msg/s      polls  p50 us   p99 us   max us\n");
+  for (std::size_t pollers = 0; pollers <= max_pollers; ++pollers) {
+    CallbackHandlers handlers;
+    handlers.insert<ublox_msgs::NavPVT>(&publish<ublox_msgs::NavPVT>);
+    handlers.insert<ublox_msgs::RxmRAWX>(&publish<ublox_msgs::RxmRAWX>);
+    handlers.insert<ublox_msgs::NavRELPOSNED9>(
+        &publish<ublox_msgs::NavRELPOSNED9>);
+
+    boost::atomic<bool> stop(false);
+    std::vector<std::vector<double> > latencies(pollers);
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < pollers; ++i)
+      threads.create_thread(boost::bind(&pollVersion, &handlers, &stop,
+                                        &latencies[i]));
+
+    // Pass the whole log at once, like a single large read of the worker
+    std::vector<unsigned char> in(log.begin(), log.end());
+    std::size_t size = in.size();
+    Clock::time_point start = Clock::now();
+    handlers.readCallback(in.data(), size);
+    double seconds = std::chrono::duration<double>(
+        Clock::now() - start).count();
+    stop.store(true);
+    threads.join_all();
+
+    std::vector<double> all;
+    for (std::size_t i = 0; i < latencies.size(); ++i)
+      all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    std::sort(all.begin(), all.end());
+    printf("%7zu %8.0f %10zu %7.1f %8.1f %8.1f\n", pollers,
+           handlers.statistics().frames / seconds, all.size(),
+           percentile(all, 0.5), percentile(all, 0.99),
+           all.empty() ? 0 : all.back());
+  }
+  return 0;
+}
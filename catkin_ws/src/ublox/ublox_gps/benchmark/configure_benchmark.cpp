@@ -0,0 +1,267 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//
+// Measures how long the configuration of a ZED-F9P takes, see
+// config/zed_f9p.yaml with config_on_startup enabled.
+//
+// Usage: configure_benchmark [ack_latency_ms]
+//
+// The driver is connected to a simulated receiver which acknowledges every
+// UBX message after ack_latency_ms, 10 by default, roughly the round trip of
+// a USB or 115200 baud link. The startup configuration is sent one message
+// after another like UbloxNode::configureUblox does, then with all message
+// rates sent at once with Gps::configureAsync. Finally the receiver stops
+// answering to measure how long a configure() takes to time out.
+//
+
+#include <ublox_gps/gps.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+using namespace ublox_gps;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief A receiver which acknowledges the UBX messages it is sent.
+ */
+class SimulatedReceiver : public Worker {
+ public:
+  /**
+   * @param latency the time from receiving a message to sending its ACK
+   */
+  SimulatedReceiver(const Clock::duration& latency)
+      : latency_(latency), silent_(false), stopping_(false),
+        thread_(boost::bind(&SimulatedReceiver::run, this)) {}
+
+  ~SimulatedReceiver() { stop(); }
+
+  void setCallback(const Callback& callback) {
+    boost::mutex::scoped_lock lock(mutex_);
+    callback_ = callback;
+  }
+
+  void setRawDataCallback(const Callback& callback) {}
+
+  bool send(const unsigned char* data, const unsigned int size) {
+    if (size < 8 || data[0] != 0xb5 || data[1] != 0x62) return true;
+    boost::mutex::scoped_lock lock(mutex_);
+    if (silent_) return true;
+    Pending pending;
+    pending.due = Clock::now() + latency_;
+    pending.ack.clsID = data[2];
+    pending.ack.msgID = data[3];
+    pending_.push_back(pending);
+    condition_.notify_all();
+    return true;
+  }
+
+  void wait(const boost::posix_time::time_duration& timeout) {
+    boost::this_thread::sleep(timeout);
+  }
+
+  bool isOpen() const { return true; }
+
+  /**
+   * @brief Whether the messages are ignored instead of acknowledged.
+   */
+  void setSilent(bool silent) {
+    boost::mutex::scoped_lock lock(mutex_);
+    silent_ = silent;
+  }
+
+  /**
+   * @brief Stop sending, must be called before the driver is destroyed.
+   */
+  void stop() {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+      condition_.notify_all();
+    }
+    if (thread_.joinable()) thread_.join();
+  }
+
+ private:
+  //! An ACK which is sent when it is due
+  struct Pending {
+    Clock::time_point due;
+    ublox_msgs::Ack ack;
+  };
+
+  /**
+   * @brief Send the ACKs when they are due, like the I/O thread.
+   */
+  void run() {
+    std::vector<unsigned char> out(64);
+    boost::mutex::scoped_lock lock(mutex_);
+    while (!stopping_) {
+      if (pending_.empty()) {
+        condition_.wait(lock);
+        continue;
+      }
+      Clock::time_point now = Clock::now();
+      if (pending_.front().due > now) {
+        lock.unlock();
+        boost::this_thread::sleep(boost::posix_time::microseconds(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                pending_.front().due - now).count()));
+        lock.lock();
+        continue;
+      }
+      ublox::Writer writer(out.data(), out.size());
+      writer.write(pending_.front().ack, ublox_msgs::Class::ACK,
+                   ublox_msgs::Message::ACK::ACK);
+      pending_.pop_front();
+      std::size_t size = writer.end() - out.data();
+      if (callback_) callback_(out.data(), size);
+    }
+  }
+
+  const Clock::duration latency_;
+  Callback callback_;
+  std::deque<Pending> pending_;
+  bool silent_;
+  bool stopping_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  boost::thread thread_;
+};
+
+//! The messages enabled by the ZED-F9P rover configuration
+const uint8_t kRates[][2] = {
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::PVT},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::STATUS},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::SAT},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::POSLLH},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::POSECEF},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::VELNED},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::CLOCK},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::RELPOSNED9},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::HPPOSLLH},
+  {ublox_msgs::Class::NAV, ublox_msgs::Message::NAV::HPPOSECEF},
+  {ublox_msgs::Class::RXM, ublox_msgs::Message::RXM::RAWX},
+  {ublox_msgs::Class::RXM, ublox_msgs::Message::RXM::SFRBX},
+  {ublox_msgs::Class::MON, ublox_msgs::Message::MON::HW},
+};
+const std::size_t kNumRates = sizeof(kRates) / sizeof(kRates[0]);
+
+/**
+ * @brief Send the settings of the rover configuration other than the rates.
+ */
+bool configureNavigation(Gps& gps) {
+  return gps.configRate(200, 1)
+      && gps.configSbas(false, 0, 0)
+      && gps.setPpp(false, 27.11)
+      && gps.setDynamicModel(ublox_msgs::CfgNAV5::DYN_MODEL_PORTABLE)
+      && gps.setFixMode(ublox_msgs::CfgNAV5::FIX_MODE_AUTO)
+      && gps.setDeadReckonLimit(0)
+      && gps.setDgnss(ublox_msgs::CfgDGNSS::DGNSS_MODE_RTK_FIXED);
+}
+
+/**
+ * @brief Configure the device one message after another.
+ */
+bool configureSequential(Gps& gps) {
+  if (!configureNavigation(gps)) return false;
+  for (std::size_t i = 0; i < kNumRates; ++i)
+    if (!gps.setRate(kRates[i][0], kRates[i][1], 1)) return false;
+  return true;
+}
+
+/**
+ * @brief Configure the device with all message rates outstanding at once.
+ */
+bool configureOverlapped(Gps& gps) {
+  if (!configureNavigation(gps)) return false;
+  std::vector<std::future<bool> > acks;
+  for (std::size_t i = 0; i < kNumRates; ++i) {
+    ublox_msgs::CfgMSG msg;
+    msg.msgClass = kRates[i][0];
+    msg.msgID = kRates[i][1];
+    msg.rate = 1;
+    acks.push_back(gps.configureAsync(msg));
+  }
+  bool result = true;
+  for (std::size_t i = 0; i < acks.size(); ++i)
+    result = acks[i].get() && result;
+  return result;
+}
+
+/**
+ * @brief Get the time since start in milliseconds.
+ */
+double elapsed(const Clock::time_point& start) {
+  return std::chrono::duration<double, std::milli>(
+      Clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ros::Time::init();
+  int latency_ms = argc > 1 ? atoi(argv[1]) : 10;
+  boost::shared_ptr<SimulatedReceiver> receiver(
+      new SimulatedReceiver(std::chrono::milliseconds(latency_ms)));
+  {
+    Gps gps;
+    gps.setWorker(receiver);
+    const std::size_t messages = 7 + kNumRates;
+
+    Clock::time_point start = Clock::now();
+    bool sequential = configureSequential(gps);
+    double sequential_ms = elapsed(start);
+    printf("sequential  %3zu messages  %8.1f ms  %6.2f ms/message  %s\n",
+           messages, sequential_ms, sequential_ms / messages,
+           sequential ? "ok" : "failed");
+
+    start = Clock::now();
+    bool overlapped = configureOverlapped(gps);
+    double overlapped_ms = elapsed(start);
+    printf("overlapped  %3zu messages  %8.1f ms  %6.2f ms/message  %s\n",
+           messages, overlapped_ms, overlapped_ms / messages,
+           overlapped ? "ok" : "failed");
+
+    receiver->setSilent(true);
+    start = Clock::now();
+    bool acknowledged = gps.setDynamicModel(
+        ublox_msgs::CfgNAV5::DYN_MODEL_PORTABLE);
+    printf("no ACK      timed out after %.1f ms (timeout %.0f ms)%s\n",
+           elapsed(start), Gps::kDefaultAckTimeout * 1e3,
+           acknowledged ? ", unexpected ACK" : "");
+    receiver->stop();
+  }
+  return 0;
+}
@@ -0,0 +1,192 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//
+// Measures how decoding and publishing scale with the decode threads of
+// CallbackHandlers.
+//
+// Usage: decode_benchmark [max_threads [raw_log ...]]
+//
+// The raw logs, e.g. the files written by the raw data logger or by the
+// driver with debug >= 4, are replayed through CallbackHandlers in reads of
+// 4 KB, first decoding on the reading thread and then with 1 to max_threads
+// decode threads, which defaults to the number of CPUs. The callbacks
+// serialize the decoded messages like ros::Publisher::publish does. When no
+// logs are given, 60 s of synthetic 20 Hz OBSVM, BESTPOS and AGRIC messages
+// with GGA and RMC sentences are used, like the output of a UM982.
+//
+// The frames are distributed to the threads by their message type, so the
+// speedup depends on the mix of message types in the log and is limited by
+// the most expensive type, e.g. the OBSVM with its observations.
+//
+
+#include <ublox_gps/gps.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <ros/serialization.h>
+
+#include "synthetic_log.h"
+
+using namespace ublox_gps;
+
+namespace {
+
+//! The number of messages passed to the callbacks
+boost::atomic<uint64_t> handled(0);
+
+/**
+ * @brief Serialize the message like a publisher.
+ */
+template <typename T>
+void publish(const T& message) {
+  ros::SerializedMessage serialized =
+      ros::serialization::serializeMessage(message);
+  handled.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void count(boost::string_ref) {
+  handled.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void countRtcm(const uint8_t*, std::size_t) {
+  handled.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void subscribe(CallbackHandlers& handlers) {
+  handlers.insert<ublox_msgs::NavPVT>(&publish<ublox_msgs::NavPVT>);
+  handlers.insert<ublox_msgs::NavSAT>(&publish<ublox_msgs::NavSAT>);
+  handlers.insert<ublox_msgs::RxmRAWX>(&publish<ublox_msgs::RxmRAWX>);
+  handlers.insert<ublox_msgs::RxmSFRBX>(&publish<ublox_msgs::RxmSFRBX>);
+  handlers.insert<ublox_msgs::NavRELPOSNED9>(
+      &publish<ublox_msgs::NavRELPOSNED9>);
+  handlers.insert<ublox_msgs::NavHPPOSLLH>(&publish<ublox_msgs::NavHPPOSLLH>);
+  handlers.insert<ublox_msgs::BESTPOS>(&publish<ublox_msgs::BESTPOS>);
+  handlers.insert<ublox_msgs::AGRIC>(&publish<ublox_msgs::AGRIC>);
+  handlers.insert<ublox_msgs::OBSVM>(&publish<ublox_msgs::OBSVM>);
+  handlers.set_nmea_callback(&count);
+  handlers.set_rtcm_callback(&countRtcm);
+}
+
+/**
+ * @brief Pass the log to the callback handlers like the I/O worker.
+ */
+void replay(CallbackHandlers& handlers, const std::vector<uint8_t>& log) {
+  const std::size_t kRead = 4096;
+  std::vector<unsigned char> in(2 * ublox::kMaxPayloadLength + kRead);
+  std::size_t pending = 0;
+  for (std::size_t i = 0; i < log.size(); i += kRead) {
+    std::size_t read = std::min(kRead, log.size() - i);
+    memcpy(in.data() + pending, log.data() + i, read);
+    std::size_t size = pending + read;
+    handlers.readCallback(in.data(), size);
+    // Keep the incomplete frame at the start of the buffer
+    memmove(in.data(), in.data() + pending + read - size, size);
+    pending = size;
+  }
+}
+
+/**
+ * @brief Replay the log and wait until all messages were handled.
+ * @param threads the number of decode threads, 0 to decode while reading
+ * @param depth the depth of the decode queues
+ * @param expected the number of messages to wait for, 0 to not wait
+ * @param statistics the counters of the framer output
+ * @return the time in seconds
+ */
+double run(const std::vector<uint8_t>& log, std::size_t threads,
+           std::size_t depth, uint64_t expected,
+           FramerStatistics& statistics) {
+  CallbackHandlers handlers;
+  subscribe(handlers);
+  if (threads > 0)
+    handlers.startDecodeThreads(depth, threads);
+  handled.store(0);
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  replay(handlers, log);
+  while (handled.load() < expected)
+    handlers.waitDecoded(boost::posix_time::milliseconds(10));
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  statistics = handlers.statistics();
+  handlers.stopDecodeThreads();
+  return seconds;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ros::Time::init();
+  std::size_t max_threads = argc > 1 ? atoi(argv[1]) :
+      boost::thread::hardware_concurrency();
+  std::vector<uint8_t> log;
+  for (int i = 2; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Could not open %s\n", argv[i]);
+      return 1;
+    }
+    log.insert(log.end(), std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  }
+  if (log.empty())
+    benchmark::unicoreLog(log);
+
+  // The messages handled while reading are the reference, the queues hold
+  // all frames so that none is dropped
+  FramerStatistics statistics;
+  double baseline = run(log, 0, 0, 0, statistics);
+  uint64_t expected = handled.load();
+  std::size_t depth = statistics.frames + 1;
+  printf("%zu bytes, %lu frames, %lu handled, %s input\n", log.size(),
+         static_cast<unsigned long>(statistics.frames),
+         static_cast<unsigned long>(expected),
+         argc > 2 ? "recorded" : "synthetic");
+  printf("inline      %8.1f ms  %8.0f msg/s\n", baseline * 1e3,
+         expected / baseline);
+
+  double single = 0;
+  for (std::size_t threads = 1; threads <= max_threads; ++threads) {
+    double seconds = run(log, threads, depth, expected, statistics);
+    if (threads == 1)
+      single = seconds;
+    printf("%2zu threads  %8.1f ms  %8.0f msg/s  %5.2fx  %lu dropped\n",
+           threads, seconds * 1e3, expected / seconds, single / seconds,
+           static_cast<unsigned long>(statistics.dropped));
+  }
+  return 0;
+}
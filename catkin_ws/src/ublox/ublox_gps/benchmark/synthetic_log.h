@@ -0,0 +1,164 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_BENCHMARK_SYNTHETIC_LOG_H
+#define UBLOX_GPS_BENCHMARK_SYNTHETIC_LOG_H
+
+#include <ublox/checksum.h>
+#include <ublox/serialization/ublox_msgs.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+///
+/// This file builds the synthetic raw logs which the benchmarks replay when
+/// no recorded log is given.
+///
+
+namespace benchmark {
+
+/**
+ * @brief Append the encoded UBX message to the log.
+ */
+template <typename T>
+void append(std::vector<uint8_t>& log, const T& message) {
+  std::vector<uint8_t> out(ublox::kMaxPayloadLength + 8);
+  ublox::Writer writer(out.data(), out.size());
+  writer.write(message);
+  log.insert(log.end(), out.data(), writer.end());
+}
+
+/**
+ * @brief Append a Unicore binary frame whose header fields are all zero.
+ * @param class_id the third sync character, UMBIN for the 28 byte header or
+ * UMOEM for the 24 byte header
+ * @param message_id the message ID
+ * @param payload the bytes after the header
+ */
+inline void appendUnicore(std::vector<uint8_t>& log, uint8_t class_id,
+                          uint16_t message_id,
+                          const std::vector<uint8_t>& payload) {
+  const bool oem = class_id == ublox_msgs::Class::UMOEM;
+  std::vector<uint8_t> frame(oem ? 24 : 28, 0);
+  const std::size_t length_offset = oem ? 6 : 8;
+  frame[0] = 0xAA;
+  frame[1] = 0x44;
+  frame[2] = class_id;
+  if (!oem)
+    frame[3] = 28;
+  frame[4] = message_id & 0xFF;
+  frame[5] = message_id >> 8;
+  frame[length_offset] = payload.size() & 0xFF;
+  frame[length_offset + 1] = payload.size() >> 8;
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  uint32_t crc = ublox::CalculateCRC32(frame.data(), frame.size());
+  for (int i = 0; i < 4; ++i)
+    frame.push_back((crc >> (8 * i)) & 0xFF);
+  log.insert(log.end(), frame.begin(), frame.end());
+}
+
+/**
+ * @brief Append the NMEA sentence with its checksum and line terminator.
+ * @param sentence the sentence without '$' and checksum
+ */
+inline void appendNmea(std::vector<uint8_t>& log, const std::string& sentence) {
+  uint8_t checksum = 0;
+  for (std::size_t i = 0; i < sentence.size(); ++i)
+    checksum ^= sentence[i];
+  char end[6];
+  snprintf(end, sizeof(end), "*%02X\r\n", checksum);
+  log.push_back('$');
+  log.insert(log.end(), sentence.begin(), sentence.end());
+  log.insert(log.end(), end, end + 5);
+}
+
+/**
+ * @brief Build a log with 60 s of 20 Hz NavPVT, RxmRAWX and NavRELPOSNED9
+ * messages.
+ * @param log the log output
+ * @param satellites whether to add a NavSAT and 8 RxmSFRBX per second, like
+ * a raw data configuration
+ */
+inline void syntheticLog(std::vector<uint8_t>& log, bool satellites) {
+  ublox_msgs::NavPVT pvt;
+  ublox_msgs::NavSAT sat;
+  sat.numSvs = 40;
+  sat.sv.resize(sat.numSvs);
+  ublox_msgs::RxmRAWX raw;
+  raw.numMeas = 60;
+  raw.meas.resize(raw.numMeas);
+  ublox_msgs::RxmSFRBX sfrbx;
+  sfrbx.numWords = 10;
+  sfrbx.dwrd.resize(sfrbx.numWords);
+  ublox_msgs::NavRELPOSNED9 relpos;
+  for (uint32_t epoch = 0; epoch < 60 * 20; ++epoch) {
+    pvt.iTOW = sat.iTOW = relpos.iTOW = epoch * 50;
+    raw.rcvTOW = epoch * 0.05;
+    append(log, pvt);
+    append(log, raw);
+    append(log, relpos);
+    if (satellites && epoch % 20 == 0) {
+      append(log, sat);
+      for (int i = 0; i < 8; ++i)
+        append(log, sfrbx);
+    }
+  }
+}
+
+/**
+ * @brief Build a log with 60 s of 20 Hz OBSVM, BESTPOS and AGRIC messages
+ * and GGA and RMC sentences, like a UM982 configured by the driver.
+ * @param log the log output
+ */
+inline void unicoreLog(std::vector<uint8_t>& log) {
+  // OBSVM with 60 observations of 40 bytes after the count
+  const uint32_t observations = 60;
+  std::vector<uint8_t> obsvm(4 + 40 * observations, 0);
+  obsvm[0] = observations;
+  const std::vector<uint8_t> bestpos(72, 0), agric(232, 0);
+  const std::string gga =
+      "GPGGA,120000.00,3110.4691,N,12123.2661,E,4,24,0.6,12.3,M,9.8,M,1.0,0000";
+  const std::string rmc =
+      "GPRMC,120000.00,A,3110.4691,N,12123.2661,E,0.0,0.0,010124,,,D";
+  for (uint32_t epoch = 0; epoch < 60 * 20; ++epoch) {
+    appendUnicore(log, ublox_msgs::Class::UMOEM,
+                  ublox_msgs::Message::UMOEM::OBSVM, obsvm);
+    appendUnicore(log, ublox_msgs::Class::UMBIN,
+                  ublox_msgs::Message::UMBIN::BESTPOS, bestpos);
+    appendUnicore(log, ublox_msgs::Class::UMOEM,
+                  ublox_msgs::Message::UMOEM::AGRIC, agric);
+    appendNmea(log, gga);
+    appendNmea(log, rmc);
+  }
+}
+
+}  // namespace benchmark
+
+#endif  // UBLOX_GPS_BENCHMARK_SYNTHETIC_LOG_H
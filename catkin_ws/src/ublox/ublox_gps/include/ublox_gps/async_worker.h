@@ -31,6 +31,9 @@
 
 #include <ublox_gps/gps.h>
 
+#include <deque>
+#include <vector>
+
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
@@ -38,11 +41,19 @@
 #include <boost/thread/condition.hpp>
 
 
+#include "ring_buffer.h"
 #include "worker.h"
 
 namespace ublox_gps {
 
-int debug; //!< Used to determine which debug messages to display
+extern int debug; //!< Used to determine which debug messages to display
+
+//! Default size of the input buffer, holds several 20 Hz raw observation epochs
+const std::size_t kDefaultReadBufferSize = 65536;
+//! Default number of frames queued for the decode thread
+const std::size_t kDefaultDecodeQueueDepth = 256;
+//! Maximum time [ms] send() waits for the output queue to drain
+const int kSendTimeoutMs = 200;
 
 /**
  * @brief Handles Asynchronous I/O reading and writing.
@@ -57,11 +68,13 @@ class AsyncWorker : public Worker {
    * @brief Construct an Asynchronous I/O worker.
    * @param stream the stream for th I/O service
    * @param io_service the I/O service
-   * @param buffer_size the size of the input and output buffers
+   * @param buffer_size the size of the output buffer
+   * @param read_buffer_size the minimum size of the input buffer
    */
   AsyncWorker(boost::shared_ptr<StreamT> stream,
               boost::shared_ptr<boost::asio::io_service> io_service,
-              std::size_t buffer_size = 8192);
+              std::size_t buffer_size = 8192,
+              std::size_t read_buffer_size = kDefaultReadBufferSize);
   virtual ~AsyncWorker();
 
   /**
@@ -77,9 +90,14 @@ class AsyncWorker : public Worker {
   void setRawDataCallback(const Callback& callback) { write_callback_ = callback; }
 
   /**
-   * @brief Send the data bytes via the I/O stream.
+   * @brief Queue the data bytes to be sent via the I/O stream.
+   *
+   * @details The bytes are written asynchronously by the I/O thread. If the
+   * output queue is full, the caller is blocked until the device took enough
+   * bytes, at most kSendTimeoutMs.
    * @param data the buffer of data bytes to send
    * @param size the size of the buffer
+   * @return false if the bytes did not fit into the output queue in time
    */
   bool send(const unsigned char* data, const unsigned int size);
   /**
@@ -104,10 +122,23 @@ class AsyncWorker : public Worker {
   void readEnd(const boost::system::error_code&, std::size_t);
 
   /**
-   * @brief Send all the data in the output buffer.
+   * @brief Start writing the queued output buffers.
    */
   void doWrite();
 
+  /**
+   * @brief Return the written buffers to the pool and continue with the
+   * buffers queued in the meantime.
+   * @param error_code an error code for write failures
+   * @param the number of bytes sent
+   */
+  void writeEnd(const boost::system::error_code&, std::size_t);
+
+  /**
+   * @brief Print the bytes of the buffers which are written.
+   */
+  void printWrite() const;
+
   /**
    * @brief Close the I/O stream.
    */
@@ -118,13 +149,26 @@ class AsyncWorker : public Worker {
 
   Mutex read_mutex_; //!< Lock for the input buffer
   boost::condition read_condition_;
-  std::vector<unsigned char> in_; //!< The input buffer
-  std::size_t in_buffer_size_; //!< number of bytes currently in the input
-                               //!< buffer
+  RingBuffer in_; //!< The input buffer
+  //! The fill level above which the high-water mark is reported as warning
+  std::size_t in_warn_level_;
 
-  Mutex write_mutex_; //!< Lock for the output buffer
+  typedef std::vector<unsigned char> Buffer;
+
+  Mutex write_mutex_; //!< Lock for the output queue
+  //! Notified when written buffers leave the output queue
   boost::condition write_condition_;
-  std::vector<unsigned char> out_; //!< The output buffer
+  //! The buffers to send, one per call of send(). The first in_flight_
+  //! buffers are being written.
+  std::deque<Buffer> out_;
+  //! Sent buffers, whose memory is reused for the next calls of send()
+  std::vector<Buffer> pool_;
+  //! The number of buffers of the current write
+  std::size_t in_flight_;
+  //! The number of bytes in the output queue
+  std::size_t out_size_;
+  //! The maximum number of bytes in the output queue
+  std::size_t out_capacity_;
 
   boost::shared_ptr<boost::thread> background_thread_; //!< thread for the I/O
                                                        //!< service
@@ -137,14 +181,18 @@ class AsyncWorker : public Worker {
 template <typename StreamT>
 AsyncWorker<StreamT>::AsyncWorker(boost::shared_ptr<StreamT> stream,
         boost::shared_ptr<boost::asio::io_service> io_service,
-        std::size_t buffer_size)
-    : stopping_(false) {
+        std::size_t buffer_size, std::size_t read_buffer_size)
+    // The buffer must hold an incomplete frame of maximum size plus the next
+    // read, so that the framer never has to drop a frame in progress
+    : in_(std::max(read_buffer_size,
+                   2 * static_cast<std::size_t>(ublox::kMaxPayloadLength))),
+      in_flight_(0), out_size_(0), out_capacity_(buffer_size),
+      stopping_(false) {
   stream_ = stream;
   io_service_ = io_service;
-  in_.resize(buffer_size);
-  in_buffer_size_ = 0;
-
-  out_.reserve(buffer_size);
+  in_warn_level_ = in_.capacity() / 2;
+  ROS_DEBUG("U-Blox ASIO input buffer: %zu bytes, %s", in_.capacity(),
+            in_.mirrored() ? "mirrored" : "linear");
 
   io_service_->post(boost::bind(&AsyncWorker<StreamT>::doRead, this));
   background_thread_.reset(new boost::thread(
@@ -167,67 +215,115 @@ bool AsyncWorker<StreamT>::send(const unsigned char* data,
     return true;
   }
 
-  if (out_.capacity() - out_.size() < size) {
-    ROS_ERROR("Ublox AsyncWorker::send: Output buffer too full to send message");
-    return false;
+  // Wait until the device took enough of the queued bytes, unless this is
+  // the I/O thread, which writes them
+  boost::system_time wait_until = boost::get_system_time() +
+      boost::posix_time::milliseconds(kSendTimeoutMs);
+  bool io_thread =
+      boost::this_thread::get_id() == background_thread_->get_id();
+  while (out_size_ > 0 && out_size_ + size > out_capacity_) {
+    if (io_thread || !write_condition_.timed_wait(lock, wait_until)) {
+      ROS_ERROR_THROTTLE(1.0, "Ublox AsyncWorker::send: Output buffer too "
+                         "full to send message, %zu bytes queued",
+                         out_size_);
+      return false;
+    }
+  }
+
+  // Reuse the memory of a sent buffer
+  if (pool_.empty()) {
+    out_.push_back(Buffer());
+  } else {
+    out_.push_back(std::move(pool_.back()));
+    pool_.pop_back();
   }
-  out_.insert(out_.end(), data, data + size);
+  out_.back().assign(data, data + size);
+  out_size_ += size;
 
-  io_service_->post(boost::bind(&AsyncWorker<StreamT>::doWrite, this));
+  if (in_flight_ == 0)
+    io_service_->post(boost::bind(&AsyncWorker<StreamT>::doWrite, this));
   return true;
 }
 
 template <typename StreamT>
 void AsyncWorker<StreamT>::doWrite() {
   ScopedLock lock(write_mutex_);
-  // Do nothing if out buffer is empty
-  if (out_.size() == 0) {
+  // Do nothing if a write is in progress or the queue is empty
+  if (in_flight_ > 0 || out_.empty()) {
     return;
   }
-  // Write all the data in the out buffer
-  boost::asio::write(*stream_, boost::asio::buffer(out_.data(), out_.size()));
-
-  if (debug >= 2) {
-    // Print the data that was sent
-    std::ostringstream oss;
-    for (std::vector<unsigned char>::iterator it = out_.begin();
-         it != out_.end(); ++it)
-      oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
-    ROS_DEBUG("U-Blox sent %li bytes: \n%s", out_.size(), oss.str().c_str());
-  }
-  // Clear the buffer & unlock
-  out_.clear();
-  write_condition_.notify_all();
+  // Write all queued buffers at once
+  std::vector<boost::asio::const_buffer> buffers;
+  buffers.reserve(out_.size());
+  for (std::size_t i = 0; i < out_.size(); ++i)
+    buffers.push_back(boost::asio::buffer(out_[i]));
+  in_flight_ = out_.size();
+  if (debug >= 2) printWrite();
+
+  boost::asio::async_write(*stream_, buffers,
+      boost::bind(&AsyncWorker<StreamT>::writeEnd, this,
+                  boost::asio::placeholders::error,
+                  boost::asio::placeholders::bytes_transferred));
 }
+
 template <>
 inline void AsyncWorker<boost::asio::ip::udp::socket>::doWrite() {
   ScopedLock lock(write_mutex_);
-  // Do nothing if out buffer is empty
-  if (out_.size() == 0) {
+  // Do nothing if a write is in progress or the queue is empty
+  if (in_flight_ > 0 || out_.empty()) {
     return;
   }
-  // Write all the data in the out buffer
-  stream_->send(boost::asio::buffer(out_.data(), out_.size()));
-
-  if (debug >= 2) {
-    // Print the data that was sent
-    std::ostringstream oss;
-    for (std::vector<unsigned char>::iterator it = out_.begin();
-         it != out_.end(); ++it)
-      oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
-    ROS_DEBUG("U-Blox sent %li bytes: \n%s", out_.size(), oss.str().c_str());
+  // Send one datagram per buffer
+  in_flight_ = 1;
+  if (debug >= 2) printWrite();
+
+  stream_->async_send(boost::asio::buffer(out_.front()),
+      boost::bind(&AsyncWorker<boost::asio::ip::udp::socket>::writeEnd, this,
+                  boost::asio::placeholders::error,
+                  boost::asio::placeholders::bytes_transferred));
+}
+
+template <typename StreamT>
+void AsyncWorker<StreamT>::writeEnd(const boost::system::error_code& error,
+                                    std::size_t bytes_transfered) {
+  ScopedLock lock(write_mutex_);
+  if (error) {
+    ROS_ERROR("U-Blox ASIO write error: %s, %li of %zu bytes sent",
+              error.message().c_str(), bytes_transfered, out_size_);
+  }
+  // Return the written buffers to the pool
+  for (; in_flight_ > 0; --in_flight_) {
+    out_size_ -= out_.front().size();
+    pool_.push_back(std::move(out_.front()));
+    out_.pop_front();
   }
-  // Clear the buffer & unlock
-  out_.clear();
   write_condition_.notify_all();
+
+  if (!out_.empty())
+    io_service_->post(boost::bind(&AsyncWorker<StreamT>::doWrite, this));
 }
+
+template <typename StreamT>
+void AsyncWorker<StreamT>::printWrite() const {
+  // Print the data that is sent
+  std::ostringstream oss;
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < in_flight_; ++i) {
+    for (Buffer::const_iterator it = out_[i].begin(); it != out_[i].end();
+         ++it)
+      oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
+    size += out_[i].size();
+  }
+  ROS_DEBUG("U-Blox sent %li bytes: \n%s", size, oss.str().c_str());
+}
+
 // for uart serail
 template <typename StreamT>
 void AsyncWorker<StreamT>::doRead() {
   ScopedLock lock(read_mutex_);
+  unsigned char *start = in_.writePtr();
   stream_->async_read_some(
-      boost::asio::buffer(in_.data() + in_buffer_size_,
-                          in_.size() - in_buffer_size_),
+      boost::asio::buffer(start, in_.space()),
                           boost::bind(&AsyncWorker<StreamT>::readEnd, this,
                               boost::asio::placeholders::error,
                               boost::asio::placeholders::bytes_transferred));
@@ -236,9 +332,9 @@ void AsyncWorker<StreamT>::doRead() {
 template <>
 inline void AsyncWorker<boost::asio::ip::udp::socket>::doRead() {
   ScopedLock lock(read_mutex_);
+  unsigned char *start = in_.writePtr();
   stream_->async_receive(
-      boost::asio::buffer(in_.data() + in_buffer_size_,
-                          in_.size() - in_buffer_size_),
+      boost::asio::buffer(start, in_.space()),
                           boost::bind(&AsyncWorker<boost::asio::ip::udp::socket>::readEnd, this,
                               boost::asio::placeholders::error,
                               boost::asio::placeholders::bytes_transferred));
@@ -253,48 +349,49 @@ void AsyncWorker<StreamT>::readEnd(const boost::system::error_code& error,
               error.message().c_str(),
               bytes_transfered);
   } else if (bytes_transfered > 0) {
-    in_buffer_size_ += bytes_transfered;
-
-    unsigned char *pRawDataStart = &(*(in_.begin() + (in_buffer_size_ - bytes_transfered)));
+    // doRead() received the bytes at the write position
+    unsigned char *pRawDataStart = in_.data() + in_.size();
     std::size_t raw_data_stream_size = bytes_transfered;
+    in_.commit(bytes_transfered);
 
     if (write_callback_)
       write_callback_(pRawDataStart, raw_data_stream_size);
 
     if (debug >= 4) {
-      /*
-      std::ostringstream oss;
-      for (std::vector<unsigned char>::iterator it =
-               in_.begin() + in_buffer_size_ - bytes_transfered;
-           it != in_.begin() + in_buffer_size_; ++it)
-        oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
-      ROS_DEBUG("U-Blox received %li bytes \n%s", bytes_transfered,
-               oss.str().c_str());
-      */
       // show me total
       std::ostringstream oss;
-      for (std::vector<unsigned char>::iterator it =
-               in_.begin();
-           it != in_.begin() + in_buffer_size_; ++it)
+      for (const unsigned char *it = in_.data();
+           it != in_.data() + in_.size(); ++it)
         oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
-      ROS_DEBUG("ASIO all bufer %li bytes,fill %li byte \n%s", in_buffer_size_,bytes_transfered,
-               oss.str().c_str());
+      ROS_DEBUG("ASIO all bufer %li bytes,fill %li byte \n%s", in_.size(),
+                bytes_transfered, oss.str().c_str());
+    }
+
+    if (in_.highWaterMark() > in_warn_level_) {
+      ROS_WARN("U-Blox ASIO input buffer high-water mark %zu of %zu bytes",
+               in_.highWaterMark(), in_.capacity());
+      in_warn_level_ = in_.highWaterMark() + in_.capacity() / 8;
+    }
+
+    // decode in reader, the callback leaves the unprocessed bytes at the end
+    if (read_callback_) {
+      std::size_t size = in_.size();
+      read_callback_(in_.data(), size);
+      in_.consume(in_.size() - size);
     }
-    // decode in reader
-    if (read_callback_)
-      read_callback_(in_.data(), in_buffer_size_);
     
     read_condition_.notify_all();
   }
 
   // Check for buffer overflow
-  // The remaining buffer size in_.size() - in_buffer_size_ must be at least
-  // one byte. Otherwise readEnd() and doRead() start to busy-wait without
-  // a chance to recover.
-  if (in_buffer_size_ >= in_.size()) {
-    ROS_ERROR("U-Blox ASIO input buffer overflow, dropping %zu bytes",
-	      in_buffer_size_);
-    in_buffer_size_ = 0;
+  // The free space must be at least one byte. Otherwise readEnd() and
+  // doRead() start to busy-wait without a chance to recover. This only
+  // happens if a frame does not fit into the buffer, drop its first byte so
+  // that the reader resynchronizes on the following data.
+  if (in_.size() >= in_.capacity()) {
+    ROS_ERROR("U-Blox ASIO input buffer overflow, dropping 1 of %zu bytes",
+	      in_.size());
+    in_.consume(1);
   }
   // try read again
   if (!stopping_)
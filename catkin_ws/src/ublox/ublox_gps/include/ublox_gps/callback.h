@@ -30,12 +30,31 @@
 #define UBLOX_GPS_CALLBACK_H
 
 #include <ros/console.h>
+#include <ros/time.h>
 #include <ublox/serialization/ublox_msgs.h>
+#include <ublox/framer.h>
+#include <ublox_gps/dispatch_table.h>
+#include <ublox_gps/frame_queue.h>
+#include <ublox_gps/message_pool.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <boost/function.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
+#include <boost/utility/string_ref.hpp>
 
+#include <pthread.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <vector>
 
 namespace ublox_gps {
 
@@ -46,8 +65,14 @@ class CallbackHandler {
  public:
   /**
    * @brief Decode the u-blox message.
+   * @param frame the frame containing the message
    */
-  virtual void handle(ublox::Reader& reader) = 0;
+  virtual void handle(const ublox::FrameView& frame) = 0;
+
+  /**
+   * @brief Can the handler decode messages with the given ID?
+   */
+  virtual bool canDecode(uint8_t class_id, uint32_t message_id) const = 0;
 
   /**
    * @brief Wait for on the condition.
@@ -82,29 +107,37 @@ class CallbackHandler_ : public CallbackHandler {
    */
   virtual const T& get() { return message_; }
 
+  /**
+   * @brief Wait for the next message and copy it while the handler is locked,
+   * so it is not overwritten by a frame decoded at the same time.
+   * @param message the received message
+   * @param timeout the maximum time to wait
+   * @return true if a message was received before the timeout
+   */
+  bool wait(T& message, const boost::posix_time::time_duration& timeout) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!condition_.timed_wait(lock, timeout)) return false;
+    message = message_;
+    return true;
+  }
+
   /**
    * @brief Decode the U-Blox message & call the callback function if it exists.
-   * @param reader a reader to decode the message buffer
+   * @param frame the frame containing the message
    */
-  void handle(ublox::Reader& reader) {
+  void handle(const ublox::FrameView& frame) {
     boost::mutex::scoped_lock lock(mutex_);
-    ROS_DEBUG("handle read for class_id[%02x] msg_id[%04x]",reader.classId(),reader.messageId());
+    ROS_DEBUG("handle read for class_id[%02x] msg_id[%04x]", frame.class_id,
+              frame.message_id);
     try {
-      if (!reader.read<T>(message_)) {
-        ROS_DEBUG_COND(debug >= 2, 
-                       "U-Blox Decoder error for 0x%02x / 0x%02x (%d bytes)", 
-                       static_cast<unsigned int>(reader.classId()),
-                       static_cast<unsigned int>(reader.messageId()),
-                       reader.length());
-        condition_.notify_all();
-        return;
-      }
+      // The dispatch table only contains the IDs this type can decode
+      ublox::deserialize<T>(frame, message_);
     } catch (std::runtime_error& e) {
       ROS_DEBUG_COND(debug >= 2, 
-                     "U-Blox Decoder error for 0x%02x / 0x%02x (%d bytes)", 
-                     static_cast<unsigned int>(reader.classId()),
-                     static_cast<unsigned int>(reader.messageId()),
-                     reader.length());
+                     "U-Blox Decoder error for 0x%02x / 0x%02x (%u bytes)", 
+                     static_cast<unsigned int>(frame.class_id),
+                     static_cast<unsigned int>(frame.message_id),
+                     frame.payload_length);
       condition_.notify_all();
       return;
     }
@@ -112,17 +145,302 @@ class CallbackHandler_ : public CallbackHandler {
     if (func_) func_(message_);
     condition_.notify_all();
   }
+
+  bool canDecode(uint8_t class_id, uint32_t message_id) const {
+    return ublox::Message<T>::canDecode(class_id, message_id);
+  }
   
  private:
   Callback func_; //!< the callback function to handle the message
   T message_; //!< The last received message
 };
 
+/**
+ * @brief A callback handler which decodes each u-blox message into a pooled
+ * message and passes it as a shared pointer, e.g. to publish it as ConstPtr.
+ * @typedef T the message type
+ */
+template <typename T>
+class SharedCallbackHandler_ : public CallbackHandler {
+ public:
+  //! A callback function
+  typedef boost::function<void(const boost::shared_ptr<const T>&)> Callback;
+
+  /**
+   * @param func a callback function for the message
+   */
+  SharedCallbackHandler_(const Callback& func) : func_(func) {}
+
+  /**
+   * @brief Decode the U-Blox message & call the callback function.
+   * @param frame the frame containing the message
+   */
+  void handle(const ublox::FrameView& frame) {
+    boost::mutex::scoped_lock lock(mutex_);
+    // A released message keeps the capacity of its arrays
+    typename MessagePool<T>::Ptr message = pool_.get();
+    try {
+      ublox::deserialize<T>(frame, *message);
+    } catch (std::runtime_error& e) {
+      ROS_DEBUG_COND(debug >= 2,
+                     "U-Blox Decoder error for 0x%02x / 0x%02x (%u bytes)",
+                     static_cast<unsigned int>(frame.class_id),
+                     static_cast<unsigned int>(frame.message_id),
+                     frame.payload_length);
+      condition_.notify_all();
+      return;
+    }
+    if (func_) func_(message);
+    condition_.notify_all();
+  }
+
+  bool canDecode(uint8_t class_id, uint32_t message_id) const {
+    return ublox::Message<T>::canDecode(class_id, message_id);
+  }
+
+ private:
+  Callback func_; //!< the callback function to handle the message
+  MessagePool<T> pool_; //!< The decoded messages
+};
+
+/**
+ * @brief A callback handler which passes a read-only view of the message in
+ * the frame instead of decoding it.
+ * @typedef V a view generated by ublox_msgs with CLASS_ID and MESSAGE_ID
+ */
+template <typename V>
+class ViewCallbackHandler_ : public CallbackHandler {
+ public:
+  typedef boost::function<void(const V&)> Callback; //!< A callback function
+
+  /**
+   * @param func a callback function for the message
+   */
+  ViewCallbackHandler_(const Callback& func) : func_(func) {}
+
+  /**
+   * @brief Call the callback function with the view of the message.
+   * @param frame the frame containing the message
+   */
+  void handle(const ublox::FrameView& frame) {
+    boost::mutex::scoped_lock lock(mutex_);
+    V view(frame);
+    if (!view.valid()) {
+      ROS_DEBUG_COND(debug >= 2,
+                     "U-Blox Decoder error for 0x%02x / 0x%02x (%u bytes)",
+                     static_cast<unsigned int>(frame.class_id),
+                     static_cast<unsigned int>(frame.message_id),
+                     frame.payload_length);
+    } else if (func_) {
+      func_(view);
+    }
+    condition_.notify_all();
+  }
+
+  //! The view is only subscribed to its own message
+  bool canDecode(uint8_t, uint32_t) const { return true; }
+
+ private:
+  Callback func_; //!< the callback function to handle the message
+};
+
+/**
+ * @brief A handler of a pending request, which is completed by the first
+ * matching message or failed when its deadline passes.
+ */
+class RequestHandler {
+ public:
+  //! The clock of the deadlines, which is not affected by time adjustments
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @param deadline the time at which the request fails
+   */
+  RequestHandler(const Clock::time_point& deadline)
+      : deadline_(deadline), done_(false) {}
+
+  virtual ~RequestHandler() {}
+
+  /**
+   * @brief Complete the request with the message in the frame.
+   * @param frame the frame containing the message
+   * @return true if the frame completed the request, it is then not passed
+   * to the later requests for the same message
+   */
+  virtual bool complete(const ublox::FrameView& frame) = 0;
+
+  /**
+   * @brief Can the handler decode messages with the given ID?
+   */
+  virtual bool canDecode(uint8_t class_id, uint32_t message_id) const = 0;
+
+  /**
+   * @brief Fail the request if its deadline passed.
+   * @param now the current time
+   * @return true if the request is done and can be removed
+   */
+  bool expire(const Clock::time_point& now) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!done_ && now >= deadline_) {
+      done_ = true;
+      timeout();
+    }
+    return done_;
+  }
+
+  //! Get the time at which the request fails
+  const Clock::time_point& deadline() const { return deadline_; }
+
+ protected:
+  /**
+   * @brief Called when the deadline passed before the request was completed.
+   */
+  virtual void timeout() = 0;
+
+  boost::mutex mutex_; //!< Lock for the handler
+  const Clock::time_point deadline_; //!< The time at which the request fails
+  bool done_; //!< Whether the request was completed or failed
+};
+
+/**
+ * @brief A handler of a pending request for a u-blox message.
+ * @typedef T the message type
+ */
+template <typename T>
+class RequestHandler_ : public RequestHandler {
+ public:
+  //! Called with each message which may complete the request and its
+  //! message ID, returns true if it completes the request. Called with NULL
+  //! when the deadline passed.
+  typedef boost::function<bool(const T*, uint32_t)> Callback;
+
+  /**
+   * @param func the callback function for the messages
+   * @param deadline the time at which the request fails
+   */
+  RequestHandler_(const Callback& func, const Clock::time_point& deadline)
+      : RequestHandler(deadline), func_(func) {}
+
+  bool complete(const ublox::FrameView& frame) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (done_) return false;
+    try {
+      ublox::deserialize<T>(frame, message_);
+    } catch (std::runtime_error& e) {
+      ROS_DEBUG_COND(debug >= 2,
+                     "U-Blox Decoder error for 0x%02x / 0x%02x (%u bytes)",
+                     static_cast<unsigned int>(frame.class_id),
+                     static_cast<unsigned int>(frame.message_id),
+                     frame.payload_length);
+      return false;
+    }
+    done_ = func_(&message_, frame.message_id);
+    return done_;
+  }
+
+  bool canDecode(uint8_t class_id, uint32_t message_id) const {
+    return ublox::Message<T>::canDecode(class_id, message_id);
+  }
+
+ protected:
+  void timeout() { func_(NULL, 0); }
+
+ private:
+  Callback func_; //!< the callback function to handle the messages
+  T message_; //!< The last received message
+};
+
+/**
+ * @brief Counters of the frames read by the callback handlers.
+ */
+struct FramerStatistics {
+  //! The total number of frames with a valid checksum
+  uint64_t frames;
+  //! The total number of bytes which did not belong to any frame
+  uint64_t discarded;
+  //! The total number of frames dropped because the decode queue was full
+  uint64_t dropped;
+};
+
 /**
  * @brief Callback handlers for incoming u-blox messages.
  */
 class CallbackHandlers {
  public:
+  CallbackHandlers() : registry_(boost::make_shared<Registry>()),
+                       framer_(ublox::kMaxPayloadLength),
+                       checksum_errors_(0), frames_(0), discarded_(0),
+                       dropped_(0), stopping_(false),
+                       stopping_expiry_(false) {}
+
+  ~CallbackHandlers() {
+    stopDecodeThreads();
+    stopExpiryThread();
+  }
+
+  /**
+   * @brief Get the counters of the framer, may be called from any thread.
+   */
+  FramerStatistics statistics() const {
+    FramerStatistics statistics;
+    statistics.frames = frames_.load(boost::memory_order_relaxed);
+    statistics.discarded = discarded_.load(boost::memory_order_relaxed);
+    statistics.dropped = dropped();
+    return statistics;
+  }
+
+  /**
+   * @brief Decode the frames on separate threads.
+   *
+   * @details The I/O thread then only splits the input into frames and
+   * queues them, so slow callbacks do not delay reading. With more than one
+   * thread, the frames are distributed by their message type: the messages
+   * of a type are decoded by the same thread in the order they were
+   * received, while different types are decoded concurrently, so callbacks
+   * of different types must lock the state they share. Must be called
+   * before the I/O worker calls readCallback().
+   * @param depth the number of frames the queue of each thread holds
+   * @param threads the number of decode threads
+   * @param cpus the CPUs the decode threads are bound to in turn, none to
+   * leave the placement to the scheduler
+   */
+  void startDecodeThreads(std::size_t depth, std::size_t threads = 1,
+                          const std::vector<int>& cpus = std::vector<int>()) {
+    if (!decode_threads_.empty()) return;
+    stopping_.store(false);
+    for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i)
+      queues_.push_back(boost::make_shared<FrameQueue>(depth));
+    for (std::size_t i = 0; i < queues_.size(); ++i) {
+      decode_threads_.push_back(boost::make_shared<boost::thread>(
+          boost::bind(&CallbackHandlers::decodeLoop, this, queues_[i].get())));
+      if (!cpus.empty())
+        setAffinity(*decode_threads_.back(), cpus[i % cpus.size()]);
+    }
+  }
+
+  /**
+   * @brief Stop the decode threads, the frames which are still queued are
+   * dropped. Must not be called while the I/O worker calls readCallback().
+   */
+  void stopDecodeThreads() {
+    stopping_.store(true);
+    for (std::size_t i = 0; i < queues_.size(); ++i)
+      queues_[i]->notify();
+    for (std::size_t i = 0; i < decode_threads_.size(); ++i)
+      decode_threads_[i]->join();
+    decode_threads_.clear();
+    queues_.clear();
+  }
+
+  /**
+   * @brief Wait until frames were decoded.
+   * @param timeout the maximum time to wait
+   */
+  void waitDecoded(const boost::posix_time::time_duration& timeout) {
+    boost::mutex::scoped_lock lock(decoded_mutex_);
+    decoded_condition_.timed_wait(lock, timeout);
+  }
+
   /**
    * @brief Add a callback handler for the given message type.
    * @param callback the callback handler for the message
@@ -130,11 +448,8 @@ class CallbackHandlers {
    */
   template <typename T>
   void insert(typename CallbackHandler_<T>::Callback callback) {
-    boost::mutex::scoped_lock lock(callback_mutex_);
-    CallbackHandler_<T>* handler = new CallbackHandler_<T>(callback);
-    callbacks_.insert(
-      std::make_pair(std::make_pair(T::CLASS_ID, T::MESSAGE_ID),
-                     boost::shared_ptr<CallbackHandler>(handler)));
+    add(std::make_pair(T::CLASS_ID, T::MESSAGE_ID),
+        boost::make_shared<CallbackHandler_<T> >(callback));
   }
 
   /**
@@ -149,61 +464,121 @@ class CallbackHandlers {
   void insert(
       typename CallbackHandler_<T>::Callback callback, 
       unsigned int message_id) {
-    boost::mutex::scoped_lock lock(callback_mutex_);
-    CallbackHandler_<T>* handler = new CallbackHandler_<T>(callback);
-    callbacks_.insert(
-      std::make_pair(std::make_pair(T::CLASS_ID, message_id),
-                     boost::shared_ptr<CallbackHandler>(handler)));
+    add(std::make_pair(T::CLASS_ID, message_id),
+        boost::make_shared<CallbackHandler_<T> >(callback));
   }
 
   /**
-   * @brief Add a callback handler for nmea messages
+   * @brief Add a callback handler which gets the message as a shared pointer
+   * to a pooled message instead of a reference.
    * @param callback the callback handler for the message
+   * @typedef.a ublox_msgs message with CLASS_ID and MESSAGE_ID constants
    */
-  void set_nmea_callback(boost::function<void(const std::string&)> callback) {
-    boost::mutex::scoped_lock lock(callback_mutex_);
-    callback_nmea_ = callback;
+  template <typename T>
+  void insertShared(typename SharedCallbackHandler_<T>::Callback callback) {
+    add(std::make_pair(T::CLASS_ID, T::MESSAGE_ID),
+        boost::make_shared<SharedCallbackHandler_<T> >(callback));
   }
 
   /**
-   * @brief Calls the callback handler for the message in the reader.
-   * @param reader a reader containing a u-blox message
+   * @brief Add a callback handler which gets a read-only view of the message.
+   * @param callback the callback handler for the message
+   * @typedef V a view generated by ublox_msgs
    */
-  void handle(ublox::Reader& reader) {
-    // Find the callback handlers for the message & decode it
-    boost::mutex::scoped_lock lock(callback_mutex_);
-    // key is current asio got msg 
-    Callbacks::key_type key =
-        std::make_pair(reader.classId(), reader.messageId());
-    //ROS_DEBUG("classId[0x%02x] messageId[0x%04x]",reader.classId(),reader.messageId());
-    for (Callbacks::iterator callback = callbacks_.lower_bound(key);
-         callback != callbacks_.upper_bound(key); ++callback)
-    {
-      //ROS_DEBUG("fond serialization for classId[0x%02x] messageId[0x%04x]",reader.classId(),reader.messageId());
-      // the read func maybe callback, if subscrible the msg, call
-      callback->second->handle(reader);
-    }
+  template <typename V>
+  void insertView(typename ViewCallbackHandler_<V>::Callback callback) {
+    add(std::make_pair(static_cast<uint8_t>(V::CLASS_ID),
+                       static_cast<uint32_t>(V::MESSAGE_ID)),
+        boost::make_shared<ViewCallbackHandler_<V> >(callback));
   }
 
   /**
-   * @brief Calls the callback handler for the nmea messages in the reader.
-   * @param reader a reader containing an nmea message
+   * @brief Add a callback handler for nmea messages
+   * @param callback the callback handler for the message, called with the
+   * sentence including the line terminator. The sentence points into the
+   * read buffer and is only valid during the call.
    */
-  void handle_nmea(ublox::Reader& reader) {
-    boost::mutex::scoped_lock lock(callback_mutex_);
-    if(callback_nmea_.empty())
-        return;
+  void set_nmea_callback(boost::function<void(boost::string_ref)> callback) {
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> registry = copyRegistry();
+    registry->nmea = callback;
+    commit(registry);
+  }
 
-    const std::string& buffer = reader.getUnusedData();
-    size_t nmea_start = buffer.find('$', 0);
-    size_t nmea_end = buffer.find('\n', nmea_start);
-    while(nmea_start != std::string::npos && nmea_end != std::string::npos) {
-        std::string sentence = buffer.substr(nmea_start, nmea_end - nmea_start + 1);
-        callback_nmea_(sentence);
+  /**
+   * @brief Add a callback handler for the responses of Unicore receivers to
+   * commands, i.e. the sentences starting with $command.
+   * @param callback the callback handler, called with the sentence, which is
+   * also passed to the nmea callback
+   */
+  void set_command_callback(
+      boost::function<void(boost::string_ref)> callback) {
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> registry = copyRegistry();
+    registry->command = callback;
+    commit(registry);
+  }
 
-        nmea_start = buffer.find('$', nmea_end+1);
-        nmea_end = buffer.find('\n', nmea_start);
+  /**
+   * @brief Calls the callback handler for the message in the frame.
+   * @param frame a UBX or Unicore binary frame
+   */
+  void handle(const ublox::FrameView& frame) {
+    // Find the callback handlers for the message & decode it. The snapshot
+    // keeps the handlers alive while they are called.
+    boost::shared_ptr<const Registry> registry = boost::atomic_load(&registry_);
+    const Callbacks::key_type key(frame.class_id, frame.message_id);
+    Dispatch::iterator begin, end;
+    if (registry->dispatch.find(key, begin, end)) {
+      for (Dispatch::iterator handler = begin; handler != end; ++handler)
+        (*handler)->handle(frame);
     }
+    // The message completes at most one request, the oldest one it matches
+    RequestDispatch::iterator request, last;
+    if (registry->request_dispatch.find(key, request, last)) {
+      for (; request != last; ++request)
+        if ((*request)->complete(frame)) break;
+    }
+  }
+
+  /**
+   * @brief Add a callback handler for RTCM 3 messages
+   * @param callback the callback handler for the message, called with the
+   * complete message including preamble and CRC
+   */
+  void set_rtcm_callback(
+      boost::function<void(const uint8_t*, std::size_t)> callback) {
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> registry = copyRegistry();
+    registry->rtcm = callback;
+    commit(registry);
+  }
+
+  /**
+   * @brief Calls the callback handler for a text frame, i.e. an nmea sentence
+   * or a Unicore ASCII message.
+   * @param frame the text frame including the line terminator
+   */
+  void handle_nmea(const ublox::FrameView& frame) {
+    boost::string_ref sentence(reinterpret_cast<const char*>(frame.data),
+                               frame.size);
+    boost::shared_ptr<const Registry> registry = boost::atomic_load(&registry_);
+    if (!registry->command.empty() && sentence.starts_with("$command,"))
+      registry->command(sentence);
+    if(registry->nmea.empty())
+        return;
+    registry->nmea(sentence);
+  }
+
+  /**
+   * @brief Calls the callback handler for a RTCM 3 frame.
+   * @param frame the RTCM 3 frame
+   */
+  void handle_rtcm(const ublox::FrameView& frame) {
+    boost::shared_ptr<const Registry> registry = boost::atomic_load(&registry_);
+    if(registry->rtcm.empty())
+        return;
+    registry->rtcm(frame.data, frame.size);
   }
 
   /**
@@ -213,28 +588,104 @@ class CallbackHandlers {
    */
   template <typename T>
   bool read(T& message, const boost::posix_time::time_duration& timeout) {
-    bool result = false;
     // Create a callback handler for this message
-    callback_mutex_.lock();
-    CallbackHandler_<T>* handler = new CallbackHandler_<T>();
-    Callbacks::iterator callback = callbacks_.insert(
-      (std::make_pair(std::make_pair(T::CLASS_ID, T::MESSAGE_ID),
-                      boost::shared_ptr<CallbackHandler>(handler))));
-    callback_mutex_.unlock();
+    boost::shared_ptr<CallbackHandler_<T> > handler =
+        boost::make_shared<CallbackHandler_<T> >();
+    add(std::make_pair(T::CLASS_ID, T::MESSAGE_ID), handler);
 
     // Wait for the message
-    if (handler->wait(timeout)) {
-      message = handler->get();
-      result = true;
-    }
-    
+    bool result = handler->wait(message, timeout);
+
     // Remove the callback handler
-    callback_mutex_.lock();
-    callbacks_.erase(callback);
-    callback_mutex_.unlock();
+    remove(handler.get());
     return result;
   }
 
+  /**
+   * @brief Add a request which is completed by the first matching message.
+   *
+   * @details The requests for the same message are offered the messages in
+   * the order they were added, so many requests can be outstanding at the
+   * same time. A request is failed when its deadline passes, even if no
+   * more data is read.
+   * @param callback called with the messages until it returns true, or with
+   * NULL when the deadline passed
+   * @param deadline the time at which the request fails
+   * @param message_ids the IDs of the messages of class T::CLASS_ID which
+   * may complete the request
+   * @typedef T a ublox_msgs message with a CLASS_ID constant
+   * @return the handler of the request, see cancel()
+   */
+  template <typename T>
+  boost::shared_ptr<RequestHandler> request(
+      const typename RequestHandler_<T>::Callback& callback,
+      const RequestHandler::Clock::time_point& deadline,
+      const std::vector<uint32_t>& message_ids) {
+    boost::shared_ptr<RequestHandler> handler =
+        boost::make_shared<RequestHandler_<T> >(callback, deadline);
+    {
+      boost::mutex::scoped_lock lock(write_mutex_);
+      boost::shared_ptr<Registry> registry = copyRegistry();
+      for (std::size_t i = 0; i < message_ids.size(); ++i)
+        registry->requests.insert(std::make_pair(
+            std::make_pair(static_cast<uint8_t>(T::CLASS_ID), message_ids[i]),
+            handler));
+      registry->request_dispatch.build(registry->requests.begin(),
+                                       registry->requests.end(),
+                                       &decodable<RequestHandler>);
+      commit(registry);
+      if (!expiry_thread_)
+        expiry_thread_ = boost::make_shared<boost::thread>(
+            boost::bind(&CallbackHandlers::expireLoop, this));
+    }
+    // Wake up the expiry thread, the deadline may be the earliest
+    std::lock_guard<std::mutex> lock(expiry_mutex_);
+    expiry_condition_.notify_all();
+    return handler;
+  }
+
+  /**
+   * @brief Remove a request without completing or failing it, e.g. if the
+   * message which it waits for could not be sent.
+   * @param handler the handler returned by request()
+   */
+  void cancel(const boost::shared_ptr<RequestHandler>& handler) {
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> registry = copyRegistry();
+    for (Requests::iterator it = registry->requests.begin();
+         it != registry->requests.end(); ) {
+      if (it->second == handler)
+        registry->requests.erase(it++);
+      else
+        ++it;
+    }
+    registry->request_dispatch.build(registry->requests.begin(),
+                                     registry->requests.end(),
+                                     &decodable<RequestHandler>);
+    commit(registry);
+  }
+
+  /**
+   * @brief Read the next u-blox message of the given type without blocking.
+   * @param deadline the time at which the read fails
+   * @param handler set to the handler of the request if not NULL, see
+   * cancel()
+   * @return the future message, it throws std::runtime_error if none was
+   * received before the deadline
+   */
+  template <typename T>
+  std::future<T> readAsync(const RequestHandler::Clock::time_point& deadline,
+                           boost::shared_ptr<RequestHandler>* handler = 0) {
+    boost::shared_ptr<std::promise<T> > promise =
+        boost::make_shared<std::promise<T> >();
+    std::future<T> future = promise->get_future();
+    boost::shared_ptr<RequestHandler> request_handler = request<T>(
+        boost::bind(&CallbackHandlers::fulfil<T>, promise, _1, _2), deadline,
+        std::vector<uint32_t>(1, static_cast<uint32_t>(T::MESSAGE_ID)));
+    if (handler) *handler = request_handler;
+    return future;
+  }
+
   void open_log_file(std::string dir)
   {
         time_t t = time(NULL);
@@ -267,39 +718,17 @@ class CallbackHandlers {
         }
   }
   /**
-   * @brief Processes u-blox messages in the given buffer & clears the read
+   * @brief Processes the messages in the given buffer & clears the read
    * messages from the buffer.
-   * @param data the buffer of u-blox messages to process
+   *
+   * @details The buffer may carry UBX, Unicore binary, Unicore ASCII, NMEA
+   * and RTCM 3 messages at the same time. Every frame is passed to the
+   * handler of its protocol.
+   * @param data the buffer of messages to process
    * @param size the size of the buffer
    */
   // asio worker will call readCallback after device update data
   void readCallback(unsigned char* data, std::size_t& size) {
-
-#if 0
-    ublox::Reader reader(data, size);
-    // Read all U-Blox messages in buffer
-    while (reader.search() != reader.end() && reader.found()) {
-      if (debug >= 3) {
-        // Print the received bytes
-        std::ostringstream oss;
-        for (ublox::Reader::iterator it = reader.pos();
-             it != reader.pos() + reader.length() + 8; ++it)
-          oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
-        ROS_DEBUG("U-blox: reading %d bytes\n%s", reader.length() + 8, 
-                 oss.str().c_str());
-      }
-
-      handle(reader);
-    }
-    handle_nmea(reader);
-    // delete read bytes from ASIO input buffer
-    std::copy(reader.pos(), reader.end(), data); // move the remain buffer to header
-    size -= reader.pos() - data;
-#endif
-    //for UM982
-#if 1
-      //ROS_DEBUG("asio read:%ld from %p",size,(void*)data);
-
       static int cnt  = 0;
       if (debug >= 4) {
           if (!file_handle_.is_open())  {
@@ -322,31 +751,54 @@ class CallbackHandlers {
               }
           }
       }
-      ublox::ReaderUnicore readerUnicore(data, size);
-      bool unicore_msg = false;
-    // Read all U-Blox messages in buffer
-    while (readerUnicore.search() != readerUnicore.end() && readerUnicore.found()) {
+
+    // Continue the frame which was incomplete at the end of the last read
+    framer_.reset(data, size, ros::Time::now().toSec());
+    ublox::FrameView frame;
+    // Read all messages in buffer
+    while (framer_.next(frame)) {
       if (debug >= 4) {
         // Print the received bytes
         std::ostringstream oss;
-        for (ublox::Reader::iterator it = readerUnicore.pos();
-             it != readerUnicore.pos() + readerUnicore.length()+readerUnicore.headLen()+4; ++it)
+        for (ublox::Framer::iterator it = frame.data;
+             it != frame.data + frame.size; ++it)
           oss << boost::format("%02x") % static_cast<unsigned int>(*it) << " ";
-        ROS_DEBUG("unicore: reading %d bytes\n%s", readerUnicore.length()+readerUnicore.headLen()+4, 
-                 oss.str().c_str());
+        ROS_DEBUG("protocol %d: reading %u bytes\n%s", frame.protocol,
+                  frame.size, oss.str().c_str());
       }
-      //ROS_DEBUG("pos1=%p",readerUnicore.pos());
-      handle(readerUnicore);
-      unicore_msg = true;
+
+      if (queues_.empty())
+        dispatch(frame);
+      else
+        queues_[queueIndex(frame)]->push(frame);
     }
-    handle_nmea(readerUnicore);
-    // delete read bytes from ASIO input buffer
-    std::copy(readerUnicore.pos(), readerUnicore.end(), data); // move the remain buffer to header
-    size -= readerUnicore.pos() - data;
-    //ROS_DEBUG("remove size = %ld",readerUnicore.pos() - data);
-    //size = 0;// no data remain 
-#endif
-    
+    if (queues_.empty())
+      notifyDecoded();
+    for (std::size_t i = 0; i < queues_.size(); ++i)
+      queues_[i]->notify();
+    ROS_DEBUG_COND(debug >= 2 && framer_.skipped() > 0,
+                   "skipped %u bytes which do not belong to any message",
+                   framer_.skipped());
+    // A noisy link can corrupt many frames per second, report them at most
+    // once per second
+    if (framer_.checksumErrors() != checksum_errors_) {
+      checksum_errors_ = framer_.checksumErrors();
+      ROS_ERROR_THROTTLE(1.0, "%lu frames dropped because of checksum errors, "
+                         "%lu bytes discarded in total",
+                         static_cast<unsigned long>(checksum_errors_),
+                         static_cast<unsigned long>(framer_.discarded()));
+    }
+    // Slow callbacks let the decode queue overflow
+    if (!queues_.empty() && dropped() != dropped_) {
+      dropped_ = dropped();
+      ROS_WARN_THROTTLE(1.0, "%lu frames dropped because the decode queue "
+                        "is full", static_cast<unsigned long>(dropped_));
+    }
+    frames_.store(framer_.frames(), boost::memory_order_relaxed);
+    discarded_.store(framer_.discarded(), boost::memory_order_relaxed);
+    expireRequests();
+    // keep the incomplete frame at the end of the ASIO input buffer
+    size = framer_.end() - framer_.pos();
   }
 
  private:
@@ -354,12 +806,313 @@ class CallbackHandlers {
   typedef std::multimap<std::pair<uint8_t, uint32_t>,
                         boost::shared_ptr<CallbackHandler> > Callbacks;
 
-  // Call back handlers for u-blox messages
-  Callbacks callbacks_;
-  boost::mutex callback_mutex_;
-  
-  //! Callback handler for nmea messages
-  boost::function<void(const std::string&)> callback_nmea_;
+  typedef DispatchTable<CallbackHandler> Dispatch;
+
+  typedef std::multimap<std::pair<uint8_t, uint32_t>,
+                        boost::shared_ptr<RequestHandler> > Requests;
+
+  typedef DispatchTable<RequestHandler> RequestDispatch;
+
+  /**
+   * @brief Whether the handler can decode the message it was subscribed to.
+   */
+  template <typename Handler>
+  static bool decodable(const Callbacks::key_type& key,
+                        const Handler& handler) {
+    return handler.canDecode(key.first, key.second);
+  }
+
+  /**
+   * @brief Set the value of the promise of readAsync().
+   */
+  template <typename T>
+  static bool fulfil(const boost::shared_ptr<std::promise<T> >& promise,
+                     const T* message, uint32_t) {
+    if (message) {
+      promise->set_value(*message);
+    } else {
+      promise->set_exception(std::make_exception_ptr(std::runtime_error(
+          (boost::format("Timed out reading message 0x%02x / 0x%02x")
+           % static_cast<unsigned int>(T::CLASS_ID)
+           % static_cast<unsigned int>(T::MESSAGE_ID)).str())));
+    }
+    return true;
+  }
+
+  /**
+   * @brief Fail the requests whose deadline passed & remove the requests
+   * which are done.
+   */
+  void expireRequests() {
+    boost::shared_ptr<const Registry> registry = boost::atomic_load(&registry_);
+    if (registry->requests.empty()) return;
+    const RequestHandler::Clock::time_point now =
+        RequestHandler::Clock::now();
+    bool done = false;
+    for (Requests::const_iterator it = registry->requests.begin();
+         it != registry->requests.end(); ++it)
+      done = it->second->expire(now) || done;
+    if (!done) return;
+
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> copy = copyRegistry();
+    for (Requests::iterator it = copy->requests.begin();
+         it != copy->requests.end(); ) {
+      // The requests which were done are still done, even if another thread
+      // removed them in the meantime
+      if (it->second->expire(now))
+        copy->requests.erase(it++);
+      else
+        ++it;
+    }
+    copy->request_dispatch.build(copy->requests.begin(),
+                                 copy->requests.end(),
+                                 &decodable<RequestHandler>);
+    commit(copy);
+  }
+
+  /**
+   * @brief Fail the requests when their deadline passes, also when no data
+   * is read which would call expireRequests().
+   */
+  void expireLoop() {
+    std::unique_lock<std::mutex> lock(expiry_mutex_);
+    while (!stopping_expiry_) {
+      // Requests added after this are notified under the lock
+      boost::shared_ptr<const Registry> registry =
+          boost::atomic_load(&registry_);
+      if (registry->requests.empty()) {
+        expiry_condition_.wait(lock);
+      } else {
+        RequestHandler::Clock::time_point next =
+            RequestHandler::Clock::time_point::max();
+        for (Requests::const_iterator it = registry->requests.begin();
+             it != registry->requests.end(); ++it)
+          next = std::min(next, it->second->deadline());
+        expiry_condition_.wait_until(lock, next);
+      }
+      registry.reset();
+      lock.unlock();
+      expireRequests();
+      lock.lock();
+    }
+  }
+
+  /**
+   * @brief Stop the thread of expireLoop().
+   */
+  void stopExpiryThread() {
+    {
+      std::lock_guard<std::mutex> lock(expiry_mutex_);
+      stopping_expiry_ = true;
+    }
+    expiry_condition_.notify_all();
+    if (expiry_thread_) expiry_thread_->join();
+    expiry_thread_.reset();
+  }
+
+  /**
+   * @brief Pass the frame to the handlers of its protocol.
+   */
+  void dispatch(const ublox::FrameView& frame) {
+    switch (frame.protocol) {
+      case ublox::PROTOCOL_UBX:
+      case ublox::PROTOCOL_UNICORE_BIN:
+      case ublox::PROTOCOL_UNICORE_OEM:
+        handle(frame);
+        break;
+      case ublox::PROTOCOL_NMEA:
+      case ublox::PROTOCOL_UNICORE_ASCII:
+        handle_nmea(frame);
+        break;
+      case ublox::PROTOCOL_RTCM3:
+        handle_rtcm(frame);
+        break;
+      default:
+        break;
+    }
+  }
+
+  /**
+   * @brief Decode the queued frames until the decode threads are stopped.
+   * @param queue the queue of the thread
+   */
+  void decodeLoop(FrameQueue* queue) {
+    FrameQueue::Slot *slot;
+    while (!stopping_.load()) {
+      bool decoded = false;
+      while (!stopping_.load() && queue->pop(slot)) {
+        dispatch(slot->frame);
+        queue->release(slot);
+        decoded = true;
+      }
+      if (decoded)
+        notifyDecoded();
+      queue->wait(boost::posix_time::milliseconds(100));
+    }
+  }
+
+  /**
+   * @brief Get the queue of the thread which decodes the frame.
+   *
+   * @details The frames of a message type go to the same thread. All RTCM
+   * messages are forwarded by one callback in the order of the stream, so
+   * they count as one type, as do the text frames, which have no ID.
+   */
+  std::size_t queueIndex(const ublox::FrameView& frame) const {
+    std::size_t seed = 0;
+    boost::hash_combine(seed, static_cast<int>(frame.protocol));
+    if (frame.protocol != ublox::PROTOCOL_RTCM3) {
+      boost::hash_combine(seed, frame.class_id);
+      boost::hash_combine(seed, frame.message_id);
+    }
+    return seed % queues_.size();
+  }
+
+  /**
+   * @brief Get the total number of frames dropped by the decode queues.
+   */
+  uint64_t dropped() const {
+    uint64_t dropped = 0;
+    for (std::size_t i = 0; i < queues_.size(); ++i)
+      dropped += queues_[i]->dropped();
+    return dropped;
+  }
+
+  /**
+   * @brief Bind the thread to a CPU, only supported on Linux.
+   */
+  static void setAffinity(boost::thread& thread, int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(thread.native_handle(), sizeof(set),
+                                       &set);
+    if (error != 0)
+      ROS_WARN("Could not bind the decode thread to CPU %d: %s", cpu,
+               strerror(error));
+#else
+    ROS_WARN("Binding the decode threads to CPUs is not supported");
+#endif
+  }
+
+  /**
+   * @brief Wake up the threads waiting in waitDecoded().
+   */
+  void notifyDecoded() {
+    boost::mutex::scoped_lock lock(decoded_mutex_);
+    decoded_condition_.notify_all();
+  }
+
+  /**
+   * @brief A version of the callbacks, which is never changed once it is
+   * published, so the frames are dispatched without locking.
+   */
+  struct Registry {
+    // Call back handlers for u-blox messages
+    Callbacks callbacks;
+    //! The handlers of callbacks by message ID, used to dispatch the frames
+    Dispatch dispatch;
+    //! The pending requests, in the order they were added
+    Requests requests;
+    //! The pending requests by message ID
+    RequestDispatch request_dispatch;
+    //! Callback handler for nmea messages
+    boost::function<void(boost::string_ref)> nmea;
+    //! Callback handler for the responses to Unicore commands
+    boost::function<void(boost::string_ref)> command;
+    //! Callback handler for RTCM 3 messages
+    boost::function<void(const uint8_t*, std::size_t)> rtcm;
+  };
+
+  /**
+   * @brief Copy the current callbacks to change them, the write mutex must
+   * be locked.
+   */
+  boost::shared_ptr<Registry> copyRegistry() const {
+    return boost::make_shared<Registry>(*registry_);
+  }
+
+  /**
+   * @brief Replace the current callbacks with the changed copy, the write
+   * mutex must be locked.
+   */
+  void commit(const boost::shared_ptr<const Registry>& registry) {
+    boost::atomic_store(&registry_, registry);
+  }
+
+  /**
+   * @brief Publish a new version of the callbacks with the given handler.
+   */
+  void add(const Callbacks::key_type& key,
+           const boost::shared_ptr<CallbackHandler>& handler) {
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> registry = copyRegistry();
+    registry->callbacks.insert(std::make_pair(key, handler));
+    registry->dispatch.build(registry->callbacks.begin(),
+                             registry->callbacks.end(),
+                             &decodable<CallbackHandler>);
+    commit(registry);
+  }
+
+  /**
+   * @brief Publish a new version of the callbacks without the given handler.
+   */
+  void remove(const CallbackHandler* handler) {
+    boost::mutex::scoped_lock lock(write_mutex_);
+    boost::shared_ptr<Registry> registry = copyRegistry();
+    for (Callbacks::iterator it = registry->callbacks.begin();
+         it != registry->callbacks.end(); ++it) {
+      if (it->second.get() == handler) {
+        registry->callbacks.erase(it);
+        break;
+      }
+    }
+    registry->dispatch.build(registry->callbacks.begin(),
+                             registry->callbacks.end(),
+                             &decodable<CallbackHandler>);
+    commit(registry);
+  }
+
+  //! The current version of the callbacks. It is read with atomic_load by
+  //! the threads which dispatch frames and replaced with atomic_store.
+  boost::shared_ptr<const Registry> registry_;
+  //! Serializes the changes of the callbacks
+  boost::mutex write_mutex_;
+  //! Splits the input into frames, keeps the state of incomplete frames
+  //! between reads
+  ublox::Framer framer_;
+  //! The number of checksum errors of the framer which were reported
+  uint64_t checksum_errors_;
+  //! The frames of the framer, read by other threads
+  boost::atomic<uint64_t> frames_;
+  //! The discarded bytes of the framer, read by other threads
+  boost::atomic<uint64_t> discarded_;
+  //! The frames dropped because the decode queue was full, which were
+  //! reported
+  uint64_t dropped_;
+
+  //! The frames from the I/O thread to each decode thread, empty if the
+  //! frames are decoded on the I/O thread
+  std::vector<boost::shared_ptr<FrameQueue> > queues_;
+  //! The threads which decode the queued frames
+  std::vector<boost::shared_ptr<boost::thread> > decode_threads_;
+  //! Whether the decode threads should stop
+  boost::atomic<bool> stopping_;
+  //! Lock for waiting on decoded frames
+  boost::mutex decoded_mutex_;
+  //! Notified when frames were decoded
+  boost::condition_variable decoded_condition_;
+  //! The thread which fails the requests when their deadline passes,
+  //! started with the first request
+  boost::shared_ptr<boost::thread> expiry_thread_;
+  //! Whether the expiry thread should stop, protected by expiry_mutex_
+  bool stopping_expiry_;
+  //! Lock for waiting on the earliest deadline
+  std::mutex expiry_mutex_;
+  //! Notified when a request was added or the expiry thread should stop
+  std::condition_variable expiry_condition_;
 
   //
     //! Filename for storing raw data
@@ -0,0 +1,144 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_DISPATCH_TABLE_H
+#define UBLOX_GPS_DISPATCH_TABLE_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace ublox_gps {
+
+/**
+ * @brief A flat hash table which maps the class and message ID of a message
+ * to the handlers subscribed to it.
+ *
+ * @details The table is rebuilt from the subscriptions whenever they change.
+ * It uses open addressing with linear probing, the handlers of each key are
+ * stored contiguously, so a lookup neither allocates nor walks a tree. The
+ * class ID also identifies the protocol, the Unicore messages use the third
+ * sync character which is not used as UBX class.
+ * @typedef Handler the handler type, the table stores pointers to it
+ */
+template <typename Handler>
+class DispatchTable {
+ public:
+  typedef std::pair<uint8_t, uint32_t> Key;
+  typedef Handler* const* iterator;
+
+  DispatchTable() : mask_(0) {}
+
+  /**
+   * @brief Rebuild the table from the subscriptions.
+   * @param begin the first subscription, the subscriptions must be sorted by
+   * key like in a std::multimap
+   * @param end the end of the subscriptions
+   * @param filter called with the key and handler of every subscription,
+   * only subscriptions for which it returns true are added
+   */
+  template <typename Iterator, typename Filter>
+  void build(Iterator begin, Iterator end, Filter filter) {
+    handlers_.clear();
+    std::vector<std::pair<uint64_t, std::pair<uint32_t, uint32_t> > > keys;
+    for (Iterator it = begin; it != end; ++it) {
+      if (!filter(it->first, *it->second)) continue;
+      uint64_t key = pack(it->first);
+      if (keys.empty() || keys.back().first != key)
+        keys.push_back(std::make_pair(key, std::make_pair(
+            static_cast<uint32_t>(handlers_.size()), 0u)));
+      handlers_.push_back(&*it->second);
+      keys.back().second.second = handlers_.size();
+    }
+
+    // Keep the load factor at or below one half
+    uint32_t size = 16;
+    while (size < 2 * keys.size()) size *= 2;
+    mask_ = size - 1;
+    slots_.assign(size, Slot());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      uint32_t index = hash(keys[i].first) & mask_;
+      while (slots_[index].begin != slots_[index].end)
+        index = (index + 1) & mask_;
+      slots_[index].key = keys[i].first;
+      slots_[index].begin = keys[i].second.first;
+      slots_[index].end = keys[i].second.second;
+    }
+  }
+
+  /**
+   * @brief Find the handlers of the given message.
+   * @param key the class and message ID
+   * @param begin set to the first handler
+   * @param end set to the end of the handlers
+   * @return false if there is no handler for the message
+   */
+  bool find(const Key& key, iterator& begin, iterator& end) const {
+    if (slots_.empty()) return false;
+    uint64_t packed = pack(key);
+    for (uint32_t index = hash(packed) & mask_; ; index = (index + 1) & mask_) {
+      const Slot& slot = slots_[index];
+      // Every used slot has at least one handler
+      if (slot.begin == slot.end) return false;
+      if (slot.key == packed) {
+        begin = &handlers_[0] + slot.begin;
+        end = &handlers_[0] + slot.end;
+        return true;
+      }
+    }
+  }
+
+ private:
+  //! A slot of the table, empty if it has no handlers
+  struct Slot {
+    Slot() : key(0), begin(0), end(0) {}
+    uint64_t key;
+    //! The range of the handlers in handlers_
+    uint32_t begin, end;
+  };
+
+  static uint64_t pack(const Key& key) {
+    return (static_cast<uint64_t>(key.first) << 32) | key.second;
+  }
+
+  //! Fibonacci hashing, the high bits of the product are well mixed
+  static uint32_t hash(uint64_t key) {
+    return static_cast<uint32_t>((key * 0x9E3779B97F4A7C15ull) >> 40);
+  }
+
+  //! The slots, the size is a power of two
+  std::vector<Slot> slots_;
+  //! The handlers of all keys, grouped by key
+  std::vector<Handler*> handlers_;
+  //! The size of the table minus one
+  uint32_t mask_;
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_DISPATCH_TABLE_H
@@ -0,0 +1,152 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_FRAME_QUEUE_H
+#define UBLOX_GPS_FRAME_QUEUE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include <ublox/framer.h>
+
+namespace ublox_gps {
+
+/**
+ * @brief Passes frames from the I/O thread to the decode thread.
+ *
+ * @details The frames are copied out of the input buffer into slots, so the
+ * I/O thread can go on reading while the decode thread works. The slots are
+ * allocated once and circulate between two lock-free single producer,
+ * single consumer queues: the queue of frames to the decode thread and the
+ * queue of free slots back to the I/O thread. The buffers of the slots keep
+ * their capacity, so no memory is allocated once they have grown to the
+ * size of the frames.
+ *
+ * push() and notify() must only be called by the producer, pop(), release()
+ * and wait() only by the consumer.
+ */
+class FrameQueue : boost::noncopyable {
+ public:
+  //! A copy of a frame
+  struct Slot {
+    //! The frame, which points into data
+    ublox::FrameView frame;
+    //! The bytes of the frame
+    std::vector<uint8_t> data;
+  };
+
+  /**
+   * @param depth the number of frames the queue holds
+   */
+  explicit FrameQueue(std::size_t depth) :
+      slots_(depth), queue_(depth), free_(depth), dropped_(0) {
+    for (std::size_t i = 0; i < slots_.size(); ++i)
+      free_.push(&slots_[i]);
+  }
+
+  /**
+   * @brief Copy the frame into a free slot and queue it.
+   * @return false if the queue is full, the frame is dropped then
+   */
+  bool push(const ublox::FrameView &frame) {
+    Slot *slot;
+    if (!free_.pop(slot)) {
+      dropped_.fetch_add(1, boost::memory_order_relaxed);
+      return false;
+    }
+    slot->data.assign(frame.data, frame.data + frame.size);
+    slot->frame = frame;
+    slot->frame.data = slot->data.data();
+    slot->frame.payload = slot->data.data() + (frame.payload - frame.data);
+    queue_.push(slot);
+    return true;
+  }
+
+  /**
+   * @brief Wake up the consumer after frames were pushed.
+   */
+  void notify() {
+    boost::mutex::scoped_lock lock(mutex_);
+    condition_.notify_one();
+  }
+
+  /**
+   * @brief Take the next frame.
+   * @param slot the slot of the frame, which must be passed to release()
+   * @return false if the queue is empty
+   */
+  bool pop(Slot *&slot) { return queue_.pop(slot); }
+
+  /**
+   * @brief Return the slot of a frame which was processed.
+   */
+  void release(Slot *slot) { free_.push(slot); }
+
+  /**
+   * @brief Wait until a frame was pushed, unless the queue holds frames.
+   * @param timeout the maximum time to wait
+   */
+  void wait(const boost::posix_time::time_duration &timeout) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (queue_.read_available() == 0)
+      condition_.timed_wait(lock, timeout);
+  }
+
+  /**
+   * @brief Get the total number of frames which were dropped because the
+   * queue was full, may be called from any thread.
+   */
+  uint64_t dropped() const {
+    return dropped_.load(boost::memory_order_relaxed);
+  }
+
+ private:
+  //! The slots, referenced by the queues
+  std::vector<Slot> slots_;
+  //! The frames from the producer to the consumer
+  boost::lockfree::spsc_queue<Slot*> queue_;
+  //! The free slots from the consumer back to the producer
+  boost::lockfree::spsc_queue<Slot*> free_;
+  //! The number of frames which did not fit into the queue
+  boost::atomic<uint64_t> dropped_;
+
+  //! Lock for waiting on an empty queue
+  boost::mutex mutex_;
+  //! Notified when frames were pushed
+  boost::condition_variable condition_;
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_FRAME_QUEUE_H
@@ -34,6 +34,10 @@
 #include <vector>
 #include <locale>
 #include <stdexcept>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
 // Boost
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/udp.hpp>
@@ -62,7 +66,8 @@ constexpr static unsigned int kBaudrates[] = { 4800,
                                                57600,
                                                115200,
                                                230400,
-                                               460800 };
+                                               460800,
+                                               921600 };
 /**
  * @brief Handles communication with and configuration of the u-blox device
  */
@@ -72,6 +77,9 @@ class Gps {
   constexpr static double kDefaultAckTimeout = 1.0;
   //! Size of write buffer for output messages
   constexpr static int kWriterSize = 2056;
+  //! Maximum size of the Unicore commands waiting for their response, which
+  //! stays below the size of the input buffer of the receiver
+  constexpr static std::size_t kUnicoreCommandWindow = 256;
 
   Gps();
   virtual ~Gps();
@@ -99,6 +107,35 @@ class Gps {
    * @param config_on_startup boolean flag
    */ 
   void setUbloxDevice(const bool isUblox) { ubloxDevice = isUblox; }
+
+  /**
+   * @brief Set the size of the input buffer, must be called before the I/O
+   * is initialized.
+   * @param size the minimum size in bytes
+   */
+  void setReadBufferSize(std::size_t size) { read_buffer_size_ = size; }
+
+  /**
+   * @brief Set the number of frames queued for the decode thread, must be
+   * called before the I/O is initialized.
+   * @param depth the depth of the queue, 0 to decode the frames on the I/O
+   * thread
+   */
+  void setDecodeQueueDepth(std::size_t depth) { decode_queue_depth_ = depth; }
+
+  /**
+   * @brief Set the number of decode threads, must be called before the I/O
+   * is initialized. Messages of the same type are decoded in order by the
+   * same thread, so only callbacks of different message types run
+   * concurrently.
+   * @param threads the number of threads
+   * @param cpus the CPUs the threads are bound to in turn, none to leave the
+   * placement to the scheduler
+   */
+  void setDecodeThreads(std::size_t threads, const std::vector<int>& cpus) {
+    decode_threads_ = threads;
+    decode_cpus_ = cpus;
+  }
   /**
    * @brief Initialize TCP I/O.
    * @param host the TCP host
@@ -354,10 +391,37 @@ class Gps {
   void subscribe(typename CallbackHandler_<T>::Callback callback);
 
   /**
-   * @brief Subscribe to the given Ublox message.
+   * @brief Configure the rate of the given message and subscribe to it as
+   * shared pointers to pooled messages, which can be published as ConstPtr.
+   * @param the callback handler for the message
+   * @param rate the rate in Hz of the message
+   */
+  template <typename T>
+  void subscribeShared(typename SharedCallbackHandler_<T>::Callback callback,
+                       unsigned int rate);
+
+  /**
+   * @brief Subscribe to a read-only view of the given message, the message is
+   * not decoded into a ROS message.
+   * @param the callback handler for the view
+   */
+  template <typename V>
+  void subscribeView(typename ViewCallbackHandler_<V>::Callback callback) {
+    callbacks_.insertView<V>(callback);
+  }
+
+  /**
+   * @brief Subscribe to the NMEA sentences and Unicore ASCII messages.
+   * @param the callback handler for the sentences, see
+   * CallbackHandlers::set_nmea_callback
+   */
+  void subscribe_nmea(boost::function<void(boost::string_ref)> callback) { callbacks_.set_nmea_callback(callback); }
+
+  /**
+   * @brief Subscribe to the RTCM 3 messages output by the device.
    * @param the callback handler for the message
    */
-  void subscribe_nmea(boost::function<void(const std::string&)> callback) { callbacks_.set_nmea_callback(callback); }
+  void subscribe_rtcm(boost::function<void(const uint8_t*, std::size_t)> callback) { callbacks_.set_rtcm_callback(callback); }
 
   /**
    * @brief Subscribe to the message with the given ID. This is used for
@@ -379,10 +443,28 @@ class Gps {
   bool read(T& message,
             const boost::posix_time::time_duration& timeout = default_timeout_);
 
+  /**
+   * @brief Read the next u-blox message of the given type without blocking.
+   * @param timeout the amount of time to wait for the desired message
+   * @return the future message, it throws std::runtime_error if none was
+   * received in time
+   */
+  template <typename T>
+  std::future<T> readAsync(
+      const boost::posix_time::time_duration& timeout = default_timeout_);
+
   bool isInitialized() const { return worker_ != 0; }
   bool isConfigured() const { return isInitialized() && configured_; }
   bool isOpen() const { return worker_->isOpen(); }
 
+  /**
+   * @brief Get the number of frames and discarded bytes read so far, e.g. to
+   * tell whether the baudrate matches the device.
+   */
+  FramerStatistics framerStatistics() const {
+    return callbacks_.statistics();
+  }
+
   /**
    * Poll a u-blox message of the given type.
    * @param message the received u-blox message output
@@ -405,6 +487,39 @@ class Gps {
   bool poll(uint8_t class_id, uint8_t message_id,
             const std::vector<uint8_t>& payload = std::vector<uint8_t>());
 
+  /**
+   * @brief Poll a u-blox message of the given type without blocking.
+   *
+   * @details The response is awaited before the poll is sent, any number of
+   * polls may be outstanding at the same time, e.g. to poll several
+   * configurations in one round trip.
+   * @param payload the poll message payload sent to the device,
+   * defaults to empty
+   * @param timeout the amount of time to wait for the desired message
+   * @return the future message, it throws std::runtime_error if the poll
+   * could not be sent or no response was received in time
+   */
+  template <typename ConfigT>
+  std::future<ConfigT> pollAsync(
+      const std::vector<uint8_t>& payload = std::vector<uint8_t>(),
+      const boost::posix_time::time_duration& timeout = default_timeout_);
+
+  /**
+   * @brief Send the given configuration message without waiting for the ACK.
+   *
+   * @details The ACKs are matched to the outstanding configurations by the
+   * class and message ID they acknowledge, in the order the configurations
+   * were sent.
+   * @param message the configuration message
+   * @param timeout the amount of time to wait for the ACK
+   * @return the future result, true if the message was sent and an ACK was
+   * received, false on a NACK, a timeout or if the message was not sent
+   */
+  template <typename ConfigT>
+  std::future<bool> configureAsync(
+      const ConfigT& message,
+      const boost::posix_time::time_duration& timeout = default_timeout_);
+
   /**
    * @brief Send the given configuration message.
    * @param message the configuration message
@@ -415,9 +530,27 @@ class Gps {
   template <typename ConfigT>
   bool configure(const ConfigT& message, bool wait = true);
 
-  // for UM982
+  /**
+   * @brief Send a command to a Unicore receiver.
+   * @param cmd the command including the line terminator
+   * @param wait if true, wait for the response of the receiver to the command
+   * @return true if the command was sent and either the receiver accepted it
+   * or wait was set to false
+   */
   bool configureUnicore(const std::string & cmd, bool wait = false);
 
+  /**
+   * @brief Send a sequence of commands to a Unicore receiver.
+   *
+   * @details The commands are sent back to back as long as the commands
+   * without response fit into the input buffer of the receiver, instead of
+   * waiting for the response of each command before sending the next one.
+   * The time until each response is logged.
+   * @param commands the commands including the line terminators
+   * @return true if the receiver accepted all commands
+   */
+  bool configureUnicore(const std::vector<std::string> & commands);
+
   /**
    * @brief Wait for an acknowledge message until the timeout
    * @param timeout maximum time to wait in seconds
@@ -434,6 +567,13 @@ class Gps {
    */
   void setRawDataCallback(const Worker::Callback& callback);
 
+  /**
+   * @brief Set the I/O worker, e.g. a simulated device. The initialize
+   * functions set the worker of the I/O port.
+   * @param an I/O handler
+   */
+  void setWorker(const boost::shared_ptr<Worker>& worker);
+
  private:
   //! Types for ACK/NACK messages, WAIT is used when waiting for an ACK
   enum AckType {
@@ -449,12 +589,6 @@ class Gps {
     uint8_t msg_id; //!< The message ID of the ACK
   };
 
-  /**
-   * @brief Set the I/O worker
-   * @param an I/O handler
-   */
-  void setWorker(const boost::shared_ptr<Worker>& worker);
-
   /**
    * @brief Subscribe to ACK/NACK messages and UPD-SOS-ACK messages.
    */
@@ -472,12 +606,77 @@ class Gps {
    */
   void processNack(const ublox_msgs::Ack &m);
 
+  /**
+   * @brief Callback handler for the responses of Unicore receivers to
+   * commands.
+   * @param sentence the $command sentence
+   */
+  void processCommandResponse(boost::string_ref sentence);
+
   /**
    * @brief Callback handler for UBX-UPD-SOS-ACK message.
    * @param m the message to process
    */
   void processUpdSosAck(const ublox_msgs::UpdSOS_Ack &m);
 
+  /**
+   * @brief Store the last received ACK and wake up waitForAcknowledge().
+   */
+  void storeAck(const Ack& ack);
+
+  /**
+   * @brief Get the deadline of a request with the given timeout.
+   */
+  static RequestHandler::Clock::time_point deadline(
+      const boost::posix_time::time_duration& timeout) {
+    return RequestHandler::Clock::now()
+        + std::chrono::microseconds(timeout.total_microseconds());
+  }
+
+  /**
+   * @brief Get a future which is ready with the given value.
+   */
+  template <typename T>
+  static std::future<T> ready(const T& value) {
+    std::promise<T> promise;
+    promise.set_value(value);
+    return promise.get_future();
+  }
+
+  /**
+   * @brief Get a future which is ready with a std::runtime_error.
+   */
+  template <typename T>
+  static std::future<T> failed(const std::string& what) {
+    std::promise<T> promise;
+    promise.set_exception(std::make_exception_ptr(std::runtime_error(what)));
+    return promise.get_future();
+  }
+
+  /**
+   * @brief Complete the promise of configureAsync() with an ACK or NACK.
+   * @param promise the result of configureAsync()
+   * @param class_id the class ID of the configuration message
+   * @param msg_id the message ID of the configuration message
+   * @param ack the ACK or NACK message, NULL on a timeout
+   * @param type the message ID of the ACK or NACK
+   * @return true if the message acknowledges the configuration
+   */
+  static bool acknowledged(
+      const boost::shared_ptr<std::promise<bool> >& promise,
+      uint8_t class_id, uint8_t msg_id, const ublox_msgs::Ack* ack,
+      uint32_t type) {
+    if (!ack) {
+      ROS_DEBUG_COND(debug >= 2, "U-blox: no ACK for 0x%02x / 0x%02x",
+                     class_id, msg_id);
+      promise->set_value(false);
+      return true;
+    }
+    if (ack->clsID != class_id || ack->msgID != msg_id) return false;
+    promise->set_value(type == ublox_msgs::Message::ACK::ACK);
+    return true;
+  }
+
   /**
    * @brief Execute save on shutdown procedure.
    *
@@ -502,13 +701,46 @@ class Gps {
   bool ubloxDevice;
   //! The default timeout for ACK messages
   static const boost::posix_time::time_duration default_timeout_;
-  //! Stores last received ACK accessed by multiple threads
-  mutable boost::atomic<Ack> ack_;
+  //! Stores last received ACK, protected by ack_mutex_
+  Ack ack_;
+  //! Protects the last received ACK
+  std::mutex ack_mutex_;
+  //! Notified when an ACK or NACK arrives
+  std::condition_variable ack_condition_;
+
+  //! A Unicore command sent to the device
+  struct UnicoreCommand {
+    //! The command without the line terminator
+    std::string command;
+    //! The response to the command, WAIT until it arrives
+    AckType ack;
+    //! When the command was sent
+    RequestHandler::Clock::time_point sent;
+    //! When the response arrived
+    RequestHandler::Clock::time_point answered;
+  };
+  //! The Unicore commands of the running sequence
+  std::vector<UnicoreCommand> commands_;
+  //! Protects the commands and their responses
+  std::mutex command_mutex_;
+  //! Notified when the response to a command arrives
+  std::condition_variable command_condition_;
+  //! Serializes the Unicore command sequences
+  std::mutex sequence_mutex_;
 
   //! Callback handlers for u-blox messages
   CallbackHandlers callbacks_;
 
   unsigned int uart_baudrate;
+  //! The minimum size of the input buffer of the I/O worker
+  std::size_t read_buffer_size_;
+  //! The number of frames queued for the decode thread, 0 if the frames are
+  //! decoded on the I/O thread
+  std::size_t decode_queue_depth_;
+  //! The number of decode threads
+  std::size_t decode_threads_;
+  //! The CPUs the decode threads are bound to
+  std::vector<int> decode_cpus_;
 
   std::string host_, port_;
 };
@@ -526,6 +758,13 @@ void Gps::subscribe(typename CallbackHandler_<T>::Callback callback) {
   callbacks_.insert<T>(callback);
 }
 
+template <typename T>
+void Gps::subscribeShared(
+    typename SharedCallbackHandler_<T>::Callback callback, unsigned int rate) {
+  if (!setRate(T::CLASS_ID, T::MESSAGE_ID, rate)) return;
+  callbacks_.insertShared<T>(callback);
+}
+
 template <typename T>
 void Gps::subscribeId(typename CallbackHandler_<T>::Callback callback,
                       unsigned int message_id) {
@@ -536,8 +775,18 @@ template <typename ConfigT>
 bool Gps::poll(ConfigT& message,
                const std::vector<uint8_t>& payload,
                const boost::posix_time::time_duration& timeout) {
-  if (!poll(ConfigT::CLASS_ID, ConfigT::MESSAGE_ID, payload)) return false;
-  return read(message, timeout);
+  // Awaiting the response before sending the poll, so a fast response is
+  // not missed
+  std::future<ConfigT> response = pollAsync<ConfigT>(payload, timeout);
+  if (response.wait_for(std::chrono::microseconds(
+          timeout.total_microseconds())) != std::future_status::ready)
+    return false;
+  try {
+    message = response.get();
+  } catch (std::runtime_error& e) {
+    return false;
+  }
+  return true;
 }
 
 template <typename T>
@@ -546,6 +795,72 @@ bool Gps::read(T& message, const boost::posix_time::time_duration& timeout) {
   return callbacks_.read(message, timeout);
 }
 
+template <typename T>
+std::future<T> Gps::readAsync(
+    const boost::posix_time::time_duration& timeout) {
+  if (!worker_) return failed<T>("Not connected to the device");
+  return callbacks_.readAsync<T>(deadline(timeout));
+}
+
+template <typename ConfigT>
+std::future<ConfigT> Gps::pollAsync(
+    const std::vector<uint8_t>& payload,
+    const boost::posix_time::time_duration& timeout) {
+  if (!worker_) return failed<ConfigT>("Not connected to the device");
+  if (ubloxDevice == false)
+    return failed<ConfigT>("Polling is only supported by u-blox devices");
+  boost::shared_ptr<RequestHandler> handler;
+  std::future<ConfigT> response =
+      callbacks_.readAsync<ConfigT>(deadline(timeout), &handler);
+  if (!poll(ConfigT::CLASS_ID, ConfigT::MESSAGE_ID, payload)) {
+    callbacks_.cancel(handler);
+    return failed<ConfigT>("Failed to send the poll");
+  }
+  return response;
+}
+
+template <typename ConfigT>
+std::future<bool> Gps::configureAsync(
+    const ConfigT& message, const boost::posix_time::time_duration& timeout) {
+  if (!worker_) return ready(false);
+
+  // Encode the message
+  std::vector<unsigned char> out(kWriterSize);
+  ublox::Writer writer(out.data(), out.size());
+  if (!writer.write(message)) {
+    ROS_ERROR("Failed to encode config message 0x%02x / 0x%02x",
+              message.CLASS_ID, message.MESSAGE_ID);
+    return ready(false);
+  }
+
+  // Other devices do not acknowledge UBX messages
+  std::future<bool> result;
+  boost::shared_ptr<RequestHandler> handler;
+  if (ubloxDevice) {
+    boost::shared_ptr<std::promise<bool> > promise =
+        boost::make_shared<std::promise<bool> >();
+    result = promise->get_future();
+    std::vector<uint32_t> ids;
+    ids.push_back(ublox_msgs::Message::ACK::ACK);
+    ids.push_back(ublox_msgs::Message::ACK::NACK);
+    handler = callbacks_.request<ublox_msgs::Ack>(
+        boost::bind(&Gps::acknowledged, promise,
+                    static_cast<uint8_t>(ConfigT::CLASS_ID),
+                    static_cast<uint8_t>(ConfigT::MESSAGE_ID), _1, _2),
+        deadline(timeout), ids);
+  } else {
+    result = ready(true);
+  }
+
+  // Send the message to the device, the ACK of a later configuration of the
+  // same message must not complete the request if it was not sent
+  if (!worker_->send(out.data(), writer.end() - out.data())) {
+    if (handler) callbacks_.cancel(handler);
+    return ready(false);
+  }
+  return result;
+}
+
 template <typename ConfigT>
 bool Gps::configure(const ConfigT& message, bool wait) {
   if (!worker_) return false;
@@ -553,7 +868,7 @@ bool Gps::configure(const ConfigT& message, bool wait) {
   // Reset ack
   Ack ack;
   ack.type = WAIT;
-  ack_.store(ack, boost::memory_order_seq_cst);
+  storeAck(ack);
 
   // Encode the message
   std::vector<unsigned char> out(kWriterSize);
@@ -574,16 +889,6 @@ bool Gps::configure(const ConfigT& message, bool wait) {
                             message.MESSAGE_ID);
 }
 
-bool Gps::configureUnicore(const std::string & cmd, bool wait)
-{
-    if (!worker_) return false;
-    // Send the message to the device
-    worker_->send((const unsigned char*)cmd.c_str(),strlen(cmd.c_str())); //cmd.size()
-    //if (!wait) return true;
-    //Todo: for unicore cmd response: need check rsp 
-    return true;
-}
-
 }  // namespace ublox_gps
 
 #endif  // UBLOX_GPS_H
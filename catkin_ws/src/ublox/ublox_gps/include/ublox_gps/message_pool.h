@@ -0,0 +1,135 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_MESSAGE_POOL_H
+#define UBLOX_GPS_MESSAGE_POOL_H
+
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief A pool of messages of one type, which are handed out as shared
+ * pointers and reused when the last reference is released.
+ *
+ * @details A reused message keeps the capacity of its arrays, so filling it
+ * with a message of the same size does not allocate. The messages can be
+ * published as ConstPtr, subscribers in the same process then get the
+ * pointer instead of a serialized copy. A message may outlive the pool, it is
+ * then deleted when it is released.
+ * @typedef T the message type
+ */
+template <typename T>
+class MessagePool : boost::noncopyable {
+ public:
+  typedef boost::shared_ptr<T> Ptr;
+  typedef boost::shared_ptr<const T> ConstPtr;
+
+  //! The default number of released messages kept for reuse
+  static const std::size_t kDefaultCapacity = 8;
+
+  /**
+   * @param capacity the number of released messages kept for reuse, more
+   * are deleted
+   */
+  explicit MessagePool(std::size_t capacity = kDefaultCapacity)
+      : free_(boost::make_shared<Free>(capacity)) {}
+
+  /**
+   * @brief Get a message, a released one if available.
+   *
+   * @details The message still has the contents it had when it was
+   * released, every field has to be set.
+   */
+  Ptr get() {
+    T* message = free_->take();
+    if (!message) message = new T();
+    return Ptr(message, Recycler(free_));
+  }
+
+ private:
+  //! The released messages, shared with the messages which are handed out
+  class Free {
+   public:
+    explicit Free(std::size_t capacity) : capacity_(capacity) {
+      messages_.reserve(capacity);
+    }
+
+    ~Free() {
+      for (std::size_t i = 0; i < messages_.size(); ++i)
+        delete messages_[i];
+    }
+
+    //! Take a released message, NULL if there is none
+    T* take() {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (messages_.empty()) return NULL;
+      T* message = messages_.back();
+      messages_.pop_back();
+      return message;
+    }
+
+    //! Keep the message for reuse or delete it if the pool is full
+    void release(T* message) {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (messages_.size() < capacity_) {
+          messages_.push_back(message);
+          return;
+        }
+      }
+      delete message;
+    }
+
+   private:
+    boost::mutex mutex_;
+    std::vector<T*> messages_;
+    const std::size_t capacity_;
+  };
+
+  //! The deleter of the handed out messages
+  struct Recycler {
+    explicit Recycler(const boost::shared_ptr<Free>& free) : free(free) {}
+    void operator()(T* message) const { free->release(message); }
+    boost::shared_ptr<Free> free;
+  };
+
+  boost::shared_ptr<Free> free_;
+};
+
+template <typename T>
+const std::size_t MessagePool<T>::kDefaultCapacity;
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_MESSAGE_POOL_H
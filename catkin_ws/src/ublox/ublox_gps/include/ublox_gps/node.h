@@ -52,9 +52,12 @@
 #include <sensor_msgs/Imu.h>
 #include <nmea_msgs/Sentence.h>
 // Other U-Blox package includes
+#include <ublox/nmea.h>
 #include <ublox_msgs/ublox_msgs.h>
+#include <ublox_msgs/views.h>
 // Ublox GPS includes
 #include <ublox_gps/gps.h>
+#include <ublox_gps/message_pool.h>
 #include <ublox_gps/utils.h>
 #include <ublox_gps/raw_data_pa.h>
 
@@ -96,41 +99,306 @@ constexpr static uint32_t kSubscribeRate = 1;
 //! Subscribe Rate for u-blox SV Info messages
 constexpr static uint32_t kNavSvInfoSubscribeRate = 20;
 
-// ROS objects
-//! ROS diagnostic updater
-boost::shared_ptr<diagnostic_updater::Updater> updater;
-//! Node Handle for GPS node
-boost::shared_ptr<ros::NodeHandle> nh;
-
-//! Handles communication with the U-Blox Device
-ublox_gps::Gps gps;
-//! Which GNSS are supported by the device
-std::set<std::string> supported;
-//! Whether or not to publish the given ublox message
-/*!
- * key is the message name (all lowercase) without firmware version numbers
- * (e.g. NavPVT instead of NavPVT7). Value indicates whether or not to enable
- * the message. */
-std::map<std::string, bool> enabled;
-//! The ROS frame ID of this device
-std::string frame_id;
-//! The fix status service type, set in the Firmware Component
-//! based on the enabled GNSS
-int fix_status_service;
-//! The measurement [ms], see CfgRate.msg
-uint16_t meas_rate;
-//! Navigation rate in measurement cycles, see CfgRate.msg
-uint16_t nav_rate;
-//! IDs of RTCM out messages to configure.
-std::vector<uint8_t> rtcm_ids;
-//! Rates of RTCM out messages. Size must be the same as rtcm_ids
-std::vector<uint8_t> rtcm_rates;
-//! Flag for enabling configuration on startup
-bool config_on_startup_flag_;
-
-//! uniore oem used , map  unicore bin to ubx messgae
-uint8_t unicore_oem;
-int uart_index = 1;
+/**
+ * @brief Check that the parameter is above the minimum.
+ * @param val the value to check
+ * @param min the minimum for this value
+ * @param name the name of the parameter
+ * @throws std::runtime_error if it is below the minimum
+ */
+template <typename V, typename T>
+void checkMin(V val, T min, std::string name) {
+  if(val < min) {
+    std::stringstream oss;
+    oss << "Invalid settings: " << name << " must be > " << min;
+    throw std::runtime_error(oss.str());
+  }
+}
+
+/**
+ * @brief Check that the parameter is in the range.
+ * @param val the value to check
+ * @param min the minimum for this value
+ * @param max the maximum for this value
+ * @param name the name of the parameter
+ * @throws std::runtime_error if it is out of bounds
+ */
+template <typename V, typename T>
+void checkRange(V val, T min, T max, std::string name) {
+  if(val < min || val > max) {
+    std::stringstream oss;
+    oss << "Invalid settings: " << name << " must be in range [" << min <<
+        ", " << max << "].";
+    throw std::runtime_error(oss.str());
+  }
+}
+
+/**
+ * @brief Check that the elements of the vector are in the range.
+ * @param val the vector to check
+ * @param min the minimum for this value
+ * @param max the maximum for this value
+ * @param name the name of the parameter
+ * @throws std::runtime_error value it is out of bounds
+ */
+template <typename V, typename T>
+void checkRange(std::vector<V> val, T min, T max, std::string name) {
+  for(size_t i = 0; i < val.size(); i++)  {
+    std::stringstream oss;
+    oss << name << "[" << i << "]";
+    checkRange(val[i], min, max, oss.str());
+  }
+}
+
+struct FixDiagnostic;
+
+/**
+ * @brief Publish a ROS message of type MessageT without copying it.
+ *
+ * @details Subscribers in the same process, e.g. nodelets in the same
+ * manager, get the pointer, the message is only serialized for the others.
+ * The message must not be changed after it was published, see MessagePool.
+ * @param m the message to publish
+ * @param publisher the publisher of the topic
+ */
+template <typename MessageT>
+void publish(const boost::shared_ptr<const MessageT>& m,
+             const ros::Publisher& publisher) {
+  publisher.publish(m);
+}
+
+/**
+ * @brief The state of a u-blox node, which is shared by the node and its
+ * components.
+ *
+ * @details Each UbloxNode has its own, so that nodelets for several devices
+ * can run in one process.
+ */
+struct NodeState {
+  /**
+   * @param nh the node handle for the parameters and topics of the node
+   */
+  explicit NodeState(const ros::NodeHandle& nh);
+
+  // ROS objects
+  //! ROS diagnostic updater
+  boost::shared_ptr<diagnostic_updater::Updater> updater;
+  //! Node Handle for GPS node
+  ros::NodeHandle nh;
+
+  //! Handles communication with the U-Blox Device
+  ublox_gps::Gps gps;
+  //! Which GNSS are supported by the device
+  std::set<std::string> supported;
+  //! Whether or not to publish the given ublox message
+  /*!
+   * key is the message name (all lowercase) without firmware version numbers
+   * (e.g. NavPVT instead of NavPVT7). Value indicates whether or not to enable
+   * the message. */
+  std::map<std::string, bool> enabled;
+  //! The ROS frame ID of this device
+  std::string frame_id;
+  //! The fix status service type, set in the Firmware Component
+  //! based on the enabled GNSS
+  int fix_status_service;
+  //! The measurement [ms], see CfgRate.msg
+  uint16_t meas_rate;
+  //! Navigation rate in measurement cycles, see CfgRate.msg
+  uint16_t nav_rate;
+  //! IDs of RTCM out messages to configure.
+  std::vector<uint8_t> rtcm_ids;
+  //! Rates of RTCM out messages. Size must be the same as rtcm_ids
+  std::vector<uint8_t> rtcm_rates;
+  //! Flag for enabling configuration on startup
+  bool config_on_startup_flag;
+
+  //! uniore oem used , map  unicore bin to ubx messgae
+  uint8_t unicore_oem;
+  int uart_index;
+  //! fix frequency diagnostic updater
+  boost::shared_ptr<FixDiagnostic> freq_diag;
+  //! Lock for the diagnostic updater and the messages its tasks read, which
+  //! are written by the callbacks of the decode threads
+  boost::mutex diagnostics_mutex;
+  //! Lock for the publishers which are advertised with their first message
+  boost::mutex advertise_mutex;
+
+  /**
+   * @brief Get a unsigned integer value from the parameter server.
+   * @param key the key to be used in the parameter server's dictionary
+   * @param u storage for the retrieved value.
+   * @throws std::runtime_error if the parameter is out of bounds
+   * @return true if found, false if not found.
+   */
+  template <typename U>
+  bool getRosUint(const std::string& key, U &u) {
+    int param;
+    if (!nh.getParam(key, param)) return false;
+    // Check the bounds
+    U min = std::numeric_limits<U>::lowest();
+    U max = std::numeric_limits<U>::max();
+    checkRange(param, min, max, key);
+    // set the output
+    u = (U) param;
+    return true;
+  }
+
+  /**
+   * @brief Get a unsigned integer value from the parameter server.
+   * @param key the key to be used in the parameter server's dictionary
+   * @param u storage for the retrieved value.
+   * @param val value to use if the server doesn't contain this parameter.
+   * @throws std::runtime_error if the parameter is out of bounds
+   * @return true if found, false if not found.
+   */
+  template <typename U, typename V>
+  void getRosUint(const std::string& key, U &u, V default_val) {
+    if(!getRosUint(key, u))
+      u = default_val;
+  }
+
+  /**
+   * @brief Get a unsigned integer vector from the parameter server.
+   * @throws std::runtime_error if the parameter is out of bounds.
+   * @return true if found, false if not found.
+   */
+  template <typename U>
+  bool getRosUint(const std::string& key, std::vector<U> &u) {
+    std::vector<int> param;
+    if (!nh.getParam(key, param)) return false;
+
+    // Check the bounds
+    U min = std::numeric_limits<U>::lowest();
+    U max = std::numeric_limits<U>::max();
+    checkRange(param, min, max, key);
+
+    // set the output
+    u.insert(u.begin(), param.begin(), param.end());
+    return true;
+  }
+
+  /**
+   * @brief Get a integer (size 8 or 16) value from the parameter server.
+   * @param key the key to be used in the parameter server's dictionary
+   * @param u storage for the retrieved value.
+   * @throws std::runtime_error if the parameter is out of bounds
+   * @return true if found, false if not found.
+   */
+  template <typename I>
+  bool getRosInt(const std::string& key, I &u) {
+    int param;
+    if (!nh.getParam(key, param)) return false;
+    // Check the bounds
+    I min = std::numeric_limits<I>::lowest();
+    I max = std::numeric_limits<I>::max();
+    checkRange(param, min, max, key);
+    // set the output
+    u = (I) param;
+    return true;
+  }
+
+  /**
+   * @brief Get an integer value (size 8 or 16) from the parameter server.
+   * @param key the key to be used in the parameter server's dictionary
+   * @param u storage for the retrieved value.
+   * @param val value to use if the server doesn't contain this parameter.
+   * @throws std::runtime_error if the parameter is out of bounds
+   * @return true if found, false if not found.
+   */
+  template <typename U, typename V>
+  void getRosInt(const std::string& key, U &u, V default_val) {
+    if(!getRosInt(key, u))
+      u = default_val;
+  }
+
+  /**
+   * @brief Get a int (size 8 or 16) vector from the parameter server.
+   * @throws std::runtime_error if the parameter is out of bounds.
+   * @return true if found, false if not found.
+   */
+  template <typename I>
+  bool getRosInt(const std::string& key, std::vector<I> &i) {
+    std::vector<int> param;
+    if (!nh.getParam(key, param)) return false;
+
+    // Check the bounds
+    I min = std::numeric_limits<I>::lowest();
+    I max = std::numeric_limits<I>::max();
+    checkRange(param, min, max, key);
+
+    // set the output
+    i.insert(i.begin(), param.begin(), param.end());
+    return true;
+  }
+  /**
+   * @brief Advertise the topic if the publisher is empty.
+   *
+   * @details Used for the topics which are advertised with their first
+   * message. The callbacks of the decode threads may advertise concurrently,
+   * so the publisher must only be accessed through this function.
+   * @param publisher the publisher of the topic
+   * @param topic the topic to advertise
+   * @return the publisher
+   */
+  template <typename MessageT>
+  ros::Publisher& advertise(ros::Publisher& publisher,
+                            const std::string& topic) {
+    boost::mutex::scoped_lock lock(advertise_mutex);
+    if (!publisher)
+      publisher = nh.advertise<MessageT>(topic, kROSQueueSize);
+    return publisher;
+  }
+
+  /**
+   * @brief Subscribe to the u-blox message of type MessageT and publish it.
+   *
+   * @details This function should be used for all messages which are simply
+   * read from u-blox and published. They are decoded into a MessagePool and
+   * published without copying them.
+   * @param topic the topic to publish the message on
+   * @param rate the rate of the message, see Gps::subscribe
+   */
+  template <typename MessageT>
+  void subscribe(const std::string& topic, unsigned int rate) {
+    gps.subscribeShared<MessageT>(boost::bind(
+        publish<MessageT>, _1, nh.advertise<MessageT>(topic, kROSQueueSize)),
+        rate);
+  }
+
+  /**
+   * @brief Publish a NMEA sentence.
+   *
+   * @details The messages are reused, so their strings keep their capacity
+   * and publishing a sentence does not allocate.
+   * @param sentence the sentence, which points into the read buffer
+   * @param topic the topic to publish the sentence on
+   */
+  void publish_nmea(boost::string_ref sentence, const std::string& topic);
+
+  /**
+   * @brief Publish a RTCM message output by the device.
+   * @param data the message
+   * @param size the size of the message
+   * @param topic the topic to publish the message on
+   */
+  void publish_rtcm(const uint8_t* data, std::size_t size,
+                    const std::string& topic);
+
+  /**
+   * @param gnss The string representing the GNSS. Refer MonVER message protocol.
+   * i.e. GPS, GLO, GAL, BDS, QZSS, SBAS, IMES
+   * @return true if the device supports the given GNSS
+   */
+  bool supportsGnss(std::string gnss);
+
+  //! The publisher and the reused messages of publish_nmea
+  ros::Publisher nmea_publisher;
+  ublox_gps::MessagePool<nmea_msgs::Sentence> nmea_pool;
+  //! The publisher and the reused messages of publish_rtcm
+  ros::Publisher rtcm_publisher;
+  ublox_gps::MessagePool<rtcm_msgs::Message> rtcm_pool;
+};
+
 //! Topic diagnostics for u-blox messages
 struct UbloxTopicDiagnostic {
   UbloxTopicDiagnostic() {}
@@ -142,40 +410,42 @@ struct UbloxTopicDiagnostic {
    * @brief Add a topic diagnostic to the diagnostic updater for
    *
    * @details The minimum and maximum frequency are equal to the nav rate in Hz.
+   * @param state the state of the node
    * @param name the ROS topic
    * @param freq_tol the tolerance [%] for the topic frequency
    * @param freq_window the number of messages to use for diagnostic statistics
    */
-  UbloxTopicDiagnostic (std::string topic, double freq_tol, int freq_window) {
-    const double target_freq = 1.0 / (meas_rate * 1e-3 * nav_rate); // Hz
+  UbloxTopicDiagnostic (NodeState& state, std::string topic, double freq_tol,
+                        int freq_window) {
+    const double target_freq =
+        1.0 / (state.meas_rate * 1e-3 * state.nav_rate); // Hz
     min_freq = target_freq;
     max_freq = target_freq;
     diagnostic_updater::FrequencyStatusParam freq_param(&min_freq, &max_freq,
                                                         freq_tol, freq_window);
-    diagnostic = new diagnostic_updater::HeaderlessTopicDiagnostic(topic,
-                                                                   *updater,
-                                                                   freq_param);
+    diagnostic = new diagnostic_updater::HeaderlessTopicDiagnostic(
+        topic, *state.updater, freq_param);
   }
 
   /**
    * @brief Add a topic diagnostic to the diagnostic updater for
    *
    * @details The minimum and maximum frequency are equal to the nav rate in Hz.
+   * @param state the state of the node
    * @param name the ROS topic
    * @param freq_min the minimum acceptable frequency for the topic
    * @param freq_max the maximum acceptable frequency for the topic
    * @param freq_tol the tolerance [%] for the topic frequency
    * @param freq_window the number of messages to use for diagnostic statistics
    */
-  UbloxTopicDiagnostic (std::string topic, double freq_min, double freq_max,
-                   double freq_tol, int freq_window) {
+  UbloxTopicDiagnostic (NodeState& state, std::string topic, double freq_min,
+                        double freq_max, double freq_tol, int freq_window) {
     min_freq = freq_min;
     max_freq = freq_max;
     diagnostic_updater::FrequencyStatusParam freq_param(&min_freq, &max_freq,
                                                         freq_tol, freq_window);
-    diagnostic = new diagnostic_updater::HeaderlessTopicDiagnostic(topic,
-                                                                   *updater,
-                                                                   freq_param);
+    diagnostic = new diagnostic_updater::HeaderlessTopicDiagnostic(
+        topic, *state.updater, freq_param);
   }
 
   //! Topic frequency diagnostic updater
@@ -197,22 +467,24 @@ struct FixDiagnostic {
    * @brief Add a topic diagnostic to the diagnostic updater for fix topics.
    *
    * @details The minimum and maximum frequency are equal to the nav rate in Hz.
+   * @param state the state of the node
    * @param name the ROS topic
    * @param freq_tol the tolerance [%] for the topic frequency
    * @param freq_window the number of messages to use for diagnostic statistics
    * @param stamp_min the minimum allowed time delay
    */
-  FixDiagnostic (std::string name, double freq_tol, int freq_window,
-                 double stamp_min) {
-    const double target_freq = 1.0 / (meas_rate * 1e-3 * nav_rate); // Hz
+  FixDiagnostic (NodeState& state, std::string name, double freq_tol,
+                 int freq_window, double stamp_min) {
+    const double target_freq =
+        1.0 / (state.meas_rate * 1e-3 * state.nav_rate); // Hz
     min_freq = target_freq;
     max_freq = target_freq;
     diagnostic_updater::FrequencyStatusParam freq_param(&min_freq, &max_freq,
                                                         freq_tol, freq_window);
-    double stamp_max = meas_rate * 1e-3 * (1 + freq_tol);
+    double stamp_max = state.meas_rate * 1e-3 * (1 + freq_tol);
     diagnostic_updater::TimeStampStatusParam time_param(stamp_min, stamp_max);
     diagnostic = new diagnostic_updater::TopicDiagnostic(name,
-                                                         *updater,
+                                                         *state.updater,
                                                          freq_param,
                                                          time_param);
   }
@@ -225,9 +497,6 @@ struct FixDiagnostic {
   double max_freq;
 };
 
-//! fix frequency diagnostic updater
-boost::shared_ptr<FixDiagnostic> freq_diag;
-
 /**
  * @brief Determine dynamic model from human-readable string.
  * @param model One of the following (case-insensitive):
@@ -256,199 +525,6 @@ uint8_t modelFromString(const std::string& model);
  */
 uint8_t fixModeFromString(const std::string& mode);
 
-/**
- * @brief Check that the parameter is above the minimum.
- * @param val the value to check
- * @param min the minimum for this value
- * @param name the name of the parameter
- * @throws std::runtime_error if it is below the minimum
- */
-template <typename V, typename T>
-void checkMin(V val, T min, std::string name) {
-  if(val < min) {
-    std::stringstream oss;
-    oss << "Invalid settings: " << name << " must be > " << min;
-    throw std::runtime_error(oss.str());
-  }
-}
-
-/**
- * @brief Check that the parameter is in the range.
- * @param val the value to check
- * @param min the minimum for this value
- * @param max the maximum for this value
- * @param name the name of the parameter
- * @throws std::runtime_error if it is out of bounds
- */
-template <typename V, typename T>
-void checkRange(V val, T min, T max, std::string name) {
-  if(val < min || val > max) {
-    std::stringstream oss;
-    oss << "Invalid settings: " << name << " must be in range [" << min <<
-        ", " << max << "].";
-    throw std::runtime_error(oss.str());
-  }
-}
-
-/**
- * @brief Check that the elements of the vector are in the range.
- * @param val the vector to check
- * @param min the minimum for this value
- * @param max the maximum for this value
- * @param name the name of the parameter
- * @throws std::runtime_error value it is out of bounds
- */
-template <typename V, typename T>
-void checkRange(std::vector<V> val, T min, T max, std::string name) {
-  for(size_t i = 0; i < val.size(); i++)  {
-    std::stringstream oss;
-    oss << name << "[" << i << "]";
-    checkRange(val[i], min, max, oss.str());
-  }
-}
-
-/**
- * @brief Get a unsigned integer value from the parameter server.
- * @param key the key to be used in the parameter server's dictionary
- * @param u storage for the retrieved value.
- * @throws std::runtime_error if the parameter is out of bounds
- * @return true if found, false if not found.
- */
-template <typename U>
-bool getRosUint(const std::string& key, U &u) {
-  int param;
-  if (!nh->getParam(key, param)) return false;
-  // Check the bounds
-  U min = std::numeric_limits<U>::lowest();
-  U max = std::numeric_limits<U>::max();
-  checkRange(param, min, max, key);
-  // set the output
-  u = (U) param;
-  return true;
-}
-
-/**
- * @brief Get a unsigned integer value from the parameter server.
- * @param key the key to be used in the parameter server's dictionary
- * @param u storage for the retrieved value.
- * @param val value to use if the server doesn't contain this parameter.
- * @throws std::runtime_error if the parameter is out of bounds
- * @return true if found, false if not found.
- */
-template <typename U, typename V>
-void getRosUint(const std::string& key, U &u, V default_val) {
-  if(!getRosUint(key, u))
-    u = default_val;
-}
-
-/**
- * @brief Get a unsigned integer vector from the parameter server.
- * @throws std::runtime_error if the parameter is out of bounds.
- * @return true if found, false if not found.
- */
-template <typename U>
-bool getRosUint(const std::string& key, std::vector<U> &u) {
-  std::vector<int> param;
-  if (!nh->getParam(key, param)) return false;
-
-  // Check the bounds
-  U min = std::numeric_limits<U>::lowest();
-  U max = std::numeric_limits<U>::max();
-  checkRange(param, min, max, key);
-
-  // set the output
-  u.insert(u.begin(), param.begin(), param.end());
-  return true;
-}
-
-/**
- * @brief Get a integer (size 8 or 16) value from the parameter server.
- * @param key the key to be used in the parameter server's dictionary
- * @param u storage for the retrieved value.
- * @throws std::runtime_error if the parameter is out of bounds
- * @return true if found, false if not found.
- */
-template <typename I>
-bool getRosInt(const std::string& key, I &u) {
-  int param;
-  if (!nh->getParam(key, param)) return false;
-  // Check the bounds
-  I min = std::numeric_limits<I>::lowest();
-  I max = std::numeric_limits<I>::max();
-  checkRange(param, min, max, key);
-  // set the output
-  u = (I) param;
-  return true;
-}
-
-/**
- * @brief Get an integer value (size 8 or 16) from the parameter server.
- * @param key the key to be used in the parameter server's dictionary
- * @param u storage for the retrieved value.
- * @param val value to use if the server doesn't contain this parameter.
- * @throws std::runtime_error if the parameter is out of bounds
- * @return true if found, false if not found.
- */
-template <typename U, typename V>
-void getRosInt(const std::string& key, U &u, V default_val) {
-  if(!getRosInt(key, u))
-    u = default_val;
-}
-
-/**
- * @brief Get a int (size 8 or 16) vector from the parameter server.
- * @throws std::runtime_error if the parameter is out of bounds.
- * @return true if found, false if not found.
- */
-template <typename I>
-bool getRosInt(const std::string& key, std::vector<I> &i) {
-  std::vector<int> param;
-  if (!nh->getParam(key, param)) return false;
-
-  // Check the bounds
-  I min = std::numeric_limits<I>::lowest();
-  I max = std::numeric_limits<I>::max();
-  checkRange(param, min, max, key);
-
-  // set the output
-  i.insert(i.begin(), param.begin(), param.end());
-  return true;
-}
-
-/**
- * @brief Publish a ROS message of type MessageT.
- *
- * @details This function should be used to publish all messages which are
- * simply read from u-blox and published.
- * @param m the message to publish
- * @param topic the topic to publish the message on
- */
-template <typename MessageT>
-void publish(const MessageT& m, const std::string& topic) {
-  static ros::Publisher publisher = nh->advertise<MessageT>(topic,
-                                                            kROSQueueSize);
-  publisher.publish(m);
-}
-
-void publish_nmea(const std::string& sentence, const std::string& topic) {
-  static ros::Publisher publisher = nh->advertise<nmea_msgs::Sentence>(topic,
-                                                            kROSQueueSize);
-  nmea_msgs::Sentence m;
-  m.header.stamp = ros::Time::now();
-  m.header.frame_id = frame_id;
-  m.sentence = sentence;
-  publisher.publish(m);
-}
-
-/**
- * @param gnss The string representing the GNSS. Refer MonVER message protocol.
- * i.e. GPS, GLO, GAL, BDS, QZSS, SBAS, IMES
- * @return true if the device supports the given GNSS
- */
-bool supportsGnss(std::string gnss) {
-  return supported.count(gnss) > 0;
-}
-
 /**
  * @brief This interface is used to add functionality to the main node.
  *
@@ -517,9 +593,26 @@ class UbloxNode : public virtual ComponentInterface {
   constexpr static double kTimeStampStatusMin = 0;
 
   /**
-   * @brief Initialize and run the u-blox node.
+   * @brief Create the u-blox node, call initialize to start it.
+   * @param nh the node handle for the parameters and topics of the node
+   */
+  explicit UbloxNode(const ros::NodeHandle& nh);
+
+  /**
+   * @brief Shutdown the node.
+   */
+  ~UbloxNode();
+
+  /**
+   * @brief Initialize the U-Blox node. Configure the U-Blox and subscribe to
+   * messages.
+   *
+   * @details The messages are published from the I/O threads and the timers,
+   * so the caller has to spin the callback queue of the node handle.
+   * @throws std::runtime_error if a parameter is invalid
+   * @return true if the device was configured successfully
    */
-  UbloxNode();
+  bool initialize();
 
   /**
    * @brief Get the node parameters from the ROS Parameter Server.
@@ -555,13 +648,7 @@ class UbloxNode : public virtual ComponentInterface {
   void initializeIo();
 
   /**
-   * @brief Initialize the U-Blox node. Configure the U-Blox and subscribe to
-   * messages.
-   */
-  void initialize();
-
-  /**
-   * @brief Shutdown the node. Closes the serial port.
+   * @brief Shutdown the node. Stops the timers and closes the serial port.
    */
   void shutdown();
 
@@ -611,6 +698,15 @@ class UbloxNode : public virtual ComponentInterface {
    */
   void configureInf();
 
+  /**
+   * @brief Send the RTCM correction to the device.
+   * @param m the correction
+   */
+  void rtcmCallback(const rtcm_msgs::Message::ConstPtr& m);
+
+  //! The state shared with the components
+  NodeState state_;
+
   //! The u-blox node components
   /*!
    * The node will call the functions in these interfaces for each object
@@ -633,6 +729,14 @@ class UbloxNode : public virtual ComponentInterface {
   uint8_t fmode_;
   //! UART1 baudrate
   uint32_t baudrate_;
+  //! Size of the input buffer in bytes
+  uint32_t read_buffer_size_;
+  //! Number of frames queued for the decode thread
+  uint32_t decode_queue_depth_;
+  //! Number of decode threads
+  uint32_t decode_threads_;
+  //! CPUs the decode threads are bound to
+  std::vector<int> decode_cpus_;
   //! UART in protocol (see CfgPRT message for constants)
   uint16_t uart_in_;
   //! UART out protocol (see CfgPRT message for constants)
@@ -671,6 +775,13 @@ class UbloxNode : public virtual ComponentInterface {
   
   //! raw data stream logging
   RawDataStreamPa rawDataStreamPa_;
+
+  //! Sends the keep-alive messages
+  ros::Timer keep_alive_;
+  //! Polls the messages which are not sent periodically
+  ros::Timer poller_;
+  //! Receives the RTCM corrections
+  ros::Subscriber rtcm_subscriber_;
 };
 
 /**
@@ -680,6 +791,11 @@ class UbloxNode : public virtual ComponentInterface {
  */
 class UbloxFirmware : public virtual ComponentInterface {
  public:
+  /**
+   * @param state the state of the node
+   */
+  explicit UbloxFirmware(NodeState& state) : state_(state) {}
+
   /**
    * @brief Add the fix diagnostics to the updater.
    */
@@ -691,6 +807,9 @@ class UbloxFirmware : public virtual ComponentInterface {
    */
   virtual void fixDiagnostic(
       diagnostic_updater::DiagnosticStatusWrapper& stat) = 0;
+
+  //! The state of the node
+  NodeState& state_;
 };
 
 /**
@@ -698,7 +817,7 @@ class UbloxFirmware : public virtual ComponentInterface {
  */
 class UbloxFirmware6 : public UbloxFirmware {
  public:
-  UbloxFirmware6();
+  explicit UbloxFirmware6(NodeState& state);
 
   /**
    * @brief Sets the fix status service type to GPS.
@@ -731,7 +850,7 @@ class UbloxFirmware6 : public UbloxFirmware {
    * message if publishing is enabled.
    * @param m the message to process
    */
-  void callbackNavPosLlh(const ublox_msgs::NavPOSLLH& m);
+  void callbackNavPosLlh(const ublox_msgs::NavPOSLLH::ConstPtr& m);
 
   /**
    * @brief Update the last known velocity.
@@ -739,7 +858,7 @@ class UbloxFirmware6 : public UbloxFirmware {
    * @details Publish the message if publishing is enabled.
    * @param m the message to process
    */
-  void callbackNavVelNed(const ublox_msgs::NavVELNED& m);
+  void callbackNavVelNed(const ublox_msgs::NavVELNED::ConstPtr& m);
 
   /**
    * @brief Update the number of SVs used for the fix.
@@ -747,7 +866,7 @@ class UbloxFirmware6 : public UbloxFirmware {
    * @details Publish the message if publishing is enabled.
    * @param m the message to process
    */
-  void callbackNavSol(const ublox_msgs::NavSOL& m);
+  void callbackNavSol(const ublox_msgs::NavSOL::ConstPtr& m);
 
   //! The last received navigation position
   ublox_msgs::NavPOSLLH last_nav_pos_;
@@ -760,6 +879,13 @@ class UbloxFirmware6 : public UbloxFirmware {
   //! The last Twist based on last_nav_vel_
   geometry_msgs::TwistWithCovarianceStamped velocity_;
 
+  //! The publishers of the callbacks
+  ros::Publisher nav_pos_llh_publisher_;
+  ros::Publisher nav_vel_ned_publisher_;
+  ros::Publisher nav_sol_publisher_;
+  ros::Publisher fix_publisher_;
+  ros::Publisher velocity_publisher_;
+
   //! Used to configure NMEA (if set_nmea_) filled with ROS parameters
   ublox_msgs::CfgNMEA6 cfg_nmea_;
   //! Whether or not to configure the NMEA settings
@@ -778,6 +904,11 @@ class UbloxFirmware6 : public UbloxFirmware {
 template<typename NavPVT>
 class UbloxFirmware7Plus : public UbloxFirmware {
  public:
+  /**
+   * @param state the state of the node
+   */
+  explicit UbloxFirmware7Plus(NodeState& state) : UbloxFirmware(state) {}
+
   /**
    * @brief Publish a NavSatFix and TwistWithCovarianceStamped messages.
    *
@@ -786,22 +917,20 @@ class UbloxFirmware7Plus : public UbloxFirmware {
    * is published. This function also calls the ROS diagnostics updater.
    * @param m the message to publish
    */
-  void callbackNavPvt(const NavPVT& m) {
-    if(enabled["nav_pvt"]) {
+  void callbackNavPvt(const typename NavPVT::ConstPtr& msg) {
+    const NavPVT& m = *msg;
+    if(state_.enabled["nav_pvt"]) {
       // NavPVT publisher
-      static ros::Publisher publisher = nh->advertise<NavPVT>("navpvt",
-                                                              kROSQueueSize);
-      publisher.publish(m);
+      state_.advertise<NavPVT>(nav_pvt_publisher_, "navpvt").publish(msg);
     }
 
     //
     // NavSatFix message
     //
-    static ros::Publisher fixPublisher =
-        nh->advertise<sensor_msgs::NavSatFix>("fix", kROSQueueSize);
-
-    sensor_msgs::NavSatFix fix;
-    fix.header.frame_id = frame_id;
+    boost::shared_ptr<sensor_msgs::NavSatFix> fix_msg =
+        boost::make_shared<sensor_msgs::NavSatFix>();
+    sensor_msgs::NavSatFix& fix = *fix_msg;
+    fix.header.frame_id = state_.frame_id;
     // set the timestamp
     uint8_t valid_time = m.VALID_DATE | m.VALID_TIME | m.VALID_FULLY_RESOLVED;
     if (((m.valid & valid_time) == valid_time) &&
@@ -837,7 +966,7 @@ class UbloxFirmware7Plus : public UbloxFirmware {
       fix.status.status = fix.status.STATUS_NO_FIX;
     }
     // Set the service based on GNSS configuration
-    fix.status.service = fix_status_service;
+    fix.status.service = state_.fix_status_service;
 
     // Set the position covariance
     const double varH = pow(m.hAcc / 1000.0, 2); // to [m^2]
@@ -848,17 +977,17 @@ class UbloxFirmware7Plus : public UbloxFirmware {
     fix.position_covariance_type =
         sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
 
-    fixPublisher.publish(fix);
+    state_.advertise<sensor_msgs::NavSatFix>(fix_publisher_, "fix")
+        .publish(fix_msg);
 
     //
     // Twist message
     //
-    static ros::Publisher velocityPublisher =
-        nh->advertise<geometry_msgs::TwistWithCovarianceStamped>("fix_velocity",
-                                                                 kROSQueueSize);
-    geometry_msgs::TwistWithCovarianceStamped velocity;
+    boost::shared_ptr<geometry_msgs::TwistWithCovarianceStamped> velocity_msg =
+        boost::make_shared<geometry_msgs::TwistWithCovarianceStamped>();
+    geometry_msgs::TwistWithCovarianceStamped& velocity = *velocity_msg;
     velocity.header.stamp = fix.header.stamp;
-    velocity.header.frame_id = frame_id;
+    velocity.header.frame_id = state_.frame_id;
 
     // convert to XYZ linear velocity [m/s] in ENU
     velocity.twist.twist.linear.x = m.velE * 1e-3;
@@ -872,14 +1001,16 @@ class UbloxFirmware7Plus : public UbloxFirmware {
     velocity.twist.covariance[cols * 2 + 2] = covSpeed;
     velocity.twist.covariance[cols * 3 + 3] = -1;  //  angular rate unsupported
 
-    velocityPublisher.publish(velocity);
+    state_.advertise<geometry_msgs::TwistWithCovarianceStamped>(
+        velocity_publisher_, "fix_velocity").publish(velocity_msg);
 
     //
     // Update diagnostics
     //
+    boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
     last_nav_pvt_ = m;
-    freq_diag->diagnostic->tick(fix.header.stamp);
-    updater->update();
+    state_.freq_diag->diagnostic->tick(fix.header.stamp);
+    state_.updater->update();
   }
 
  protected:
@@ -961,6 +1092,11 @@ class UbloxFirmware7Plus : public UbloxFirmware {
   bool enable_sbas_;
   //! The QZSS Signal configuration, see CfgGNSS message
   uint32_t qzss_sig_cfg_;
+
+  //! The publishers of callbackNavPvt
+  ros::Publisher nav_pvt_publisher_;
+  ros::Publisher fix_publisher_;
+  ros::Publisher velocity_publisher_;
 };
 
 /**
@@ -968,7 +1104,7 @@ class UbloxFirmware7Plus : public UbloxFirmware {
  */
 class UbloxFirmware7 : public UbloxFirmware7Plus<ublox_msgs::NavPVT7> {
  public:
-  UbloxFirmware7();
+  explicit UbloxFirmware7(NodeState& state);
 
   /**
    * @brief Get the parameters specific to firmware version 7.
@@ -1004,7 +1140,7 @@ class UbloxFirmware7 : public UbloxFirmware7Plus<ublox_msgs::NavPVT7> {
  */
 class UbloxFirmware8 : public UbloxFirmware7Plus<ublox_msgs::NavPVT> {
  public:
-  UbloxFirmware8();
+  explicit UbloxFirmware8(NodeState& state);
 
   /**
    * @brief Get the ROS parameters specific to firmware version 8.
@@ -1053,6 +1189,8 @@ class UbloxFirmware8 : public UbloxFirmware7Plus<ublox_msgs::NavPVT> {
  *  but allows for future expansion of functionality
  */
 class UbloxFirmware9 : public UbloxFirmware8 {
+ public:
+  explicit UbloxFirmware9(NodeState& state) : UbloxFirmware8(state) {}
 };
 
 /**
@@ -1063,6 +1201,11 @@ class RawDataProduct: public virtual ComponentInterface {
   static constexpr double kRtcmFreqTol = 0.15;
   static constexpr int kRtcmFreqWindow = 25;
 
+  /**
+   * @param state the state of the node
+   */
+  explicit RawDataProduct(NodeState& state) : state_(state) {}
+
   /**
    * @brief Does nothing since there are no Raw Data product specific settings.
    */
@@ -1087,6 +1230,8 @@ class RawDataProduct: public virtual ComponentInterface {
   void initializeRosDiagnostics();
 
  private:
+  //! The state of the node
+  NodeState& state_;
   //! Topic diagnostic updaters
   std::vector<boost::shared_ptr<UbloxTopicDiagnostic> > freq_diagnostics_;
 };
@@ -1097,7 +1242,7 @@ class RawDataProduct: public virtual ComponentInterface {
  */
 class AdrUdrProduct: public virtual ComponentInterface {
  public:
-  AdrUdrProduct(float protocol_version);
+  AdrUdrProduct(NodeState& state, float protocol_version);
   
   /**
    * @brief Get the ADR/UDR parameters.
@@ -1131,6 +1276,8 @@ class AdrUdrProduct: public virtual ComponentInterface {
   }
 
  protected:
+  //! The state of the node
+  NodeState& state_;
   //! Whether or not to enable dead reckoning
   bool use_adr_;  
   float protocol_version_;
@@ -1139,6 +1286,8 @@ class AdrUdrProduct: public virtual ComponentInterface {
   sensor_msgs::Imu imu_;
   sensor_msgs::TimeReference t_ref_;
   ublox_msgs::TimTM2 timtm2;
+  //! The publishers of callbackEsfMEAS
+  ros::Publisher imu_publisher_, time_ref_publisher_;
 
   void callbackEsfMEAS(const ublox_msgs::EsfMEAS &m);
 };
@@ -1182,6 +1331,11 @@ class FtsProduct: public virtual ComponentInterface {
  */
 class HpgRefProduct: public virtual ComponentInterface {
  public:
+  /**
+   * @param state the state of the node
+   */
+  explicit HpgRefProduct(NodeState& state) : state_(state) {}
+
   /**
    * @brief Get the ROS parameters specific to the Reference Station
    * configuration.
@@ -1223,7 +1377,7 @@ class HpgRefProduct: public virtual ComponentInterface {
    * configured RTCM messages. Publish received Nav SVIN messages if enabled.
    * @param m the message to process
    */
-  void callbackNavSvIn(ublox_msgs::NavSVIN m);
+  void callbackNavSvIn(const ublox_msgs::NavSVIN::ConstPtr& m);
 
  protected:
   /**
@@ -1241,8 +1395,12 @@ class HpgRefProduct: public virtual ComponentInterface {
    */
   bool setTimeMode();
 
+  //! The state of the node
+  NodeState& state_;
   //! The last received Nav SVIN message
   ublox_msgs::NavSVIN last_nav_svin_;
+  //! The publisher of callbackNavSvIn
+  ros::Publisher nav_svin_publisher_;
 
   //! TMODE3 to set, such as disabled, survey-in, fixed
   uint8_t tmode3_;
@@ -1300,6 +1458,12 @@ class HpgRovProduct: public virtual ComponentInterface {
   constexpr static double kRtcmFreqTol = 0.1;
   //! Diagnostic updater: RTCM topic frequency window [num messages]
   constexpr static int kRtcmFreqWindow = 25;
+
+  /**
+   * @param state the state of the node
+   */
+  explicit HpgRovProduct(NodeState& state) : state_(state) {}
+
   /**
    * @brief Get the ROS parameters specific to the Rover configuration.
    *
@@ -1339,11 +1503,14 @@ class HpgRovProduct: public virtual ComponentInterface {
    *
    * @details Publish received NavRELPOSNED messages if enabled
    */
-  void callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED &m);
-
+  void callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED::ConstPtr& m);
 
+  //! The state of the node
+  NodeState& state_;
   //! Last relative position (used for diagnostic updater)
   ublox_msgs::NavRELPOSNED last_rel_pos_;
+  //! The publisher of callbackNavRelPosNed
+  ros::Publisher nav_rel_pos_ned_publisher_;
 
   //! The DGNSS mode
   /*! see CfgDGNSS message for possible values */
@@ -1355,6 +1522,11 @@ class HpgRovProduct: public virtual ComponentInterface {
 // f9p 
 class HpPosRecProduct: public virtual HpgRefProduct {
  public:
+  /**
+   * @param state the state of the node
+   */
+  explicit HpPosRecProduct(NodeState& state) : HpgRefProduct(state) {}
+
   /**
    * @brief Subscribe to Rover messages, such as NavRELPOSNED.
    */
@@ -1365,19 +1537,23 @@ class HpPosRecProduct: public virtual HpgRefProduct {
   /**
    * @brief Publish a sensor_msgs/NavSatFix message upon receiving a HPPOSLLH UBX message
    */
-  void callbackNavHpPosLlh(const ublox_msgs::NavHPPOSLLH& m);
+  void callbackNavHpPosLlh(const ublox_msgs::NavHPPOSLLH::ConstPtr& m);
 
   /**
    * @brief Set the last received message and call rover diagnostic updater
    *
    * @details Publish received NavRELPOSNED messages if enabled
    */
-  void callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED9 &m);
+  void callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED9::ConstPtr& m);
 
   sensor_msgs::Imu imu_;
 
   //! Last relative position (used for diagnostic updater)
   ublox_msgs::NavRELPOSNED9 last_rel_pos_;
+
+  //! The publishers of the callbacks
+  ros::Publisher nav_hp_pos_llh_publisher_, fix_publisher_,
+      nav_rel_pos_ned_publisher_, imu_publisher_;
 };
 
 /**
@@ -1385,6 +1561,12 @@ class HpPosRecProduct: public virtual HpgRefProduct {
  * @todo partially implemented
  */
 class TimProduct: public virtual ComponentInterface {
+ public:
+  /**
+   * @param state the state of the node
+   */
+  explicit TimProduct(NodeState& state) : state_(state) {}
+
   /**
    * @brief Get the Time Sync parameters.
    * @todo Currently unimplemented.
@@ -1415,9 +1597,89 @@ class TimProduct: public virtual ComponentInterface {
    * @brief 
    * @details Publish recieved TimTM2 messages if enabled
    */
-  void callbackTimTM2(const ublox_msgs::TimTM2 &m);
- 
+  void callbackTimTM2(const ublox_msgs::TimTM2::ConstPtr& m);
+
+  //! The state of the node
+  NodeState& state_;
   sensor_msgs::TimeReference t_ref_;
+  //! The publishers of callbackTimTM2
+  ros::Publisher tim_tm2_publisher_, time_ref_publisher_;
+};
+
+/**
+ * @brief Decodes the NMEA sentences of the device and publishes them as ROS
+ * messages, for devices which only output NMEA.
+ *
+ * @details Publishes GGA as fix, with the covariance of the last GST if it
+ * is recent, RMC or VTG as fix_velocity, HDT as navheading and the GSV
+ * sentences of all talkers of an epoch as one navsat. Enabled by the
+ * parameter nmea/decode.
+ */
+class NmeaProduct: public virtual ComponentInterface {
+ public:
+  //! The maximum age of a GST to be used for the covariance of a GGA [s]
+  static constexpr double kMaxGstAge = 1.5;
+
+  explicit NmeaProduct(NodeState& state);
+
+  /**
+   * @brief Does nothing since the sentences are selected on the device.
+   */
+  void getRosParams() {}
+
+  /**
+   * @brief Does nothing since the sentences are selected on the device.
+   * @return always returns true
+   */
+  bool configureUblox() { return true; }
+
+  /**
+   * @brief Subscribe to the NMEA sentences and set up the ROS publishers.
+   *
+   * @details Also publishes the raw sentences if publish/nmea is enabled,
+   * since the device has a single NMEA callback.
+   */
+  void subscribe();
+
+  /**
+   * @brief Does nothing.
+   */
+  void initializeRosDiagnostics() {}
+
+ private:
+  /**
+   * @brief Decode a sentence and publish it.
+   * @param sentence the sentence, which points into the read buffer
+   */
+  void callbackNmea(boost::string_ref sentence);
+
+  //! Publish a GGA as NavSatFix
+  void publishFix(const ublox::NmeaGGA& m);
+  //! Publish the course and speed over ground as TwistWithCovarianceStamped
+  void publishVelocity(double course, double speed);
+  //! Publish a HDT as Imu
+  void publishHeading(const ublox::NmeaHDT& m);
+  //! Add the satellites of a GSV to the NavSAT of the current epoch
+  void addSatellites(boost::string_ref talker, const ublox::NmeaGSV& m);
+  //! Publish the satellites of the GSV since the last GGA or RMC as NavSAT
+  void publishSatellites();
+
+  //! The state of the node
+  NodeState& state_;
+  //! The fields of the current sentence
+  ublox::NmeaFields fields_;
+  //! The last GST, used for the covariance of the fix
+  ublox::NmeaGST last_gst_;
+  //! Whether a VTG was received, then the velocity of RMC is not published
+  bool has_vtg_;
+  //! The satellites of the GSV of all talkers in the current epoch
+  ublox_msgs::NavSAT nav_sat_;
+  //! Whether a GSV was received since nav_sat_ was published
+  bool has_satellites_;
+  //! Whether to publish the raw sentences
+  bool publish_raw_;
+  ros::Publisher fix_publisher_, velocity_publisher_, heading_publisher_,
+      satellites_publisher_;
 };
 
 /**
@@ -1426,26 +1688,32 @@ class TimProduct: public virtual ComponentInterface {
  */
 class UnicoreVirtualProduct: public virtual ComponentInterface {
  public:
-  UnicoreVirtualProduct();
+  explicit UnicoreVirtualProduct(NodeState& state);
   //  publish unicore bestpos and map to navfix
-  void callbackBestpos(const ublox_msgs::BESTPOS& m);
+  void callbackBestpos(const ublox_msgs::BESTPOSView& m);
     // publish unicore agric and map to ubx rxmrtcm  status 
-  void callbackAgric(const ublox_msgs::AGRIC& m);
+  void callbackAgric(const ublox_msgs::AGRICView& m);
   // publish unicore obsvm
-  void callbackObsvm(const ublox_msgs::OBSVM& m);
+  void callbackObsvm(const ublox_msgs::OBSVMView& m);
 
   // for check version
-  void callbackVersion(const ublox_msgs::VERSIONB& m);
+  void callbackVersion(const ublox_msgs::VERSIONBView& m);
 
   bool auto_detect_bps(std::string &uart, int &det_bps,int &cur_bps);
 
-  bool convertToNavStaFix(const ublox_msgs::BESTPOS& m,sensor_msgs::NavSatFix& fix);
+  bool convertToNavStaFix(const ublox_msgs::BESTPOSView& m,sensor_msgs::NavSatFix& fix);
 
-  bool convertToNavrelposned(const ublox_msgs::AGRIC&,ublox_msgs::NavRELPOSNED &m);
+  bool convertToNavrelposned(const ublox_msgs::AGRICView&,ublox_msgs::NavRELPOSNED &m);
 
-  bool convertToRxmrtcm(const ublox_msgs::BESTPOS&,ublox_msgs::RxmRTCM &m);
+  bool convertToRxmrtcm(const ublox_msgs::BESTPOSView&,ublox_msgs::RxmRTCM &m);
 
-  bool convertToRxmrawx(const ublox_msgs::OBSVM&,ublox_msgs::RxmRAWX &m);
+  bool convertToRxmrawx(const ublox_msgs::OBSVMView&,ublox_msgs::RxmRAWX &m);
+
+  //! Get the leap seconds of the last AGRIC message
+  int leapSeconds() {
+    boost::mutex::scoped_lock lock(conversion_mutex_);
+    return leap_sec_;
+  }
 
   bool waitVersion(const boost::posix_time::time_duration& timeout) {
     boost::mutex::scoped_lock lock(mutex_);
@@ -1478,10 +1746,43 @@ class UnicoreVirtualProduct: public virtual ComponentInterface {
   void initializeRosDiagnostics();
 
  private:
+  /**
+   * @brief Decode the message in the view and publish it if the publisher
+   * has subscribers.
+   * @param view the view of the received message
+   * @param publisher the publisher of the raw topic, empty if it is disabled
+   */
+  template <typename MessageT, typename ViewT>
+  void publishRaw(const ViewT& view, ros::Publisher& publisher) {
+    if (!publisher || publisher.getNumSubscribers() == 0) return;
+    MessageT m;
+    try {
+      ublox::Serializer<MessageT>::read(view.data(), view.size(), m);
+    } catch (std::runtime_error& e) {
+      ROS_DEBUG_COND(ublox_gps::debug >= 2, "Unicore decoder error for 0x%02x / 0x%02x",
+                     static_cast<unsigned int>(ViewT::CLASS_ID),
+                     static_cast<unsigned int>(ViewT::MESSAGE_ID));
+      return;
+    }
+    publisher.publish(m);
+  }
+
+  //! The state of the node
+  NodeState& state_;
   //! Topic diagnostic updaters
   std::vector<boost::shared_ptr<UbloxTopicDiagnostic> > freq_diagnostics_;
+  //! Publishers of the raw Unicore messages, empty if disabled
+  ros::Publisher bestpos_publisher_, agric_publisher_, obsvm_publisher_;
+  //! Publishers of the converted messages
+  ros::Publisher fix_publisher_, rxmrtcm_publisher_, relposned_publisher_,
+      rawx_publisher_;
+  //! The RxmRAWX messages converted from OBSVM
+  ublox_gps::MessagePool<ublox_msgs::RxmRAWX> rawx_pool_;
   int leap_sec_;
   uint16_t refStationId;
+  //! Lock for the leap seconds and the station, which are shared by the
+  //! conversions of different messages and thus decode threads
+  boost::mutex conversion_mutex_;
 
   boost::mutex mutex_; //!< Lock for callback
   boost::condition_variable condition_; //!< Condition for  callback lock
@@ -64,8 +64,11 @@ class RawDataStreamPa {
     /**
      * @brief Constructor.
      * Initialises variables and the nodehandle.
+     * @param is_ros_subscriber whether to subscribe to the raw data stream
+     * @param pnh the private node handle for the parameters and the publisher
      */
-    RawDataStreamPa(bool is_ros_subscriber = false);
+    RawDataStreamPa(bool is_ros_subscriber = false,
+                    const ros::NodeHandle& pnh = ros::NodeHandle("~"));
 
     /**
      * @brief Get the raw data stream parameters.
@@ -137,6 +140,10 @@ class RawDataStreamPa {
     ros::NodeHandle pnh_;
     //! ROS node handle (only for subscriber)
     ros::NodeHandle nh_;
+    //! Publisher of the raw data stream
+    ros::Publisher publisher_;
+    //! Subscriber of the raw data stream
+    ros::Subscriber subscriber_;
 };
 
 }
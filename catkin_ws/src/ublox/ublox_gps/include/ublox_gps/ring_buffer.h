@@ -0,0 +1,195 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_RING_BUFFER_H
+#define UBLOX_GPS_RING_BUFFER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace ublox_gps {
+
+/**
+ * @brief Input buffer in which the received bytes always stay contiguous.
+ *
+ * @details The buffer is mapped twice into consecutive virtual memory, so
+ * data which wraps around the end of the buffer can be read and written in
+ * one piece. Frames are therefore never moved once they have been received.
+ * If the mirrored mapping is not available, a linear buffer is used which
+ * moves the unread bytes to the front when the free space at its end runs
+ * low.
+ *
+ * The buffer is used by a single thread, the I/O thread of the AsyncWorker,
+ * so no locking is done here.
+ */
+class RingBuffer : boost::noncopyable {
+ public:
+  /**
+   * @param capacity the minimum capacity in bytes. It is rounded up to a
+   * power of two and to a multiple of the page size.
+   */
+  explicit RingBuffer(std::size_t capacity)
+      : base_(0), capacity_(roundCapacity(capacity)), head_(0), tail_(0),
+        high_water_mark_(0) {
+    mapMirrored();
+    if (!base_) {
+      linear_.resize(capacity_);
+      base_ = linear_.data();
+    }
+  }
+
+  ~RingBuffer() {
+    if (mirrored()) munmap(base_, 2 * capacity_);
+  }
+
+  //! Whether the buffer is mapped twice, i.e. never moves data
+  bool mirrored() const { return linear_.empty(); }
+
+  //! The capacity in bytes
+  std::size_t capacity() const { return capacity_; }
+
+  //! The number of unread bytes
+  std::size_t size() const { return tail_ - head_; }
+
+  //! The largest number of unread bytes since construction
+  std::size_t highWaterMark() const { return high_water_mark_; }
+
+  //! The start of the unread bytes, which are contiguous
+  uint8_t *data() { return base_ + offset(head_); }
+
+  /**
+   * @brief Get the start of the free space, the bytes received next are
+   * written here.
+   */
+  uint8_t *writePtr() {
+    if (!mirrored() && capacity_ - tail_ < capacity_ / 2 && head_ > 0) {
+      // Linear buffer: move the unread bytes to the front
+      memmove(base_, base_ + head_, size());
+      tail_ -= head_;
+      head_ = 0;
+    }
+    return base_ + offset(tail_);
+  }
+
+  /**
+   * @brief Get the number of bytes which can be written at writePtr().
+   */
+  std::size_t space() const {
+    return mirrored() ? capacity_ - size() : capacity_ - tail_;
+  }
+
+  /**
+   * @brief Append the bytes written at writePtr() to the unread bytes.
+   */
+  void commit(std::size_t count) {
+    tail_ += count;
+    high_water_mark_ = std::max(high_water_mark_, size());
+  }
+
+  /**
+   * @brief Remove bytes from the front of the unread bytes.
+   */
+  void consume(std::size_t count) {
+    head_ += std::min(count, size());
+    if (head_ == tail_ && !mirrored())
+      head_ = tail_ = 0;
+  }
+
+  //! Remove all unread bytes
+  void clear() { consume(size()); }
+
+ private:
+  static std::size_t roundCapacity(std::size_t capacity) {
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t size = std::max(page, static_cast<std::size_t>(4096));
+    while (size < capacity) size <<= 1;
+    return size;
+  }
+
+  //! The position of the given byte count in the buffer
+  std::size_t offset(std::size_t position) const {
+    return mirrored() ? position & (capacity_ - 1) : position;
+  }
+
+  /**
+   * @brief Map one shared memory object twice into consecutive addresses.
+   * @details Leaves base_ 0 on failure.
+   */
+  void mapMirrored() {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    int fd = memfd_create("ublox_gps_input", MFD_CLOEXEC);
+    if (fd < 0) return;
+    if (ftruncate(fd, capacity_) != 0) {
+      close(fd);
+      return;
+    }
+    // Reserve the address range, then map the object into both halves
+    void *base = mmap(0, 2 * capacity_, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      close(fd);
+      return;
+    }
+    uint8_t *bytes = static_cast<uint8_t *>(base);
+    if (mmap(bytes, capacity_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(bytes + capacity_, capacity_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      munmap(base, 2 * capacity_);
+      close(fd);
+      return;
+    }
+    close(fd);
+    base_ = bytes;
+#endif
+  }
+
+  //! The start of the buffer
+  uint8_t *base_;
+  //! The storage of the linear fallback, empty if the buffer is mirrored
+  std::vector<uint8_t> linear_;
+  //! The capacity in bytes
+  std::size_t capacity_;
+  //! The number of bytes consumed, an offset into the linear buffer
+  std::size_t head_;
+  //! The number of bytes committed, an offset into the linear buffer
+  std::size_t tail_;
+  //! The largest number of unread bytes
+  std::size_t high_water_mark_;
+};
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_RING_BUFFER_H
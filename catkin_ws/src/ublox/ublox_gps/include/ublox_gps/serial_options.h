@@ -0,0 +1,73 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_GPS_SERIAL_OPTIONS_H
+#define UBLOX_GPS_SERIAL_OPTIONS_H
+
+///
+/// Options of serial ports which boost::asio does not support. The functions
+/// are implemented with the termios2 interface of Linux, whose header can not
+/// be included together with <termios.h> and therefore not with boost::asio,
+/// so they take the native handle of the port. On other systems they do
+/// nothing and return false.
+///
+
+namespace ublox_gps {
+
+/**
+ * @brief Set any baudrate, including rates without a termios constant, which
+ * some USB serial bridges support.
+ * @param fd the native handle of the serial port
+ * @param baudrate the baudrate in bit/s
+ * @return true if the baudrate was set
+ */
+bool setCustomBaudrate(int fd, unsigned int baudrate);
+
+/**
+ * @brief Get the baudrate, including rates without a termios constant.
+ * @param fd the native handle of the serial port
+ * @param baudrate the baudrate output in bit/s
+ * @return true if the baudrate could be read
+ */
+bool getCustomBaudrate(int fd, unsigned int &baudrate);
+
+/**
+ * @brief Reduce the latency of the serial port.
+ *
+ * @details Sets the ASYNC_LOW_LATENCY flag, which makes the driver pass the
+ * received bytes on immediately instead of after a timer, e.g. every 16 ms
+ * for FTDI bridges, and lets a read return as soon as one byte arrived
+ * (VMIN 1, VTIME 0). Not all drivers support the flag.
+ * @param fd the native handle of the serial port
+ * @return true if the driver accepted the flag
+ */
+bool setLowLatency(int fd);
+
+}  // namespace ublox_gps
+
+#endif  // UBLOX_GPS_SERIAL_OPTIONS_H
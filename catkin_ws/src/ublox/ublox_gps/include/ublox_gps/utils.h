@@ -36,7 +36,7 @@ typedef struct {        /* time struct */
     double sec;         /* fraction of second under 1 s */ 
 } gtime_t; 
  
-gtime_t epoch2time(const double *ep) 
+inline gtime_t epoch2time(const double *ep) 
 { 
     const int doy[]={1,32,60,91,121,152,182,213,244,274,305,335}; 
     gtime_t time={0}; 
@@ -52,7 +52,7 @@ gtime_t epoch2time(const double *ep)
     return time; 
 } 
  
-gtime_t gpst2time(int week, double sec) 
+inline gtime_t gpst2time(int week, double sec) 
 { 
     gtime_t t=epoch2time(gpst0); 
      
@@ -62,20 +62,20 @@ gtime_t gpst2time(int week, double sec)
     return t; 
 } 
  
-gtime_t timeadd(gtime_t t, double sec) 
+inline gtime_t timeadd(gtime_t t, double sec) 
 { 
     double tt; 
     t.sec+=sec; tt=floor(t.sec); t.time+=(int)tt; t.sec-=tt; 
     return t; 
 } 
  
-gtime_t GPSTime2UTCTime(int week,double sec,double leapsec) 
+inline gtime_t GPSTime2UTCTime(int week,double sec,double leapsec) 
 { 
     gtime_t gpst = gpst2time(week,sec); 
     return timeadd(gpst,-leapsec); 
 }
 
-gtime_t epoch2time_gnssindex(int gnss)
+inline gtime_t epoch2time_gnssindex(int gnss)
 {
     static gtime_t s_gtimes[] = {
     /*gps*/{315964800,  0.0},
@@ -88,7 +88,7 @@ gtime_t epoch2time_gnssindex(int gnss)
     return s_gtimes[gnss];
 }
 
-double time2gpst(gtime_t t, int *week)
+inline double time2gpst(gtime_t t, int *week)
 {
 	/*gtime_t t0 = epoch2time(gpst0);*/
     gtime_t t0 = epoch2time_gnssindex(0);
@@ -101,7 +101,7 @@ double time2gpst(gtime_t t, int *week)
 }
 	
 // utc time	
-gtime_t timeget(double timeoffset)
+inline gtime_t timeget(double timeoffset)
 {
     gtime_t time;
     double ep[6]={0};
@@ -44,6 +44,10 @@ class Worker {
 
   /**
    * @brief Set the callback function for received messages.
+   *
+   * @details The callback sets the size to the number of bytes it did not
+   * process. These are the last bytes of the buffer and must not be moved,
+   * they are passed again together with the next received bytes.
    * @param callback the callback function which process messages in the buffer
    */
   virtual void setCallback(const Callback& callback) = 0;
@@ -28,20 +28,62 @@
 //==============================================================================
 
 #include <ublox_gps/gps.h>
+#include <ublox_gps/serial_options.h>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/version.hpp>
+#include <ublox/nmea.h>
 
 namespace ublox_gps {
 
+int debug;
+
 using namespace ublox_msgs;
 
 //! Sleep time [ms] after setting the baudrate
 constexpr static int kSetBaudrateSleepMs = 500;
 
+/**
+ * @brief Set the baudrate of the serial port, rates without a termios
+ * constant are set with termios2.
+ */
+static void setBaudrate(boost::asio::serial_port &serial,
+                        unsigned int baudrate) {
+  try {
+    serial.set_option(boost::asio::serial_port_base::baud_rate(baudrate));
+  } catch (boost::system::system_error &e) {
+    if (!setCustomBaudrate(serial.native_handle(), baudrate))
+      throw std::runtime_error("Could not set serial baud rate "
+                               + boost::lexical_cast<std::string>(baudrate)
+                               + ": " + e.what());
+  }
+}
+
+/**
+ * @brief Get the baudrate of the serial port, including rates without a
+ * termios constant.
+ */
+static unsigned int getBaudrate(boost::asio::serial_port &serial) {
+  boost::asio::serial_port_base::baud_rate current_baudrate;
+  boost::system::error_code error;
+  serial.get_option(current_baudrate, error);
+  unsigned int baudrate = current_baudrate.value();
+  if (error && !getCustomBaudrate(serial.native_handle(), baudrate))
+    throw std::runtime_error("Could not get serial baud rate: "
+                             + error.message());
+  return baudrate;
+}
+
 const boost::posix_time::time_duration Gps::default_timeout_ =
     boost::posix_time::milliseconds(
         static_cast<int>(Gps::kDefaultAckTimeout * 1000));
 
-Gps::Gps() : configured_(false), config_on_startup_flag_(true),ubloxDevice(true) {
+Gps::Gps() : configured_(false), save_on_shutdown_(false),
+    config_on_startup_flag_(true), ubloxDevice(true),
+    read_buffer_size_(kDefaultReadBufferSize),
+    decode_queue_depth_(kDefaultDecodeQueueDepth), decode_threads_(1) {
+ ack_.type = WAIT;
  subscribeAcks();
 }
 
@@ -50,6 +92,9 @@ Gps::~Gps() { close(); }
 void Gps::setWorker(const boost::shared_ptr<Worker>& worker) {
   if (worker_) return;
   worker_ = worker;
+  if (decode_queue_depth_ > 0)
+    callbacks_.startDecodeThreads(decode_queue_depth_, decode_threads_,
+                                  decode_cpus_);
   worker_->setCallback(boost::bind(&CallbackHandlers::readCallback,
                                    &callbacks_, _1, _2));
   configured_ = static_cast<bool>(worker);
@@ -65,6 +110,9 @@ void Gps::subscribeAcks() {
   // Set UPD-SOS-ACK handler
   subscribe<ublox_msgs::UpdSOS_Ack>(
       boost::bind(&Gps::processUpdSosAck, this, _1));
+  // Set the handler of the responses to Unicore commands
+  callbacks_.set_command_callback(
+      boost::bind(&Gps::processCommandResponse, this, _1));
 }
 
 void Gps::processAck(const ublox_msgs::Ack &m) {
@@ -73,8 +121,7 @@ void Gps::processAck(const ublox_msgs::Ack &m) {
   ack.type = ACK;
   ack.class_id = m.clsID;
   ack.msg_id = m.msgID;
-  // store the ack atomically
-  ack_.store(ack, boost::memory_order_seq_cst);
+  storeAck(ack);
   ROS_DEBUG_COND(debug >= 2, "U-blox: received ACK: 0x%02x / 0x%02x",
                  m.clsID, m.msgID);
 }
@@ -85,19 +132,52 @@ void Gps::processNack(const ublox_msgs::Ack &m) {
   ack.type = NACK;
   ack.class_id = m.clsID;
   ack.msg_id = m.msgID;
-  // store the ack atomically
-  ack_.store(ack, boost::memory_order_seq_cst);
+  storeAck(ack);
   ROS_ERROR("U-blox: received NACK: 0x%02x / 0x%02x", m.clsID, m.msgID);
 }
 
+void Gps::storeAck(const Ack& ack) {
+  {
+    std::lock_guard<std::mutex> lock(ack_mutex_);
+    ack_ = ack;
+  }
+  ack_condition_.notify_all();
+}
+
+void Gps::processCommandResponse(boost::string_ref sentence) {
+  ublox::NmeaCommandResponse response;
+  if (!ublox::parseCommandResponse(sentence, response)) return;
+
+  std::lock_guard<std::mutex> lock(command_mutex_);
+  // The response belongs to the first waiting command it echoes
+  for (size_t i = 0; i < commands_.size(); ++i) {
+    UnicoreCommand &command = commands_[i];
+    if (command.ack != WAIT
+        || !boost::algorithm::iequals(response.command, command.command))
+      continue;
+    command.ack = response.ok() ? ACK : NACK;
+    command.answered = RequestHandler::Clock::now();
+    if (command.ack == NACK)
+      ROS_ERROR("Unicore: command %s failed: %.*s", command.command.c_str(),
+                static_cast<int>(response.response.size()),
+                response.response.data());
+    command_condition_.notify_all();
+    return;
+  }
+  ROS_DEBUG_COND(debug >= 2, "Unicore: response to %.*s: %.*s",
+                 static_cast<int>(response.command.size()),
+                 response.command.data(),
+                 static_cast<int>(response.response.size()),
+                 response.response.data());
+}
+
 void Gps::processUpdSosAck(const ublox_msgs::UpdSOS_Ack &m) {
   if (m.cmd == UpdSOS_Ack::CMD_BACKUP_CREATE_ACK) {
     Ack ack;
     ack.type = (m.response == m.BACKUP_CREATE_ACK) ? ACK : NACK;
     ack.class_id = m.CLASS_ID;
     ack.msg_id = m.MESSAGE_ID;
-    // store the ack atomically
-    ack_.store(ack, boost::memory_order_seq_cst);
+    storeAck(ack);
     ROS_DEBUG_COND(ack.type == ACK && debug >= 2,
                    "U-blox: received UPD SOS Backup ACK");
     if(ack.type == NACK)
@@ -134,34 +214,42 @@ void Gps::initializeSerial(std::string port, unsigned int baudrate,
     cfmakeraw(&tio);
     tcsetattr(fd, TCSANOW, &tio);
   }
+  if (!setLowLatency(serial->native_handle()))
+    ROS_DEBUG("U-Blox: The driver of %s does not support low latency mode",
+              port.c_str());
 
   // Set the I/O worker
   if (worker_) return;
   setWorker(boost::shared_ptr<Worker>(
-      new AsyncWorker<boost::asio::serial_port>(serial, io_service)));
+      new AsyncWorker<boost::asio::serial_port>(serial, io_service,
+                                                8192, read_buffer_size_)));
 
   configured_ = false;
 
   // Set the baudrate
-  boost::asio::serial_port_base::baud_rate current_baudrate;
-  serial->get_option(current_baudrate);
+  unsigned int current_baudrate = getBaudrate(*serial);
   // Incrementally increase the baudrate to the desired value
   for (int i = 0; i < sizeof(kBaudrates)/sizeof(kBaudrates[0]); i++) {
-    if (current_baudrate.value() == baudrate)
+    if (current_baudrate == baudrate)
       break;
     // Don't step down, unless the desired baudrate is lower
-    if(current_baudrate.value() > kBaudrates[i] && baudrate > kBaudrates[i])
+    if(current_baudrate > kBaudrates[i] && baudrate > kBaudrates[i])
       continue;
-    serial->set_option(
-        boost::asio::serial_port_base::baud_rate(kBaudrates[i]));
+    setBaudrate(*serial, kBaudrates[i]);
     boost::this_thread::sleep(
         boost::posix_time::milliseconds(kSetBaudrateSleepMs));
-    serial->get_option(current_baudrate);
-    ROS_DEBUG("U-Blox: Set ASIO baudrate to %u", current_baudrate.value());
+    current_baudrate = getBaudrate(*serial);
+    ROS_DEBUG("U-Blox: Set ASIO baudrate to %u", current_baudrate);
+  }
+  // A custom baudrate above the standard baudrates
+  if (current_baudrate != baudrate) {
+    setBaudrate(*serial, baudrate);
+    current_baudrate = getBaudrate(*serial);
+    ROS_DEBUG("U-Blox: Set custom baudrate to %u", current_baudrate);
   }
   if (config_on_startup_flag_) {
     configured_ = configUart1(baudrate, uart_in, uart_out);
-    if(!configured_ || current_baudrate.value() != baudrate) {
+    if(!configured_ || current_baudrate != baudrate) {
       throw std::runtime_error("Could not configure serial baud rate");
     }
   } else {
@@ -185,11 +273,13 @@ void Gps::resetSerial(std::string port) {
   }
 
   ROS_INFO("U-Blox: Reset serial port %s", port.c_str());
+  setLowLatency(serial->native_handle());
 
   // Set the I/O worker
   if (worker_) return;
   setWorker(boost::shared_ptr<Worker>(
-      new AsyncWorker<boost::asio::serial_port>(serial, io_service)));
+      new AsyncWorker<boost::asio::serial_port>(serial, io_service,
+                                                8192, read_buffer_size_)));
   configured_ = false;
   if (ubloxDevice == true) 
   {
@@ -251,7 +341,8 @@ void Gps::initializeTcp(std::string host, std::string port) {
   if (worker_) return;
   setWorker(boost::shared_ptr<Worker>(
       new AsyncWorker<boost::asio::ip::tcp::socket>(socket,
-                                                    io_service)));
+                                                    io_service, 8192,
+                                                    read_buffer_size_)));
 }
 
 void Gps::initializeUdp(std::string host, std::string port) {
@@ -287,7 +378,8 @@ void Gps::initializeUdp(std::string host, std::string port) {
   if (worker_) return;
   setWorker(boost::shared_ptr<Worker>(
       new AsyncWorker<boost::asio::ip::udp::socket>(socket,
-                                                    io_service)));
+                                                    io_service, 8192,
+                                                    read_buffer_size_)));
 }
 
 void Gps::close() {
@@ -298,6 +390,7 @@ void Gps::close() {
       ROS_INFO("U-Blox Flash BBR failed to save");
   }
   worker_.reset();
+  callbacks_.stopDecodeThreads();
   configured_ = false;
 }
 
@@ -586,8 +679,8 @@ bool Gps::setUseAdr(bool enable, float protocol_version) {
 }
 
 bool Gps::sendRtcm(const std::vector<uint8_t>& rtcm){
-  worker_->send(rtcm.data(), rtcm.size());
-  return true;
+  if (!worker_) return false;
+  return worker_->send(rtcm.data(), rtcm.size());
 }
 
 bool Gps::poll(uint8_t class_id, uint8_t message_id,
@@ -610,20 +703,103 @@ bool Gps::waitForAcknowledge(const boost::posix_time::time_duration& timeout,
   ROS_DEBUG_COND(debug >= 2, "Waiting for ACK 0x%02x / 0x%02x",
                  class_id, msg_id);
   if (ubloxDevice == false) return true;
-  boost::posix_time::ptime wait_until(
-      boost::posix_time::second_clock::local_time() + timeout);
-
-  Ack ack = ack_.load(boost::memory_order_seq_cst);
-  while (boost::posix_time::second_clock::local_time() < wait_until
-         && (ack.class_id != class_id
-             || ack.msg_id != msg_id
-             || ack.type == WAIT)) {
-    worker_->wait(timeout);
-    ack = ack_.load(boost::memory_order_seq_cst);
+  // The monotonic clock is not affected by adjustments of the system time
+  const RequestHandler::Clock::time_point wait_until = deadline(timeout);
+
+  std::unique_lock<std::mutex> lock(ack_mutex_);
+  while (ack_.class_id != class_id
+         || ack_.msg_id != msg_id
+         || ack_.type == WAIT) {
+    if (ack_condition_.wait_until(lock, wait_until)
+        == std::cv_status::timeout)
+      break;
+  }
+  bool result = ack_.type == ACK
+                && ack_.class_id == class_id
+                && ack_.msg_id == msg_id;
+  return result;
+}
+
+bool Gps::configureUnicore(const std::string & cmd, bool wait) {
+  if (wait) return configureUnicore(std::vector<std::string>(1, cmd));
+  if (!worker_) return false;
+  // Send the command to the device
+  return worker_->send(reinterpret_cast<const unsigned char*>(cmd.data()),
+                       cmd.size());
+}
+
+bool Gps::configureUnicore(const std::vector<std::string> & commands) {
+  if (!worker_) return false;
+  typedef RequestHandler::Clock Clock;
+  std::lock_guard<std::mutex> sequence_lock(sequence_mutex_);
+  std::unique_lock<std::mutex> lock(command_mutex_);
+  commands_.resize(commands.size());
+  for (size_t i = 0; i < commands.size(); ++i) {
+    commands_[i].command = boost::algorithm::trim_copy(commands[i]);
+    commands_[i].ack = WAIT;
+  }
+
+  const Clock::duration timeout =
+      std::chrono::microseconds(default_timeout_.total_microseconds());
+  const Clock::time_point start = Clock::now();
+  size_t sent = 0, answered = 0;
+  // The bytes of each command in the window, 0 if it was not sent
+  std::vector<std::size_t> in_window(commands.size(), 0);
+  std::size_t window = 0;
+  while (answered < commands.size()) {
+    // Send the next commands while they fit into the input buffer of the
+    // receiver, but at least one command
+    while (sent < commands.size()
+           && (sent == answered
+               || window + commands[sent].size() <= kUnicoreCommandWindow)) {
+      commands_[sent].sent = Clock::now();
+      // The I/O thread needs the lock to store the responses while the
+      // worker waits for space in its output buffer
+      lock.unlock();
+      bool ok = worker_->send(
+          reinterpret_cast<const unsigned char*>(commands[sent].data()),
+          commands[sent].size());
+      lock.lock();
+      if (ok) {
+        in_window[sent] = commands[sent].size();
+        window += in_window[sent];
+      } else {
+        // Do not wait for the response to a command which was not sent
+        ROS_ERROR("Unicore: failed to send command %s",
+                  commands_[sent].command.c_str());
+        commands_[sent].ack = NACK;
+        commands_[sent].answered = Clock::now();
+      }
+      ++sent;
+    }
+
+    // Wait for the response to the oldest command
+    UnicoreCommand &oldest = commands_[answered];
+    if (oldest.ack == WAIT
+        && command_condition_.wait_until(lock, oldest.sent + timeout)
+            == std::cv_status::timeout
+        && oldest.ack == WAIT) {
+      ROS_WARN("Unicore: no response to command %s", oldest.command.c_str());
+      oldest.ack = NACK;
+      oldest.answered = Clock::now();
+    }
+    while (answered < sent && commands_[answered].ack != WAIT)
+      window -= in_window[answered++];
+  }
+
+  bool result = true;
+  for (size_t i = 0; i < commands_.size(); ++i) {
+    ROS_DEBUG("Unicore: %s %s after %ld ms", commands_[i].command.c_str(),
+              commands_[i].ack == ACK ? "accepted" : "failed",
+              static_cast<long>(std::chrono::duration_cast<
+                  std::chrono::milliseconds>(commands_[i].answered
+                                             - commands_[i].sent).count()));
+    result = result && commands_[i].ack == ACK;
   }
-  bool result = ack.type == ACK
-                && ack.class_id == class_id
-                && ack.msg_id == msg_id;
+  ROS_INFO("Unicore: sent %zu commands in %ld ms", commands_.size(),
+           static_cast<long>(std::chrono::duration_cast<
+               std::chrono::milliseconds>(Clock::now() - start).count()));
+  commands_.clear();
   return result;
 }
 
@@ -28,6 +28,7 @@
 //==============================================================================
 
 #include "ublox_gps/node.h"
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <sstream>
@@ -86,26 +87,58 @@ uint8_t ublox_node::fixModeFromString(const std::string& mode) {
                            " is not a valid fix mode.");
 }
 
+//
+// u-blox node state
+//
+NodeState::NodeState(const ros::NodeHandle& nh)
+    : nh(nh), fix_status_service(0), meas_rate(0), nav_rate(0),
+      config_on_startup_flag(true), unicore_oem(0), uart_index(1) {}
+
+void NodeState::publish_nmea(boost::string_ref sentence,
+                             const std::string& topic) {
+  boost::shared_ptr<nmea_msgs::Sentence> m = nmea_pool.get();
+  m->header.stamp = ros::Time::now();
+  m->header.frame_id = frame_id;
+  m->sentence.assign(sentence.data(), sentence.size());
+  advertise<nmea_msgs::Sentence>(nmea_publisher, topic).publish(m);
+}
+
+void NodeState::publish_rtcm(const uint8_t* data, std::size_t size,
+                             const std::string& topic) {
+  boost::shared_ptr<rtcm_msgs::Message> m = rtcm_pool.get();
+  m->header.stamp = ros::Time::now();
+  m->header.frame_id = frame_id;
+  m->message.assign(data, data + size);
+  advertise<rtcm_msgs::Message>(rtcm_publisher, topic).publish(m);
+}
+
+bool NodeState::supportsGnss(std::string gnss) {
+  return supported.count(gnss) > 0;
+}
+
 //
 // u-blox ROS Node
 //
-UbloxNode::UbloxNode() {
-  initialize();
+UbloxNode::UbloxNode(const ros::NodeHandle& nh)
+    : state_(nh), rawDataStreamPa_(false, nh) {}
+
+UbloxNode::~UbloxNode() {
+  shutdown();
 }
 
 void UbloxNode::addFirmwareInterface() {
   int ublox_version;
   if (protocol_version_ < 14) {
-    components_.push_back(ComponentPtr(new UbloxFirmware6));
+    components_.push_back(ComponentPtr(new UbloxFirmware6(state_)));
     ublox_version = 6;
   } else if (protocol_version_ >= 14 && protocol_version_ <= 15) {
-    components_.push_back(ComponentPtr(new UbloxFirmware7));
+    components_.push_back(ComponentPtr(new UbloxFirmware7(state_)));
     ublox_version = 7;
   } else if (protocol_version_ > 15 && protocol_version_ <= 23) {
-    components_.push_back(ComponentPtr(new UbloxFirmware8));
+    components_.push_back(ComponentPtr(new UbloxFirmware8(state_)));
     ublox_version = 8;
   } else {
-    components_.push_back(ComponentPtr(new UbloxFirmware9)); // FOR F9P
+    components_.push_back(ComponentPtr(new UbloxFirmware9(state_))); // FOR F9P
     ublox_version = 9;
   }
 
@@ -116,19 +149,19 @@ void UbloxNode::addFirmwareInterface() {
 void UbloxNode::addProductInterface(std::string product_category,
                                     std::string ref_rov) {
   if (product_category.compare("HPG") == 0 && ref_rov.compare("REF") == 0)
-    components_.push_back(ComponentPtr(new HpgRefProduct));
+    components_.push_back(ComponentPtr(new HpgRefProduct(state_)));
   else if (product_category.compare("HPG") == 0 && ref_rov.compare("ROV") == 0)
-    components_.push_back(ComponentPtr(new HpgRovProduct));
+    components_.push_back(ComponentPtr(new HpgRovProduct(state_)));
   else if (product_category.compare("HPG") == 0)
-    components_.push_back(ComponentPtr(new HpPosRecProduct)); // F9P-01B
+    components_.push_back(ComponentPtr(new HpPosRecProduct(state_))); // F9P-01B
   else if (product_category.compare("HDG") == 0)
-    components_.push_back(ComponentPtr(new HpPosRecProduct));
+    components_.push_back(ComponentPtr(new HpPosRecProduct(state_)));
   else if (product_category.compare("TIM") == 0)
-    components_.push_back(ComponentPtr(new TimProduct));
+    components_.push_back(ComponentPtr(new TimProduct(state_)));
   else if (product_category.compare("ADR") == 0 ||
            product_category.compare("UDR") == 0 ||
            product_category.compare("LAP") == 0)
-    components_.push_back(ComponentPtr(new AdrUdrProduct(protocol_version_)));
+    components_.push_back(ComponentPtr(new AdrUdrProduct(state_, protocol_version_)));
   else if (product_category.compare("FTS") == 0)
     components_.push_back(ComponentPtr(new FtsProduct));
   else if(product_category.compare("SPG") != 0)
@@ -138,78 +171,90 @@ void UbloxNode::addProductInterface(std::string product_category,
 }
 
 void UbloxNode::getRosParams() {
-  nh->param("device", device_, std::string("/dev/ttyACM0"));
-  nh->param("frame_id", frame_id, std::string("gps"));
+  state_.nh.param("debug", ublox_gps::debug, 1);
+  if(ublox_gps::debug) {
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
+                                       ros::console::levels::Debug))
+     ros::console::notifyLoggerLevelsChanged();
+  }
+  state_.nh.param("device", device_, std::string("/dev/ttyACM0"));
+  state_.nh.param("frame_id", state_.frame_id, std::string("gps"));
 
   // if unicore_oem
  
-  getRosUint("unicore_oem",unicore_oem,0);
-  nh->param("publish/nmea", enabled["nmea"], false);
+  state_.getRosUint("unicore_oem",state_.unicore_oem,0);
+  state_.nh.param("publish/nmea", state_.enabled["nmea"], false);
  
   // Save configuration parameters
-  getRosUint("load/mask", load_.loadMask, 0);
-  getRosUint("load/device", load_.deviceMask, 0);
-  getRosUint("save/mask", save_.saveMask, 0);
-  getRosUint("save/device", save_.deviceMask, 0);
+  state_.getRosUint("load/mask", load_.loadMask, 0);
+  state_.getRosUint("load/device", load_.deviceMask, 0);
+  state_.getRosUint("save/mask", save_.saveMask, 0);
+  state_.getRosUint("save/device", save_.deviceMask, 0);
 
   // UART 1 params
-  getRosUint("uart1/baudrate", baudrate_, 9600);
-  getRosUint("uart1/in", uart_in_, ublox_msgs::CfgPRT::PROTO_UBX
+  state_.getRosUint("uart1/baudrate", baudrate_, 9600);
+  state_.getRosUint("uart1/in", uart_in_, ublox_msgs::CfgPRT::PROTO_UBX
                                     | ublox_msgs::CfgPRT::PROTO_NMEA
                                     | ublox_msgs::CfgPRT::PROTO_RTCM);
-  getRosUint("uart1/out", uart_out_, ublox_msgs::CfgPRT::PROTO_UBX);
+  state_.getRosUint("uart1/out", uart_out_, ublox_msgs::CfgPRT::PROTO_UBX);
+  state_.getRosUint("read_buffer_size", read_buffer_size_,
+                    ublox_gps::kDefaultReadBufferSize);
+  state_.getRosUint("decode_queue_depth", decode_queue_depth_,
+                    ublox_gps::kDefaultDecodeQueueDepth);
+  state_.getRosUint("decode_threads", decode_threads_, 1);
+  state_.nh.param("decode_cpus", decode_cpus_, std::vector<int>());
   // USB params
   set_usb_ = false;
-  if (nh->hasParam("usb/in") || nh->hasParam("usb/out")) {
+  if (state_.nh.hasParam("usb/in") || state_.nh.hasParam("usb/out")) {
     set_usb_ = true;
-    if(!getRosUint("usb/in", usb_in_)) {
+    if(!state_.getRosUint("usb/in", usb_in_)) {
       throw std::runtime_error(std::string("usb/out is set, therefore ") +
         "usb/in must be set");
     }
-    if(!getRosUint("usb/out", usb_out_)) {
+    if(!state_.getRosUint("usb/out", usb_out_)) {
       throw std::runtime_error(std::string("usb/in is set, therefore ") +
         "usb/out must be set");
     }
-    getRosUint("usb/tx_ready", usb_tx_, 0);
+    state_.getRosUint("usb/tx_ready", usb_tx_, 0);
   }
   // Measurement rate params
-  nh->param("rate", rate_, 4.0);  // in Hz
-  getRosUint("nav_rate", nav_rate, 1);  // # of measurement rate cycles
+  state_.nh.param("rate", rate_, 4.0);  // in Hz
+  state_.getRosUint("nav_rate", state_.nav_rate, 1);  // # of measurement rate cycles
   // RTCM params
-  getRosUint("rtcm/ids", rtcm_ids);  // RTCM output message IDs
-  getRosUint("rtcm/rates", rtcm_rates);  // RTCM output message rates
+  state_.getRosUint("rtcm/ids", state_.rtcm_ids);  // RTCM output message IDs
+  state_.getRosUint("rtcm/rates", state_.rtcm_rates);  // RTCM output message rates
   // PPP: Advanced Setting
-  nh->param("enable_ppp", enable_ppp_, false);
+  state_.nh.param("enable_ppp", enable_ppp_, false);
   // SBAS params, only for some devices
-  nh->param("sbas", enable_sbas_, false);
-  getRosUint("sbas/max", max_sbas_, 0); // Maximum number of SBAS channels
-  getRosUint("sbas/usage", sbas_usage_, 0);
-  nh->param("dynamic_model", dynamic_model_, std::string("portable"));
-  nh->param("fix_mode", fix_mode_, std::string("auto"));
-  getRosUint("dr_limit", dr_limit_, 0); // Dead reckoning limit
+  state_.nh.param("sbas", enable_sbas_, false);
+  state_.getRosUint("sbas/max", max_sbas_, 0); // Maximum number of SBAS channels
+  state_.getRosUint("sbas/usage", sbas_usage_, 0);
+  state_.nh.param("dynamic_model", dynamic_model_, std::string("portable"));
+  state_.nh.param("fix_mode", fix_mode_, std::string("auto"));
+  state_.getRosUint("dr_limit", dr_limit_, 0); // Dead reckoning limit
 
-  getRosUint("unicore_oem", unicore_oem, 0); // unicore oem  for ros
+  state_.getRosUint("unicore_oem", state_.unicore_oem, 0); // unicore oem  for ros
 
   if (enable_ppp_)
     ROS_WARN("Warning: PPP is enabled - this is an expert setting.");
 
   checkMin(rate_, 0, "rate");
 
-  if(rtcm_ids.size() != rtcm_rates.size())
+  if(state_.rtcm_ids.size() != state_.rtcm_rates.size())
     throw std::runtime_error(std::string("Invalid settings: size of rtcm_ids") +
                              " must match size of rtcm_rates");
 
   dmodel_ = modelFromString(dynamic_model_);
   fmode_ = fixModeFromString(fix_mode_);
 
-  nh->param("dat/set", set_dat_, false);
+  state_.nh.param("dat/set", set_dat_, false);
   if(set_dat_) {
     std::vector<float> shift, rot;
-    if (!nh->getParam("dat/majA", cfg_dat_.majA)
-        || nh->getParam("dat/flat", cfg_dat_.flat)
-        || nh->getParam("dat/shift", shift)
-        || nh->getParam("dat/rot", rot)
-        || nh->getParam("dat/scale", cfg_dat_.scale))
+    if (!state_.nh.getParam("dat/majA", cfg_dat_.majA)
+        || state_.nh.getParam("dat/flat", cfg_dat_.flat)
+        || state_.nh.getParam("dat/shift", shift)
+        || state_.nh.getParam("dat/rot", rot)
+        || state_.nh.getParam("dat/scale", cfg_dat_.scale))
       throw std::runtime_error(std::string("dat/set is true, therefore ") +
          "dat/majA, dat/flat, dat/shift, dat/rot, & dat/scale must be set");
     if(shift.size() != 3 || rot.size() != 3)
@@ -232,10 +277,10 @@ void UbloxNode::getRosParams() {
   }
 
   // measurement period [ms]
-  meas_rate = 1000 / rate_;
+  state_.meas_rate = 1000 / rate_;
 
   // activate/deactivate any config
-  nh->param("config_on_startup", config_on_startup_flag_, true);
+  state_.nh.param("config_on_startup", state_.config_on_startup_flag, true);
 
   // raw data stream logging 
   rawDataStreamPa_.getRosParams();
@@ -243,17 +288,17 @@ void UbloxNode::getRosParams() {
 
 void UbloxNode::keepAlive(const ros::TimerEvent& event) {
   // Poll version message to keep UDP socket active
-  gps.poll(ublox_msgs::MonVER::CLASS_ID, ublox_msgs::MonVER::MESSAGE_ID);
+  state_.gps.poll(ublox_msgs::MonVER::CLASS_ID, ublox_msgs::MonVER::MESSAGE_ID);
 }
 
 void UbloxNode::pollMessages(const ros::TimerEvent& event) {
   static std::vector<uint8_t> payload(1, 1);
-  if (enabled["aid_alm"])
-    gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::ALM, payload);
-  if (enabled["aid_eph"])
-    gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::EPH, payload);
-  if (enabled["aid_hui"])
-    gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::HUI);
+  if (state_.enabled["aid_alm"])
+    state_.gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::ALM, payload);
+  if (state_.enabled["aid_eph"])
+    state_.gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::EPH, payload);
+  if (state_.enabled["aid_hui"])
+    state_.gps.poll(ublox_msgs::Class::AID, ublox_msgs::Message::AID::HUI);
 
   payload[0]++;
   if (payload[0] > 32) {
@@ -275,87 +320,87 @@ void UbloxNode::printInf(const ublox_msgs::Inf &m, uint8_t id) {
 void UbloxNode::subscribe() {
   ROS_DEBUG("Subscribing to U-Blox messages");
   // subscribe messages
-  nh->param("publish/all", enabled["all"], false);
-  nh->param("inf/all", enabled["inf"], true);
-  nh->param("publish/nav/all", enabled["nav"], enabled["all"]);
-  nh->param("publish/rxm/all", enabled["rxm"], enabled["all"]);
-  nh->param("publish/aid/all", enabled["aid"], enabled["all"]);
-  nh->param("publish/mon/all", enabled["mon"], enabled["all"]);
+  state_.nh.param("publish/all", state_.enabled["all"], false);
+  state_.nh.param("inf/all", state_.enabled["inf"], true);
+  state_.nh.param("publish/nav/all", state_.enabled["nav"], state_.enabled["all"]);
+  state_.nh.param("publish/rxm/all", state_.enabled["rxm"], state_.enabled["all"]);
+  state_.nh.param("publish/aid/all", state_.enabled["aid"], state_.enabled["all"]);
+  state_.nh.param("publish/mon/all", state_.enabled["mon"], state_.enabled["all"]);
 
   // Nav Messages
-  nh->param("publish/nav/status", enabled["nav_status"], enabled["nav"]);
-  if (enabled["nav_status"])
-    gps.subscribe<ublox_msgs::NavSTATUS>(boost::bind(
-        publish<ublox_msgs::NavSTATUS>, _1, "navstatus"), kSubscribeRate);
-
-  nh->param("publish/nav/posecef", enabled["nav_posecef"], enabled["nav"]);
-  if (enabled["nav_posecef"])
-    gps.subscribe<ublox_msgs::NavPOSECEF>(boost::bind(
-        publish<ublox_msgs::NavPOSECEF>, _1, "navposecef"), kSubscribeRate);
-
-  nh->param("publish/nav/clock", enabled["nav_clock"], enabled["nav"]);
-  if (enabled["nav_clock"])
-    gps.subscribe<ublox_msgs::NavCLOCK>(boost::bind(
-        publish<ublox_msgs::NavCLOCK>, _1, "navclock"), kSubscribeRate);
-
-  nh->param("publish/nmea", enabled["nmea"], false);
-  if (enabled["nmea"])
+  state_.nh.param("publish/nav/status", state_.enabled["nav_status"], state_.enabled["nav"]);
+  if (state_.enabled["nav_status"])
+    state_.subscribe<ublox_msgs::NavSTATUS>("navstatus", kSubscribeRate);
+
+  state_.nh.param("publish/nav/posecef", state_.enabled["nav_posecef"], state_.enabled["nav"]);
+  if (state_.enabled["nav_posecef"])
+    state_.subscribe<ublox_msgs::NavPOSECEF>("navposecef", kSubscribeRate);
+
+  state_.nh.param("publish/nav/clock", state_.enabled["nav_clock"], state_.enabled["nav"]);
+  if (state_.enabled["nav_clock"])
+    state_.subscribe<ublox_msgs::NavCLOCK>("navclock", kSubscribeRate);
+
+  state_.nh.param("publish/nmea", state_.enabled["nmea"], false);
+  if (state_.enabled["nmea"])
   {
      ROS_DEBUG("sub nema");
-     gps.subscribe_nmea(boost::bind(publish_nmea, _1, "nmea"));
+     state_.gps.subscribe_nmea(boost::bind(&NodeState::publish_nmea, &state_,
+                                           _1, "nmea"));
   }
 
+  state_.nh.param("publish/rtcm", state_.enabled["rtcm"], false);
+  if (state_.enabled["rtcm"])
+    state_.gps.subscribe_rtcm(boost::bind(&NodeState::publish_rtcm, &state_,
+                                          _1, _2, "rtcm"));
+
   // INF messages
-  nh->param("inf/debug", enabled["inf_debug"], false);
-  if (enabled["inf_debug"])
-    gps.subscribeId<ublox_msgs::Inf>(
+  state_.nh.param("inf/debug", state_.enabled["inf_debug"], false);
+  if (state_.enabled["inf_debug"])
+    state_.gps.subscribeId<ublox_msgs::Inf>(
         boost::bind(&UbloxNode::printInf, this, _1,
                     ublox_msgs::Message::INF::DEBUG),
         ublox_msgs::Message::INF::DEBUG);
 
-  nh->param("inf/error", enabled["inf_error"], enabled["inf"]);
-  if (enabled["inf_error"])
-    gps.subscribeId<ublox_msgs::Inf>(
+  state_.nh.param("inf/error", state_.enabled["inf_error"], state_.enabled["inf"]);
+  if (state_.enabled["inf_error"])
+    state_.gps.subscribeId<ublox_msgs::Inf>(
         boost::bind(&UbloxNode::printInf, this, _1,
                     ublox_msgs::Message::INF::ERROR),
         ublox_msgs::Message::INF::ERROR);
 
-  nh->param("inf/notice", enabled["inf_notice"], enabled["inf"]);
-  if (enabled["inf_notice"])
-    gps.subscribeId<ublox_msgs::Inf>(
+  state_.nh.param("inf/notice", state_.enabled["inf_notice"], state_.enabled["inf"]);
+  if (state_.enabled["inf_notice"])
+    state_.gps.subscribeId<ublox_msgs::Inf>(
         boost::bind(&UbloxNode::printInf, this, _1,
                     ublox_msgs::Message::INF::NOTICE),
         ublox_msgs::Message::INF::NOTICE);
 
-  nh->param("inf/test", enabled["inf_test"], enabled["inf"]);
-  if (enabled["inf_test"])
-    gps.subscribeId<ublox_msgs::Inf>(
+  state_.nh.param("inf/test", state_.enabled["inf_test"], state_.enabled["inf"]);
+  if (state_.enabled["inf_test"])
+    state_.gps.subscribeId<ublox_msgs::Inf>(
         boost::bind(&UbloxNode::printInf, this, _1,
                     ublox_msgs::Message::INF::TEST),
         ublox_msgs::Message::INF::TEST);
 
-  nh->param("inf/warning", enabled["inf_warning"], enabled["inf"]);
-  if (enabled["inf_warning"])
-    gps.subscribeId<ublox_msgs::Inf>(
+  state_.nh.param("inf/warning", state_.enabled["inf_warning"], state_.enabled["inf"]);
+  if (state_.enabled["inf_warning"])
+    state_.gps.subscribeId<ublox_msgs::Inf>(
         boost::bind(&UbloxNode::printInf, this, _1,
                     ublox_msgs::Message::INF::WARNING),
         ublox_msgs::Message::INF::WARNING);
 
   // AID messages
-  nh->param("publish/aid/alm", enabled["aid_alm"], enabled["aid"]);
-  if (enabled["aid_alm"])
-    gps.subscribe<ublox_msgs::AidALM>(boost::bind(
-        publish<ublox_msgs::AidALM>, _1, "aidalm"), kSubscribeRate);
-
-  nh->param("publish/aid/eph", enabled["aid_eph"], enabled["aid"]);
-  if (enabled["aid_eph"])
-    gps.subscribe<ublox_msgs::AidEPH>(boost::bind(
-        publish<ublox_msgs::AidEPH>, _1, "aideph"), kSubscribeRate);
-
-  nh->param("publish/aid/hui", enabled["aid_hui"], enabled["aid"]);
-  if (enabled["aid_hui"])
-    gps.subscribe<ublox_msgs::AidHUI>(boost::bind(
-        publish<ublox_msgs::AidHUI>, _1, "aidhui"), kSubscribeRate);
+  state_.nh.param("publish/aid/alm", state_.enabled["aid_alm"], state_.enabled["aid"]);
+  if (state_.enabled["aid_alm"])
+    state_.subscribe<ublox_msgs::AidALM>("aidalm", kSubscribeRate);
+
+  state_.nh.param("publish/aid/eph", state_.enabled["aid_eph"], state_.enabled["aid"]);
+  if (state_.enabled["aid_eph"])
+    state_.subscribe<ublox_msgs::AidEPH>("aideph", kSubscribeRate);
+
+  state_.nh.param("publish/aid/hui", state_.enabled["aid_hui"], state_.enabled["aid"]);
+  if (state_.enabled["aid_hui"])
+    state_.subscribe<ublox_msgs::AidHUI>("aidhui", kSubscribeRate);
   // call hw  or fw or differnt feature  callbacks
   for(int i = 0; i < components_.size(); i++)
     components_[i]->subscribe();
@@ -365,15 +410,17 @@ void UbloxNode::subscribe() {
 }
 
 void UbloxNode::initializeRosDiagnostics() {
-  if (!nh->hasParam("diagnostic_period"))
-    nh->setParam("diagnostic_period", kDiagnosticPeriod);
+  if (!state_.nh.hasParam("diagnostic_period"))
+    state_.nh.setParam("diagnostic_period", kDiagnosticPeriod);
 
-  updater.reset(new diagnostic_updater::Updater());
-  updater->setHardwareID("ublox");
+  state_.updater.reset(new diagnostic_updater::Updater(
+      ros::NodeHandle(), state_.nh, state_.nh.getNamespace()));
+  state_.updater->setHardwareID("ublox");
 
   // configure diagnostic updater for frequency
-  freq_diag.reset(new FixDiagnostic(std::string("fix"), kFixFreqTol,
-                            kFixFreqWindow, kTimeStampStatusMin));
+  state_.freq_diag.reset(new FixDiagnostic(state_, std::string("fix"),
+                                           kFixFreqTol, kFixFreqWindow,
+                                           kTimeStampStatusMin));
   for(int i = 0; i < components_.size(); i++)
     components_[i]->initializeRosDiagnostics();
 }
@@ -381,7 +428,7 @@ void UbloxNode::initializeRosDiagnostics() {
 
 void UbloxNode::processMonVer() {
   ublox_msgs::MonVER monVer;
-  if (!gps.poll(monVer))
+  if (!state_.gps.poll(monVer))
     throw std::runtime_error("Failed to poll MonVER & set relevant settings");
 
   ROS_DEBUG("%s, HW VER: %s", monVer.swVersion.c_array(),
@@ -418,7 +465,7 @@ void UbloxNode::processMonVer() {
     if(extension.size() > 0)
       boost::split(strs, extension[extension.size()-1], boost::is_any_of(";"));
     for(size_t i = 0; i < strs.size(); i++)
-      supported.insert(strs[i]);
+      state_.supported.insert(strs[i]);
   } else {
     for(std::size_t i = 0; i < extension.size(); ++i) {
       std::vector<std::string> strs;
@@ -439,7 +486,7 @@ void UbloxNode::processMonVer() {
       if(i >= extension.size() - 2) {
         boost::split(strs, extension[i], boost::is_any_of(";"));
         for(size_t i = 0; i < strs.size(); i++)
-          supported.insert(strs[i]);
+          state_.supported.insert(strs[i]);
       }
     }
   }
@@ -447,56 +494,56 @@ void UbloxNode::processMonVer() {
 
 bool UbloxNode::configureUblox() {
   try {
-    if (!gps.isInitialized())
+    if (!state_.gps.isInitialized())
       throw std::runtime_error("Failed to initialize.");
     if (load_.loadMask != 0) {
       ROS_DEBUG("Loading u-blox configuration from memory. %u", load_.loadMask);
-      if (!gps.configure(load_))
+      if (!state_.gps.configure(load_))
         throw std::runtime_error(std::string("Failed to load configuration ") +
                                  "from memory");
       if (load_.loadMask & load_.MASK_IO_PORT) {
         ROS_DEBUG("Loaded I/O configuration from memory, resetting serial %s",
           "communications.");
         boost::posix_time::seconds wait(kResetWait);
-        gps.reset(wait);
-        if (!gps.isConfigured())
+        state_.gps.reset(wait);
+        if (!state_.gps.isConfigured())
           throw std::runtime_error(std::string("Failed to reset serial I/O") +
             "after loading I/O configurations from device memory.");
       }
     }
 
-    if (config_on_startup_flag_) {
+    if (state_.config_on_startup_flag) {
       if (set_usb_) {
-        gps.configUsb(usb_tx_, usb_in_, usb_out_);
+        state_.gps.configUsb(usb_tx_, usb_in_, usb_out_);
       }
-      if (!gps.configRate(meas_rate, nav_rate)) {
+      if (!state_.gps.configRate(state_.meas_rate, state_.nav_rate)) {
         std::stringstream ss;
-        ss << "Failed to set measurement rate to " << meas_rate
-          << "ms and navigation rate to " << nav_rate;
+        ss << "Failed to set measurement rate to " << state_.meas_rate
+          << "ms and navigation rate to " << state_.nav_rate;
         throw std::runtime_error(ss.str());
       }
       // If device doesn't have SBAS, will receive NACK (causes exception)
-      if(supportsGnss("SBAS")) {
-        if (!gps.configSbas(enable_sbas_, sbas_usage_, max_sbas_)) {
+      if(state_.supportsGnss("SBAS")) {
+        if (!state_.gps.configSbas(enable_sbas_, sbas_usage_, max_sbas_)) {
           throw std::runtime_error(std::string("Failed to ") +
                                   ((enable_sbas_) ? "enable" : "disable") +
                                   " SBAS.");
         }
       }
-      if (!gps.setPpp(enable_ppp_, protocol_version_))
+      if (!state_.gps.setPpp(enable_ppp_, protocol_version_))
         throw std::runtime_error(std::string("Failed to ") +
                                 ((enable_ppp_) ? "enable" : "disable")
                                 + " PPP.");
-      if (!gps.setDynamicModel(dmodel_))
+      if (!state_.gps.setDynamicModel(dmodel_))
         throw std::runtime_error("Failed to set model: " + dynamic_model_ + ".");
-      if (!gps.setFixMode(fmode_))
+      if (!state_.gps.setFixMode(fmode_))
         throw std::runtime_error("Failed to set fix mode: " + fix_mode_ + ".");
-      if (!gps.setDeadReckonLimit(dr_limit_)) {
+      if (!state_.gps.setDeadReckonLimit(dr_limit_)) {
         std::stringstream ss;
         ss << "Failed to set dead reckoning limit: " << dr_limit_ << ".";
         throw std::runtime_error(ss.str());
       }
-      if (set_dat_ && !gps.configure(cfg_dat_))
+      if (set_dat_ && !state_.gps.configure(cfg_dat_))
         throw std::runtime_error("Failed to set user-defined datum.");
       // Configure each component
       for (int i = 0; i < components_.size(); i++) {
@@ -507,7 +554,7 @@ bool UbloxNode::configureUblox() {
     if (save_.saveMask != 0) {
       ROS_DEBUG("Saving the u-blox configuration, mask %u, device %u",
                 save_.saveMask, save_.deviceMask);
-      if(!gps.configure(save_))
+      if(!state_.gps.configure(save_))
         ROS_ERROR("u-blox unable to save configuration to non-volatile memory");
     }
   } catch (std::exception& e) {
@@ -523,11 +570,11 @@ void UbloxNode::configureInf() {
   ublox_msgs::CfgINF_Block block;
   block.protocolID = block.PROTOCOL_ID_UBX;
   // Enable desired INF messages on each UBX port
-  uint8_t mask = (enabled["inf_error"] ? block.INF_MSG_ERROR : 0) |
-                 (enabled["inf_warning"] ? block.INF_MSG_WARNING : 0) |
-                 (enabled["inf_notice"] ? block.INF_MSG_NOTICE : 0) |
-                 (enabled["inf_test"] ? block.INF_MSG_TEST : 0) |
-                 (enabled["inf_debug"] ? block.INF_MSG_DEBUG : 0);
+  uint8_t mask = (state_.enabled["inf_error"] ? block.INF_MSG_ERROR : 0) |
+                 (state_.enabled["inf_warning"] ? block.INF_MSG_WARNING : 0) |
+                 (state_.enabled["inf_notice"] ? block.INF_MSG_NOTICE : 0) |
+                 (state_.enabled["inf_test"] ? block.INF_MSG_TEST : 0) |
+                 (state_.enabled["inf_debug"] ? block.INF_MSG_DEBUG : 0);
   for (int i = 0; i < block.infMsgMask.size(); i++)
     block.infMsgMask[i] = mask;
 
@@ -544,18 +591,21 @@ void UbloxNode::configureInf() {
   }
 
   ROS_DEBUG("Configuring INF messages");
-  if (!gps.configure(msg))
+  if (!state_.gps.configure(msg))
     ROS_WARN("Failed to configure INF messages");
 }
 
 void UbloxNode::initializeIo() {
   // if unicore
 
-    if (unicore_oem == 1) {
+    if (state_.unicore_oem == 1) {
         ROS_DEBUG("deice is unicore oem");
-        gps.setUbloxDev(false);
+        state_.gps.setUbloxDev(false);
     }
-    gps.setConfigOnStartup(config_on_startup_flag_);
+    state_.gps.setConfigOnStartup(state_.config_on_startup_flag);
+    state_.gps.setReadBufferSize(read_buffer_size_);
+    state_.gps.setDecodeQueueDepth(decode_queue_depth_);
+    state_.gps.setDecodeThreads(decode_threads_, decode_cpus_);
 
   boost::smatch match;
   if (boost::regex_match(device_, match,
@@ -566,34 +616,34 @@ void UbloxNode::initializeIo() {
       std::string port(match[3]);
       ROS_INFO("Connecting to %s://%s:%s ...", proto.c_str(), host.c_str(),
                port.c_str());
-      gps.initializeTcp(host, port);
+      state_.gps.initializeTcp(host, port);
     } else if (proto == "udp") {
       std::string host(match[2]);
       std::string port(match[3]);
       ROS_INFO("Connecting to %s://%s:%s ...", proto.c_str(), host.c_str(),
                port.c_str());
-      gps.initializeUdp(host, port);
+      state_.gps.initializeUdp(host, port);
     } else {
       throw std::runtime_error("Protocol '" + proto + "' is unsupported");
     }
   } else {
-    gps.initializeSerial(device_, baudrate_, uart_in_, uart_out_);
+    state_.gps.initializeSerial(device_, baudrate_, uart_in_, uart_out_);
   }
 
   // raw data stream logging
   if (rawDataStreamPa_.isEnabled()) {
-    gps.setRawDataCallback(
-      boost::bind(&RawDataStreamPa::ubloxCallback,&rawDataStreamPa_, _1, _2));
     rawDataStreamPa_.initialize();
+    state_.gps.setRawDataCallback(
+      boost::bind(&RawDataStreamPa::ubloxCallback,&rawDataStreamPa_, _1, _2));
   }
 }
 
-void UbloxNode::initialize() {
+bool UbloxNode::initialize() {
   // Params must be set before initializing IO
   getRosParams();
   initializeIo();
   
-  if (unicore_oem == 0) {
+  if (state_.unicore_oem == 0) {
       // Must process Mon VER before setting firmware/hardware params
       processMonVer();
   }
@@ -601,7 +651,7 @@ void UbloxNode::initialize() {
   {
       //for um982,fake ublox f9p
       protocol_version_ = 9;
-      UnicoreVirtualProduct* unicoreProduct = new UnicoreVirtualProduct;
+      UnicoreVirtualProduct* unicoreProduct = new UnicoreVirtualProduct(state_);
       int cur_bps,det_bps;
       #if 1
       if (unicoreProduct->auto_detect_bps(device_,det_bps,cur_bps) == true) {
@@ -610,75 +660,84 @@ void UbloxNode::initialize() {
             if (det_bps != cur_bps) {
               //config to custom  bps
               char format_str[128] = { 0 };
-              snprintf(format_str,sizeof(format_str)-1,"CONFIG COM%d %d 8 n 1\r\n",uart_index,baudrate_);
+              snprintf(format_str,sizeof(format_str)-1,"CONFIG COM%d %d 8 n 1\r\n",state_.uart_index,baudrate_);
               ROS_INFO("uart bps:%s",format_str);
-              gps.configureUnicore(format_str);
-              ros::Duration(2.0).sleep();
-              gps.resetSerial(device_);
+              // The receiver changes the baudrate after its response
+              if (!state_.gps.configureUnicore(format_str, true))
+                ros::Duration(2.0).sleep();
+              state_.gps.resetSerial(device_);
               ROS_INFO("after config uart ,re-inited uart with bps:%d",baudrate_);
-              gps.initializeSerial(device_, baudrate_, uart_in_, uart_out_);
+              state_.gps.initializeSerial(device_, baudrate_, uart_in_, uart_out_);
             }
       }
       //delete unicoreProduct;
       #endif
-      components_.push_back(ComponentPtr(new UbloxFirmware9)); // FOR F9P
-      components_.push_back(ComponentPtr(new HpPosRecProduct)); // F9P-01B
+      components_.push_back(ComponentPtr(new UbloxFirmware9(state_))); // FOR F9P
+      components_.push_back(ComponentPtr(new HpPosRecProduct(state_))); // F9P-01B
       //components_.push_back(ComponentPtr(new UnicoreVirtualProduct));// unicore convet to ubx
       components_.push_back(ComponentPtr((ComponentInterface*)unicoreProduct));// unicore convet to ubx
       //GPS, GLO, GAL, BDS, QZSS, SBAS,
-      supported.insert("GPS");
-      supported.insert("GLO");
-      supported.insert("GAL");
-      supported.insert("BDS");
-      supported.insert("QZSS");
-      supported.insert("SBAS");
+      state_.supported.insert("GPS");
+      state_.supported.insert("GLO");
+      state_.supported.insert("GAL");
+      state_.supported.insert("BDS");
+      state_.supported.insert("QZSS");
+      state_.supported.insert("SBAS");
       //
   }
   if(protocol_version_ <= 14) { // f9p: protocol_version_ is 9
-    if(nh->param("raw_data", false))
-      components_.push_back(ComponentPtr(new RawDataProduct));
+    if(state_.nh.param("raw_data", false))
+      components_.push_back(ComponentPtr(new RawDataProduct(state_)));
   }
+  if (state_.nh.param("nmea/decode", false))
+    components_.push_back(ComponentPtr(new NmeaProduct(state_)));
   // Must set firmware & hardware params before initializing diagnostics
   for (int i = 0; i < components_.size(); i++)
     components_[i]->getRosParams();
 
-  if (unicore_oem) {
+  if (state_.unicore_oem) {
       // auto check bps
   }
   // Do this last
   initializeRosDiagnostics();
 
-  if (configureUblox()) {
-    ROS_INFO("U-Blox configured successfully.");
-    // Subscribe to all U-Blox messages
-    subscribe();
-    // for ublox device
-    if (unicore_oem == 0) {
-        // Configure INF messages (needs INF params, call after subscribing)
-        configureInf();
-
-        ros::Timer keep_alive;
-        if (device_.substr(0, 6) == "udp://") {
-          // Setup timer to poll version message to keep UDP socket active
-          keep_alive = nh->createTimer(ros::Duration(kKeepAlivePeriod),
-                                       &UbloxNode::keepAlive,
-                                       this);
-        }
+  if (!configureUblox())
+    return false;
+  ROS_INFO("U-Blox configured successfully.");
+  // Subscribe to all U-Blox messages
+  subscribe();
+  // for ublox device
+  if (state_.unicore_oem == 0) {
+      // Configure INF messages (needs INF params, call after subscribing)
+      configureInf();
+
+      if (device_.substr(0, 6) == "udp://") {
+        // Setup timer to poll version message to keep UDP socket active
+        keep_alive_ = state_.nh.createTimer(ros::Duration(kKeepAlivePeriod),
+                                            &UbloxNode::keepAlive,
+                                            this);
+      }
 
-        ros::Timer poller;
-        poller = nh->createTimer(ros::Duration(kPollDuration),
-                                 &UbloxNode::pollMessages,
-                                 this);
-        poller.start();
-    }
-    ros::spin();
+      poller_ = state_.nh.createTimer(ros::Duration(kPollDuration),
+                                      &UbloxNode::pollMessages,
+                                      this);
   }
-  shutdown();
+  rtcm_subscriber_ = state_.nh.subscribe("/rtcm", 10, &UbloxNode::rtcmCallback,
+                                         this);
+  return true;
+}
+
+void UbloxNode::rtcmCallback(const rtcm_msgs::Message::ConstPtr& m) {
+  ROS_INFO("rtcmCallback");
+  state_.gps.sendRtcm(m->message);
 }
 
 void UbloxNode::shutdown() {
-  if (gps.isInitialized()) {
-    gps.close();
+  keep_alive_.stop();
+  poller_.stop();
+  rtcm_subscriber_.shutdown();
+  if (state_.gps.isInitialized()) {
+    state_.gps.close();
     ROS_INFO("Closed connection to %s.", device_.c_str());
   }
 }
@@ -687,33 +746,34 @@ void UbloxNode::shutdown() {
 // U-Blox Firmware (all versions)
 //
 void UbloxFirmware::initializeRosDiagnostics() {
-  updater->add("fix", this, &UbloxFirmware::fixDiagnostic);
-  updater->force_update();
+  state_.updater->add("fix", this, &UbloxFirmware::fixDiagnostic);
+  state_.updater->force_update();
 }
 
 //
 // U-Blox Firmware Version 6
 //
-UbloxFirmware6::UbloxFirmware6() {}
+UbloxFirmware6::UbloxFirmware6(NodeState& state)
+    : UbloxFirmware(state) {}
 
 void UbloxFirmware6::getRosParams() {
   // Fix Service type, used when publishing fix status messages
-  fix_status_service = sensor_msgs::NavSatStatus::SERVICE_GPS;
+  state_.fix_status_service = sensor_msgs::NavSatStatus::SERVICE_GPS;
 
-  nh->param("nmea/set", set_nmea_, false);
+  state_.nh.param("nmea/set", set_nmea_, false);
   if (set_nmea_) {
     bool compat, consider;
 
-    if (!getRosUint("nmea/version", cfg_nmea_.version))
+    if (!state_.getRosUint("nmea/version", cfg_nmea_.version))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/version must be set");
-    if (!getRosUint("nmea/num_sv", cfg_nmea_.numSV))
+    if (!state_.getRosUint("nmea/num_sv", cfg_nmea_.numSV))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
                 "true, therefore nmea/num_sv must be set");
-    if (!nh->getParam("nmea/compat", compat))
+    if (!state_.nh.getParam("nmea/compat", compat))
         throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/compat must be set");
-    if (!nh->getParam("nmea/consider", consider))
+    if (!state_.nh.getParam("nmea/consider", consider))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/consider must be set");
 
@@ -723,17 +783,17 @@ void UbloxFirmware6::getRosParams() {
 
     // set filter
     bool temp;
-    nh->param("nmea/filter/pos", temp, false);
+    state_.nh.param("nmea/filter/pos", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_POS : 0;
-    nh->param("nmea/filter/msk_pos", temp, false);
+    state_.nh.param("nmea/filter/msk_pos", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_MSK_POS : 0;
-    nh->param("nmea/filter/time", temp, false);
+    state_.nh.param("nmea/filter/time", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_TIME : 0;
-    nh->param("nmea/filter/date", temp, false);
+    state_.nh.param("nmea/filter/date", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_DATE : 0;
-    nh->param("nmea/filter/sbas", temp, false);
+    state_.nh.param("nmea/filter/sbas", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_SBAS_FILT : 0;
-    nh->param("nmea/filter/track", temp, false);
+    state_.nh.param("nmea/filter/track", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_TRACK : 0;
   }
 }
@@ -741,7 +801,7 @@ void UbloxFirmware6::getRosParams() {
 bool UbloxFirmware6::configureUblox() {
   ROS_WARN("ublox_version < 7, ignoring GNSS settings");
 
-  if (set_nmea_ && !gps.configure(cfg_nmea_))
+  if (set_nmea_ && !state_.gps.configure(cfg_nmea_))
     throw std::runtime_error("Failed to configure NMEA");
 
   return true;
@@ -749,33 +809,31 @@ bool UbloxFirmware6::configureUblox() {
 
 void UbloxFirmware6::subscribe() {
   // Whether or not to publish Nav POS LLH (always subscribes)
-  nh->param("publish/nav/posllh", enabled["nav_posllh"], enabled["nav"]);
-  nh->param("publish/nav/sol", enabled["nav_sol"], enabled["nav"]);
-  nh->param("publish/nav/velned", enabled["nav_velned"], enabled["nav"]);
+  state_.nh.param("publish/nav/posllh", state_.enabled["nav_posllh"], state_.enabled["nav"]);
+  state_.nh.param("publish/nav/sol", state_.enabled["nav_sol"], state_.enabled["nav"]);
+  state_.nh.param("publish/nav/velned", state_.enabled["nav_velned"], state_.enabled["nav"]);
 
   // Always subscribes to these messages, but may not publish to ROS topic
   // Subscribe to Nav POSLLH
-  gps.subscribe<ublox_msgs::NavPOSLLH>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavPOSLLH>(boost::bind(
       &UbloxFirmware6::callbackNavPosLlh, this, _1), kSubscribeRate);
   // Subscribe to Nav SOL
-  gps.subscribe<ublox_msgs::NavSOL>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavSOL>(boost::bind(
       &UbloxFirmware6::callbackNavSol, this, _1), kSubscribeRate);
   // Subscribe to Nav VELNED
-  gps.subscribe<ublox_msgs::NavVELNED>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavVELNED>(boost::bind(
       &UbloxFirmware6::callbackNavVelNed, this, _1), kSubscribeRate);
 
   // Subscribe to Nav SVINFO
-  nh->param("publish/nav/svinfo", enabled["nav_svinfo"], enabled["nav"]);
-  if (enabled["nav_svinfo"])
-    gps.subscribe<ublox_msgs::NavSVINFO>(boost::bind(
-        publish<ublox_msgs::NavSVINFO>, _1, "navsvinfo"),
-        kNavSvInfoSubscribeRate);
+  state_.nh.param("publish/nav/svinfo", state_.enabled["nav_svinfo"], state_.enabled["nav"]);
+  if (state_.enabled["nav_svinfo"])
+    state_.subscribe<ublox_msgs::NavSVINFO>("navsvinfo",
+                                            kNavSvInfoSubscribeRate);
 
   // Subscribe to Mon HW
-  nh->param("publish/mon_hw", enabled["mon_hw"], enabled["mon"]);
-  if (enabled["mon_hw"])
-    gps.subscribe<ublox_msgs::MonHW6>(boost::bind(
-        publish<ublox_msgs::MonHW6>, _1, "monhw"), kSubscribeRate);
+  state_.nh.param("publish/mon_hw", state_.enabled["mon_hw"], state_.enabled["mon"]);
+  if (state_.enabled["mon_hw"])
+    state_.subscribe<ublox_msgs::MonHW6>("monhw", kSubscribeRate);
 }
 
 void UbloxFirmware6::fixDiagnostic(
@@ -820,22 +878,24 @@ void UbloxFirmware6::fixDiagnostic(
   stat.add("# SVs used", (int)last_nav_sol_.numSV);
 }
 
-void UbloxFirmware6::callbackNavPosLlh(const ublox_msgs::NavPOSLLH& m) {
-  if(enabled["nav_posllh"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavPOSLLH>("navposllh", kROSQueueSize);
-    publisher.publish(m);
+void UbloxFirmware6::callbackNavPosLlh(
+    const ublox_msgs::NavPOSLLH::ConstPtr& msg) {
+  const ublox_msgs::NavPOSLLH& m = *msg;
+  if(state_.enabled["nav_posllh"]) {
+    state_.advertise<ublox_msgs::NavPOSLLH>(nav_pos_llh_publisher_,
+                                            "navposllh").publish(msg);
   }
 
+  // The fix, the velocity and the last messages are shared with the other
+  // callbacks and the diagnostics
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
   // Position message
-  static ros::Publisher fixPublisher =
-      nh->advertise<sensor_msgs::NavSatFix>("fix", kROSQueueSize);
   if (m.iTOW == last_nav_vel_.iTOW)
     fix_.header.stamp = velocity_.header.stamp; // use last timestamp
   else
     fix_.header.stamp = ros::Time::now(); // new timestamp
 
-  fix_.header.frame_id = frame_id;
+  fix_.header.frame_id = state_.frame_id;
   fix_.latitude = m.lat * 1e-7;
   fix_.longitude = m.lon * 1e-7;
   fix_.altitude = m.height * 1e-3;
@@ -856,29 +916,29 @@ void UbloxFirmware6::callbackNavPosLlh(const ublox_msgs::NavPOSLLH& m) {
       sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
 
   fix_.status.service = fix_.status.SERVICE_GPS;
-  fixPublisher.publish(fix_);
+  state_.advertise<sensor_msgs::NavSatFix>(fix_publisher_, "fix")
+      .publish(boost::make_shared<sensor_msgs::NavSatFix>(fix_));
   last_nav_pos_ = m;
   //  update diagnostics
-  freq_diag->diagnostic->tick(fix_.header.stamp);
-  updater->update();
+  state_.freq_diag->diagnostic->tick(fix_.header.stamp);
+  state_.updater->update();
 }
 
-void UbloxFirmware6::callbackNavVelNed(const ublox_msgs::NavVELNED& m) {
-  if(enabled["nav_velned"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavVELNED>("navvelned", kROSQueueSize);
-    publisher.publish(m);
+void UbloxFirmware6::callbackNavVelNed(
+    const ublox_msgs::NavVELNED::ConstPtr& msg) {
+  const ublox_msgs::NavVELNED& m = *msg;
+  if(state_.enabled["nav_velned"]) {
+    state_.advertise<ublox_msgs::NavVELNED>(nav_vel_ned_publisher_,
+                                            "navvelned").publish(msg);
   }
 
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
   // Example geometry message
-  static ros::Publisher velocityPublisher =
-      nh->advertise<geometry_msgs::TwistWithCovarianceStamped>("fix_velocity",
-                                                                kROSQueueSize);
   if (m.iTOW == last_nav_pos_.iTOW)
     velocity_.header.stamp = fix_.header.stamp; // same time as last navposllh
   else
     velocity_.header.stamp = ros::Time::now(); // create a new timestamp
-  velocity_.header.frame_id = frame_id;
+  velocity_.header.frame_id = state_.frame_id;
 
   //  convert to XYZ linear velocity
   velocity_.twist.twist.linear.x = m.velE / 100.0;
@@ -893,77 +953,81 @@ void UbloxFirmware6::callbackNavVelNed(const ublox_msgs::NavVELNED& m) {
   velocity_.twist.covariance[cols * 2 + 2] = varSpeed;
   velocity_.twist.covariance[cols * 3 + 3] = -1;  //  angular rate unsupported
 
-  velocityPublisher.publish(velocity_);
+  state_.advertise<geometry_msgs::TwistWithCovarianceStamped>(
+      velocity_publisher_, "fix_velocity").publish(
+          boost::make_shared<geometry_msgs::TwistWithCovarianceStamped>(
+              velocity_));
   last_nav_vel_ = m;
 }
 
-void UbloxFirmware6::callbackNavSol(const ublox_msgs::NavSOL& m) {
-  if(enabled["nav_sol"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavSOL>("navsol", kROSQueueSize);
-    publisher.publish(m);
+void UbloxFirmware6::callbackNavSol(const ublox_msgs::NavSOL::ConstPtr& m) {
+  if(state_.enabled["nav_sol"]) {
+    state_.advertise<ublox_msgs::NavSOL>(nav_sol_publisher_, "navsol")
+        .publish(m);
   }
-  last_nav_sol_ = m;
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+  last_nav_sol_ = *m;
 }
 
 //
 // Ublox Firmware Version 7
 //
-UbloxFirmware7::UbloxFirmware7() {}
+UbloxFirmware7::UbloxFirmware7(NodeState& state)
+    : UbloxFirmware7Plus<ublox_msgs::NavPVT7>(state) {}
 
 void UbloxFirmware7::getRosParams() {
   //
   // GNSS configuration
   //
   // GNSS enable/disable
-  nh->param("gnss/gps", enable_gps_, true);
-  nh->param("gnss/glonass", enable_glonass_, false);
-  nh->param("gnss/qzss", enable_qzss_, false);
-  getRosUint("gnss/qzss_sig_cfg", qzss_sig_cfg_,
+  state_.nh.param("gnss/gps", enable_gps_, true);
+  state_.nh.param("gnss/glonass", enable_glonass_, false);
+  state_.nh.param("gnss/qzss", enable_qzss_, false);
+  state_.getRosUint("gnss/qzss_sig_cfg", qzss_sig_cfg_,
               ublox_msgs::CfgGNSS_Block::SIG_CFG_QZSS_L1CA);
-  nh->param("gnss/sbas", enable_sbas_, false);
+  state_.nh.param("gnss/sbas", enable_sbas_, false);
 
-  if(enable_gps_ && !supportsGnss("GPS"))
+  if(enable_gps_ && !state_.supportsGnss("GPS"))
     ROS_WARN("gnss/gps is true, but GPS GNSS is not supported by this device");
-  if(enable_glonass_ && !supportsGnss("GLO"))
+  if(enable_glonass_ && !state_.supportsGnss("GLO"))
     ROS_WARN("gnss/glonass is true, but GLONASS is not %s",
              "supported by this device");
-  if(enable_qzss_ && !supportsGnss("QZSS"))
+  if(enable_qzss_ && !state_.supportsGnss("QZSS"))
     ROS_WARN("gnss/qzss is true, but QZSS is not supported by this device");
-  if(enable_sbas_ && !supportsGnss("SBAS"))
+  if(enable_sbas_ && !state_.supportsGnss("SBAS"))
     ROS_WARN("gnss/sbas is true, but SBAS is not supported by this device");
 
-  if(nh->hasParam("gnss/galileo"))
+  if(state_.nh.hasParam("gnss/galileo"))
     ROS_WARN("ublox_version < 8, ignoring Galileo GNSS Settings");
-  if(nh->hasParam("gnss/beidou"))
+  if(state_.nh.hasParam("gnss/beidou"))
     ROS_WARN("ublox_version < 8, ignoring BeiDou Settings");
-  if(nh->hasParam("gnss/imes"))
+  if(state_.nh.hasParam("gnss/imes"))
     ROS_WARN("ublox_version < 8, ignoring IMES GNSS Settings");
 
   // Fix Service type, used when publishing fix status messages
-  fix_status_service = sensor_msgs::NavSatStatus::SERVICE_GPS
+  state_.fix_status_service = sensor_msgs::NavSatStatus::SERVICE_GPS
       + (enable_glonass_ ? 1 : 0) * sensor_msgs::NavSatStatus::SERVICE_GLONASS;
 
   //
   // NMEA Configuration
   //
-  nh->param("nmea/set", set_nmea_, false);
+  state_.nh.param("nmea/set", set_nmea_, false);
   if (set_nmea_) {
     bool compat, consider;
 
-    if (!getRosUint("nmea/version", cfg_nmea_.nmeaVersion))
+    if (!state_.getRosUint("nmea/version", cfg_nmea_.nmeaVersion))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/version must be set");
-    if (!getRosUint("nmea/num_sv", cfg_nmea_.numSV))
+    if (!state_.getRosUint("nmea/num_sv", cfg_nmea_.numSV))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
                 "true, therefore nmea/num_sv must be set");
-    if (!getRosUint("nmea/sv_numbering", cfg_nmea_.svNumbering))
+    if (!state_.getRosUint("nmea/sv_numbering", cfg_nmea_.svNumbering))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/sv_numbering must be set");
-    if (!nh->getParam("nmea/compat", compat))
+    if (!state_.nh.getParam("nmea/compat", compat))
         throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/compat must be set");
-    if (!nh->getParam("nmea/consider", consider))
+    if (!state_.nh.getParam("nmea/consider", consider))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/consider must be set");
 
@@ -972,40 +1036,40 @@ void UbloxFirmware7::getRosParams() {
     cfg_nmea_.flags |= consider ? cfg_nmea_.FLAGS_CONSIDER : 0;
     // set filter
     bool temp;
-    nh->param("nmea/filter/pos", temp, false);
+    state_.nh.param("nmea/filter/pos", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_POS : 0;
-    nh->param("nmea/filter/msk_pos", temp, false);
+    state_.nh.param("nmea/filter/msk_pos", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_MSK_POS : 0;
-    nh->param("nmea/filter/time", temp, false);
+    state_.nh.param("nmea/filter/time", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_TIME : 0;
-    nh->param("nmea/filter/date", temp, false);
+    state_.nh.param("nmea/filter/date", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_DATE : 0;
-    nh->param("nmea/filter/gps_only", temp, false);
+    state_.nh.param("nmea/filter/gps_only", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_GPS_ONLY : 0;
-    nh->param("nmea/filter/track", temp, false);
+    state_.nh.param("nmea/filter/track", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_TRACK : 0;
     // set gnssToFilter
-    nh->param("nmea/gnssToFilter/gps", temp, false);
+    state_.nh.param("nmea/gnssToFilter/gps", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_GPS : 0;
-    nh->param("nmea/gnssToFilter/sbas", temp, false);
+    state_.nh.param("nmea/gnssToFilter/sbas", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_SBAS : 0;
-    nh->param("nmea/gnssToFilter/qzss", temp, false);
+    state_.nh.param("nmea/gnssToFilter/qzss", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_QZSS : 0;
-    nh->param("nmea/gnssToFilter/glonass", temp, false);
+    state_.nh.param("nmea/gnssToFilter/glonass", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_GLONASS : 0;
 
-    getRosUint("nmea/main_talker_id", cfg_nmea_.mainTalkerId);
-    getRosUint("nmea/gsv_talker_id", cfg_nmea_.gsvTalkerId);
+    state_.getRosUint("nmea/main_talker_id", cfg_nmea_.mainTalkerId);
+    state_.getRosUint("nmea/gsv_talker_id", cfg_nmea_.gsvTalkerId);
   }
 }
 
 bool UbloxFirmware7::configureUblox() {
- if (unicore_oem==1) {
+ if (state_.unicore_oem==1) {
   return true;
  }
     /** Configure the GNSS **/
   ublox_msgs::CfgGNSS cfgGNSSRead;
-  if (gps.poll(cfgGNSSRead)) {
+  if (state_.gps.poll(cfgGNSSRead)) {
     ROS_DEBUG("Read GNSS config.");
     ROS_DEBUG("Num. tracking channels in hardware: %i", cfgGNSSRead.numTrkChHw);
     ROS_DEBUG("Num. tracking channels to use: %i", cfgGNSSRead.numTrkChUse);
@@ -1020,21 +1084,21 @@ bool UbloxFirmware7::configureUblox() {
   cfgGNSSWrite.msgVer = 0;
 
   // configure GLONASS
-  if(supportsGnss("GLO")) {
+  if(state_.supportsGnss("GLO")) {
     ublox_msgs::CfgGNSS_Block block;
     block.gnssId = block.GNSS_ID_GLONASS;
     block.resTrkCh = block.RES_TRK_CH_GLONASS;
     block.maxTrkCh = block.MAX_TRK_CH_GLONASS;
     block.flags = enable_glonass_ ? block.SIG_CFG_GLONASS_L1OF : 0;
     cfgGNSSWrite.blocks.push_back(block);
-    if (!gps.configure(cfgGNSSWrite)) {
+    if (!state_.gps.configure(cfgGNSSWrite)) {
       throw std::runtime_error(std::string("Failed to ") +
                                ((enable_glonass_) ? "enable" : "disable") +
                                " GLONASS.");
     }
   }
 
-  if(supportsGnss("QZSS")) {
+  if(state_.supportsGnss("QZSS")) {
     // configure QZSS
     ublox_msgs::CfgGNSS_Block block;
     block.gnssId = block.GNSS_ID_QZSS;
@@ -1042,14 +1106,14 @@ bool UbloxFirmware7::configureUblox() {
     block.maxTrkCh = block.MAX_TRK_CH_QZSS;
     block.flags = enable_qzss_ ? qzss_sig_cfg_ : 0;
     cfgGNSSWrite.blocks[0] = block;
-    if (!gps.configure(cfgGNSSWrite)) {
+    if (!state_.gps.configure(cfgGNSSWrite)) {
       throw std::runtime_error(std::string("Failed to ") +
                                ((enable_glonass_) ? "enable" : "disable") +
                                " QZSS.");
     }
   }
 
-  if(supportsGnss("SBAS")) {
+  if(state_.supportsGnss("SBAS")) {
     // configure SBAS
     ublox_msgs::CfgGNSS_Block block;
     block.gnssId = block.GNSS_ID_SBAS;
@@ -1057,14 +1121,14 @@ bool UbloxFirmware7::configureUblox() {
     block.maxTrkCh = block.MAX_TRK_CH_SBAS;
     block.flags = enable_sbas_ ? block.SIG_CFG_SBAS_L1CA : 0;
     cfgGNSSWrite.blocks[0] = block;
-    if (!gps.configure(cfgGNSSWrite)) {
+    if (!state_.gps.configure(cfgGNSSWrite)) {
       throw std::runtime_error(std::string("Failed to ") +
                                ((enable_sbas_) ? "enable" : "disable") +
                                " SBAS.");
     }
   }
 
-  if(set_nmea_ && !gps.configure(cfg_nmea_))
+  if(set_nmea_ && !state_.gps.configure(cfg_nmea_))
     throw std::runtime_error("Failed to configure NMEA");
 
   return true;
@@ -1072,71 +1136,70 @@ bool UbloxFirmware7::configureUblox() {
 
 void UbloxFirmware7::subscribe() {
   // Whether to publish Nav PVT messages to a ROS topic
-  nh->param("publish/nav/pvt", enabled["nav_pvt"], enabled["nav"]);
+  state_.nh.param("publish/nav/pvt", state_.enabled["nav_pvt"], state_.enabled["nav"]);
   // Subscribe to Nav PVT (always does so since fix information is published
   // from this)
-  gps.subscribe<ublox_msgs::NavPVT7>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavPVT7>(boost::bind(
         &UbloxFirmware7Plus::callbackNavPvt, this, _1),
         kSubscribeRate);
 
   // Subscribe to Nav SVINFO
-  nh->param("publish/nav/svinfo", enabled["nav_svinfo"], enabled["nav"]);
-  if (enabled["nav_svinfo"])
-    gps.subscribe<ublox_msgs::NavSVINFO>(boost::bind(
-        publish<ublox_msgs::NavSVINFO>, _1, "navsvinfo"),
-        kNavSvInfoSubscribeRate);
+  state_.nh.param("publish/nav/svinfo", state_.enabled["nav_svinfo"], state_.enabled["nav"]);
+  if (state_.enabled["nav_svinfo"])
+    state_.subscribe<ublox_msgs::NavSVINFO>("navsvinfo",
+                                            kNavSvInfoSubscribeRate);
 
   // Subscribe to Mon HW
-  nh->param("publish/mon_hw", enabled["mon_hw"], enabled["mon"]);
-  if (enabled["mon_hw"])
-    gps.subscribe<ublox_msgs::MonHW>(boost::bind(
-        publish<ublox_msgs::MonHW>, _1, "monhw"), kSubscribeRate);
+  state_.nh.param("publish/mon_hw", state_.enabled["mon_hw"], state_.enabled["mon"]);
+  if (state_.enabled["mon_hw"])
+    state_.subscribe<ublox_msgs::MonHW>("monhw", kSubscribeRate);
 }
 
 //
 // Ublox Version 8
 //
-UbloxFirmware8::UbloxFirmware8() {}
+UbloxFirmware8::UbloxFirmware8(NodeState& state)
+    : UbloxFirmware7Plus<ublox_msgs::NavPVT>(state) {}
 
 void UbloxFirmware8::getRosParams() {
   // UPD SOS configuration
-  nh->param("clear_bbr", clear_bbr_, false);
-  gps.setSaveOnShutdown(nh->param("save_on_shutdown", false));
+  state_.nh.param("clear_bbr", clear_bbr_, false);
+  state_.gps.setSaveOnShutdown(state_.nh.param("save_on_shutdown", false));
 
   // GNSS enable/disable
-  nh->param("gnss/gps", enable_gps_, true);
-  nh->param("gnss/galileo", enable_galileo_, false);
-  nh->param("gnss/beidou", enable_beidou_, false);
-  nh->param("gnss/imes", enable_imes_, false);
-  nh->param("gnss/glonass", enable_glonass_, false);
-  nh->param("gnss/qzss", enable_qzss_, false);
-  nh->param("gnss/sbas", enable_sbas_, false);
+  state_.nh.param("gnss/gps", enable_gps_, true);
+  state_.nh.param("gnss/galileo", enable_galileo_, false);
+  state_.nh.param("gnss/beidou", enable_beidou_, false);
+  state_.nh.param("gnss/imes", enable_imes_, false);
+  state_.nh.param("gnss/glonass", enable_glonass_, false);
+  state_.nh.param("gnss/qzss", enable_qzss_, false);
+  state_.nh.param("gnss/sbas", enable_sbas_, false);
   // QZSS Signal Configuration
-  getRosUint("gnss/qzss_sig_cfg", qzss_sig_cfg_,
+  state_.getRosUint("gnss/qzss_sig_cfg", qzss_sig_cfg_,
               ublox_msgs::CfgGNSS_Block::SIG_CFG_QZSS_L1CA);
 
-  if (enable_gps_ && !supportsGnss("GPS"))
+  if (enable_gps_ && !state_.supportsGnss("GPS"))
     ROS_WARN("gnss/gps is true, but GPS GNSS is not supported by %s",
              "this device");
-  if (enable_glonass_ && !supportsGnss("GLO"))
+  if (enable_glonass_ && !state_.supportsGnss("GLO"))
     ROS_WARN("gnss/glonass is true, but GLONASS is not supported by %s",
              "this device");
-  if (enable_galileo_ && !supportsGnss("GAL"))
+  if (enable_galileo_ && !state_.supportsGnss("GAL"))
     ROS_WARN("gnss/galileo is true, but Galileo GNSS is not supported %s",
              "by this device");
-  if (enable_beidou_ && !supportsGnss("BDS"))
+  if (enable_beidou_ && !state_.supportsGnss("BDS"))
     ROS_WARN("gnss/beidou is true, but Beidou GNSS is not supported %s",
              "by this device");
-  if (enable_imes_ && !supportsGnss("IMES"))
+  if (enable_imes_ && !state_.supportsGnss("IMES"))
     ROS_WARN("gnss/imes is true, but IMES GNSS is not supported by %s",
              "this device");
-  if (enable_qzss_ && !supportsGnss("QZSS"))
+  if (enable_qzss_ && !state_.supportsGnss("QZSS"))
     ROS_WARN("gnss/qzss is true, but QZSS is not supported by this device");
-  if (enable_sbas_ && !supportsGnss("SBAS"))
+  if (enable_sbas_ && !state_.supportsGnss("SBAS"))
     ROS_WARN("gnss/sbas is true, but SBAS is not supported by this device");
 
   // Fix Service type, used when publishing fix status messages
-  fix_status_service = sensor_msgs::NavSatStatus::SERVICE_GPS
+  state_.fix_status_service = sensor_msgs::NavSatStatus::SERVICE_GPS
       + (enable_glonass_ ? 1 : 0) * sensor_msgs::NavSatStatus::SERVICE_GLONASS
       + (enable_beidou_ ? 1 : 0) * sensor_msgs::NavSatStatus::SERVICE_COMPASS
       + (enable_galileo_ ? 1 : 0) * sensor_msgs::NavSatStatus::SERVICE_GALILEO;
@@ -1144,25 +1207,25 @@ void UbloxFirmware8::getRosParams() {
   //
   // NMEA Configuration
   //
-  nh->param("nmea/set", set_nmea_, false);
+  state_.nh.param("nmea/set", set_nmea_, false);
   if (set_nmea_) {
     bool compat, consider;
     cfg_nmea_.version = cfg_nmea_.VERSION; // message version
 
     // Verify that parameters are set
-    if (!getRosUint("nmea/version", cfg_nmea_.nmeaVersion))
+    if (!state_.getRosUint("nmea/version", cfg_nmea_.nmeaVersion))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/version must be set");
-    if (!getRosUint("nmea/num_sv", cfg_nmea_.numSV))
+    if (!state_.getRosUint("nmea/num_sv", cfg_nmea_.numSV))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
                 "true, therefore nmea/num_sv must be set");
-    if (!getRosUint("nmea/sv_numbering", cfg_nmea_.svNumbering))
+    if (!state_.getRosUint("nmea/sv_numbering", cfg_nmea_.svNumbering))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/sv_numbering must be set");
-    if (!nh->getParam("nmea/compat", compat))
+    if (!state_.nh.getParam("nmea/compat", compat))
         throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/compat must be set");
-    if (!nh->getParam("nmea/consider", consider))
+    if (!state_.nh.getParam("nmea/consider", consider))
       throw std::runtime_error(std::string("Invalid settings: nmea/set is ") +
           "true, therefore nmea/consider must be set");
 
@@ -1170,40 +1233,40 @@ void UbloxFirmware8::getRosParams() {
     cfg_nmea_.flags = compat ? cfg_nmea_.FLAGS_COMPAT : 0;
     cfg_nmea_.flags |= consider ? cfg_nmea_.FLAGS_CONSIDER : 0;
     bool temp;
-    nh->param("nmea/limit82", temp, false);
+    state_.nh.param("nmea/limit82", temp, false);
     cfg_nmea_.flags |= temp ? cfg_nmea_.FLAGS_LIMIT82 : 0;
-    nh->param("nmea/high_prec", temp, false);
+    state_.nh.param("nmea/high_prec", temp, false);
     cfg_nmea_.flags |= temp ? cfg_nmea_.FLAGS_HIGH_PREC : 0;
     // set filter
-    nh->param("nmea/filter/pos", temp, false);
+    state_.nh.param("nmea/filter/pos", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_POS : 0;
-    nh->param("nmea/filter/msk_pos", temp, false);
+    state_.nh.param("nmea/filter/msk_pos", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_MSK_POS : 0;
-    nh->param("nmea/filter/time", temp, false);
+    state_.nh.param("nmea/filter/time", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_TIME : 0;
-    nh->param("nmea/filter/date", temp, false);
+    state_.nh.param("nmea/filter/date", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_DATE : 0;
-    nh->param("nmea/filter/gps_only", temp, false);
+    state_.nh.param("nmea/filter/gps_only", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_GPS_ONLY : 0;
-    nh->param("nmea/filter/track", temp, false);
+    state_.nh.param("nmea/filter/track", temp, false);
     cfg_nmea_.filter |= temp ? cfg_nmea_.FILTER_TRACK : 0;
     // set gnssToFilter
-    nh->param("nmea/gnssToFilter/gps", temp, false);
+    state_.nh.param("nmea/gnssToFilter/gps", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_GPS : 0;
-    nh->param("nmea/gnssToFilter/sbas", temp, false);
+    state_.nh.param("nmea/gnssToFilter/sbas", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_SBAS : 0;
-    nh->param("nmea/gnssToFilter/qzss", temp, false);
+    state_.nh.param("nmea/gnssToFilter/qzss", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_QZSS : 0;
-    nh->param("nmea/gnssToFilter/glonass", temp, false);
+    state_.nh.param("nmea/gnssToFilter/glonass", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_GLONASS : 0;
-    nh->param("nmea/gnssToFilter/beidou", temp, false);
+    state_.nh.param("nmea/gnssToFilter/beidou", temp, false);
     cfg_nmea_.gnssToFilter |= temp ? cfg_nmea_.GNSS_TO_FILTER_BEIDOU : 0;
 
-    getRosUint("nmea/main_talker_id", cfg_nmea_.mainTalkerId);
-    getRosUint("nmea/gsv_talker_id", cfg_nmea_.gsvTalkerId);
+    state_.getRosUint("nmea/main_talker_id", cfg_nmea_.mainTalkerId);
+    state_.getRosUint("nmea/gsv_talker_id", cfg_nmea_.gsvTalkerId);
 
     std::vector<uint8_t> bdsTalkerId;
-    getRosUint("nmea/bds_talker_id", bdsTalkerId);
+    state_.getRosUint("nmea/bds_talker_id", bdsTalkerId);
     if(bdsTalkerId.size() >= 2) {
       cfg_nmea_.bdsTalkerId[0] = bdsTalkerId[0];
       cfg_nmea_.bdsTalkerId[1] = bdsTalkerId[1];
@@ -1214,12 +1277,12 @@ void UbloxFirmware8::getRosParams() {
 
 
 bool UbloxFirmware8::configureUblox() {
- if (unicore_oem==1) {
+ if (state_.unicore_oem==1) {
   return true;
  }
   if (clear_bbr_) {
     // clear flash memory
-    if(!gps.clearBbr())
+    if(!state_.gps.clearBbr())
       ROS_ERROR("u-blox failed to clear flash memory");
   }
   //
@@ -1227,7 +1290,7 @@ bool UbloxFirmware8::configureUblox() {
   //
   // First, get the current GNSS configuration
   ublox_msgs::CfgGNSS cfg_gnss;
-  if (gps.poll(cfg_gnss)) {
+  if (state_.gps.poll(cfg_gnss)) {
     ROS_DEBUG("Read GNSS config.");
     ROS_DEBUG("Num. tracking channels in hardware: %i", cfg_gnss.numTrkChHw);
     ROS_DEBUG("Num. tracking channels to use: %i", cfg_gnss.numTrkChUse);
@@ -1296,14 +1359,14 @@ bool UbloxFirmware8::configureUblox() {
   // since this requires a cold reset
   if (correct)
     ROS_DEBUG("U-Blox GNSS configuration is correct. GNSS not re-configured.");
-  else if (!gps.configGnss(cfg_gnss, boost::posix_time::seconds(15)))
+  else if (!state_.gps.configGnss(cfg_gnss, boost::posix_time::seconds(15)))
     throw std::runtime_error(std::string("Failed to cold reset device ") +
                              "after configuring GNSS");
 
   //
   // NMEA config
   //
-  if (set_nmea_ && !gps.configure(cfg_nmea_))
+  if (set_nmea_ && !state_.gps.configure(cfg_nmea_))
     throw std::runtime_error("Failed to configure NMEA");
 
   return true;
@@ -1311,28 +1374,25 @@ bool UbloxFirmware8::configureUblox() {
 
 void UbloxFirmware8::subscribe() {
   // Whether to publish Nav PVT messages
-  nh->param("publish/nav/pvt", enabled["nav_pvt"], enabled["nav"]);
+  state_.nh.param("publish/nav/pvt", state_.enabled["nav_pvt"], state_.enabled["nav"]);
   // Subscribe to Nav PVT
-  gps.subscribe<ublox_msgs::NavPVT>(
+  state_.gps.subscribeShared<ublox_msgs::NavPVT>(
     boost::bind(&UbloxFirmware7Plus::callbackNavPvt, this, _1), kSubscribeRate);
 
   // Subscribe to Nav SAT messages
-  nh->param("publish/nav/sat", enabled["nav_sat"], enabled["nav"]);
-  if (enabled["nav_sat"])
-    gps.subscribe<ublox_msgs::NavSAT>(boost::bind(
-        publish<ublox_msgs::NavSAT>, _1, "navsat"), kNavSvInfoSubscribeRate);
+  state_.nh.param("publish/nav/sat", state_.enabled["nav_sat"], state_.enabled["nav"]);
+  if (state_.enabled["nav_sat"])
+    state_.subscribe<ublox_msgs::NavSAT>("navsat", kNavSvInfoSubscribeRate);
 
   // Subscribe to Mon HW
-  nh->param("publish/mon/hw", enabled["mon_hw"], enabled["mon"]);
-  if (enabled["mon_hw"])
-    gps.subscribe<ublox_msgs::MonHW>(boost::bind(
-        publish<ublox_msgs::MonHW>, _1, "monhw"), kSubscribeRate);
+  state_.nh.param("publish/mon/hw", state_.enabled["mon_hw"], state_.enabled["mon"]);
+  if (state_.enabled["mon_hw"])
+    state_.subscribe<ublox_msgs::MonHW>("monhw", kSubscribeRate);
 
   // Subscribe to RTCM messages
-  nh->param("publish/rxm/rtcm", enabled["rxm_rtcm"], enabled["rxm"]);
-  if (enabled["rxm_rtcm"])
-    gps.subscribe<ublox_msgs::RxmRTCM>(boost::bind(
-        publish<ublox_msgs::RxmRTCM>, _1, "rxmrtcm"), kSubscribeRate);
+  state_.nh.param("publish/rxm/rtcm", state_.enabled["rxm_rtcm"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_rtcm"])
+    state_.subscribe<ublox_msgs::RxmRTCM>("rxmrtcm", kSubscribeRate);
 }
 
 //
@@ -1340,131 +1400,125 @@ void UbloxFirmware8::subscribe() {
 //
 void RawDataProduct::subscribe() {
   // Defaults to true instead of to all
-  nh->param("publish/rxm/all", enabled["rxm"], true);
+  state_.nh.param("publish/rxm/all", state_.enabled["rxm"], true);
 
   // Subscribe to RXM Raw
-  nh->param("publish/rxm/raw", enabled["rxm_raw"], enabled["rxm"]);
-  if (enabled["rxm_raw"])
-    gps.subscribe<ublox_msgs::RxmRAW>(boost::bind(
-        publish<ublox_msgs::RxmRAW>, _1, "rxmraw"), kSubscribeRate);
+  state_.nh.param("publish/rxm/raw", state_.enabled["rxm_raw"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_raw"])
+    state_.subscribe<ublox_msgs::RxmRAW>("rxmraw", kSubscribeRate);
 
   // Subscribe to RXM SFRB
-  nh->param("publish/rxm/sfrb", enabled["rxm_sfrb"], enabled["rxm"]);
-  if (enabled["rxm_sfrb"])
-    gps.subscribe<ublox_msgs::RxmSFRB>(boost::bind(
-        publish<ublox_msgs::RxmSFRB>, _1, "rxmsfrb"), kSubscribeRate);
+  state_.nh.param("publish/rxm/sfrb", state_.enabled["rxm_sfrb"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_sfrb"])
+    state_.subscribe<ublox_msgs::RxmSFRB>("rxmsfrb", kSubscribeRate);
 
   // Subscribe to RXM EPH
-  nh->param("publish/rxm/eph", enabled["rxm_eph"], enabled["rxm"]);
-  if (enabled["rxm_eph"])
-    gps.subscribe<ublox_msgs::RxmEPH>(boost::bind(
-        publish<ublox_msgs::RxmEPH>, _1, "rxmeph"), kSubscribeRate);
+  state_.nh.param("publish/rxm/eph", state_.enabled["rxm_eph"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_eph"])
+    state_.subscribe<ublox_msgs::RxmEPH>("rxmeph", kSubscribeRate);
 
   // Subscribe to RXM ALM
-  nh->param("publish/rxm/almRaw", enabled["rxm_alm"], enabled["rxm"]);
-  if (enabled["rxm_alm"])
-    gps.subscribe<ublox_msgs::RxmALM>(boost::bind(
-        publish<ublox_msgs::RxmALM>, _1, "rxmalm"), kSubscribeRate);
+  state_.nh.param("publish/rxm/almRaw", state_.enabled["rxm_alm"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_alm"])
+    state_.subscribe<ublox_msgs::RxmALM>("rxmalm", kSubscribeRate);
 }
 
 void RawDataProduct::initializeRosDiagnostics() {
-  if (enabled["rxm_raw"])
+  if (state_.enabled["rxm_raw"])
     freq_diagnostics_.push_back(boost::shared_ptr<UbloxTopicDiagnostic>(
-      new UbloxTopicDiagnostic("rxmraw", kRtcmFreqTol, kRtcmFreqWindow)));
-  if (enabled["rxm_sfrb"])
+      new UbloxTopicDiagnostic(state_, "rxmraw", kRtcmFreqTol,
+                               kRtcmFreqWindow)));
+  if (state_.enabled["rxm_sfrb"])
     freq_diagnostics_.push_back(boost::shared_ptr<UbloxTopicDiagnostic>(
-      new UbloxTopicDiagnostic("rxmsfrb", kRtcmFreqTol, kRtcmFreqWindow)));
-  if (enabled["rxm_eph"])
+      new UbloxTopicDiagnostic(state_, "rxmsfrb", kRtcmFreqTol,
+                               kRtcmFreqWindow)));
+  if (state_.enabled["rxm_eph"])
     freq_diagnostics_.push_back(boost::shared_ptr<UbloxTopicDiagnostic>(
-      new UbloxTopicDiagnostic("rxmeph", kRtcmFreqTol, kRtcmFreqWindow)));
-  if (enabled["rxm_alm"])
+      new UbloxTopicDiagnostic(state_, "rxmeph", kRtcmFreqTol,
+                               kRtcmFreqWindow)));
+  if (state_.enabled["rxm_alm"])
     freq_diagnostics_.push_back(boost::shared_ptr<UbloxTopicDiagnostic>(
-      new UbloxTopicDiagnostic("rxmalm", kRtcmFreqTol, kRtcmFreqWindow)));
+      new UbloxTopicDiagnostic(state_, "rxmalm", kRtcmFreqTol,
+                               kRtcmFreqWindow)));
 }
 
-AdrUdrProduct::AdrUdrProduct(float protocol_version)
-    : protocol_version_(protocol_version)
+AdrUdrProduct::AdrUdrProduct(NodeState& state, float protocol_version)
+    : state_(state), protocol_version_(protocol_version)
 {}
 
 //
 // u-blox ADR devices, partially implemented
 //
 void AdrUdrProduct::getRosParams() {
-  nh->param("use_adr", use_adr_, true);
+  state_.nh.param("use_adr", use_adr_, true);
   // Check the nav rate
-  float nav_rate_hz = 1000 / (meas_rate * nav_rate);
+  float nav_rate_hz = 1000 / (state_.meas_rate * state_.nav_rate);
   if(nav_rate_hz != 1)
     ROS_WARN("Nav Rate recommended to be 1 Hz");
 }
 
 bool AdrUdrProduct::configureUblox() {
-  if (unicore_oem==1) {
+  if (state_.unicore_oem==1) {
    return true;
   }
-  if(!gps.setUseAdr(use_adr_, protocol_version_))
+  if(!state_.gps.setUseAdr(use_adr_, protocol_version_))
     throw std::runtime_error(std::string("Failed to ")
                              + (use_adr_ ? "enable" : "disable") + "use_adr");
   return true;
 }
 
 void AdrUdrProduct::subscribe() {
-  nh->param("publish/esf/all", enabled["esf"], true);
+  state_.nh.param("publish/esf/all", state_.enabled["esf"], true);
 
   // Subscribe to NAV ATT messages
-  nh->param("publish/nav/att", enabled["nav_att"], enabled["nav"]);
-  if (enabled["nav_att"])
-    gps.subscribe<ublox_msgs::NavATT>(boost::bind(
-        publish<ublox_msgs::NavATT>, _1, "navatt"), kSubscribeRate);
+  state_.nh.param("publish/nav/att", state_.enabled["nav_att"], state_.enabled["nav"]);
+  if (state_.enabled["nav_att"])
+    state_.subscribe<ublox_msgs::NavATT>("navatt", kSubscribeRate);
 
   // Subscribe to ESF ALG messages
-  nh->param("publish/esf/alg", enabled["esf_alg"], enabled["esf"]);
-  if (enabled["esf_alg"])
-    gps.subscribe<ublox_msgs::EsfALG>(boost::bind(
-        publish<ublox_msgs::EsfALG>, _1, "esfalg"), kSubscribeRate);
+  state_.nh.param("publish/esf/alg", state_.enabled["esf_alg"], state_.enabled["esf"]);
+  if (state_.enabled["esf_alg"])
+    state_.subscribe<ublox_msgs::EsfALG>("esfalg", kSubscribeRate);
 
   // Subscribe to ESF INS messages
-  nh->param("publish/esf/ins", enabled["esf_ins"], enabled["esf"]);
-  if (enabled["esf_ins"])
-    gps.subscribe<ublox_msgs::EsfINS>(boost::bind(
-        publish<ublox_msgs::EsfINS>, _1, "esfins"), kSubscribeRate);
+  state_.nh.param("publish/esf/ins", state_.enabled["esf_ins"], state_.enabled["esf"]);
+  if (state_.enabled["esf_ins"])
+    state_.subscribe<ublox_msgs::EsfINS>("esfins", kSubscribeRate);
 
   // Subscribe to ESF Meas messages
-  nh->param("publish/esf/meas", enabled["esf_meas"], enabled["esf"]);
-  if (enabled["esf_meas"])
-    gps.subscribe<ublox_msgs::EsfMEAS>(boost::bind(
-        publish<ublox_msgs::EsfMEAS>, _1, "esfmeas"), kSubscribeRate);
+  state_.nh.param("publish/esf/meas", state_.enabled["esf_meas"], state_.enabled["esf"]);
+  if (state_.enabled["esf_meas"])
+    state_.subscribe<ublox_msgs::EsfMEAS>("esfmeas", kSubscribeRate);
     // also publish sensor_msgs::Imu
-    gps.subscribe<ublox_msgs::EsfMEAS>(boost::bind(
+    state_.gps.subscribe<ublox_msgs::EsfMEAS>(boost::bind(
       &AdrUdrProduct::callbackEsfMEAS, this, _1), kSubscribeRate);
  
   // Subscribe to ESF Raw messages
-  nh->param("publish/esf/raw", enabled["esf_raw"], enabled["esf"]);
-  if (enabled["esf_raw"])
-    gps.subscribe<ublox_msgs::EsfRAW>(boost::bind(
-        publish<ublox_msgs::EsfRAW>, _1, "esfraw"), kSubscribeRate);
+  state_.nh.param("publish/esf/raw", state_.enabled["esf_raw"], state_.enabled["esf"]);
+  if (state_.enabled["esf_raw"])
+    state_.subscribe<ublox_msgs::EsfRAW>("esfraw", kSubscribeRate);
 
   // Subscribe to ESF Status messages
-  nh->param("publish/esf/status", enabled["esf_status"], enabled["esf"]);
-  if (enabled["esf_status"])
-    gps.subscribe<ublox_msgs::EsfSTATUS>(boost::bind(
-        publish<ublox_msgs::EsfSTATUS>, _1, "esfstatus"), kSubscribeRate);
+  state_.nh.param("publish/esf/status", state_.enabled["esf_status"], state_.enabled["esf"]);
+  if (state_.enabled["esf_status"])
+    state_.subscribe<ublox_msgs::EsfSTATUS>("esfstatus", kSubscribeRate);
 
   // Subscribe to HNR PVT messages
-  nh->param("publish/hnr/pvt", enabled["hnr_pvt"], true);
-  if (enabled["hnr_pvt"])
-    gps.subscribe<ublox_msgs::HnrPVT>(boost::bind(
-        publish<ublox_msgs::HnrPVT>, _1, "hnrpvt"), kSubscribeRate);
+  state_.nh.param("publish/hnr/pvt", state_.enabled["hnr_pvt"], true);
+  if (state_.enabled["hnr_pvt"])
+    state_.subscribe<ublox_msgs::HnrPVT>("hnrpvt", kSubscribeRate);
 }
 
 void AdrUdrProduct::callbackEsfMEAS(const ublox_msgs::EsfMEAS &m) {
-  if (enabled["esf_meas"]) {
-    static ros::Publisher imu_pub = 
-	nh->advertise<sensor_msgs::Imu>("imu_meas", kROSQueueSize);
-    static ros::Publisher time_ref_pub =
-	nh->advertise<sensor_msgs::TimeReference>("interrupt_time", kROSQueueSize);
+  if (state_.enabled["esf_meas"]) {
+    ros::Publisher& imu_pub =
+        state_.advertise<sensor_msgs::Imu>(imu_publisher_, "imu_meas");
+    ros::Publisher& time_ref_pub =
+        state_.advertise<sensor_msgs::TimeReference>(time_ref_publisher_,
+                                                     "interrupt_time");
     
     imu_.header.stamp = ros::Time::now();
-    imu_.header.frame_id = frame_id;
+    imu_.header.frame_id = state_.frame_id;
     
     static const float rad_per_sec = pow(2, -12) * M_PI / 180.0F;
     static const float m_per_sec_sq = pow(2, -10);
@@ -1511,48 +1565,50 @@ void AdrUdrProduct::callbackEsfMEAS(const ublox_msgs::EsfMEAS &m) {
       //t_ref_.source = src.str();
 
       t_ref_.header.stamp = ros::Time::now(); // create a new timestamp
-      t_ref_.header.frame_id = frame_id;
+      t_ref_.header.frame_id = state_.frame_id;
    
-      time_ref_pub.publish(t_ref_);
-      imu_pub.publish(imu_);
+      time_ref_pub.publish(
+          boost::make_shared<sensor_msgs::TimeReference>(t_ref_));
+      imu_pub.publish(boost::make_shared<sensor_msgs::Imu>(imu_));
     }
   }
   
-  updater->force_update();
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+  state_.updater->force_update();
 }
 //
 // u-blox High Precision GNSS Reference Station
 //
 void HpgRefProduct::getRosParams() {
-  if (config_on_startup_flag_) {
-    if (unicore_oem==1) return ;
-    if(nav_rate * meas_rate != 1000)
+  if (state_.config_on_startup_flag) {
+    if (state_.unicore_oem==1) return ;
+    if(state_.nav_rate * state_.meas_rate != 1000)
       ROS_WARN("For HPG Ref devices, nav_rate should be exactly 1 Hz.");
 
-    if(!getRosUint("tmode3", tmode3_))
+    if(!state_.getRosUint("tmode3", tmode3_))
       throw std::runtime_error("Invalid settings: TMODE3 must be set");
 
     if(tmode3_ == ublox_msgs::CfgTMODE3::FLAGS_MODE_FIXED) {
-      if(!nh->getParam("arp/position", arp_position_))
+      if(!state_.nh.getParam("arp/position", arp_position_))
         throw std::runtime_error(std::string("Invalid settings: arp/position ")
                                 + "must be set if TMODE3 is fixed");
-      if(!getRosInt("arp/position_hp", arp_position_hp_))
+      if(!state_.getRosInt("arp/position_hp", arp_position_hp_))
         throw std::runtime_error(std::string("Invalid settings: arp/position_hp ")
                                 + "must be set if TMODE3 is fixed");
-      if(!nh->getParam("arp/acc", fixed_pos_acc_))
+      if(!state_.nh.getParam("arp/acc", fixed_pos_acc_))
         throw std::runtime_error(std::string("Invalid settings: arp/acc ")
                                 + "must be set if TMODE3 is fixed");
-      if(!nh->getParam("arp/lla_flag", lla_flag_)) {
+      if(!state_.nh.getParam("arp/lla_flag", lla_flag_)) {
         ROS_WARN("arp/lla_flag param not set, assuming ARP coordinates are %s",
                 "in ECEF");
         lla_flag_ = false;
       }
     } else if(tmode3_ == ublox_msgs::CfgTMODE3::FLAGS_MODE_SURVEY_IN) {
-      nh->param("sv_in/reset", svin_reset_, true);
-      if(!getRosUint("sv_in/min_dur", sv_in_min_dur_))
+      state_.nh.param("sv_in/reset", svin_reset_, true);
+      if(!state_.getRosUint("sv_in/min_dur", sv_in_min_dur_))
         throw std::runtime_error(std::string("Invalid settings: sv_in/min_dur ")
                                 + "must be set if TMODE3 is survey-in");
-      if(!nh->getParam("sv_in/acc_lim", sv_in_acc_lim_))
+      if(!state_.nh.getParam("sv_in/acc_lim", sv_in_acc_lim_))
         throw std::runtime_error(std::string("Invalid settings: sv_in/acc_lim ")
                                 + "must be set if TMODE3 is survey-in");
     } else if(tmode3_ != ublox_msgs::CfgTMODE3::FLAGS_MODE_DISABLED) {
@@ -1560,29 +1616,29 @@ void HpgRefProduct::getRosParams() {
                               + " flag constants for possible values.");
     }
   }
-  getRosUint("uart_index", uart_index, 1);  // # current uart_idex 
+  state_.getRosUint("uart_index", state_.uart_index, 1);  // # current uart_idex 
 }
 
 bool HpgRefProduct::configureUblox() {
-  if (unicore_oem==1) {
+  if (state_.unicore_oem==1) {
    return true;
   }
   // Configure TMODE3
   if(tmode3_ == ublox_msgs::CfgTMODE3::FLAGS_MODE_DISABLED) {
-    if(!gps.disableTmode3())
+    if(!state_.gps.disableTmode3())
       throw std::runtime_error("Failed to disable TMODE3.");
     mode_ = DISABLED;
   } else if(tmode3_ == ublox_msgs::CfgTMODE3::FLAGS_MODE_FIXED) {
-    if(!gps.configTmode3Fixed(lla_flag_, arp_position_, arp_position_hp_,
+    if(!state_.gps.configTmode3Fixed(lla_flag_, arp_position_, arp_position_hp_,
                                fixed_pos_acc_))
       throw std::runtime_error("Failed to set TMODE3 to fixed.");
-    if(!gps.configRtcm(rtcm_ids, rtcm_rates))
+    if(!state_.gps.configRtcm(state_.rtcm_ids, state_.rtcm_rates))
       throw std::runtime_error("Failed to set RTCM rates");
     mode_ = FIXED;
   } else if(tmode3_ == ublox_msgs::CfgTMODE3::FLAGS_MODE_SURVEY_IN) {
     if(!svin_reset_) {
       ublox_msgs::NavSVIN nav_svin;
-      if(!gps.poll(nav_svin))
+      if(!state_.gps.poll(nav_svin))
         throw std::runtime_error(std::string("Failed to poll NavSVIN while") +
                                  " configuring survey-in");
       // Don't reset survey-in if it's already active
@@ -1596,7 +1652,7 @@ bool HpgRefProduct::configureUblox() {
         return true;
       }
       ublox_msgs::NavPVT nav_pvt;
-      if(!gps.poll(nav_pvt))
+      if(!state_.gps.poll(nav_pvt))
         throw std::runtime_error(std::string("Failed to poll NavPVT while") +
                                  " configuring survey-in");
       // Don't reset survey in if in time mode with a good fix
@@ -1608,21 +1664,21 @@ bool HpgRefProduct::configureUblox() {
     }
     // Reset the Survey In
     // For Survey in, meas rate must be at least 1 Hz
-    uint16_t meas_rate_temp = meas_rate < 1000 ? meas_rate : 1000; // [ms]
+    uint16_t meas_rate_temp = state_.meas_rate < 1000 ? state_.meas_rate : 1000; // [ms]
     // If measurement period isn't a factor of 1000, set to default
     if(1000 % meas_rate_temp != 0)
       meas_rate_temp = kDefaultMeasPeriod;
     // Set nav rate to 1 Hz during survey in
-    if(!gps.configRate(meas_rate_temp, (int) 1000 / meas_rate_temp))
+    if(!state_.gps.configRate(meas_rate_temp, (int) 1000 / meas_rate_temp))
       throw std::runtime_error(std::string("Failed to set nav rate to 1 Hz") +
                                "before setting TMODE3 to survey-in.");
     // As recommended in the documentation, first disable, then set to survey in
-    if(!gps.disableTmode3())
+    if(!state_.gps.disableTmode3())
       ROS_ERROR("Failed to disable TMODE3 before setting to survey-in.");
     else
       mode_ = DISABLED;
     // Set to Survey in mode
-    if(!gps.configTmode3SurveyIn(sv_in_min_dur_, sv_in_acc_lim_))
+    if(!state_.gps.configTmode3SurveyIn(sv_in_min_dur_, sv_in_acc_lim_))
       throw std::runtime_error("Failed to set TMODE3 to survey-in.");
     mode_ = SURVEY_IN;
   }
@@ -1631,39 +1687,47 @@ bool HpgRefProduct::configureUblox() {
 
 void HpgRefProduct::subscribe() {
   // Whether to publish Nav Survey-In messages
-  nh->param("publish/nav/svin", enabled["nav_svin"], enabled["nav"]);
+  state_.nh.param("publish/nav/svin", state_.enabled["nav_svin"], state_.enabled["nav"]);
   // Subscribe to Nav Survey-In
-  gps.subscribe<ublox_msgs::NavSVIN>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavSVIN>(boost::bind(
       &HpgRefProduct::callbackNavSvIn, this, _1), kSubscribeRate);
 }
 
-void HpgRefProduct::callbackNavSvIn(ublox_msgs::NavSVIN m) {
-  if(enabled["nav_svin"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavSVIN>("navsvin", kROSQueueSize);
-    publisher.publish(m);
+void HpgRefProduct::callbackNavSvIn(const ublox_msgs::NavSVIN::ConstPtr& m) {
+  if(state_.enabled["nav_svin"]) {
+    state_.advertise<ublox_msgs::NavSVIN>(nav_svin_publisher_, "navsvin")
+        .publish(m);
   }
 
-  last_nav_svin_ = m;
-
-  if(!m.active && m.valid && mode_ == SURVEY_IN) {
+  bool survey_in_done;
+  {
+    boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+    last_nav_svin_ = *m;
+    survey_in_done = !m->active && m->valid && mode_ == SURVEY_IN;
+  }
+  // Not locked while it waits for the acknowledgements
+  if (survey_in_done) {
     setTimeMode();
   }
 
-  updater->update();
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+  state_.updater->update();
 }
 
 bool HpgRefProduct::setTimeMode() {
   ROS_INFO("Setting mode (internal state) to Time Mode");
-  mode_ = TIME;
+  {
+    boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+    mode_ = TIME;
+  }
 
   // Set the Measurement & nav rate to user config
   // (survey-in sets nav_rate to 1 Hz regardless of user setting)
-  if(!gps.configRate(meas_rate, nav_rate))
-    ROS_ERROR("Failed to set measurement rate to %d ms %s %d", meas_rate,
-              "navigation rate to ", nav_rate);
+  if(!state_.gps.configRate(state_.meas_rate, state_.nav_rate))
+    ROS_ERROR("Failed to set measurement rate to %d ms %s %d", state_.meas_rate,
+              "navigation rate to ", state_.nav_rate);
   // Enable the RTCM out messages
-  if(!gps.configRtcm(rtcm_ids, rtcm_rates)) {
+  if(!state_.gps.configRtcm(state_.rtcm_ids, state_.rtcm_rates)) {
     ROS_ERROR("Failed to configure RTCM IDs");
     return false;
   }
@@ -1671,8 +1735,8 @@ bool HpgRefProduct::setTimeMode() {
 }
 
 void HpgRefProduct::initializeRosDiagnostics() {
-  updater->add("TMODE3", this, &HpgRefProduct::tmode3Diagnostics);
-  updater->force_update();
+  state_.updater->add("TMODE3", this, &HpgRefProduct::tmode3Diagnostics);
+  state_.updater->force_update();
 }
 
 void HpgRefProduct::tmode3Diagnostics(
@@ -1722,35 +1786,35 @@ void HpgRefProduct::tmode3Diagnostics(
 //
 void HpgRovProduct::getRosParams() {
   // default to float, see CfgDGNSS message for details
-  getRosUint("dgnss_mode", dgnss_mode_,
+  state_.getRosUint("dgnss_mode", dgnss_mode_,
               ublox_msgs::CfgDGNSS::DGNSS_MODE_RTK_FIXED);
 }
 
 bool HpgRovProduct::configureUblox() {
-  if (unicore_oem==1) {
+  if (state_.unicore_oem==1) {
    return true;
   }
   // Configure the DGNSS
-  if(!gps.setDgnss(dgnss_mode_))
+  if(!state_.gps.setDgnss(dgnss_mode_))
     throw std::runtime_error(std::string("Failed to Configure DGNSS"));
   return true;
 }
 
 void HpgRovProduct::subscribe() {
   // Whether to publish Nav Relative Position NED
-  nh->param("publish/nav/relposned", enabled["nav_relposned"], enabled["nav"]);
+  state_.nh.param("publish/nav/relposned", state_.enabled["nav_relposned"], state_.enabled["nav"]);
   // Subscribe to Nav Relative Position NED messages (also updates diagnostics)
-  gps.subscribe<ublox_msgs::NavRELPOSNED>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavRELPOSNED>(boost::bind(
      &HpgRovProduct::callbackNavRelPosNed, this, _1), kSubscribeRate);
 }
 
 void HpgRovProduct::initializeRosDiagnostics() {
-  freq_rtcm_ = UbloxTopicDiagnostic(std::string("rxmrtcm"),
-                               kRtcmFreqMin, kRtcmFreqMax,
-                               kRtcmFreqTol, kRtcmFreqWindow);
-  updater->add("Carrier Phase Solution", this,
+  freq_rtcm_ = UbloxTopicDiagnostic(state_, std::string("rxmrtcm"),
+                                    kRtcmFreqMin, kRtcmFreqMax,
+                                    kRtcmFreqTol, kRtcmFreqWindow);
+  state_.updater->add("Carrier Phase Solution", this,
                 &HpgRovProduct::carrierPhaseDiagnostics);
-  updater->force_update();
+  state_.updater->force_update();
 }
 
 void HpgRovProduct::carrierPhaseDiagnostics(
@@ -1787,15 +1851,16 @@ void HpgRovProduct::carrierPhaseDiagnostics(
   }
 }
 
-void HpgRovProduct::callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED &m) {
-  if (enabled["nav_relposned"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavRELPOSNED>("navrelposned", kROSQueueSize);
-    publisher.publish(m);
+void HpgRovProduct::callbackNavRelPosNed(
+    const ublox_msgs::NavRELPOSNED::ConstPtr& m) {
+  if (state_.enabled["nav_relposned"]) {
+    state_.advertise<ublox_msgs::NavRELPOSNED>(nav_rel_pos_ned_publisher_,
+                                               "navrelposned").publish(m);
   }
 
-  last_rel_pos_ = m;
-  updater->update();
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+  last_rel_pos_ = *m;
+  state_.updater->update();
 }
 
 //
@@ -1803,46 +1868,46 @@ void HpgRovProduct::callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED &m) {
 //
 void HpPosRecProduct::subscribe() {
   // Subscribe to Nav High Precision Position ECEF
-  nh->param("publish/nav/hpposecef", enabled["nav_hpposecef"], enabled["nav"]);
-  if (enabled["nav_hpposecef"])
-    gps.subscribe<ublox_msgs::NavHPPOSECEF>(boost::bind(
-        publish<ublox_msgs::NavHPPOSECEF>, _1, "navhpposecef"), kSubscribeRate);
+  state_.nh.param("publish/nav/hpposecef", state_.enabled["nav_hpposecef"], state_.enabled["nav"]);
+  if (state_.enabled["nav_hpposecef"])
+    state_.subscribe<ublox_msgs::NavHPPOSECEF>("navhpposecef", kSubscribeRate);
 
   // Whether to publish the NavSatFix info from Nav High Precision Position LLH
-  nh->param("publish/nav/hp_fix", enabled["nav_hpfix"], enabled["nav"]);
+  state_.nh.param("publish/nav/hp_fix", state_.enabled["nav_hpfix"], state_.enabled["nav"]);
 
   // Whether to publish the NavSatFix info from Nav High Precision Position LLH
-  nh->param("publish/nav/hpposllh", enabled["nav_hpposllh"], enabled["nav"]);
+  state_.nh.param("publish/nav/hpposllh", state_.enabled["nav_hpposllh"], state_.enabled["nav"]);
 
   // Subscribe to Nav High Precision Position LLH
-  if (enabled["nav_hpposllh"] || enabled["nav_hpfix"])
-    gps.subscribe<ublox_msgs::NavHPPOSLLH>(boost::bind(
+  if (state_.enabled["nav_hpposllh"] || state_.enabled["nav_hpfix"])
+    state_.gps.subscribeShared<ublox_msgs::NavHPPOSLLH>(boost::bind(
         &HpPosRecProduct::callbackNavHpPosLlh, this, _1), kSubscribeRate);
 
   // Whether to publish Nav Relative Position NED
-  nh->param("publish/nav/relposned", enabled["nav_relposned"], enabled["nav"]);
+  state_.nh.param("publish/nav/relposned", state_.enabled["nav_relposned"], state_.enabled["nav"]);
   // Subscribe to Nav Relative Position NED messages (also updates diagnostics)
-  gps.subscribe<ublox_msgs::NavRELPOSNED9>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::NavRELPOSNED9>(boost::bind(
      &HpPosRecProduct::callbackNavRelPosNed, this, _1), kSubscribeRate);
 
   // Whether to publish the Heading info from Nav Relative Position NED
-  nh->param("publish/nav/heading", enabled["nav_heading"], enabled["nav"]);
+  state_.nh.param("publish/nav/heading", state_.enabled["nav_heading"], state_.enabled["nav"]);
 }
 
-void HpPosRecProduct::callbackNavHpPosLlh(const ublox_msgs::NavHPPOSLLH& m) {
-  if (enabled["nav_hpposllh"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavHPPOSLLH>("navhpposllh", kROSQueueSize);
-    publisher.publish(m);
+void HpPosRecProduct::callbackNavHpPosLlh(
+    const ublox_msgs::NavHPPOSLLH::ConstPtr& msg) {
+  const ublox_msgs::NavHPPOSLLH& m = *msg;
+  if (state_.enabled["nav_hpposllh"]) {
+    state_.advertise<ublox_msgs::NavHPPOSLLH>(nav_hp_pos_llh_publisher_,
+                                              "navhpposllh").publish(msg);
   }
 
-  if (enabled["nav_hpfix"]) {
-    sensor_msgs::NavSatFix fix_msg;
-    static ros::Publisher fixPublisher =
-        nh->advertise<sensor_msgs::NavSatFix>("hp_fix", kROSQueueSize);
+  if (state_.enabled["nav_hpfix"]) {
+    boost::shared_ptr<sensor_msgs::NavSatFix> fix =
+        boost::make_shared<sensor_msgs::NavSatFix>();
+    sensor_msgs::NavSatFix& fix_msg = *fix;
 
     fix_msg.header.stamp = ros::Time::now();
-    fix_msg.header.frame_id = frame_id;
+    fix_msg.header.frame_id = state_.frame_id;
     fix_msg.latitude = m.lat * 1e-7 + m.latHp * 1e-9;
     fix_msg.longitude = m.lon * 1e-7 + m.lonHp * 1e-9;
     fix_msg.altitude = m.height * 1e-3 + m.heightHp * 1e-4;
@@ -1864,23 +1929,22 @@ void HpPosRecProduct::callbackNavHpPosLlh(const ublox_msgs::NavHPPOSLLH& m) {
         sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
 
     fix_msg.status.service = fix_msg.status.SERVICE_GPS;
-    fixPublisher.publish(fix_msg);
+    state_.advertise<sensor_msgs::NavSatFix>(fix_publisher_, "hp_fix")
+        .publish(fix);
   }
 }
 
-void HpPosRecProduct::callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED9 &m) {
-  if (enabled["nav_relposned"]) {
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavRELPOSNED9>("navrelposned", kROSQueueSize);
-    publisher.publish(m);
+void HpPosRecProduct::callbackNavRelPosNed(
+    const ublox_msgs::NavRELPOSNED9::ConstPtr& msg) {
+  const ublox_msgs::NavRELPOSNED9& m = *msg;
+  if (state_.enabled["nav_relposned"]) {
+    state_.advertise<ublox_msgs::NavRELPOSNED9>(nav_rel_pos_ned_publisher_,
+                                                "navrelposned").publish(msg);
   }
 
-  if (enabled["nav_heading"]) {
-    static ros::Publisher imu_pub =
-	      nh->advertise<sensor_msgs::Imu>("navheading", kROSQueueSize);
-
+  if (state_.enabled["nav_heading"]) {
     imu_.header.stamp = ros::Time::now();
-    imu_.header.frame_id = frame_id;
+    imu_.header.frame_id = state_.frame_id;
 
     imu_.linear_acceleration_covariance[0] = -1;
     imu_.angular_velocity_covariance[0] = -1;
@@ -1902,11 +1966,13 @@ void HpPosRecProduct::callbackNavRelPosNed(const ublox_msgs::NavRELPOSNED9 &m) {
       imu_.orientation_covariance[8] = pow(m.accHeading * 1e-5 / 180.0 * M_PI, 2);
     }
 
-    imu_pub.publish(imu_);
+    state_.advertise<sensor_msgs::Imu>(imu_publisher_, "navheading")
+        .publish(boost::make_shared<sensor_msgs::Imu>(imu_));
   }
 
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
   last_rel_pos_ = m;
-  updater->update();
+  state_.updater->update();
 }
 
 //
@@ -1917,55 +1983,49 @@ void TimProduct::getRosParams() {
 
 bool TimProduct::configureUblox() {
   uint8_t r = 1;
-  if (unicore_oem==1) {
+  if (state_.unicore_oem==1) {
    return true;
   }
   // Configure the reciever
-  if(!gps.setUTCtime()) 
+  if(!state_.gps.setUTCtime()) 
     throw std::runtime_error(std::string("Failed to Configure TIM Product to UTC Time"));
  
-  if(!gps.setTimtm2(r))
+  if(!state_.gps.setTimtm2(r))
     throw std::runtime_error(std::string("Failed to Configure TIM Product"));
 
   return true;
 }
 
 void TimProduct::subscribe() {
-  ROS_INFO("TIM is Enabled: %u", enabled["tim"]);
-  ROS_INFO("TIM-TM2 is Enabled: %u", enabled["tim_tm2"]);
+  ROS_INFO("TIM is Enabled: %u", state_.enabled["tim"]);
+  ROS_INFO("TIM-TM2 is Enabled: %u", state_.enabled["tim_tm2"]);
   // Subscribe to TIM-TM2 messages (Time mark messages)
-  nh->param("publish/tim/tm2", enabled["tim_tm2"], enabled["tim"]);
+  state_.nh.param("publish/tim/tm2", state_.enabled["tim_tm2"], state_.enabled["tim"]);
 
-  gps.subscribe<ublox_msgs::TimTM2>(boost::bind(
+  state_.gps.subscribeShared<ublox_msgs::TimTM2>(boost::bind(
     &TimProduct::callbackTimTM2, this, _1), kSubscribeRate);
 	
   ROS_INFO("Subscribed to TIM-TM2 messages on topic tim/tm2");
 	
   // Subscribe to SFRBX messages
-  nh->param("publish/rxm/sfrb", enabled["rxm_sfrb"], enabled["rxm"]);
-  if (enabled["rxm_sfrb"])
-    gps.subscribe<ublox_msgs::RxmSFRBX>(boost::bind(
-        publish<ublox_msgs::RxmSFRBX>, _1, "rxmsfrb"), kSubscribeRate);
+  state_.nh.param("publish/rxm/sfrb", state_.enabled["rxm_sfrb"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_sfrb"])
+    state_.subscribe<ublox_msgs::RxmSFRBX>("rxmsfrb", kSubscribeRate);
 	
    // Subscribe to RawX messages
-   nh->param("publish/rxm/raw", enabled["rxm_raw"], enabled["rxm"]);
-   if (enabled["rxm_raw"])
-     gps.subscribe<ublox_msgs::RxmRAWX>(boost::bind(
-        publish<ublox_msgs::RxmRAWX>, _1, "rxmraw"), kSubscribeRate);
+   state_.nh.param("publish/rxm/raw", state_.enabled["rxm_raw"], state_.enabled["rxm"]);
+   if (state_.enabled["rxm_raw"])
+     state_.subscribe<ublox_msgs::RxmRAWX>("rxmraw", kSubscribeRate);
 }
 
-void TimProduct::callbackTimTM2(const ublox_msgs::TimTM2 &m) {
-  
-  if (enabled["tim_tm2"]) {
-    static ros::Publisher publisher =
-    	nh->advertise<ublox_msgs::TimTM2>("timtm2", kROSQueueSize);
-    static ros::Publisher time_ref_pub =
-	nh->advertise<sensor_msgs::TimeReference>("interrupt_time", kROSQueueSize);
+void TimProduct::callbackTimTM2(const ublox_msgs::TimTM2::ConstPtr& msg) {
+  const ublox_msgs::TimTM2& m = *msg;
+  if (state_.enabled["tim_tm2"]) {
     
     // create time ref message and put in the data
     t_ref_.header.seq = m.risingEdgeCount;
     t_ref_.header.stamp = ros::Time::now();
-    t_ref_.header.frame_id = frame_id;
+    t_ref_.header.frame_id = state_.frame_id;
 
     t_ref_.time_ref = ros::Time((m.wnR * 604800 + m.towMsR / 1000), (m.towMsR % 1000) * 1000000 + m.towSubMsR); 
     
@@ -1974,20 +2034,230 @@ void TimProduct::callbackTimTM2(const ublox_msgs::TimTM2 &m) {
     t_ref_.source = src.str();
 
     t_ref_.header.stamp = ros::Time::now(); // create a new timestamp
-    t_ref_.header.frame_id = frame_id;
+    t_ref_.header.frame_id = state_.frame_id;
   
-    publisher.publish(m);
-    time_ref_pub.publish(t_ref_);
+    state_.advertise<ublox_msgs::TimTM2>(tim_tm2_publisher_, "timtm2")
+        .publish(msg);
+    state_.advertise<sensor_msgs::TimeReference>(time_ref_publisher_,
+                                                 "interrupt_time")
+        .publish(boost::make_shared<sensor_msgs::TimeReference>(t_ref_));
   }
   
-  updater->force_update();
+  boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+  state_.updater->force_update();
 }
 
 void TimProduct::initializeRosDiagnostics() {
-  updater->force_update();
+  state_.updater->force_update();
+}
+
+//
+// NMEA only devices
+//
+NmeaProduct::NmeaProduct(NodeState& state)
+    : state_(state), has_vtg_(false), has_satellites_(false),
+      publish_raw_(false) {
+  last_gst_.time = std::numeric_limits<double>::quiet_NaN();
+}
+
+void NmeaProduct::subscribe() {
+  publish_raw_ = state_.enabled["nmea"];
+  fix_publisher_ =
+      state_.nh.advertise<sensor_msgs::NavSatFix>("fix", kROSQueueSize);
+  velocity_publisher_ =
+      state_.nh.advertise<geometry_msgs::TwistWithCovarianceStamped>(
+          "fix_velocity", kROSQueueSize);
+  heading_publisher_ =
+      state_.nh.advertise<sensor_msgs::Imu>("navheading", kROSQueueSize);
+  satellites_publisher_ =
+      state_.nh.advertise<ublox_msgs::NavSAT>("navsat", kROSQueueSize);
+  state_.gps.subscribe_nmea(boost::bind(&NmeaProduct::callbackNmea, this, _1));
+}
+
+void NmeaProduct::callbackNmea(boost::string_ref sentence) {
+  if (publish_raw_)
+    state_.publish_nmea(sentence, "nmea");
+  if (!fields_.split(sentence))
+    return;
+
+  switch (fields_.type()) {
+    case ublox::NMEA_GGA: {
+      // GGA and RMC start an epoch, the GSV of the previous one are complete
+      publishSatellites();
+      ublox::NmeaGGA m;
+      if (ublox::decodeNmea(fields_, m))
+        publishFix(m);
+      break;
+    }
+    case ublox::NMEA_GST:
+      ublox::decodeNmea(fields_, last_gst_);
+      break;
+    case ublox::NMEA_RMC: {
+      publishSatellites();
+      ublox::NmeaRMC m;
+      if (!has_vtg_ && ublox::decodeNmea(fields_, m) && m.valid)
+        publishVelocity(m.course, m.speed);
+      break;
+    }
+    case ublox::NMEA_VTG: {
+      ublox::NmeaVTG m;
+      has_vtg_ = true;
+      if (ublox::decodeNmea(fields_, m) && m.mode != 'N')
+        publishVelocity(m.course, m.speed);
+      break;
+    }
+    case ublox::NMEA_HDT: {
+      ublox::NmeaHDT m;
+      if (ublox::decodeNmea(fields_, m))
+        publishHeading(m);
+      break;
+    }
+    case ublox::NMEA_GSV: {
+      ublox::NmeaGSV m;
+      if (ublox::decodeNmea(fields_, m))
+        addSatellites(fields_.talker(), m);
+      break;
+    }
+    default:
+      break;
+  }
 }
 
-UnicoreVirtualProduct::UnicoreVirtualProduct():leap_sec_(LEAPS){ROS_INFO("create unicore product");}
+void NmeaProduct::publishFix(const ublox::NmeaGGA& m) {
+  boost::shared_ptr<sensor_msgs::NavSatFix> fix_msg =
+      boost::make_shared<sensor_msgs::NavSatFix>();
+  sensor_msgs::NavSatFix& fix = *fix_msg;
+  fix.header.stamp = ros::Time::now();
+  fix.header.frame_id = state_.frame_id;
+  fix.latitude = m.latitude;
+  fix.longitude = m.longitude;
+  // NavSatFix uses the height above the ellipsoid
+  fix.altitude = m.altitude +
+      (std::isnan(m.geoid_separation) ? 0 : m.geoid_separation);
+
+  switch (m.quality) {
+    case 0:
+      fix.status.status = fix.status.STATUS_NO_FIX;
+      break;
+    case 2:
+      fix.status.status = fix.status.STATUS_SBAS_FIX;
+      break;
+    case 4:
+    case 5:
+      fix.status.status = fix.status.STATUS_GBAS_FIX;
+      break;
+    default:
+      fix.status.status = fix.status.STATUS_FIX;
+      break;
+  }
+  fix.status.service = state_.fix_status_service;
+
+  // The GST of an epoch usually follows its GGA, so the last one is used
+  // if it is from this or the previous epoch
+  double age = std::fabs(m.time - last_gst_.time);
+  if ((age <= kMaxGstAge || age >= 86400 - kMaxGstAge) &&
+      !std::isnan(last_gst_.sigma_latitude + last_gst_.sigma_longitude +
+                  last_gst_.sigma_altitude)) {
+    fix.position_covariance[0] = pow(last_gst_.sigma_longitude, 2);
+    fix.position_covariance[4] = pow(last_gst_.sigma_latitude, 2);
+    fix.position_covariance[8] = pow(last_gst_.sigma_altitude, 2);
+    fix.position_covariance_type =
+        sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
+  } else {
+    fix.position_covariance_type =
+        sensor_msgs::NavSatFix::COVARIANCE_TYPE_UNKNOWN;
+  }
+  fix_publisher_.publish(fix_msg);
+}
+
+void NmeaProduct::publishVelocity(double course, double speed) {
+  if (std::isnan(course) || std::isnan(speed))
+    return;
+  boost::shared_ptr<geometry_msgs::TwistWithCovarianceStamped> velocity_msg =
+      boost::make_shared<geometry_msgs::TwistWithCovarianceStamped>();
+  geometry_msgs::TwistWithCovarianceStamped& velocity = *velocity_msg;
+  velocity.header.stamp = ros::Time::now();
+  velocity.header.frame_id = state_.frame_id;
+  // The course is clockwise from north, the velocity is east, north, up
+  const double course_rad = course / 180.0 * M_PI;
+  velocity.twist.twist.linear.x = speed * sin(course_rad);
+  velocity.twist.twist.linear.y = speed * cos(course_rad);
+
+  // NMEA does not report the accuracy of the velocity
+  const int cols = 6;
+  velocity.twist.covariance[cols * 0 + 0] = -1;
+  velocity.twist.covariance[cols * 3 + 3] = -1;  //  angular rate unsupported
+  velocity_publisher_.publish(velocity_msg);
+}
+
+void NmeaProduct::publishHeading(const ublox::NmeaHDT& m) {
+  boost::shared_ptr<sensor_msgs::Imu> imu_msg =
+      boost::make_shared<sensor_msgs::Imu>();
+  sensor_msgs::Imu& imu = *imu_msg;
+  imu.header.stamp = ros::Time::now();
+  imu.header.frame_id = state_.frame_id;
+  imu.linear_acceleration_covariance[0] = -1;
+  imu.angular_velocity_covariance[0] = -1;
+
+  // Transform angle since NMEA is representing heading as NED but ROS uses
+  // ENU as convention (REP-103).
+  double heading = M_PI_2 - m.heading / 180.0 * M_PI;
+  tf::Quaternion orientation;
+  orientation.setRPY(0, 0, heading);
+  imu.orientation.x = orientation[0];
+  imu.orientation.y = orientation[1];
+  imu.orientation.z = orientation[2];
+  imu.orientation.w = orientation[3];
+  // Roll and pitch are unknown, HDT does not report the accuracy
+  imu.orientation_covariance[0] = 1000.0;
+  imu.orientation_covariance[4] = 1000.0;
+  imu.orientation_covariance[8] = 1000.0;
+  heading_publisher_.publish(imu_msg);
+}
+
+void NmeaProduct::addSatellites(boost::string_ref talker,
+                                const ublox::NmeaGSV& m) {
+  // Map the talker to the GNSS identifier of CfgGNSS
+  uint8_t gnss_id = ublox_msgs::CfgGNSS_Block::GNSS_ID_GPS;
+  if (talker == "GL")
+    gnss_id = ublox_msgs::CfgGNSS_Block::GNSS_ID_GLONASS;
+  else if (talker == "GA")
+    gnss_id = ublox_msgs::CfgGNSS_Block::GNSS_ID_GALILEO;
+  else if (talker == "GB" || talker == "BD")
+    gnss_id = ublox_msgs::CfgGNSS_Block::GNSS_ID_BEIDOU;
+  else if (talker == "GQ")
+    gnss_id = ublox_msgs::CfgGNSS_Block::GNSS_ID_QZSS;
+
+  for (uint32_t i = 0; i < m.num_satellites; ++i) {
+    const ublox::NmeaGSV::Satellite& satellite = m.satellites[i];
+    ublox_msgs::NavSAT_SV sv;
+    sv.gnssId = gnss_id;
+    // NMEA numbers the GLONASS satellites from 65
+    sv.svId = gnss_id == ublox_msgs::CfgGNSS_Block::GNSS_ID_GLONASS &&
+        satellite.id > 64 ? satellite.id - 64 : satellite.id;
+    sv.cno = std::isnan(satellite.snr) ? 0 : satellite.snr;
+    sv.elev = std::isnan(satellite.elevation) ? -91 : satellite.elevation;
+    sv.azim = std::isnan(satellite.azimuth) ? 0 : satellite.azimuth;
+    nav_sat_.sv.push_back(sv);
+  }
+  has_satellites_ = true;
+}
+
+void NmeaProduct::publishSatellites() {
+  if (!has_satellites_)
+    return;
+  // The GSV has no time of week
+  nav_sat_.iTOW = 0;
+  nav_sat_.version = 1;
+  nav_sat_.numSvs = nav_sat_.sv.size();
+  satellites_publisher_.publish(
+      boost::make_shared<ublox_msgs::NavSAT>(nav_sat_));
+  nav_sat_.sv.clear();
+  has_satellites_ = false;
+}
+
+UnicoreVirtualProduct::UnicoreVirtualProduct(NodeState& state)
+    : state_(state), leap_sec_(LEAPS) {ROS_INFO("create unicore product");}
 
 void UnicoreVirtualProduct::getRosParams()
 {
@@ -2005,7 +2275,7 @@ bool UnicoreVirtualProduct::auto_detect_bps(std::string &uart, int &det_bps,int
       new boost::asio::serial_port(*io_service));
 
   ROS_DEBUG("Subscribe versionb  firstly");
-  gps.subscribe<ublox_msgs::VERSIONB>(boost::bind(
+  state_.gps.subscribeView<ublox_msgs::VERSIONBView>(boost::bind(
     &UnicoreVirtualProduct::callbackVersion, this,_1));
 
   // open serial port
@@ -2033,19 +2303,43 @@ bool UnicoreVirtualProduct::auto_detect_bps(std::string &uart, int &det_bps,int
   cur_bps =  current_baudrate.value();
   ROS_DEBUG("unicore: curent baudrate to %u", current_baudrate.value());
   det_bps = 0; 
-  // from 115200 to 460800
-  for (int i = 5; i < sizeof(ublox_gps::kBaudrates)/sizeof(ublox_gps::kBaudrates[0]); i++) {
+  // Listen at each baudrate from 115200 first. A receiver which is streaming
+  // yields frames at its baudrate and garbage at the others, so the probe
+  // command is only needed to confirm the best baudrate.
+  const int kNumBaudrates =
+      sizeof(ublox_gps::kBaudrates) / sizeof(ublox_gps::kBaudrates[0]);
+  // Each frame outweighs a few bytes of garbage at the wrong baudrate
+  const int64_t kFrameScore = 64;
+  std::vector<std::pair<int64_t, unsigned int> > candidates;
+  for (int i = 5; i < kNumBaudrates; i++) {
     serial->set_option(
         boost::asio::serial_port_base::baud_rate(ublox_gps::kBaudrates[i]));
-    boost::this_thread::sleep(
-        boost::posix_time::milliseconds(500));
+    // Let the bytes received at the previous baudrate drain
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    ublox_gps::FramerStatistics before = state_.gps.framerStatistics();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    ublox_gps::FramerStatistics after = state_.gps.framerStatistics();
+    int64_t frames = after.frames - before.frames;
+    int64_t discarded = after.discarded - before.discarded;
+    ROS_DEBUG("unicore: %u bps: %ld frames, %ld bytes of garbage",
+              ublox_gps::kBaudrates[i], static_cast<long>(frames),
+              static_cast<long>(discarded));
+    candidates.push_back(std::make_pair(frames * kFrameScore - discarded,
+                                        ublox_gps::kBaudrates[i]));
+  }
+  // Probe the best baudrate first, a silent receiver needs all probes
+  std::sort(candidates.rbegin(), candidates.rend());
+
+  for (size_t i = 0; i < candidates.size(); i++) {
+    serial->set_option(
+        boost::asio::serial_port_base::baud_rate(candidates[i].second));
     serial->get_option(current_baudrate);
     ROS_DEBUG("unicore: Set ASIO baudrate to %u", current_baudrate.value());
     //query version 
-    for (int i = 0 ; i < 3 ; i++) {
-        gps.configureUnicore("versionb\r\n");
+    for (int j = 0 ; j < 2 ; j++) {
+        state_.gps.configureUnicore("versionb\r\n");
         // wait version cmd rsp
-        if (waitVersion(boost::posix_time::milliseconds(1000))) {
+        if (waitVersion(boost::posix_time::milliseconds(300))) {
             //hit verison
             ROS_DEBUG("hit version at bps:%d",current_baudrate.value());
             det_bps = current_baudrate.value();
@@ -2072,114 +2366,118 @@ bool UnicoreVirtualProduct::configureUblox()
   //ROS_INFO("uart1 bps:%s",format_str);
   //gps.configureUnicore(format_str);
 
-  ROS_INFO("unlog com1");
-  snprintf(format_str,sizeof(format_str)-1,"unlog com%d\r\n",uart_index);
-  gps.configureUnicore(format_str);
-  ros::Duration(1.0).sleep();
+  // The commands are pipelined, each command is sent once the commands
+  // before it leave enough room in the input buffer of the receiver
+  std::vector<std::string> commands;
+  snprintf(format_str,sizeof(format_str)-1,"unlog com%d\r\n",state_.uart_index);
+  commands.push_back(format_str);
 
   //if(enabled["nmea"]) // ntrip client need gga
   {
       //maybe need custom the gga output 
-      snprintf(format_str,sizeof(format_str)-1,"log com%d gpgga ontime 1\r\n",uart_index);
-      gps.configureUnicore(format_str);
-      ros::Duration(0.5).sleep();
+      snprintf(format_str,sizeof(format_str)-1,"log com%d gpgga ontime 1\r\n",state_.uart_index);
+      commands.push_back(format_str);
   }
 #define UNICORE_RTKTIMEOUT "RTKTIMEOUT 30\r\n"
 #define UNICORE_DGPSTIMEOUT "DGPSTIMEOUT 100\r\n"
 #define UNICORE_CMD_ROVER "mode rover\r\n"
-  gps.configureUnicore(UNICORE_RTKTIMEOUT);
-  ros::Duration(0.3).sleep();
-  gps.configureUnicore(UNICORE_DGPSTIMEOUT);
-  ros::Duration(0.3).sleep();
-  gps.configureUnicore(UNICORE_CMD_ROVER);
-
-  memset(format_str,sizeof(format_str),0);
-  snprintf(format_str,sizeof(format_str)-1,"OBSVMB COM%d %.2f\r\n",uart_index,nav_sec);
+  commands.push_back(UNICORE_RTKTIMEOUT);
+  commands.push_back(UNICORE_DGPSTIMEOUT);
+  commands.push_back(UNICORE_CMD_ROVER);
+
+  snprintf(format_str,sizeof(format_str)-1,"OBSVMB COM%d %.2f\r\n",state_.uart_index,nav_sec);
   ROS_INFO("obsvm=%s",format_str);
-  gps.configureUnicore(format_str); 
-  ros::Duration(0.5).sleep();
+  commands.push_back(format_str);
 
-  memset(format_str,sizeof(format_str),0);
-  snprintf(format_str,sizeof(format_str)-1,"log com%d bestposb ontime %.2f\r\n",uart_index,nav_sec);
+  snprintf(format_str,sizeof(format_str)-1,"log com%d bestposb ontime %.2f\r\n",state_.uart_index,nav_sec);
   ROS_INFO("logBestpos=%s",format_str);
-  gps.configureUnicore(format_str); 
-  ros::Duration(0.5).sleep();
- 
+  commands.push_back(format_str);
 
-  memset(format_str,sizeof(format_str),0);
-  snprintf(format_str,sizeof(format_str)-1,"agricb com%d %.2f\r\n",uart_index,argic_sec);
+  snprintf(format_str,sizeof(format_str)-1,"agricb com%d %.2f\r\n",state_.uart_index,argic_sec);
   ROS_INFO("logAgric=%s",format_str);
-  gps.configureUnicore(format_str); 
-  ros::Duration(0.5).sleep();
+  commands.push_back(format_str);
+
+  // Failed commands are logged by Gps
+  if (!state_.gps.configureUnicore(commands)) {
+    ROS_ERROR("Failed to configure the Unicore receiver");
+    return false;
+  }
 
   return true;
 }   
 
 
 
-void UnicoreVirtualProduct::callbackBestpos(const ublox_msgs::BESTPOS& m)
+void UnicoreVirtualProduct::callbackBestpos(const ublox_msgs::BESTPOSView& m)
 {
     ROS_DEBUG("callbackBestpos");
+    publishRaw<ublox_msgs::BESTPOS>(m, bestpos_publisher_);
     //
     // NavSatFix message
     //
-    static ros::Publisher fixPublisher =
-        nh->advertise<sensor_msgs::NavSatFix>("fix", kROSQueueSize);
+    boost::shared_ptr<sensor_msgs::NavSatFix> fix =
+        boost::make_shared<sensor_msgs::NavSatFix>();
+    boost::shared_ptr<ublox_msgs::RxmRTCM> rxmrtcm =
+        boost::make_shared<ublox_msgs::RxmRTCM>();
 
-    static ros::Publisher rxmrtcmPublisher =
-        nh->advertise<ublox_msgs::RxmRTCM>("rxmrtcm", kROSQueueSize);
+    convertToNavStaFix(m,*fix);
+    state_.advertise<sensor_msgs::NavSatFix>(fix_publisher_, "fix")
+        .publish(fix);
 
-    sensor_msgs::NavSatFix fix;
-    ublox_msgs::RxmRTCM rxmrtcm;
+    convertToRxmrtcm(m,*rxmrtcm);
+    state_.advertise<ublox_msgs::RxmRTCM>(rxmrtcm_publisher_, "rxmrtcm")
+        .publish(rxmrtcm);
 
-    convertToNavStaFix(m,fix);
-    fixPublisher.publish(fix);
-
-    convertToRxmrtcm(m,rxmrtcm);
-    rxmrtcmPublisher.publish(rxmrtcm);
-
-    updater->update();
+    boost::mutex::scoped_lock lock(state_.diagnostics_mutex);
+    state_.updater->update();
     
 }
 
-void UnicoreVirtualProduct::callbackVersion(const ublox_msgs::VERSIONB& m)
+void UnicoreVirtualProduct::callbackVersion(const ublox_msgs::VERSIONBView& m)
 {
     boost::mutex::scoped_lock lock(mutex_);
-    //std::string  version(m.sw_version.begin(),m.sw_version.end());
-    ROS_INFO("unicore_pn:%d sw_version:%s",m.pn_type ,m.sw_version.data());
+    // The version is not terminated if it fills the field
+    ROS_INFO("unicore_pn:%d sw_version:%.*s", m.pn_type(),
+             static_cast<int>(m.sw_version_size()), m.sw_version_data());
     condition_.notify_all();
 }
 
-void UnicoreVirtualProduct::callbackAgric(const ublox_msgs::AGRIC& m)
+void UnicoreVirtualProduct::callbackAgric(const ublox_msgs::AGRICView& m)
 {
     ROS_INFO("callbackAgric");
-    ublox_msgs::NavRELPOSNED relpos;
-    static ros::Publisher publisher =
-        nh->advertise<ublox_msgs::NavRELPOSNED>("navrelposned", kROSQueueSize);
+    boost::shared_ptr<ublox_msgs::NavRELPOSNED> relpos =
+        boost::make_shared<ublox_msgs::NavRELPOSNED>();
 
-    //publisher.publish(m);
+    publishRaw<ublox_msgs::AGRIC>(m, agric_publisher_);
     // check leap sec 
-    uint8_t cur_leap_sec = m.Leap_sec ;
-    if (cur_leap_sec != leap_sec_) {
-        leap_sec_ = cur_leap_sec;
+    uint8_t cur_leap_sec = m.Leap_sec() ;
+    {
+        boost::mutex::scoped_lock lock(conversion_mutex_);
+        if (cur_leap_sec != leap_sec_) {
+            leap_sec_ = cur_leap_sec;
+        }
     }
-    convertToNavrelposned(m,relpos);
-    publisher.publish(relpos);
+    convertToNavrelposned(m,*relpos);
+    state_.advertise<ublox_msgs::NavRELPOSNED>(relposned_publisher_,
+                                               "navrelposned").publish(relpos);
 }
 
-void UnicoreVirtualProduct::callbackObsvm(const ublox_msgs::OBSVM& m)
+void UnicoreVirtualProduct::callbackObsvm(const ublox_msgs::OBSVMView& m)
 {
     ROS_INFO("callbackObsvm");
-    ublox_msgs::RxmRAWX  rawx;
-    convertToRxmrawx(m,rawx);
-    publish(rawx,"rxmraw");
+    publishRaw<ublox_msgs::OBSVM>(m, obsvm_publisher_);
+    // The pooled message keeps the capacity of its measurements
+    ublox_gps::MessagePool<ublox_msgs::RxmRAWX>::Ptr rawx = rawx_pool_.get();
+    convertToRxmrawx(m,*rawx);
+    state_.advertise<ublox_msgs::RxmRAWX>(rawx_publisher_, "rxmraw")
+        .publish(rawx);
 }
 
-bool UnicoreVirtualProduct::convertToRxmrawx(const ublox_msgs::OBSVM& m,ublox_msgs::RxmRAWX &raw)
+bool UnicoreVirtualProduct::convertToRxmrawx(const ublox_msgs::OBSVMView& m,ublox_msgs::RxmRAWX &raw)
 {
     ROS_INFO("convertToRxmrawx");
-    if (m.TimeStatus == 160) { //gps time is ok
-        raw.rcvTOW = m.Ms/1000; // to Sec
+    if (m.TimeStatus() == 160) { //gps time is ok
+        raw.rcvTOW = m.Ms()/1000; // to Sec
     }
     else
     {
@@ -2189,12 +2487,14 @@ bool UnicoreVirtualProduct::convertToRxmrawx(const ublox_msgs::OBSVM& m,ublox_ms
         double sec = time2gpst(gtime,&gps_wk);
         raw.rcvTOW  = sec;
     }
-    raw.week = m.Wn;
-    raw.leapS = m.Leap_sec; 
-    raw.numMeas = m.obs_num;
+    raw.week = m.Wn();
+    raw.leapS = m.Leap_sec(); 
+    // Ignore measurements which are not in the message
+    uint32_t obs_num = std::min(m.obs_num(), m.meas_capacity());
+    raw.numMeas = obs_num;
     raw.recStat = raw.REC_STAT_LEAP_SEC;
     raw.version = 0x01;
-    raw.meas.resize(m.obs_num);
+    raw.meas.resize(obs_num);
 
     /*
     uint8 GNSS_ID_GPS = 0
@@ -2206,13 +2506,15 @@ uint8 GNSS_ID_QZSS = 5
 uint8 GNSS_ID_GLONASS = 6
         */
     ublox_msgs::CfgGNSS_Block cfggnss;
-    for(std::size_t i = 0,j=0; i < m.obs_num; ++i) 
+    std::size_t j = 0;
+    for(std::size_t i = 0; i < obs_num; ++i) 
     {
+      ublox_msgs::OBSVM_MeasView meas = m.meas(i);
       raw.meas[j].trkStat = 0;
-      raw.meas[j].prMes = m.meas[i].psr;
-      raw.meas[j].cpMes = m.meas[i].adr;
-      raw.meas[j].doMes = m.meas[i].dopp_hz;
-      uint8_t  gnssid  = (m.meas[i].tr_status>>16)&0x07;
+      raw.meas[j].prMes = meas.psr();
+      raw.meas[j].cpMes = meas.adr();
+      raw.meas[j].doMes = meas.dopp_hz();
+      uint8_t  gnssid  = (meas.tr_status()>>16)&0x07;
       if (gnssid == 0) {
           gnssid = cfggnss.GNSS_ID_GPS;
       }
@@ -2235,7 +2537,7 @@ uint8 GNSS_ID_GLONASS = 6
           continue;
       }
       raw.meas[j].gnssId = gnssid;
-      uint16_t prn =  m.meas[i].prn;
+      uint16_t prn =  meas.prn();
       //ROS_DEBUG("unicore prn=%d",prn);
       // GSP and SBAS QZSS matched
       if (gnssid == cfggnss.GNSS_ID_GLONASS) {
@@ -2247,15 +2549,15 @@ uint8 GNSS_ID_GLONASS = 6
       else if (gnssid == cfggnss.GNSS_ID_GALILEO) {
           prn = prn + 210;
       }
-      raw.meas[j].svId = m.meas[i].prn;
+      raw.meas[j].svId = meas.prn();
 
-      raw.meas[j].freqId = m.meas[i].system_feq;
-      raw.meas[j].locktime = m.meas[i].locktime*1000;// to ms
-      raw.meas[j].cno = m.meas[i].cno/100;
-      raw.meas[j].prStdev = m.meas[i].psr_std/100;
-      raw.meas[j].cpStdev = m.meas[i].adr_std/10000;
+      raw.meas[j].freqId = meas.system_feq();
+      raw.meas[j].locktime = meas.locktime()*1000;// to ms
+      raw.meas[j].cno = meas.cno()/100;
+      raw.meas[j].prStdev = meas.psr_std()/100;
+      raw.meas[j].cpStdev = meas.adr_std()/10000;
       raw.meas[j].doStdev = 0.0f;// no support
-      uint8_t  trk  = (m.meas[i].tr_status>>8)&0x14;
+      uint8_t  trk  = (meas.tr_status()>>8)&0x14;
       if (trk&0x04 == 0x04) { // 
          raw.meas[j].trkStat|= 0x02;//ublox_msgs::RxmRAWX_Meas_::TRK_STAT_CP_VALID;
       }
@@ -2263,18 +2565,21 @@ uint8 GNSS_ID_GLONASS = 6
           raw.meas[j].trkStat|= 0x04;//ublox_msgs::RxmRAWX_Meas_::TRK_STAT_PR_VALID;
       }
       j++;
-      raw.numMeas = j;
     }
+    // Drop the entries of the skipped measurements, a reused message may
+    // also hold more from the last epoch
+    raw.numMeas = j;
+    raw.meas.resize(j);
     return true;
 }
 
-bool UnicoreVirtualProduct::convertToNavStaFix(const ublox_msgs::BESTPOS& m,sensor_msgs::NavSatFix& fix)
+bool UnicoreVirtualProduct::convertToNavStaFix(const ublox_msgs::BESTPOSView& m,sensor_msgs::NavSatFix& fix)
 {
     gtime_t gtime;
-    double gps_sec =  m.iTOW*0.001;
-    fix.header.frame_id = frame_id;
-    if (m.timeStaus == 160) { //gps time is ok
-        gtime = GPSTime2UTCTime(m.gpsWeek,gps_sec,leap_sec_);
+    double gps_sec =  m.iTOW()*0.001;
+    fix.header.frame_id = state_.frame_id;
+    if (m.timeStaus() == 160) { //gps time is ok
+        gtime = GPSTime2UTCTime(m.gpsWeek(),gps_sec,leapSeconds());
         fix.header.stamp.sec = gtime.time;
         fix.header.stamp.nsec = gtime.sec*1e9;
     }
@@ -2284,9 +2589,9 @@ bool UnicoreVirtualProduct::convertToNavStaFix(const ublox_msgs::BESTPOS& m,sens
       fix.header.stamp = ros::Time::now();
     }
     // Set the LLA
-    fix.latitude = m.lat;
-    fix.longitude = m.lon; 
-    fix.altitude = m.hgt;
+    fix.latitude = m.lat();
+    fix.longitude = m.lon(); 
+    fix.altitude = m.hgt();
 
     // Set the Fix status
 /* 
@@ -2295,8 +2600,8 @@ int8 STATUS_FIX =      0        # ??????
 int8 STATUS_SBAS_FIX = 1        # with satellite-based augmentation
 int8 STATUS_GBAS_FIX = 2        # with ground-based augmentation
 */
-    uint32_t pos_type = m.pos_type;
-    ROS_DEBUG("pos_type=%d undulation %f id %d lat_std %f lon_std %f",pos_type,m.undulation,m.datumId,m.lat_std,m.lon_std);
+    uint32_t pos_type = m.pos_type();
+    ROS_DEBUG("pos_type=%d undulation %f id %d lat_std %f lon_std %f",pos_type,m.undulation(),m.datumId(),m.lat_std(),m.lon_std());
     if (pos_type == 0) {
         fix.status.status = fix.status.STATUS_NO_FIX;
     }
@@ -2310,11 +2615,11 @@ int8 STATUS_GBAS_FIX = 2        # with ground-based augmentation
         fix.status.status = fix.status.STATUS_GBAS_FIX;
     }
     // Set the service based on GNSS configuration
-    fix.status.service = fix_status_service;
-    //ROS_DEBUG("lla std=%f,%f,%f ",m.lat_std,m.lon_std,m.hgt_std);
+    fix.status.service = state_.fix_status_service;
+    //ROS_DEBUG("lla std=%f,%f,%f ",m.lat_std(),m.lon_std(),m.hgt_std());
     // Set the position covariance
-    const double varH = sqrtf(m.lat_std * m.lat_std + m.lon_std * m.lon_std) / 2.0;// to [m^2]
-    const double varV = m.hgt_std; // to [m^2]
+    const double varH = sqrtf(m.lat_std() * m.lat_std() + m.lon_std() * m.lon_std()) / 2.0;// to [m^2]
+    const double varV = m.hgt_std(); // to [m^2]
     fix.position_covariance[0] = varH;
     fix.position_covariance[4] = varH;
     fix.position_covariance[8] = varV;
@@ -2323,88 +2628,112 @@ int8 STATUS_GBAS_FIX = 2        # with ground-based augmentation
     return true;
 }
 
-bool UnicoreVirtualProduct::convertToNavrelposned(const ublox_msgs::AGRIC &m,ublox_msgs::NavRELPOSNED &relpos)
+bool UnicoreVirtualProduct::convertToNavrelposned(const ublox_msgs::AGRICView &m,ublox_msgs::NavRELPOSNED &relpos)
 {
     relpos.version = 0x00;
-    relpos.refStationId = refStationId;
-    relpos.iTOW = m.Ms;
-    relpos.relPosN = (int32_t)m.Baseline_N*100;// m to cm
-    relpos.relPosE = (int32_t)m.Baseline_E*100;
-    relpos.relPosD = (int32_t)-m.Baseline_U*100;
-
-    relpos.relPosHPN = m.Baseline_N*10000 - relpos.relPosN*100; //to 0.1mm
-    relpos.relPosHPE = m.Baseline_E*10000 - relpos.relPosE*100; //to 0.1mm
-    relpos.relPosHPD = -m.Baseline_U*10000 - relpos.relPosD*100; //to 0.1mm
-    relpos.accN = m.Baseline_NStd*10000;//to 0.1mm
-    relpos.accE = m.Baseline_EStd*10000;//to 0.1mm
-    relpos.accD = m.Baseline_UStd*10000;//to 0.1mm
-    if (m.RTK_Status == ublox_msgs::AGRIC::RTK_STATUS_NONE) {
+    {
+        boost::mutex::scoped_lock lock(conversion_mutex_);
+        relpos.refStationId = refStationId;
+    }
+    relpos.iTOW = m.Ms();
+    relpos.relPosN = (int32_t)m.Baseline_N()*100;// m to cm
+    relpos.relPosE = (int32_t)m.Baseline_E()*100;
+    relpos.relPosD = (int32_t)-m.Baseline_U()*100;
+
+    relpos.relPosHPN = m.Baseline_N()*10000 - relpos.relPosN*100; //to 0.1mm
+    relpos.relPosHPE = m.Baseline_E()*10000 - relpos.relPosE*100; //to 0.1mm
+    relpos.relPosHPD = -m.Baseline_U()*10000 - relpos.relPosD*100; //to 0.1mm
+    relpos.accN = m.Baseline_NStd()*10000;//to 0.1mm
+    relpos.accE = m.Baseline_EStd()*10000;//to 0.1mm
+    relpos.accD = m.Baseline_UStd()*10000;//to 0.1mm
+    if (m.RTK_Status() == ublox_msgs::AGRIC::RTK_STATUS_NONE) {
         relpos.flags = 0;
     }
-    if (m.RTK_Status == ublox_msgs::AGRIC::RTK_STATUS_DIFF) {
+    if (m.RTK_Status() == ublox_msgs::AGRIC::RTK_STATUS_DIFF) {
         relpos.flags = ublox_msgs::NavRELPOSNED::FLAGS_DIFF_SOLN;
     }
-    else if ((m.RTK_Status == ublox_msgs::AGRIC::RTK_STATUS_PVT) ) {
+    else if ((m.RTK_Status() == ublox_msgs::AGRIC::RTK_STATUS_PVT) ) {
         relpos.flags = ublox_msgs::NavRELPOSNED::FLAGS_GNSS_FIX_OK;
-    } else if (m.RTK_Status == ublox_msgs::AGRIC::RTK_STATUS_FIX) {
+    } else if (m.RTK_Status() == ublox_msgs::AGRIC::RTK_STATUS_FIX) {
         relpos.flags = ublox_msgs::NavRELPOSNED::FLAGS_CARR_SOLN_FIXED|
             ublox_msgs::NavRELPOSNED::FLAGS_GNSS_FIX_OK|
             ublox_msgs::NavRELPOSNED::FLAGS_REL_POS_VALID;
     }
-    else if (m.RTK_Status == ublox_msgs::AGRIC::RTK_STATUS_FLOAT) {
+    else if (m.RTK_Status() == ublox_msgs::AGRIC::RTK_STATUS_FLOAT) {
         relpos.flags = ublox_msgs::NavRELPOSNED::FLAGS_CARR_SOLN_FLOAT|
             ublox_msgs::NavRELPOSNED::FLAGS_REL_POS_VALID|
             ublox_msgs::NavRELPOSNED::FLAGS_GNSS_FIX_OK;
     }
 
-    ROS_DEBUG("relpos: NEU [%lf] [%lf] [%lf] std [%lf] [%lf] [%lf]",m.Baseline_N,m.Baseline_E,m.Baseline_U,m.Baseline_NStd,m.Baseline_EStd,m.Baseline_UStd);
+    ROS_DEBUG("relpos: NEU [%lf] [%lf] [%lf] std [%lf] [%lf] [%lf]",m.Baseline_N(),m.Baseline_E(),m.Baseline_U(),m.Baseline_NStd(),m.Baseline_EStd(),m.Baseline_UStd());
 
     return true;
 }
 
-bool UnicoreVirtualProduct::convertToRxmrtcm(const ublox_msgs::BESTPOS& m,ublox_msgs::RxmRTCM &rtcm)
+bool UnicoreVirtualProduct::convertToRxmrtcm(const ublox_msgs::BESTPOSView& m,ublox_msgs::RxmRTCM &rtcm)
 {
     rtcm.version = 0x02;
     rtcm.flags =  0; // 0 ok 1 fail
 
 
-    std::string  refStr(m.stn_id.begin(),m.stn_id.end());
+    std::string  refStr(m.stn_id_data(),m.stn_id_data() + m.stn_id_size());
     rtcm.refStation = std::strtol(refStr.data(), nullptr, 10);
+    // The station is also read by the AGRIC conversion on another thread
+    boost::mutex::scoped_lock lock(conversion_mutex_);
     refStationId = rtcm.refStation;
-    if (fabs(m.diff_age -0.1) < 0.01 || (m.diff_age >5.0f) ) {
+    if (fabs(m.diff_age() -0.1) < 0.01 || (m.diff_age() >5.0f) ) {
         // no rtcm inject
         rtcm.flags = 1;
         refStationId = 0;
     }
-    ROS_DEBUG("refStation=%d,sol_age=%lf diff_age:%lf ",refStationId,m.sol_age,m.diff_age);
+    ROS_DEBUG("refStation=%d,sol_age=%lf diff_age:%lf ",refStationId,m.sol_age(),m.diff_age());
     return true;
 }
 
 void UnicoreVirtualProduct::subscribe()
 {
+  // The Unicore messages are only decoded if their raw topics have
+  // subscribers, the converted messages are read from the frames directly
+  state_.nh.param("publish/unicore/all", state_.enabled["unicore"], false);
+  state_.nh.param("publish/unicore/bestpos", state_.enabled["unicore_bestpos"],
+                  state_.enabled["unicore"]);
+  state_.nh.param("publish/unicore/agric", state_.enabled["unicore_agric"],
+                  state_.enabled["unicore"]);
+  state_.nh.param("publish/unicore/obsvm", state_.enabled["unicore_obsvm"],
+                  state_.enabled["unicore"]);
+  if (state_.enabled["unicore_bestpos"])
+    bestpos_publisher_ = state_.nh.advertise<ublox_msgs::BESTPOS>(
+        "unicore/bestpos", kROSQueueSize);
+  if (state_.enabled["unicore_agric"])
+    agric_publisher_ = state_.nh.advertise<ublox_msgs::AGRIC>(
+        "unicore/agric", kROSQueueSize);
+  if (state_.enabled["unicore_obsvm"])
+    obsvm_publisher_ = state_.nh.advertise<ublox_msgs::OBSVM>(
+        "unicore/obsvm", kROSQueueSize);
+
   // Subscribe to unicore
-  nh->param("publish/nav/bestpos", enabled["nav_bestpos"],enabled["nav"]);
-  if (enabled["nav_bestpos"])
+  state_.nh.param("publish/nav/bestpos", state_.enabled["nav_bestpos"],state_.enabled["nav"]);
+  if (state_.enabled["nav_bestpos"])
   {
-    gps.subscribe<ublox_msgs::BESTPOS>(boost::bind(
+    state_.gps.subscribeView<ublox_msgs::BESTPOSView>(boost::bind(
         &UnicoreVirtualProduct::callbackBestpos, this,_1));
     ROS_DEBUG("Subscribe bestpos");
   }
 
   // Subscribe to RXM Raw use 
-  nh->param("publish/rxm/raw", enabled["rxm_raw"], enabled["rxm"]);
-  nh->param("publish/rxm/rangcmp", enabled["rxm_rangcmp"], enabled["rxm"]);
-  if (enabled["rxm_raw"] || enabled["rxm_rangcmp"] )
+  state_.nh.param("publish/rxm/raw", state_.enabled["rxm_raw"], state_.enabled["rxm"]);
+  state_.nh.param("publish/rxm/rangcmp", state_.enabled["rxm_rangcmp"], state_.enabled["rxm"]);
+  if (state_.enabled["rxm_raw"] || state_.enabled["rxm_rangcmp"] )
   {
       ROS_DEBUG("Subscribe OBSVM");
-      gps.subscribe<ublox_msgs::OBSVM>(boost::bind(
+      state_.gps.subscribeView<ublox_msgs::OBSVMView>(boost::bind(
         &UnicoreVirtualProduct::callbackObsvm, this,_1));
   }
 
-  if (enabled["nav_relposned"] )
+  if (state_.enabled["nav_relposned"] )
   {
       ROS_DEBUG("Subscribe AGRIC");
-      gps.subscribe<ublox_msgs::AGRIC>(boost::bind(
+      state_.gps.subscribeView<ublox_msgs::AGRICView>(boost::bind(
         &UnicoreVirtualProduct::callbackAgric, this,_1));
   }
   ROS_INFO("subcrible unicore bin ");
@@ -2412,26 +2741,5 @@ void UnicoreVirtualProduct::subscribe()
 
 void UnicoreVirtualProduct::initializeRosDiagnostics()
 {
-    updater->force_update();
-}
-
-void rtcmCallback(const rtcm_msgs::Message::ConstPtr &msg) {
-  ROS_INFO("rtcmCallback");
-  gps.sendRtcm(msg->message);
-}
-
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "ublox_gps");
-  nh.reset(new ros::NodeHandle("~"));
-  ros::Subscriber subRtcm = nh->subscribe("/rtcm", 10, rtcmCallback);
-  nh->param("debug", ublox_gps::debug, 1);
-  if(ublox_gps::debug) {
-    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
-                                       ros::console::levels::Debug))
-     ros::console::notifyLoggerLevelsChanged();
-
-  }
-  // create ublox node obj
-  UbloxNode node;
-  return 0;
+    state_.updater->force_update();
 }
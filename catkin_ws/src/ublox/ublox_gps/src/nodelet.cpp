@@ -0,0 +1,87 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "ublox_gps/node.h"
+
+namespace ublox_node {
+
+/**
+ * @brief Runs a UbloxNode in a nodelet manager.
+ *
+ * @details The messages are published as shared pointers, so nodelets in the
+ * same manager receive them without serialization. The node uses the private
+ * node handle of the nodelet for its parameters and topics.
+ */
+class UbloxNodelet : public nodelet::Nodelet {
+ public:
+  /**
+   * @brief Wait for the initialization before the node is closed.
+   */
+  virtual ~UbloxNodelet() {
+    if (init_thread_.joinable())
+      init_thread_.join();
+  }
+
+ private:
+  /**
+   * @brief Create the node and initialize it on a separate thread.
+   *
+   * @details Opening and configuring the device takes seconds, which would
+   * block the manager from loading the other nodelets.
+   */
+  virtual void onInit() {
+    node_.reset(new UbloxNode(getPrivateNodeHandle()));
+    init_thread_ = boost::thread(boost::bind(&UbloxNodelet::initialize, this));
+  }
+
+  /**
+   * @brief Initialize the node.
+   */
+  void initialize() {
+    try {
+      if (!node_->initialize())
+        NODELET_ERROR("Failed to initialize the u-blox device");
+    } catch (std::exception& e) {
+      NODELET_FATAL("Error initializing u-blox: %s", e.what());
+    }
+  }
+
+  //! The node
+  boost::shared_ptr<UbloxNode> node_;
+  //! The thread which initializes the node
+  boost::thread init_thread_;
+};
+
+}  // namespace ublox_node
+
+PLUGINLIB_EXPORT_CLASS(ublox_node::UbloxNodelet, nodelet::Nodelet)
@@ -37,6 +37,8 @@
 #include <string>
 #include <sstream>
 
+#include <boost/make_shared.hpp>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -47,8 +49,9 @@ using namespace ublox_node;
 // ublox_node namespace
 //
 
-RawDataStreamPa::RawDataStreamPa(bool is_ros_subscriber) :
-  pnh_(ros::NodeHandle("~")),
+RawDataStreamPa::RawDataStreamPa(bool is_ros_subscriber,
+                                 const ros::NodeHandle& pnh) :
+  pnh_(pnh),
   flag_publish_(false),
   is_ros_subscriber_(is_ros_subscriber) {
 
@@ -78,11 +81,13 @@ void RawDataStreamPa::initialize() {
 
     if (is_ros_subscriber_) {
         ROS_INFO("Subscribing to raw data stream.");
-        static ros::Subscriber subscriber =
+        subscriber_ =
           nh_.subscribe ("raw_data_stream", 100,
             &RawDataStreamPa::msgCallback, this);
     } else if (flag_publish_) {
         ROS_INFO("Publishing raw data stream.");
+        publisher_ =
+          pnh_.advertise<std_msgs::UInt8MultiArray>("raw_data_stream", 100);
         RawDataStreamPa::publishMsg(std::string());
     }
 
@@ -172,10 +177,8 @@ std_msgs::UInt8MultiArray RawDataStreamPa::str2uint8(
 
 void RawDataStreamPa::publishMsg(const std::string str) {
 
-    static ros::Publisher publisher =
-      pnh_.advertise<std_msgs::UInt8MultiArray>("raw_data_stream", 100);
-
-    publisher.publish(RawDataStreamPa::str2uint8(str));
+    publisher_.publish(boost::make_shared<std_msgs::UInt8MultiArray>(
+      RawDataStreamPa::str2uint8(str)));
 }
 
 void RawDataStreamPa::saveToFile(const std::string str) {
@@ -0,0 +1,90 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <ublox_gps/serial_options.h>
+
+#ifdef __linux__
+// termios2 and BOTHER, must not be mixed with <termios.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace ublox_gps {
+
+#ifdef __linux__
+
+bool setCustomBaudrate(int fd, unsigned int baudrate) {
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) < 0)
+    return false;
+  tio.c_cflag &= ~CBAUD;
+  tio.c_cflag |= BOTHER;
+  tio.c_ispeed = baudrate;
+  tio.c_ospeed = baudrate;
+  return ioctl(fd, TCSETS2, &tio) == 0;
+}
+
+bool getCustomBaudrate(int fd, unsigned int &baudrate) {
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) < 0)
+    return false;
+  baudrate = tio.c_ospeed;
+  return true;
+}
+
+bool setLowLatency(int fd) {
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) == 0) {
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    ioctl(fd, TCSETS2, &tio);
+  }
+
+  struct serial_struct serial;
+  if (ioctl(fd, TIOCGSERIAL, &serial) < 0)
+    return false;
+  serial.flags |= ASYNC_LOW_LATENCY;
+  return ioctl(fd, TIOCSSERIAL, &serial) == 0;
+}
+
+#else
+
+bool setCustomBaudrate(int /* fd */, unsigned int /* baudrate */) {
+  return false;
+}
+
+bool getCustomBaudrate(int /* fd */, unsigned int & /* baudrate */) {
+  return false;
+}
+
+bool setLowLatency(int /* fd */) { return false; }
+
+#endif
+
+}  // namespace ublox_gps
@@ -37,11 +37,34 @@
 ///
 /// This file declares custom serializers for u-blox messages with dynamic 
 /// lengths and messages where the get/set messages have different sizes, but
-/// share the same parameters, such as CfgDAT.
+/// share the same parameters, such as CfgDAT. The serializers of all other
+/// messages are generated at build time.
 ///
 
 namespace ublox {
 
+/**
+ * @brief Decode the repeated blocks which follow the fixed part of a message.
+ *
+ * @details The size of all blocks is checked once before the vector is
+ * resized, then BlockReader decodes them in one pass per field instead of
+ * one deserialize call per block.
+ * @param stream the stream positioned at the first block
+ * @param n the number of blocks
+ * @param blocks the output blocks
+ */
+template <typename Vector>
+inline void readBlocks(ros::serialization::IStream &stream, uint32_t n,
+                       Vector &blocks) {
+  typedef BlockReader<typename Vector::value_type> Reader;
+  if (static_cast<uint64_t>(n) * Reader::kSize > stream.getLength())
+    ros::serialization::throwStreamOverrun();
+  const uint8_t *data = stream.advance(n * Reader::kSize);
+  blocks.resize(n);
+  if (n > 0)
+    Reader::read(data, n, &blocks[0]);
+}
+
 ///
 /// @brief Serializes the CfgDAT message which has a different length for 
 /// get/set.
@@ -329,9 +352,7 @@ struct Serializer<ublox_msgs::NavSAT_<ContainerAllocator> > {
     stream.next(m.version);
     stream.next(m.numSvs);
     stream.next(m.reserved0);
-    m.sv.resize(m.numSvs);
-    for(std::size_t i = 0; i < m.sv.size(); ++i) 
-      ros::serialization::deserialize(stream, m.sv[i]);
+    readBlocks(stream, m.numSvs, m.sv);
   }
 
   static uint32_t serializedLength (typename CallTraits::param_type m) {
@@ -449,9 +470,7 @@ struct Serializer<ublox_msgs::RxmRAWX_<ContainerAllocator> > {
     stream.next(m.recStat);
     stream.next(m.version);
     stream.next(m.reserved1);
-    m.meas.resize(m.numMeas);
-    for(std::size_t i = 0; i < m.meas.size(); ++i) 
-      ros::serialization::deserialize(stream, m.meas[i]);
+    readBlocks(stream, m.numMeas, m.meas);
   }
 
   static uint32_t serializedLength (typename CallTraits::param_type m) {
@@ -495,9 +514,7 @@ struct Serializer<ublox_msgs::RxmSFRBX_<ContainerAllocator> > {
     stream.next(m.chn);
     stream.next(m.version);
     stream.next(m.reserved1);
-    m.dwrd.resize(m.numWords);
-    for(std::size_t i = 0; i < m.dwrd.size(); ++i) 
-      ros::serialization::deserialize(stream, m.dwrd[i]);
+    readBlocks(stream, m.numWords, m.dwrd);
   }
 
   static uint32_t serializedLength (typename CallTraits::param_type m) {
@@ -902,10 +919,7 @@ struct Serializer<ublox_msgs::OBSVM_<ContainerAllocator> > {
     stream.next(m.Leap_sec);
     stream.next(m.DelayMs);
     stream.next(m.obs_num);
-   
-    m.meas.resize(m.obs_num);
-    for(std::size_t i = 0; i < m.meas.size(); ++i) 
-      ros::serialization::deserialize(stream, m.meas[i]);
+    readBlocks(stream, m.obs_num, m.meas);
   }
 
   static uint32_t serializedLength (typename CallTraits::param_type m) {
@@ -939,4 +953,8 @@ struct Serializer<ublox_msgs::OBSVM_<ContainerAllocator> > {
 
 } // namespace ublox
 
+// Serializers of the messages with a fixed size, generated from the message
+// definitions by scripts/generate_serializers.py
+#include <ublox_msgs/serializers.h>
+
 #endif // UBLOX_SERIALIZATION_UBLOX_MSGS_H
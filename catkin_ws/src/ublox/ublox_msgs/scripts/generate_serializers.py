@@ -0,0 +1,278 @@
+#!/usr/bin/env python
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the Flight Systems and Automatic Control group,
+#       TU Darmstadt, nor the names of its contributors may be used to
+#       endorse or promote products derived from this software without
+#       specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+"""Generate the serializers of the messages with a fixed size.
+
+The ROS serialization reads a message field by field through an IStream,
+which checks the bounds of every field. The generated serializers check the
+size once and then load every field from its offset, which is computed here
+from the .msg file. Messages with a custom serializer are skipped.
+
+The blocks of the variable length arrays also get a BlockReader, which the
+custom serializers use to decode all blocks one field at a time.
+
+Usage: generate_serializers.py OUTPUT MSG_DIR CUSTOM_SERIALIZERS_HEADER
+"""
+
+import re
+import sys
+
+from msg_layout import PRIMITIVES, layout, messages, write
+
+CUSTOM = re.compile(r'struct\s+Serializer\s*<\s*ublox_msgs::(\w+)_<')
+
+
+def custom_serializers(header):
+    with open(header) as f:
+        return set(CUSTOM.findall(f.read()))
+
+
+def offsets(spec):
+    lines = [
+        '//! The offsets of the %s fields' % spec.name,
+        'struct %s {' % spec.name,
+    ]
+    for field, offset, size in spec.layout:
+        lines.append('  static constexpr uint32_t %s = %d;' %
+                     (field.name, offset))
+    lines += [
+        '  //! The size of the message',
+        '  static constexpr uint32_t kSize = %d;' % spec.size,
+        '};',
+        '',
+    ]
+    return lines
+
+
+def element(field, index):
+    """Get the offset expression and the member of an element of a field."""
+    if index is None:
+        return 'Layout::%s' % field.name, 'm.%s' % field.name
+    return ('Layout::%s + %s' % (field.name, index),
+            'm.%s[%s]' % (field.name, index))
+
+
+def read_field(field, size):
+    index = None if field.array is None else 'i'
+    if index:
+        index = 'i * %d' % size if size > 1 else 'i'
+    offset, member = element(field, index)
+    member = member.replace('[i * %d]' % size, '[i]')
+    if field.type_name in PRIMITIVES:
+        if field.array is not None and size == 1:
+            return ['    memcpy(&m.%s[0], data + Layout::%s, %d);' %
+                    (field.name, field.name, field.array)]
+        statement = '%s = load<%s>(data + %s);' % (
+            member, PRIMITIVES[field.type_name][0], offset)
+    else:
+        statement = ('Serializer<ublox_msgs::%s_<ContainerAllocator> >::read('
+                     'data + %s, %d, %s);' % (field.type_name, offset, size,
+                                              member))
+    if field.array is None:
+        return ['    ' + statement]
+    return ['    for (uint32_t i = 0; i < %d; ++i)' % field.array,
+            '      ' + statement]
+
+
+def write_field(field, size):
+    index = None if field.array is None else 'i'
+    if index:
+        index = 'i * %d' % size if size > 1 else 'i'
+    offset, member = element(field, index)
+    member = member.replace('[i * %d]' % size, '[i]')
+    if field.type_name in PRIMITIVES:
+        if field.array is not None and size == 1:
+            return ['    memcpy(data + Layout::%s, &m.%s[0], %d);' %
+                    (field.name, field.name, field.array)]
+        statement = 'store<%s>(data + %s, %s);' % (
+            PRIMITIVES[field.type_name][0], offset, member)
+    else:
+        statement = ('Serializer<ublox_msgs::%s_<ContainerAllocator> >::write('
+                     'data + %s, %d, %s);' % (field.type_name, offset, size,
+                                              member))
+    if field.array is None:
+        return ['    ' + statement]
+    return ['    for (uint32_t i = 0; i < %d; ++i)' % field.array,
+            '      ' + statement]
+
+
+def serializer(spec):
+    lines = [
+        '///',
+        '/// @brief Serializes the %s message which has a fixed size.' %
+        spec.name,
+        '///',
+        'template <typename ContainerAllocator>',
+        'struct Serializer<ublox_msgs::%s_<ContainerAllocator> > {' %
+        spec.name,
+        '  typedef ublox_msgs::%s_<ContainerAllocator> Msg;' % spec.name,
+        '  typedef boost::call_traits<Msg> CallTraits;',
+        '  typedef ublox_msgs::layout::%s Layout;' % spec.name,
+        '',
+        '  static void read(const uint8_t *data, uint32_t count,',
+        '                   typename CallTraits::reference m) {',
+        '    if (count < Layout::kSize)',
+        '      ros::serialization::throwStreamOverrun();',
+    ]
+    for field, offset, size in spec.layout:
+        lines += read_field(field, size)
+    lines += [
+        '  }',
+        '',
+        '  static uint32_t serializedLength(typename CallTraits::param_type m) {',
+        '    return Layout::kSize;',
+        '  }',
+        '',
+        '  static void write(uint8_t *data, uint32_t size,',
+        '                    typename CallTraits::param_type m) {',
+        '    if (size < Layout::kSize)',
+        '      ros::serialization::throwStreamOverrun();',
+    ]
+    for field, offset, size in spec.layout:
+        lines += write_field(field, size)
+    lines += [
+        '  }',
+        '};',
+        '',
+    ]
+    return lines
+
+
+def block_reader(spec):
+    """Generate the reader of an array of blocks, which decodes the fields
+    of all blocks one field at a time."""
+    lines = [
+        '///',
+        '/// @brief Decodes an array of %s blocks.' % spec.name,
+        '///',
+        'template <typename ContainerAllocator>',
+        'struct BlockReader<ublox_msgs::%s_<ContainerAllocator> > {' %
+        spec.name,
+        '  typedef ublox_msgs::%s_<ContainerAllocator> Block;' % spec.name,
+        '  typedef ublox_msgs::layout::%s Layout;' % spec.name,
+        '  static const uint32_t kSize = Layout::kSize;',
+        '',
+        '  static void read(const uint8_t *data, uint32_t n, Block *blocks) {',
+    ]
+    nested = []
+    for field, offset, size in spec.layout:
+        if field.type_name in PRIMITIVES and field.array is None:
+            lines.append('    loadColumn(data + Layout::%s, n, kSize, blocks, '
+                         '&Block::%s);' % (field.name, field.name))
+        else:
+            nested.append((field, size))
+    if nested:
+        # Arrays and nested messages are read block by block
+        lines += [
+            '    for (uint32_t j = 0; j < n; ++j) {',
+            '      const uint8_t *block = data + j * kSize;',
+            '      Block &m = blocks[j];',
+        ]
+        for field, size in nested:
+            lines += ['  ' + line.replace('(data + ', '(block + ')
+                      .replace('data + Layout', 'block + Layout')
+                      for line in read_field(field, size)]
+        lines.append('    }')
+    lines += [
+        '  }',
+        '};',
+        '',
+    ]
+    return lines
+
+
+def main(argv):
+    if len(argv) != 4:
+        sys.stderr.write(__doc__)
+        return 1
+    output, msg_dir, header = argv[1:]
+    custom = custom_serializers(header)
+    specs = {}
+    for name in messages(msg_dir):
+        layout(msg_dir, specs, name)
+    names = [name for name in sorted(specs) if name not in custom and
+             specs[name].fixed and not specs[name].repeated]
+    # The blocks of the variable length arrays with a generated serializer
+    blocks = sorted(set(
+        spec.repeated[0].type_name for spec in specs.values()
+        if spec.repeated and spec.repeated[0].type_name in names))
+
+    lines = [
+        '// Generated by generate_serializers.py from the ublox_msgs message',
+        '// definitions. Do not edit.',
+        '',
+        '#ifndef UBLOX_MSGS_SERIALIZERS_H',
+        '#define UBLOX_MSGS_SERIALIZERS_H',
+        '',
+        '#include <stdint.h>',
+        '#include <string.h>',
+        '#include <ros/serialization.h>',
+        '#include <ublox/serialization.h>',
+        '#include <ublox/view.h>',
+        '',
+    ]
+    lines += ['#include <ublox_msgs/%s.h>' % name for name in names]
+    lines += [
+        '',
+        '//! Calls X with the name of every message with a generated serializer',
+        '#define UBLOX_MSGS_FIXED_SIZE_MESSAGES(X) \\',
+    ]
+    lines += ['  X(%s) \\' % name for name in names]
+    lines += [
+        '',
+        'namespace ublox_msgs {',
+        'namespace layout {',
+        '',
+    ]
+    for name in names:
+        lines += offsets(specs[name])
+    lines += [
+        '}  // namespace layout',
+        '}  // namespace ublox_msgs',
+        '',
+        'namespace ublox {',
+        '',
+    ]
+    for name in names:
+        lines += serializer(specs[name])
+    for name in blocks:
+        lines += block_reader(specs[name])
+    lines += [
+        '}  // namespace ublox',
+        '',
+        '#endif  // UBLOX_MSGS_SERIALIZERS_H',
+        '',
+    ]
+    write(output, lines)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,195 @@
+#!/usr/bin/env python
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the Flight Systems and Automatic Control group,
+#       TU Darmstadt, nor the names of its contributors may be used to
+#       endorse or promote products derived from this software without
+#       specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Generate read-only views of fixed layout messages.
+
+A view reads the fields of a message directly from the little endian bytes
+of a received frame, at offsets computed here from the .msg file. The fixed
+part of a message ends with the first variable length array, which must be
+an array of another message with a fixed layout, e.g. the measurements of
+OBSVM.
+
+Usage: generate_views.py OUTPUT MSG_DIR MESSAGE...
+"""
+
+import sys
+
+from msg_layout import PRIMITIVES, layout, write
+
+
+def cpp_type(field):
+    if field.type_name in PRIMITIVES:
+        return PRIMITIVES[field.type_name][0]
+    return field.type_name + 'View'
+
+
+def accessor(field, offset, size):
+    if field.type_name in PRIMITIVES:
+        read = 'ublox::load<%s>(data_ + %%s)' % cpp_type(field)
+    else:
+        read = '%s(data_ + %%s, %d)' % (cpp_type(field), size)
+    lines = []
+    if field.array is None:
+        lines.append('  %s %s() const { return %s; }' %
+                     (cpp_type(field), field.name, read % offset))
+    else:
+        lines.append('  %s %s(uint32_t i) const { return %s; }' %
+                     (cpp_type(field), field.name,
+                      read % ('%d + i' % offset if size == 1 else
+                              '%d + i * %d' % (offset, size))))
+        lines.append('  static uint32_t %s_size() { return %d; }' %
+                     (field.name, field.array))
+        if size == 1 and field.type_name in PRIMITIVES:
+            lines.append('  const uint8_t *%s_data() const '
+                         '{ return data_ + %d; }' % (field.name, offset))
+    return lines
+
+
+def generate(spec):
+    name = spec.name + 'View'
+    lines = [
+        '/**',
+        ' * @brief Read-only view of the %s message.' % spec.name,
+        ' */',
+        'class %s {' % name,
+        ' public:',
+    ]
+    # Enumerators like in the ROS messages, they do not need a definition
+    ids = ['%s = %su' % (constant, spec.constants[constant][1])
+           for constant in ('CLASS_ID', 'MESSAGE_ID')
+           if constant in spec.constants]
+    if ids:
+        lines.append('  enum { %s };' % ', '.join(ids))
+    lines += [
+        '  //! The size of the fixed part of the message',
+        '  static const uint32_t kFixedSize = %d;' % spec.size,
+        '',
+        '  /**',
+        '   * @param data the first byte of the message',
+        '   * @param size the number of bytes of the message',
+        '   */',
+        '  %s(const uint8_t *data, uint32_t size) : data_(data), '
+        'size_(size) {}' % name,
+        '',
+        '  //! View the message in a frame found by the Framer',
+        '  explicit %s(const ublox::FrameView &frame) :' % name,
+        '      data_(ublox::messageData(frame)), '
+        'size_(ublox::messageLength(frame)) {}',
+        '',
+        '  //! Whether the message is long enough for the fixed part',
+        '  bool valid() const { return size_ >= kFixedSize; }',
+        '  const uint8_t *data() const { return data_; }',
+        '  uint32_t size() const { return size_; }',
+        '',
+    ]
+    for field, offset, size in spec.layout:
+        lines += accessor(field, offset, size)
+    if spec.repeated:
+        field, size = spec.repeated
+        lines += [
+            '',
+            '  //! The number of %s elements which fit into the message' %
+            field.name,
+            '  uint32_t %s_capacity() const {' % field.name,
+            '    return size_ < kFixedSize ? 0 : (size_ - kFixedSize) / %d;' %
+            size,
+            '  }',
+            '  %s %s(uint32_t i) const {' % (cpp_type(field), field.name),
+            ('    return ublox::load<%s>(data_ + kFixedSize + i * %d);' %
+             (cpp_type(field), size)
+             if field.type_name in PRIMITIVES else
+             '    return %s(data_ + kFixedSize + i * %d, %d);' %
+             (cpp_type(field), size, size)),
+            '  }',
+        ]
+    lines += [
+        '',
+        ' private:',
+        '  //! The first byte of the message',
+        '  const uint8_t *data_;',
+        '  //! The number of bytes of the message',
+        '  uint32_t size_;',
+        '};',
+        '',
+    ]
+    return lines
+
+
+def main(argv):
+    if len(argv) < 4:
+        sys.stderr.write(__doc__)
+        return 1
+    output, msg_dir, names = argv[1], argv[2], argv[3:]
+    specs = {}
+    order = []
+
+    def visit(name):
+        spec = layout(msg_dir, specs, name)
+        if not spec.fixed:
+            raise ValueError('%s does not have a fixed layout' % name)
+        if name in order:
+            return
+        # Nested messages first
+        for field in spec.fields:
+            if field.type_name not in PRIMITIVES:
+                visit(field.type_name)
+        order.append(name)
+
+    for name in names:
+        visit(name)
+
+    lines = [
+        '// Generated by generate_views.py from the ublox_msgs message '
+        'definitions.',
+        '// Do not edit.',
+        '',
+        '#ifndef UBLOX_MSGS_VIEWS_H',
+        '#define UBLOX_MSGS_VIEWS_H',
+        '',
+        '#include <stdint.h>',
+        '#include <ublox/view.h>',
+        '',
+        'namespace ublox_msgs {',
+        '',
+    ]
+    for name in order:
+        lines += generate(specs[name])
+    lines += [
+        '}  // namespace ublox_msgs',
+        '',
+        '#endif  // UBLOX_MSGS_VIEWS_H',
+        '',
+    ]
+
+    write(output, lines)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,153 @@
+# Software License Agreement (BSD License)
+#
+# Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the Flight Systems and Automatic Control group,
+#       TU Darmstadt, nor the names of its contributors may be used to
+#       endorse or promote products derived from this software without
+#       specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+# DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+# ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Compute the wire layout of the ublox_msgs message definitions.
+
+The messages are transmitted little endian without padding, so the offset of
+a field is the sum of the sizes of the fields before it. The fixed part of a
+message ends with the first variable length array.
+"""
+
+import os
+import re
+
+# The C++ type and size of the primitive types
+PRIMITIVES = {
+    'bool': ('uint8_t', 1),
+    'byte': ('int8_t', 1),
+    'char': ('uint8_t', 1),
+    'int8': ('int8_t', 1),
+    'uint8': ('uint8_t', 1),
+    'int16': ('int16_t', 2),
+    'uint16': ('uint16_t', 2),
+    'int32': ('int32_t', 4),
+    'uint32': ('uint32_t', 4),
+    'int64': ('int64_t', 8),
+    'uint64': ('uint64_t', 8),
+    'float32': ('float', 4),
+    'float64': ('double', 8),
+}
+
+FIELD = re.compile(r'^([\w/]+)(?:\[(\d*)\])?\s+(\w+)\s*$')
+CONSTANT = re.compile(r'^(\w+)\s+(\w+)\s*=\s*(\S+)')
+
+
+class Field(object):
+    def __init__(self, type_name, array, name):
+        self.type_name = type_name
+        # None for scalars, 0 for variable length arrays
+        self.array = array
+        self.name = name
+
+
+class Spec(object):
+    """The definition and layout of a message.
+
+    layout is the list of (field, offset, element size) of the fixed part,
+    repeated is (field, element size) of the variable length array which
+    follows it or None. size is the size of the fixed part. fixed is false if
+    the message contains a field without a fixed size, e.g. a string, or a
+    field after the variable length array; the layout is not valid then.
+    """
+
+    def __init__(self, name, fields, constants):
+        self.name = name
+        self.fields = fields
+        self.constants = constants
+        self.layout = []
+        self.repeated = None
+        self.size = 0
+        self.fixed = True
+
+
+def parse(msg_dir, name):
+    fields = []
+    constants = {}
+    with open(os.path.join(msg_dir, name + '.msg')) as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            match = CONSTANT.match(line)
+            if match:
+                constants[match.group(2)] = (match.group(1), match.group(3))
+                continue
+            match = FIELD.match(line)
+            if not match:
+                raise ValueError('%s: can not parse "%s"' % (name, line))
+            array = match.group(2)
+            if array is not None:
+                array = int(array) if array else 0
+            fields.append(Field(match.group(1), array, match.group(3)))
+    return Spec(name, fields, constants)
+
+
+def layout(msg_dir, specs, name):
+    """Get the definition and layout of the message, cached in specs."""
+    if name in specs:
+        return specs[name]
+    spec = parse(msg_dir, name)
+    specs[name] = spec
+    offset = 0
+    for field in spec.fields:
+        if spec.repeated:
+            spec.fixed = False
+            break
+        if field.type_name in PRIMITIVES:
+            size = PRIMITIVES[field.type_name][1]
+        elif os.path.exists(os.path.join(msg_dir, field.type_name + '.msg')):
+            nested = layout(msg_dir, specs, field.type_name)
+            if not nested.fixed or nested.repeated:
+                spec.fixed = False
+                break
+            size = nested.size
+        else:
+            # string, time, duration or a message of another package
+            spec.fixed = False
+            break
+        if field.array == 0:
+            spec.repeated = (field, size)
+            continue
+        spec.layout.append((field, offset, size))
+        offset += size * (field.array or 1)
+    spec.size = offset
+    return spec
+
+
+def messages(msg_dir):
+    """Get the names of all messages in the directory."""
+    return sorted(os.path.splitext(f)[0] for f in os.listdir(msg_dir)
+                  if f.endswith('.msg'))
+
+
+def write(output, lines):
+    directory = os.path.dirname(output)
+    if directory and not os.path.isdir(directory):
+        os.makedirs(directory)
+    with open(output, 'w') as f:
+        f.write('\n'.join(lines))
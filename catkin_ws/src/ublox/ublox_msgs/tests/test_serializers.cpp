@@ -0,0 +1,146 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include <ublox/serialization/ublox_msgs.h>
+
+namespace {
+
+/**
+ * @brief Encode a message with the ROS serialization.
+ */
+template <typename T>
+std::vector<uint8_t> rosSerialize(const T &message) {
+  std::vector<uint8_t> buffer(
+      ros::serialization::Serializer<T>::serializedLength(message));
+  ros::serialization::OStream stream(buffer.data(), buffer.size());
+  ros::serialization::Serializer<T>::write(stream, message);
+  return buffer;
+}
+
+/**
+ * @brief Check the generated serializer of the message type against the ROS
+ * serialization, which the serializers used before, with random payloads.
+ */
+template <typename T>
+void checkParity(const char *name) {
+  typedef ublox::Serializer<T> Serializer;
+  const uint32_t size = Serializer::serializedLength(T());
+  ASSERT_EQ(ros::serialization::serializationLength(T()), size) << name;
+
+  for (int round = 0; round < 16; ++round) {
+    // A longer payload is accepted, the rest is ignored
+    std::vector<uint8_t> payload(size + round % 2);
+    for (size_t i = 0; i < payload.size(); ++i)
+      payload[i] = std::rand();
+
+    T expected;
+    ros::serialization::IStream stream(payload.data(), payload.size());
+    ros::serialization::Serializer<T>::read(stream, expected);
+    T message;
+    Serializer::read(payload.data(), payload.size(), message);
+    EXPECT_EQ(rosSerialize(message), rosSerialize(expected)) << name;
+
+    std::vector<uint8_t> encoded(size);
+    Serializer::write(encoded.data(), encoded.size(), expected);
+    EXPECT_EQ(encoded, rosSerialize(expected)) << name;
+  }
+
+  if (size > 0) {
+    std::vector<uint8_t> payload(size - 1);
+    T message;
+    EXPECT_THROW(Serializer::read(payload.data(), payload.size(), message),
+                 ros::serialization::StreamOverrunException) << name;
+  }
+}
+
+}  // namespace
+
+TEST(Serializers, ParityWithRosSerialization)
+{
+#define CHECK_PARITY(name) checkParity<ublox_msgs::name>(#name);
+  UBLOX_MSGS_FIXED_SIZE_MESSAGES(CHECK_PARITY)
+#undef CHECK_PARITY
+}
+
+TEST(Serializers, RepeatedBlocks)
+{
+  // NavSAT with 3 satellites, each block is decoded like a single message
+  const uint32_t kHeader = 8, kBlock = 12, kCount = 3;
+  std::vector<uint8_t> payload(kHeader + kCount * kBlock);
+  for (size_t i = 0; i < payload.size(); ++i)
+    payload[i] = std::rand();
+  payload[5] = kCount;
+
+  ublox_msgs::NavSAT message;
+  ublox::Serializer<ublox_msgs::NavSAT>::read(payload.data(), payload.size(),
+                                              message);
+  ASSERT_EQ(message.sv.size(), kCount);
+  for (uint32_t i = 0; i < kCount; ++i) {
+    ublox_msgs::NavSAT_SV expected;
+    ublox::Serializer<ublox_msgs::NavSAT_SV>::read(
+        payload.data() + kHeader + i * kBlock, kBlock, expected);
+    EXPECT_EQ(rosSerialize(message.sv[i]), rosSerialize(expected));
+  }
+
+  // Arrays of primitive values
+  std::vector<uint8_t> sfrbx(8 + 4 * 10);
+  for (size_t i = 0; i < sfrbx.size(); ++i)
+    sfrbx[i] = i;
+  sfrbx[4] = 10;
+  ublox_msgs::RxmSFRBX words;
+  ublox::Serializer<ublox_msgs::RxmSFRBX>::read(sfrbx.data(), sfrbx.size(),
+                                                words);
+  ASSERT_EQ(words.dwrd.size(), 10u);
+  EXPECT_EQ(words.dwrd[9], 0x2f2e2d2cu);
+
+  // More blocks than the payload holds
+  payload[5] = kCount + 1;
+  EXPECT_THROW(ublox::Serializer<ublox_msgs::NavSAT>::read(
+                   payload.data(), payload.size(), message),
+               ros::serialization::StreamOverrunException);
+}
+
+TEST(Serializers, NavPvtLayout)
+{
+  // Offsets from the u-blox 8 protocol specification
+  EXPECT_EQ(ublox_msgs::layout::NavPVT::kSize, 92u);
+  EXPECT_EQ(ublox_msgs::layout::NavPVT::lat, 28u);
+  EXPECT_EQ(ublox_msgs::layout::NavPVT::heading, 64u);
+  EXPECT_EQ(ublox_msgs::layout::NavRELPOSNED9::kSize, 64u);
+  EXPECT_EQ(ublox_msgs::layout::BESTPOS::kSize, 97u);
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
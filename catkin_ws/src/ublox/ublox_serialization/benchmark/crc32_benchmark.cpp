@@ -0,0 +1,175 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//
+// Compares every CRC32 kernel against the byte-wise table loop.
+//
+// Usage: crc32_benchmark [raw_log ...]
+//
+// Each argument is a raw byte stream recorded from a Unicore receiver, e.g. the
+// files written by the raw data logger or by the driver with debug >= 4. Every
+// complete binary frame with a valid CRC is extracted and used as input. When
+// no files are given, synthetic BESTPOS, AGRIC and OBSVM frames are used.
+//
+
+#include <ublox/crc32.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace ublox;
+
+namespace {
+
+//! A frame without its trailing CRC
+typedef std::vector<uint8_t> Frame;
+
+/**
+ * @brief Extract the Unicore binary frames with a valid CRC from a raw log.
+ */
+void extractFrames(const std::vector<uint8_t> &log, std::vector<Frame> &frames) {
+  size_t i = 0;
+  while (i + 10 <= log.size()) {
+    if (log[i] != 0xAA || log[i + 1] != 0x44 ||
+        (log[i + 2] != 0x12 && log[i + 2] != 0xB5)) {
+      ++i;
+      continue;
+    }
+    size_t header, length;
+    if (log[i + 2] == 0x12) {
+      header = 28;
+      length = log[i + 8] | (log[i + 9] << 8);
+    } else {
+      header = 24;
+      length = log[i + 6] | (log[i + 7] << 8);
+    }
+    size_t size = header + length;
+    if (i + size + 4 > log.size())
+      break;
+    uint32_t crc;
+    memcpy(&crc, &log[i + size], 4);
+    if (crc32::updateTable(0, &log[i], size) != crc) {
+      ++i;
+      continue;
+    }
+    frames.push_back(Frame(log.begin() + i, log.begin() + i + size));
+    i += size + 4;
+  }
+}
+
+/**
+ * @brief Build frames with the sizes of the messages the driver enables.
+ */
+void syntheticFrames(std::vector<Frame> &frames) {
+  // BESTPOSB, AGRICB, OBSVMB with 20, 60 and 100 observations
+  const size_t sizes[] = { 28 + 72, 24 + 232, 24 + 4 + 20 * 40,
+                           24 + 4 + 60 * 40, 24 + 4 + 100 * 40 };
+  srand(0);
+  for (int repeat = 0; repeat < 20; ++repeat) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+      Frame frame(sizes[s]);
+      for (size_t i = 0; i < frame.size(); ++i)
+        frame[i] = static_cast<uint8_t>(rand());
+      frame[0] = 0xAA;
+      frame[1] = 0x44;
+      frame[2] = 0xB5;
+      frames.push_back(frame);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<Frame> frames;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Could not open %s\n", argv[i]);
+      return 1;
+    }
+    std::vector<uint8_t> log((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    extractFrames(log, frames);
+  }
+  if (argc > 1 && frames.empty()) {
+    fprintf(stderr, "No valid Unicore frames found\n");
+    return 1;
+  }
+  if (frames.empty())
+    syntheticFrames(frames);
+
+  size_t bytes = 0;
+  std::vector<uint32_t> expected(frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    bytes += frames[i].size();
+    expected[i] = crc32::updateTable(0, frames[i].data(), frames[i].size());
+  }
+  printf("%zu frames, %zu bytes, %s input, active kernel: %s\n",
+         frames.size(), bytes, argc > 1 ? "recorded" : "synthetic",
+         crc32::kernelName(crc32::activeKernel()));
+
+  // Repeat the whole set until about 256 MB have been processed per kernel
+  const size_t iterations = (256u << 20) / bytes + 1;
+  double baseline = 0;
+  for (int k = 0; k < crc32::KERNEL_COUNT; ++k) {
+    crc32::Kernel kernel = static_cast<crc32::Kernel>(k);
+    crc32::UpdateFunction update = crc32::kernelFunction(kernel);
+    if (!update || !crc32::isSupported(kernel)) {
+      printf("%-12s not supported\n", crc32::kernelName(kernel));
+      continue;
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+      if (update(0, frames[i].data(), frames[i].size()) != expected[i]) {
+        printf("%-12s MISMATCH on frame %zu\n", crc32::kernelName(kernel), i);
+        return 1;
+      }
+    }
+
+    uint32_t sink = 0;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    for (size_t n = 0; n < iterations; ++n)
+      for (size_t i = 0; i < frames.size(); ++i)
+        sink ^= update(0, frames[i].data(), frames[i].size());
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    double mbps = iterations * bytes / seconds / (1 << 20);
+    if (kernel == crc32::KERNEL_TABLE)
+      baseline = mbps;
+    printf("%-12s %9.1f MB/s  %5.2fx  %7.1f ns/frame  (%08x)\n",
+           crc32::kernelName(kernel), mbps, mbps / baseline,
+           seconds * 1e9 / (iterations * frames.size()), sink);
+  }
+  return 0;
+}
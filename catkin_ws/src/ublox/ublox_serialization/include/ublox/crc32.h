@@ -0,0 +1,442 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_CRC32_H
+#define UBLOX_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UBLOX_CRC32_HAVE_PCLMUL 1
+#include <cpuid.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_CRC32) || defined(__clang__) || __GNUC__ >= 10)
+#define UBLOX_CRC32_HAVE_ARMV8 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#if defined(__clang__)
+#define UBLOX_CRC32_ARMV8_TARGET __attribute__((target("crc")))
+#else
+#define UBLOX_CRC32_ARMV8_TARGET __attribute__((target("+crc")))
+#endif
+#endif
+
+///
+/// This file implements the CRC-32 engine used to validate Unicore frames.
+/// Unicore frames use the reflected 0xEDB88320 polynomial with a zero initial
+/// value and no final XOR, so every kernel below works on the raw CRC register
+/// and can be called incrementally on consecutive chunks of a frame.
+///
+/// The engine selects the fastest kernel supported by the CPU the first time
+/// it is used: PCLMULQDQ folding on x86, the ARMv8 CRC32 instructions on
+/// AArch64 and slicing-by-16 tables everywhere else.
+///
+
+namespace ublox {
+namespace crc32 {
+
+//! CRC-32 kernel implementations
+enum Kernel {
+  KERNEL_TABLE,        //!< Byte-wise table loop, the reference implementation
+  KERNEL_SLICE_BY_8,   //!< Slicing-by-8 tables
+  KERNEL_SLICE_BY_16,  //!< Slicing-by-16 tables
+  KERNEL_PCLMUL,       //!< x86 carry-less multiplication folding
+  KERNEL_ARMV8,        //!< ARMv8 CRC32 instructions
+  KERNEL_COUNT
+};
+
+//! Signature of a kernel: returns the CRC register after processing the data
+typedef uint32_t (*UpdateFunction)(uint32_t crc, const uint8_t *data,
+                                   size_t size);
+
+//! Minimum length for which the folding kernel beats the tables
+static const size_t kPclmulMinLength = 64;
+
+/**
+ * @brief Lookup tables for the byte-wise and slicing kernels.
+ *
+ * @details table[0] is the classic byte-wise table, table[k] advances a byte
+ * through k additional zero bytes.
+ */
+struct Tables {
+  Tables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j)
+        crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i)
+      for (int k = 1; k < 16; ++k)
+        table[k][i] = (table[k - 1][i] >> 8) ^
+                      table[0][table[k - 1][i] & 0xFF];
+  }
+
+  uint32_t table[16][256];
+};
+
+/**
+ * @brief Get the lookup tables, built once on first use.
+ */
+inline const Tables &tables() {
+  static const Tables instance;
+  return instance;
+}
+
+/**
+ * @brief Reference kernel, processes one byte per iteration.
+ */
+inline uint32_t updateTable(uint32_t crc, const uint8_t *data, size_t size) {
+  const uint32_t *table = tables().table[0];
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc;
+}
+
+/**
+ * @brief Slicing-by-8 kernel, processes 8 bytes per iteration.
+ */
+inline uint32_t updateSliceBy8(uint32_t crc, const uint8_t *data,
+                               size_t size) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const Tables &t = tables();
+  while (size >= 8) {
+    uint32_t one, two;
+    memcpy(&one, data, 4);
+    memcpy(&two, data + 4, 4);
+    one ^= crc;
+    crc = t.table[7][one & 0xFF] ^ t.table[6][(one >> 8) & 0xFF] ^
+          t.table[5][(one >> 16) & 0xFF] ^ t.table[4][one >> 24] ^
+          t.table[3][two & 0xFF] ^ t.table[2][(two >> 8) & 0xFF] ^
+          t.table[1][(two >> 16) & 0xFF] ^ t.table[0][two >> 24];
+    data += 8;
+    size -= 8;
+  }
+#endif
+  return updateTable(crc, data, size);
+}
+
+/**
+ * @brief Slicing-by-16 kernel, processes 16 bytes per iteration.
+ */
+inline uint32_t updateSliceBy16(uint32_t crc, const uint8_t *data,
+                                size_t size) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const Tables &t = tables();
+  while (size >= 16) {
+    uint32_t w[4];
+    memcpy(w, data, 16);
+    w[0] ^= crc;
+    crc = t.table[15][w[0] & 0xFF] ^ t.table[14][(w[0] >> 8) & 0xFF] ^
+          t.table[13][(w[0] >> 16) & 0xFF] ^ t.table[12][w[0] >> 24] ^
+          t.table[11][w[1] & 0xFF] ^ t.table[10][(w[1] >> 8) & 0xFF] ^
+          t.table[9][(w[1] >> 16) & 0xFF] ^ t.table[8][w[1] >> 24] ^
+          t.table[7][w[2] & 0xFF] ^ t.table[6][(w[2] >> 8) & 0xFF] ^
+          t.table[5][(w[2] >> 16) & 0xFF] ^ t.table[4][w[2] >> 24] ^
+          t.table[3][w[3] & 0xFF] ^ t.table[2][(w[3] >> 8) & 0xFF] ^
+          t.table[1][(w[3] >> 16) & 0xFF] ^ t.table[0][w[3] >> 24];
+    data += 16;
+    size -= 16;
+  }
+#endif
+  return updateSliceBy8(crc, data, size);
+}
+
+#ifdef UBLOX_CRC32_HAVE_PCLMUL
+/**
+ * @brief Fold 16-byte blocks with carry-less multiplication and reduce with
+ * Barrett reduction.
+ *
+ * @details Follows "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction" (Intel, 2009) with the bit-reflected constants for
+ * 0xEDB88320.
+ * @param size must be a multiple of 16 and at least kPclmulMinLength
+ */
+__attribute__((target("sse4.1,pclmul")))
+inline uint32_t foldPclmul(uint32_t crc, const uint8_t *data, size_t size) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00));
+  x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10));
+  x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20));
+  x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+  data += 64;
+  size -= 64;
+
+  // Fold four lanes in parallel
+  x0 = k1k2;
+  while (size >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + 0x30)));
+    data += 64;
+    size -= 64;
+  }
+
+  // Fold the four lanes into one
+  x0 = k3k4;
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // Fold the remaining 16 byte blocks
+  while (size >= 16) {
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    data += 16;
+    size -= 16;
+  }
+
+  // Fold 128 bits to 64 bits
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = k5k0;
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits
+  x0 = poly;
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+/**
+ * @brief PCLMULQDQ kernel, falls back to the tables for short inputs and for
+ * the tail which is not a multiple of 16 bytes.
+ */
+inline uint32_t updatePclmul(uint32_t crc, const uint8_t *data, size_t size) {
+  if (size >= kPclmulMinLength) {
+    size_t chunk = size & ~static_cast<size_t>(15);
+    crc = foldPclmul(crc, data, chunk);
+    data += chunk;
+    size -= chunk;
+  }
+  return updateSliceBy16(crc, data, size);
+}
+#endif
+
+#ifdef UBLOX_CRC32_HAVE_ARMV8
+/**
+ * @brief ARMv8 kernel using the CRC32B/W/X instructions, which implement the
+ * same reflected polynomial without pre or post inversion.
+ */
+UBLOX_CRC32_ARMV8_TARGET
+inline uint32_t updateArmv8(uint32_t crc, const uint8_t *data, size_t size) {
+  while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+    crc = __crc32b(crc, *data++);
+    --size;
+  }
+  while (size >= 32) {
+    uint64_t w[4];
+    memcpy(w, data, 32);
+    crc = __crc32d(crc, w[0]);
+    crc = __crc32d(crc, w[1]);
+    crc = __crc32d(crc, w[2]);
+    crc = __crc32d(crc, w[3]);
+    data += 32;
+    size -= 32;
+  }
+  while (size >= 8) {
+    uint64_t w;
+    memcpy(&w, data, 8);
+    crc = __crc32d(crc, w);
+    data += 8;
+    size -= 8;
+  }
+  while (size > 0) {
+    crc = __crc32b(crc, *data++);
+    --size;
+  }
+  return crc;
+}
+#endif
+
+/**
+ * @brief Whether the given kernel can run on this CPU.
+ */
+inline bool isSupported(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_TABLE:
+    case KERNEL_SLICE_BY_8:
+    case KERNEL_SLICE_BY_16:
+      return true;
+    case KERNEL_PCLMUL: {
+#ifdef UBLOX_CRC32_HAVE_PCLMUL
+      unsigned int eax, ebx, ecx, edx;
+      if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+      return (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+#else
+      return false;
+#endif
+    }
+    case KERNEL_ARMV8: {
+#if defined(UBLOX_CRC32_HAVE_ARMV8) && defined(__ARM_FEATURE_CRC32)
+      return true;
+#elif defined(UBLOX_CRC32_HAVE_ARMV8) && defined(__linux__)
+      return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+      return false;
+#endif
+    }
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Get the implementation of the given kernel.
+ * @return the kernel function, or 0 if it is not compiled in
+ */
+inline UpdateFunction kernelFunction(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_TABLE: return &updateTable;
+    case KERNEL_SLICE_BY_8: return &updateSliceBy8;
+    case KERNEL_SLICE_BY_16: return &updateSliceBy16;
+#ifdef UBLOX_CRC32_HAVE_PCLMUL
+    case KERNEL_PCLMUL: return &updatePclmul;
+#endif
+#ifdef UBLOX_CRC32_HAVE_ARMV8
+    case KERNEL_ARMV8: return &updateArmv8;
+#endif
+    default: return 0;
+  }
+}
+
+/**
+ * @brief Get a human readable name of the kernel.
+ */
+inline const char *kernelName(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_TABLE: return "table";
+    case KERNEL_SLICE_BY_8: return "slice-by-8";
+    case KERNEL_SLICE_BY_16: return "slice-by-16";
+    case KERNEL_PCLMUL: return "pclmul";
+    case KERNEL_ARMV8: return "armv8";
+    default: return "unknown";
+  }
+}
+
+/**
+ * @brief Select the fastest kernel supported by this CPU.
+ */
+inline Kernel bestKernel() {
+  if (isSupported(KERNEL_ARMV8) && kernelFunction(KERNEL_ARMV8))
+    return KERNEL_ARMV8;
+  if (isSupported(KERNEL_PCLMUL) && kernelFunction(KERNEL_PCLMUL))
+    return KERNEL_PCLMUL;
+  return KERNEL_SLICE_BY_16;
+}
+
+/**
+ * @brief The kernel currently used by update().
+ */
+inline Kernel &activeKernel() {
+  static Kernel kernel = bestKernel();
+  return kernel;
+}
+
+/**
+ * @brief The kernel function currently used by update().
+ */
+inline UpdateFunction &activeFunction() {
+  static UpdateFunction function = kernelFunction(activeKernel());
+  return function;
+}
+
+/**
+ * @brief Force the engine to use the given kernel.
+ *
+ * @details Intended for tests and benchmarks. Must not be called while other
+ * threads are computing CRCs.
+ * @return false if the kernel is not supported on this CPU
+ */
+inline bool setKernel(Kernel kernel) {
+  if (!isSupported(kernel) || !kernelFunction(kernel)) return false;
+  activeKernel() = kernel;
+  activeFunction() = kernelFunction(kernel);
+  return true;
+}
+
+/**
+ * @brief Continue a CRC computation over the given data.
+ * @param crc the CRC register of the previous chunk, 0 for a new frame
+ * @param data the start of the data
+ * @param size the number of bytes
+ * @return the CRC register after processing the data
+ */
+inline uint32_t update(uint32_t crc, const uint8_t *data, size_t size) {
+  return activeFunction()(crc, data, size);
+}
+
+} // namespace crc32
+} // namespace ublox
+
+#endif // UBLOX_CRC32_H
@@ -0,0 +1,519 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_FRAMER_H
+#define UBLOX_FRAMER_H
+
+#include <stdint.h>
+
+#include "checksum.h"
+#include "sync_scan.h"
+
+///
+/// This file defines the Framer which splits a byte stream carrying several
+/// protocols at once into frames. It recognizes u-blox UBX, Unicore binary
+/// (UMBIN 0xAA 0x44 0x12 and UMOEM 0xAA 0x44 0xB5), Unicore ASCII, NMEA and
+/// RTCM 3 frames in a single pass, so every byte of the stream is classified
+/// exactly once and no protocol rescans the bytes of another.
+///
+
+namespace ublox {
+
+//! The protocols recognized by the Framer
+enum Protocol {
+  PROTOCOL_UBX,            //!< u-blox binary, 0xB5 0x62
+  PROTOCOL_UNICORE_BIN,    //!< Unicore binary with 28 byte header, 0xAA 0x44 0x12
+  PROTOCOL_UNICORE_OEM,    //!< Unicore binary with 24 byte header, 0xAA 0x44 0xB5
+  PROTOCOL_UNICORE_ASCII,  //!< Unicore ASCII message, '#' ... '\n'
+  PROTOCOL_NMEA,           //!< NMEA sentence or command response, '$' ... '\n'
+  PROTOCOL_RTCM3,          //!< RTCM 3 message, 0xD3
+  PROTOCOL_COUNT
+};
+
+/**
+ * @brief Describes a complete frame in the read buffer.
+ *
+ * @details The header fields are decoded once by the Framer, so dispatching
+ * and deserializing the frame does not parse the header again. The view does
+ * not own the bytes, it is valid until the bytes are consumed from the read
+ * buffer. It is not modified after next() returned it.
+ */
+struct FrameView {
+  //! The protocol of the frame
+  Protocol protocol;
+  //! The start of the frame, i.e. the first sync character
+  const uint8_t *data;
+  //! The size of the frame including header and checksum or line terminator
+  uint32_t size;
+  //! The UBX class ID or the third Unicore sync character, 0 for other
+  //! protocols
+  uint8_t class_id;
+  //! The UBX or Unicore message ID or the RTCM 3 message number, 0 for text
+  //! frames
+  uint32_t message_id;
+  //! The number of bytes before the payload
+  uint32_t header_length;
+  //! The start of the payload
+  const uint8_t *payload;
+  //! The number of bytes in the payload, for text frames the whole line
+  uint32_t payload_length;
+  //! The checksum transmitted with a binary frame or a NMEA sentence, 0 for
+  //! other text frames
+  uint32_t checksum;
+  //! The receive time of the read which completed the frame in seconds
+  double stamp;
+};
+
+/**
+ * @brief Splits a stream of mixed protocol data into frames.
+ *
+ * @details Binary frames are delimited by the length in their header, text
+ * frames by the line feed. The checksum of binary frames is verified and the
+ * header is decoded into a FrameView here, so the code which dispatches and
+ * decodes the frame does not need to. Bytes which do not
+ * belong to any frame are skipped and counted.
+ *
+ * NMEA sentences which end with a checksum *hh are verified as well.
+ *
+ * A frame with a wrong checksum is not returned. Its length field may be
+ * corrupt, so its size can not be trusted to find the next frame: the search
+ * continues at the byte after its first sync character. Any frame hidden in
+ * the discarded bytes is found again and confirmed by its own checksum, so a
+ * corrupt header costs one frame instead of all frames it claims to cover.
+ *
+ * The framer is persistent: if the buffer ends inside a frame, it remembers
+ * how far the frame was scanned and checksummed. When the next read is passed
+ * in with reset(), it continues where it stopped, so every byte is scanned
+ * and checksummed exactly once regardless of how the stream is split.
+ */
+class Framer {
+ public:
+  typedef const uint8_t *iterator;
+
+  /**
+   * @param max_payload_length frames with a longer payload or text frames
+   * which are longer are treated as garbage
+   */
+  explicit Framer(uint32_t max_payload_length) :
+      data_(0), count_(0), max_payload_length_(max_payload_length),
+      skipped_(0), discarded_(0), frames_(0), checksum_errors_(0),
+      stamp_(0.0),
+      pending_(false) {}
+
+  /**
+   * @brief Construct a framer for a single buffer.
+   * @param data a buffer containing the received bytes
+   * @param count the size of the buffer
+   * @param max_payload_length see above
+   */
+  Framer(const uint8_t *data, uint32_t count, uint32_t max_payload_length) :
+      data_(data), count_(count), max_payload_length_(max_payload_length),
+      skipped_(0), discarded_(0), frames_(0), checksum_errors_(0),
+      stamp_(0.0),
+      pending_(false) {}
+
+  /**
+   * @brief Continue with the next read.
+   * @param data the received bytes, must start with the bytes which were left
+   * at pos() by the previous call to next()
+   * @param count the number of bytes
+   * @param stamp the receive time of the bytes, copied to the frames which
+   * are completed by them
+   */
+  void reset(const uint8_t *data, uint32_t count, double stamp = 0.0) {
+    data_ = data;
+    count_ = count;
+    skipped_ = 0;
+    stamp_ = stamp;
+    // The pending frame is gone if the caller dropped its bytes
+    if (pending_ && (count_ < processed_ || data_[0] != sync_))
+      pending_ = false;
+  }
+
+  //! Forget the frame in progress, e.g. after the stream was reopened
+  void clear() { pending_ = false; }
+
+  /**
+   * @brief Get the next complete frame in the buffer.
+   * @param frame the frame output
+   * @return true if a frame was found, false if the rest of the buffer does
+   * not contain a complete frame. In this case pos() points to the start of
+   * the incomplete frame, which must be passed again to reset() together with
+   * the next received bytes.
+   */
+  bool next(FrameView &frame) {
+    while (count_ > 0) {
+      if (!pending_) {
+        if (!sync::isFrameStart(data_[0])) {
+          skip(sync::findStart(data_, data_ + count_) - data_);
+          continue;
+        }
+        uint32_t size;
+        Result result = start(size);
+        if (result == INCOMPLETE)
+          return false;
+        if (result == GARBAGE) {
+          skip(size);
+          continue;
+        }
+      }
+      uint32_t size;
+      Result result = resume(size);
+      if (result == INCOMPLETE)
+        return false;
+      pending_ = false;
+      if (result == GARBAGE) {
+        skip(size);
+        continue;
+      }
+      if (result == BAD_CHECKSUM) {
+        // Resynchronize after the sync character
+        ++checksum_errors_;
+        skip(1);
+        continue;
+      }
+      describe(frame, size);
+      data_ += size; count_ -= size;
+      ++frames_;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Get the current position in the read buffer.
+   * @return the start of the first byte which was not consumed
+   */
+  iterator pos() const { return data_; }
+
+  iterator end() const { return data_ + count_; }
+
+  /**
+   * @brief Get the number of bytes which did not belong to any frame since
+   * the last reset.
+   */
+  uint32_t skipped() const { return skipped_; }
+
+  /**
+   * @brief Get the total number of bytes which did not belong to any frame.
+   */
+  uint64_t discarded() const { return discarded_; }
+
+  /**
+   * @brief Get the total number of frames which were found.
+   */
+  uint64_t frames() const { return frames_; }
+
+  /**
+   * @brief Get the total number of frames which were dropped because of a
+   * wrong checksum.
+   */
+  uint64_t checksumErrors() const { return checksum_errors_; }
+
+ private:
+  //! The result of matching a frame at the current position
+  enum Result { FRAME, BAD_CHECKSUM, INCOMPLETE, GARBAGE };
+
+  //! Whether the given byte may appear in a text frame
+  static bool isText(uint8_t c) {
+    return (c >= 0x20 && c < 0x7F) || c == '\r';
+  }
+
+  void skip(uint32_t size) {
+    data_ += size; count_ -= size; skipped_ += size; discarded_ += size;
+  }
+
+  /**
+   * @brief Match the header of a frame at the current position and start
+   * tracking it.
+   * @param size the number of bytes to skip if the result is GARBAGE
+   * @return FRAME if the header is valid, INCOMPLETE if the header was not
+   * completely received or GARBAGE
+   */
+  Result start(uint32_t &size) {
+    size = 1;
+    switch (data_[0]) {
+      case 0xB5:
+        return startBinary(PROTOCOL_UBX, 0x62, 0, 6, 4, 2);
+      case 0xAA:
+        if (count_ < 3) return INCOMPLETE;
+        if (data_[2] == 0x12)
+          return startBinary(PROTOCOL_UNICORE_BIN, 0x44, 0x12, 28, 8, 4);
+        if (data_[2] == 0xB5)
+          return startBinary(PROTOCOL_UNICORE_OEM, 0x44, 0xB5, 24, 6, 4);
+        return GARBAGE;
+      case 0xD3: {
+        if (count_ < 3) return INCOMPLETE;
+        if (data_[1] & 0xFC) return GARBAGE;
+        uint32_t length = ((data_[1] & 0x03) << 8) | data_[2];
+        begin(PROTOCOL_RTCM3, length + 6, 3, 3, 0);
+        return FRAME;
+      }
+      default:
+        begin(data_[0] == '$' ? PROTOCOL_NMEA : PROTOCOL_UNICORE_ASCII, 0, 0, 0,
+              1);
+        return FRAME;
+    }
+  }
+
+  /**
+   * @brief Match the header of a binary frame with a little endian 16 bit
+   * length field.
+   * @param sync_b the second sync character
+   * @param sync_c the third sync character, 0 if there is none
+   * @param header_length the number of bytes before the payload
+   * @param length_offset the offset of the length field
+   * @param checksum_length the number of checksum bytes after the payload
+   */
+  Result startBinary(Protocol type, uint8_t sync_b, uint8_t sync_c,
+                     uint32_t header_length, uint32_t length_offset,
+                     uint32_t checksum_length) {
+    if (count_ < 2) return INCOMPLETE;
+    if (data_[1] != sync_b) return GARBAGE;
+    if (sync_c && data_[2] != sync_c) return GARBAGE;
+    if (count_ < length_offset + 2) return INCOMPLETE;
+    uint32_t length = data_[length_offset] | (data_[length_offset + 1] << 8);
+    if (length > max_payload_length_) return GARBAGE;
+    // The UBX checksum does not cover the sync characters
+    begin(type, header_length + length + checksum_length, header_length,
+          checksum_length, type == PROTOCOL_UBX ? 2 : 0);
+    return FRAME;
+  }
+
+  /**
+   * @brief Start tracking a frame at the current position.
+   * @param size the size of the frame, 0 for text frames
+   * @param header_length the number of bytes before the payload
+   * @param checksum_length the number of checksum bytes at the end
+   * @param processed the offset at which the checksum or the search for the
+   * line feed starts
+   */
+  void begin(Protocol protocol, uint32_t size, uint32_t header_length,
+             uint32_t checksum_length, uint32_t processed) {
+    pending_ = true;
+    protocol_ = protocol;
+    sync_ = data_[0];
+    size_ = size;
+    header_length_ = header_length;
+    checksum_length_ = checksum_length;
+    processed_ = processed;
+    crc_ = 0;
+    ck_a_ = 0;
+    ck_b_ = 0;
+  }
+
+  /**
+   * @brief Decode the header of the frame at the current position.
+   * @param frame the frame output
+   * @param size the size of the frame
+   */
+  void describe(FrameView &frame, uint32_t size) const {
+    frame.protocol = protocol_;
+    frame.data = data_;
+    frame.size = size;
+    frame.stamp = stamp_;
+    frame.header_length = header_length_;
+    frame.payload = data_ + header_length_;
+    frame.payload_length = size - header_length_ - checksum_length_;
+    const uint8_t *checksum = frame.payload + frame.payload_length;
+    switch (protocol_) {
+      case PROTOCOL_UBX:
+        frame.class_id = data_[2];
+        frame.message_id = data_[3];
+        frame.checksum = checksum[0] | (checksum[1] << 8);
+        break;
+      case PROTOCOL_UNICORE_BIN:
+      case PROTOCOL_UNICORE_OEM:
+        frame.class_id = data_[2];
+        frame.message_id = data_[4] | (data_[5] << 8);
+        frame.checksum = checksum[0] | (checksum[1] << 8) |
+            (checksum[2] << 16) | (static_cast<uint32_t>(checksum[3]) << 24);
+        break;
+      case PROTOCOL_RTCM3:
+        frame.class_id = 0;
+        // The message number is the first 12 bits of the payload
+        frame.message_id = frame.payload_length < 2 ? 0 :
+            (frame.payload[0] << 4) | (frame.payload[1] >> 4);
+        frame.checksum = (checksum[0] << 16) | (checksum[1] << 8) | checksum[2];
+        break;
+      default:
+        frame.class_id = 0;
+        frame.message_id = 0;
+        // Parsed by checkText()
+        frame.checksum = crc_;
+        break;
+    }
+  }
+
+  /**
+   * @brief Continue the frame in progress with the bytes received so far.
+   * @param size the size of the frame, or the number of bytes to skip if the
+   * result is GARBAGE
+   * @return FRAME, BAD_CHECKSUM or INCOMPLETE if the frame was not completely
+   * received, GARBAGE for text frames which contain binary data
+   */
+  Result resume(uint32_t &size) {
+    if (size_ == 0) return resumeText(size);
+
+    // Checksum the bytes which were not seen before
+    uint32_t checked = size_ - checksum_length_;
+    uint32_t available = count_ < checked ? count_ : checked;
+    if (available > processed_) {
+      const uint8_t *data = data_ + processed_;
+      uint32_t count = available - processed_;
+      switch (protocol_) {
+        case PROTOCOL_UBX:
+          for (uint32_t i = 0; i < count; ++i) {
+            ck_a_ = ck_a_ + data[i];
+            ck_b_ = ck_b_ + ck_a_;
+          }
+          break;
+        case PROTOCOL_RTCM3:
+          crc_ = calculateCrc24q(data, count, crc_);
+          break;
+        default:
+          crc_ = crc32::update(crc_, data, count);
+          break;
+      }
+      processed_ = available;
+    }
+    if (count_ < size_) return INCOMPLETE;
+
+    size = size_;
+    const uint8_t *checksum = data_ + checked;
+    switch (protocol_) {
+      case PROTOCOL_UBX:
+        return checksum[0] == ck_a_ && checksum[1] == ck_b_ ?
+            FRAME : BAD_CHECKSUM;
+      case PROTOCOL_RTCM3:
+        return static_cast<uint32_t>((checksum[0] << 16) | (checksum[1] << 8) |
+                                     checksum[2]) == crc_ ?
+            FRAME : BAD_CHECKSUM;
+      default:
+        return (checksum[0] | (checksum[1] << 8) | (checksum[2] << 16) |
+                (static_cast<uint32_t>(checksum[3]) << 24)) == crc_ ?
+            FRAME : BAD_CHECKSUM;
+    }
+  }
+
+  /**
+   * @brief Continue the search for the line feed which ends a text frame.
+   *
+   * @details If a byte which is not printable is found before the line feed,
+   * the partial line is garbage, e.g. a sentence cut off by a binary frame.
+   */
+  Result resumeText(uint32_t &size) {
+    uint32_t limit = count_ < max_payload_length_ ? count_ : max_payload_length_;
+    for (uint32_t i = processed_; i < limit; ++i) {
+      if (data_[i] == '\n') {
+        size = i + 1;
+        return checkText(size);
+      }
+      if (!isText(data_[i])) {
+        size = i;
+        return GARBAGE;
+      }
+    }
+    if (limit == count_ && count_ < max_payload_length_) {
+      processed_ = limit;
+      return INCOMPLETE;
+    }
+    size = limit;
+    return GARBAGE;
+  }
+
+  //! Get the value of a hex digit, or -1 if the character is none
+  static int hexDigit(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+
+  /**
+   * @brief Verify the checksum of a complete NMEA sentence if it has one.
+   * @param size the size of the line including the line terminator
+   */
+  Result checkText(uint32_t size) {
+    crc_ = 0;
+    if (protocol_ != PROTOCOL_NMEA)
+      return FRAME;
+    uint32_t end = size - 1;
+    if (end > 0 && data_[end - 1] == '\r')
+      --end;
+    if (end < 4 || data_[end - 3] != '*')
+      return FRAME;
+    int high = hexDigit(data_[end - 2]), low = hexDigit(data_[end - 1]);
+    if (high < 0 || low < 0)
+      return FRAME;
+    crc_ = (high << 4) | low;
+    return calculateNmeaChecksum(data_ + 1, end - 4) == crc_ ?
+        FRAME : BAD_CHECKSUM;
+  }
+
+  //! The current position in the buffer
+  const uint8_t *data_;
+  //! The number of bytes left in the buffer
+  uint32_t count_;
+  //! The maximum payload length of binary frames and length of text frames
+  uint32_t max_payload_length_;
+  //! The number of bytes which did not belong to any frame since the reset
+  uint32_t skipped_;
+  //! The total number of bytes which did not belong to any frame
+  uint64_t discarded_;
+  //! The total number of frames which were found
+  uint64_t frames_;
+  //! The total number of frames with a wrong checksum
+  uint64_t checksum_errors_;
+  //! The receive time of the bytes passed to reset()
+  double stamp_;
+
+  //! Whether a frame is in progress at the current position
+  bool pending_;
+  //! The protocol of the frame in progress
+  Protocol protocol_;
+  //! The first sync character of the frame in progress
+  uint8_t sync_;
+  //! The size of the frame in progress, 0 for text frames
+  uint32_t size_;
+  //! The number of bytes before the payload of the frame in progress
+  uint32_t header_length_;
+  //! The number of checksum bytes at the end of the frame in progress
+  uint32_t checksum_length_;
+  //! The offset up to which the frame in progress was checksummed or scanned
+  uint32_t processed_;
+  //! The CRC of the frame in progress, or the checksum transmitted with a
+  //! NMEA sentence
+  uint32_t crc_;
+  //! The UBX checksum of the frame in progress
+  uint8_t ck_a_, ck_b_;
+};
+
+} // namespace ublox
+
+#endif // UBLOX_FRAMER_H
@@ -0,0 +1,526 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+
+#ifndef UBLOX_NMEA_H
+#define UBLOX_NMEA_H
+
+#include <stdint.h>
+#include <limits>
+
+#include <boost/utility/string_ref.hpp>
+
+///
+/// This file declares a decoder of the NMEA sentences GGA, RMC, GST, HDT, VTG
+/// and GSV and of the responses of Unicore receivers to commands. A sentence
+/// is split into fields in place, the fields point into
+/// the sentence and the numbers are parsed directly from them, so decoding
+/// does not allocate. Fields which are empty in the sentence are decoded as
+/// NaN.
+///
+
+namespace ublox {
+
+//! The NMEA sentences which can be decoded
+enum NmeaType {
+  NMEA_UNKNOWN,
+  NMEA_GGA,
+  NMEA_RMC,
+  NMEA_GST,
+  NMEA_HDT,
+  NMEA_VTG,
+  NMEA_GSV
+};
+
+//! Meters per second in a knot
+static const double kKnotsToMps = 1852.0 / 3600.0;
+
+/**
+ * @brief Splits a NMEA sentence into its comma separated fields.
+ */
+class NmeaFields {
+ public:
+  //! The maximum number of fields of a sentence, further fields are ignored
+  static const uint32_t kMaxFields = 32;
+
+  NmeaFields() : size_(0) {}
+
+  /**
+   * @brief Split the sentence.
+   * @param sentence the sentence starting with '$', the checksum and the line
+   * terminator are not part of any field
+   * @return false if the sentence does not start with '$'
+   */
+  bool split(boost::string_ref sentence) {
+    size_ = 0;
+    if (sentence.empty() || sentence[0] != '$')
+      return false;
+    const char *begin = sentence.data() + 1;
+    const char *end = sentence.data() + sentence.size();
+    while (end > begin && (end[-1] == '\n' || end[-1] == '\r'))
+      --end;
+    for (const char *c = begin; c != end; ++c) {
+      if (*c == '*') {
+        end = c;
+        break;
+      }
+    }
+    const char *field = begin;
+    for (const char *c = begin; size_ < kMaxFields; ++c) {
+      if (c == end || *c == ',') {
+        fields_[size_++] = boost::string_ref(field, c - field);
+        if (c == end)
+          break;
+        field = c + 1;
+      }
+    }
+    return true;
+  }
+
+  //! Get the number of fields including the address field
+  uint32_t size() const { return size_; }
+
+  /**
+   * @brief Get a field, the address field, e.g. GPGGA, is field 0.
+   * @return the field or an empty field if the sentence has fewer fields
+   */
+  boost::string_ref operator[](uint32_t i) const {
+    return i < size_ ? fields_[i] : boost::string_ref();
+  }
+
+  //! Get the talker ID of the sentence, e.g. GP
+  boost::string_ref talker() const {
+    return size_ > 0 && fields_[0].size() == 5 ?
+        fields_[0].substr(0, 2) : boost::string_ref();
+  }
+
+  //! Get the type of the sentence
+  NmeaType type() const {
+    if (size_ == 0 || fields_[0].size() != 5)
+      return NMEA_UNKNOWN;
+    boost::string_ref formatter = fields_[0].substr(2);
+    if (formatter == "GGA") return NMEA_GGA;
+    if (formatter == "RMC") return NMEA_RMC;
+    if (formatter == "GST") return NMEA_GST;
+    if (formatter == "HDT") return NMEA_HDT;
+    if (formatter == "VTG") return NMEA_VTG;
+    if (formatter == "GSV") return NMEA_GSV;
+    return NMEA_UNKNOWN;
+  }
+
+ private:
+  //! The fields, they point into the sentence
+  boost::string_ref fields_[kMaxFields];
+  //! The number of fields
+  uint32_t size_;
+};
+
+/**
+ * @brief Parse an unsigned decimal integer.
+ * @param field the field
+ * @param value the output value, unchanged if the field is invalid
+ * @return false if the field is empty or not a number
+ */
+inline bool parseNmea(boost::string_ref field, uint32_t &value) {
+  if (field.empty() || field.size() > 9)
+    return false;
+  uint32_t result = 0;
+  for (size_t i = 0; i < field.size(); ++i) {
+    uint32_t digit = static_cast<uint8_t>(field[i]) - '0';
+    if (digit > 9)
+      return false;
+    result = result * 10 + digit;
+  }
+  value = result;
+  return true;
+}
+
+/**
+ * @brief Parse a decimal number with an optional sign and fraction.
+ *
+ * @details The digits are accumulated as an integer and scaled once, which
+ * is exact for the up to 15 significant digits of NMEA fields. Digits
+ * beyond 18 are ignored.
+ * @param field the field
+ * @param value the output value, NaN if the field is empty
+ * @return false if the field is empty or not a number
+ */
+inline bool parseNmea(boost::string_ref field, double &value) {
+  static const double kScale[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+  };
+  value = std::numeric_limits<double>::quiet_NaN();
+  size_t i = 0;
+  bool negative = false;
+  if (!field.empty() && (field[0] == '-' || field[0] == '+')) {
+    negative = field[0] == '-';
+    ++i;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0, fraction = -1;
+  for (; i < field.size(); ++i) {
+    if (field[i] == '.' && fraction < 0) {
+      fraction = 0;
+      continue;
+    }
+    uint32_t digit = static_cast<uint8_t>(field[i]) - '0';
+    if (digit > 9)
+      return false;
+    if (digits == 18) {
+      // Only integer digits change the magnitude
+      if (fraction < 0)
+        return false;
+      continue;
+    }
+    mantissa = mantissa * 10 + digit;
+    ++digits;
+    if (fraction >= 0)
+      ++fraction;
+  }
+  if (digits == 0)
+    return false;
+  value = static_cast<double>(mantissa);
+  if (fraction > 0)
+    value /= kScale[fraction];
+  if (negative)
+    value = -value;
+  return true;
+}
+
+/**
+ * @brief Parse a latitude or longitude, e.g. 4807.038,N.
+ * @param field the angle in the format (d)ddmm.mmmm
+ * @param hemisphere N, S, E or W
+ * @param degrees the output angle in degrees, negative in the south and
+ * west, NaN if the field is empty
+ */
+inline bool parseNmeaAngle(boost::string_ref field,
+                           boost::string_ref hemisphere, double &degrees) {
+  double value;
+  if (!parseNmea(field, value) || hemisphere.size() != 1) {
+    degrees = std::numeric_limits<double>::quiet_NaN();
+    return false;
+  }
+  double whole = static_cast<double>(static_cast<int64_t>(value / 100));
+  degrees = whole + (value - whole * 100) / 60;
+  if (hemisphere[0] == 'S' || hemisphere[0] == 'W')
+    degrees = -degrees;
+  return true;
+}
+
+/**
+ * @brief Parse a UTC time of day, e.g. 123519.00.
+ * @param field the time in the format hhmmss.ss
+ * @param seconds the output seconds since midnight, NaN if the field is
+ * empty
+ */
+inline bool parseNmeaTime(boost::string_ref field, double &seconds) {
+  double value;
+  if (!parseNmea(field, value)) {
+    seconds = std::numeric_limits<double>::quiet_NaN();
+    return false;
+  }
+  uint32_t hhmm = static_cast<uint32_t>(value / 100);
+  seconds = (hhmm / 100) * 3600.0 + (hhmm % 100) * 60.0 + (value - hhmm * 100);
+  return true;
+}
+
+//! Global positioning system fix data
+struct NmeaGGA {
+  //! UTC time of day [s]
+  double time;
+  //! Latitude [deg]
+  double latitude;
+  //! Longitude [deg]
+  double longitude;
+  //! Fix quality, 0 no fix, 1 GNSS, 2 DGNSS, 4 RTK fixed, 5 RTK float, ...
+  uint32_t quality;
+  //! Number of satellites used
+  uint32_t num_satellites;
+  //! Horizontal dilution of precision
+  double hdop;
+  //! Altitude above mean sea level [m]
+  double altitude;
+  //! Height of the geoid above the ellipsoid [m]
+  double geoid_separation;
+  //! Age of the differential corrections [s]
+  double age;
+};
+
+//! Recommended minimum specific GNSS data
+struct NmeaRMC {
+  //! UTC time of day [s]
+  double time;
+  //! Whether the data is valid, i.e. the status is A
+  bool valid;
+  //! Latitude [deg]
+  double latitude;
+  //! Longitude [deg]
+  double longitude;
+  //! Speed over ground [m/s]
+  double speed;
+  //! Course over ground, true [deg]
+  double course;
+  //! UTC date as ddmmyy
+  uint32_t date;
+  //! Mode indicator, e.g. A autonomous, D differential, 0 if not present
+  char mode;
+};
+
+//! Pseudorange error statistics
+struct NmeaGST {
+  //! UTC time of day [s]
+  double time;
+  //! RMS of the pseudorange residuals [m]
+  double rms;
+  //! Standard deviation of the semi-major axis of the error ellipse [m]
+  double sigma_major;
+  //! Standard deviation of the semi-minor axis of the error ellipse [m]
+  double sigma_minor;
+  //! Orientation of the semi-major axis, true [deg]
+  double orientation;
+  //! Standard deviation of the latitude error [m]
+  double sigma_latitude;
+  //! Standard deviation of the longitude error [m]
+  double sigma_longitude;
+  //! Standard deviation of the altitude error [m]
+  double sigma_altitude;
+};
+
+//! True heading
+struct NmeaHDT {
+  //! Heading, true [deg]
+  double heading;
+};
+
+//! Course over ground and ground speed
+struct NmeaVTG {
+  //! Course over ground, true [deg]
+  double course;
+  //! Course over ground, magnetic [deg]
+  double course_magnetic;
+  //! Speed over ground [m/s]
+  double speed;
+  //! Mode indicator, e.g. A autonomous, N not valid, 0 if not present
+  char mode;
+};
+
+//! GNSS satellites in view, one of several sentences
+struct NmeaGSV {
+  //! The maximum number of satellites in a sentence
+  static const uint32_t kMaxSatellites = 4;
+
+  //! A satellite in view
+  struct Satellite {
+    //! Satellite ID, numbered as defined by NMEA for the talker
+    uint32_t id;
+    //! Elevation [deg]
+    double elevation;
+    //! Azimuth, true [deg]
+    double azimuth;
+    //! Signal to noise ratio [dB-Hz], NaN if not tracked
+    double snr;
+  };
+
+  //! The number of sentences of this cycle
+  uint32_t num_sentences;
+  //! The number of this sentence, starting with 1
+  uint32_t sentence;
+  //! The number of satellites in view in all sentences
+  uint32_t num_in_view;
+  //! The number of satellites in this sentence
+  uint32_t num_satellites;
+  //! The satellites of this sentence
+  Satellite satellites[kMaxSatellites];
+};
+
+/**
+ * @brief Get the mode indicator of a field or 0 if it is absent.
+ */
+inline char nmeaMode(boost::string_ref field) {
+  return field.size() == 1 ? field[0] : 0;
+}
+
+/**
+ * @brief Decode a GGA sentence.
+ * @return false if the sentence has too few fields or no fix quality
+ */
+inline bool decodeNmea(const NmeaFields &f, NmeaGGA &m) {
+  if (f.size() < 15)
+    return false;
+  parseNmeaTime(f[1], m.time);
+  parseNmeaAngle(f[2], f[3], m.latitude);
+  parseNmeaAngle(f[4], f[5], m.longitude);
+  m.num_satellites = 0;
+  parseNmea(f[7], m.num_satellites);
+  parseNmea(f[8], m.hdop);
+  parseNmea(f[9], m.altitude);
+  parseNmea(f[11], m.geoid_separation);
+  parseNmea(f[13], m.age);
+  return parseNmea(f[6], m.quality);
+}
+
+/**
+ * @brief Decode a RMC sentence.
+ * @return false if the sentence has too few fields
+ */
+inline bool decodeNmea(const NmeaFields &f, NmeaRMC &m) {
+  if (f.size() < 12)
+    return false;
+  parseNmeaTime(f[1], m.time);
+  m.valid = f[2] == "A";
+  parseNmeaAngle(f[3], f[4], m.latitude);
+  parseNmeaAngle(f[5], f[6], m.longitude);
+  if (parseNmea(f[7], m.speed))
+    m.speed *= kKnotsToMps;
+  parseNmea(f[8], m.course);
+  m.date = 0;
+  parseNmea(f[9], m.date);
+  m.mode = nmeaMode(f[12]);
+  return true;
+}
+
+/**
+ * @brief Decode a GST sentence.
+ * @return false if the sentence has too few fields
+ */
+inline bool decodeNmea(const NmeaFields &f, NmeaGST &m) {
+  if (f.size() < 9)
+    return false;
+  parseNmeaTime(f[1], m.time);
+  parseNmea(f[2], m.rms);
+  parseNmea(f[3], m.sigma_major);
+  parseNmea(f[4], m.sigma_minor);
+  parseNmea(f[5], m.orientation);
+  parseNmea(f[6], m.sigma_latitude);
+  parseNmea(f[7], m.sigma_longitude);
+  parseNmea(f[8], m.sigma_altitude);
+  return true;
+}
+
+/**
+ * @brief Decode a HDT sentence.
+ * @return false if the sentence has no heading
+ */
+inline bool decodeNmea(const NmeaFields &f, NmeaHDT &m) {
+  return parseNmea(f[1], m.heading);
+}
+
+/**
+ * @brief Decode a VTG sentence.
+ * @return false if the sentence has too few fields
+ */
+inline bool decodeNmea(const NmeaFields &f, NmeaVTG &m) {
+  if (f.size() < 9)
+    return false;
+  parseNmea(f[1], m.course);
+  parseNmea(f[3], m.course_magnetic);
+  // Prefer the speed in km/h, it has more resolution
+  if (parseNmea(f[7], m.speed))
+    m.speed /= 3.6;
+  else if (parseNmea(f[5], m.speed))
+    m.speed *= kKnotsToMps;
+  m.mode = nmeaMode(f[9]);
+  return true;
+}
+
+/**
+ * @brief Decode a GSV sentence.
+ * @return false if the sentence has too few fields or no sentence numbers
+ */
+inline bool decodeNmea(const NmeaFields &f, NmeaGSV &m) {
+  if (f.size() < 4 || !parseNmea(f[1], m.num_sentences) ||
+      !parseNmea(f[2], m.sentence) || !parseNmea(f[3], m.num_in_view))
+    return false;
+  // NMEA 4.1 appends the signal ID, which makes the number of fields odd
+  uint32_t fields = f.size() - 4 - (f.size() % 4 == 1 ? 1 : 0);
+  m.num_satellites = 0;
+  for (uint32_t i = 0; i < fields / 4 && i < NmeaGSV::kMaxSatellites; ++i) {
+    NmeaGSV::Satellite &satellite = m.satellites[m.num_satellites];
+    const uint32_t field = 4 + i * 4;
+    if (!parseNmea(f[field], satellite.id))
+      continue;
+    parseNmea(f[field + 1], satellite.elevation);
+    parseNmea(f[field + 2], satellite.azimuth);
+    parseNmea(f[field + 3], satellite.snr);
+    ++m.num_satellites;
+  }
+  return true;
+}
+
+//! The response of a Unicore receiver to a command, e.g.
+//! $command,unlog com1,response: OK*75
+struct NmeaCommandResponse {
+  //! The command as echoed by the receiver
+  boost::string_ref command;
+  //! The response, OK if the command was accepted, else the error
+  boost::string_ref response;
+
+  //! Whether the command was accepted
+  bool ok() const { return response == "OK"; }
+};
+
+/**
+ * @brief Parse the response of a Unicore receiver to a command.
+ *
+ * @details The command may contain commas, so the response is found from the
+ * end of the sentence.
+ * @param sentence the sentence
+ * @param m the output response, points into the sentence
+ * @return false if the sentence is not a command response
+ */
+inline bool parseCommandResponse(boost::string_ref sentence,
+                                 NmeaCommandResponse &m) {
+  static const boost::string_ref kPrefix("$command,");
+  static const boost::string_ref kSeparator(",response:");
+  if (!sentence.starts_with(kPrefix))
+    return false;
+  boost::string_ref body = sentence.substr(kPrefix.size());
+  size_t end = body.rfind('*');
+  if (end == boost::string_ref::npos) {
+    end = body.size();
+    while (end > 0 && (body[end - 1] == '\n' || body[end - 1] == '\r'))
+      --end;
+  }
+  body = body.substr(0, end);
+  size_t separator = body.rfind(kSeparator);
+  if (separator == boost::string_ref::npos)
+    return false;
+  m.command = body.substr(0, separator);
+  m.response = body.substr(separator + kSeparator.size());
+  while (!m.response.empty() && m.response[0] == ' ')
+    m.response.remove_prefix(1);
+  while (!m.response.empty() && m.response[m.response.size() - 1] == ' ')
+    m.response.remove_suffix(1);
+  return true;
+}
+
+}  // namespace ublox
+
+#endif  // UBLOX_NMEA_H
@@ -37,12 +37,14 @@
 #include <algorithm>
 
 #include "checksum.h"
+#include "framer.h"
+#include "view.h"
 
 ///
 /// This file defines the Serializer template class which encodes and decodes
 /// specific message types. 
-/// The Reader class decodes messages and from a buffer and the Writer class 
-/// encodes messages and writes them to a buffer.
+/// deserialize() and decode() decode the message in a frame found by the
+/// Framer and the Writer class encodes messages and writes them to a buffer.
 /// It also declares macros for declaring Messages. The Message class
 /// maps ROS messages types to class and message ID(s).
 ///
@@ -98,6 +100,29 @@ struct Serializer {
                     typename boost::call_traits<T>::param_type message);
 };
 
+/**
+ * @brief Decodes an array of blocks with a fixed size, e.g. the repeated
+ * measurement blocks of a message, in one pass per field.
+ *
+ * @details The default reads an array of primitive values. It is specialized
+ * for the repeated blocks of the messages.
+ */
+template <typename T>
+struct BlockReader {
+  //! The size of a block in bytes
+  static const uint32_t kSize = sizeof(T);
+
+  /**
+   * @brief Decode the blocks.
+   * @param data a pointer to the first block
+   * @param n the number of blocks, the caller checks the buffer holds them
+   * @param blocks the output blocks
+   */
+  static void read(const uint8_t *data, uint32_t n, T *blocks) {
+    loadArray(data, n, blocks);
+  }
+};
+
 /**
  * @brief Keeps track of which class and message IDs can be decoded by a given
  * message type.
@@ -138,7 +163,7 @@ class Message {
 };
 
 /**
- * @brief Options for the Reader and Writer for encoding and decoding messages.
+ * @brief Options for the Writer for encoding messages.
  */
 struct Options {
   /**
@@ -169,232 +194,34 @@ struct Options {
   }
 };
 
-/** 
- * @brief Decodes byte messages into u-blox ROS messages.
+/**
+ * @brief Decode the message in a frame found by the Framer without checking
+ * the message IDs, e.g. if the dispatcher already did.
+ *
+ * @details The header fields are taken from the frame, so they are not parsed
+ * again. The checksum was verified by the Framer.
+ * @param frame a valid UBX or Unicore binary frame
+ * @param message the output message
  */
-class Reader {
- public:
-  /**
-   * @param data a buffer containing u-blox messages
-   * @param count the size of the buffer
-   * @param options A struct containing the parameters sync_a and sync_b  
-   * which represent the sync bytes indicating the beginning of the message
-   */
-  Reader(const uint8_t *data, uint32_t count,
-         const Options &options = Options()) : 
-      data_(data), count_(count), found_(false),ubloxDev(true),options_(options)
-  {
-          unused_data_.reserve(1024);
-  }
-
-  typedef const uint8_t *iterator;
-
-  /**
-   * @brief Search the buffer for the beginning of the next u-blox message
-   * @return a pointer to the start of the next u-blox message
-   */
-  virtual iterator search()
-  {
-    if (found_) next();
-    // Search for a message header
-    for( ; count_ > 0; --count_, ++data_) {
-      if (data_[0] == options_.sync_a && 
-          (count_ == 1 || data_[1] == options_.sync_b)) {
-        // Ignore messages which exceed the maximum payload length
-        if (length() > options_.max_payload_length) {
-          // Message exceeds maximum payload length
-          ROS_ERROR("U-Blox message exceeds maximum payload length %u: "
-	            "0x%02x / 0x%02x", options_.max_payload_length,
-		    classId(), messageId());
-          continue;
-        }
-        //ROS_DEBUG("HIT UBX HEADER");
-        break;
-      }
-      else {
-          unused_data_.push_back(data_[0]);
-      }
-    }
-
-    return data_;
-  }
-
-  /**
-   * @brief Has a u-blox message been found in the buffer?
-   * @returns true if A message with the correct header & length has been found
-   */
-  virtual bool found()
-  {
-    if (found_) return true;
-    // Verify message is long enough to have sync chars, id, length & checksum
-    if (count_ < options_.wrapper_length()) return false;
-    // Verify the header bits
-    if (data_[0] != options_.sync_a || data_[1] != options_.sync_b) 
-      return false;
-    // Verify that the buffer length is long enough based on the received
-    // message length
-    if (count_ < length() + options_.wrapper_length()) return false;
-
-    found_ = true;
-    //ROS_DEBUG("found UBX msg");
-    return true;
-  }
-
-  /**
-   * @brief Go to the start of the next message based on the received message 
-   * length.
-   *
-   * @details Warning: Does not go to the correct byte location if the received 
-   * message length is incorrect. If this is the case, search must be called.
-   */
-  virtual iterator next() {
-    if (found()) {
-      uint32_t size = length() + options_.wrapper_length();
-      data_ += size; count_ -= size;
-    }
-    found_ = false;
-    return data_;
-  }
-
-  /**
-   * @brief Get the current position in the read buffer.
-   * @return the current position of the read buffer
-   */
-  virtual iterator pos() {
-    return data_;
-  }
-
-  virtual iterator end() {
-    return data_ + count_;
-  }
-
-  virtual uint8_t classId() { return data_[2]; }
-  // for UM982 uint8_t ->uint32_t
-  virtual uint32_t messageId() { return data_[3]; }
-
-  /**
-   * @brief Get the length of the u-blox message payload.
-   *
-   * @details Payload length does not include the header or checksum length.
-   * Determines the length from the header of the u-blox message.
-   * @return the length of the message payload
-   */
-  virtual uint32_t length() {
-    if (count_ < 6) return 0u;
-    return (data_[5] << 8) + data_[4];
-  }
-  // not caller ?
-  virtual  const uint8_t *data() { return data_ + options_.header_length; }
-  
-  /**
-   * @brief Get the checksum of the u-blox message.
-   *
-   * @return the checksum of the u-blox message
-   */
-  virtual uint32_t checksum() { 
-    ROS_DEBUG("checksum for ubx");
-    uint32_t ubx_crc = 0;
-    ubx_crc =  *reinterpret_cast<const uint16_t *>(data_ + options_.header_length +
-                                               length()); 
-    return ubx_crc;
-  }
-
-  /**
-   * @brief Decode the given message.
-   * @param message the output message
-   * @param search whether or not to skip to the next message in the buffer
-   */
-  template <typename T>
-  bool read(typename boost::call_traits<T>::reference message, 
-            bool search = false) {
-    if (search) this->search();
-    if (!found()) return false; 
-    if (!Message<T>::canDecode(classId(), messageId())) return false;
-
-    if (ubloxDev) {
-      //for ublox
-      uint16_t chk;
-      if (calculateChecksum(data_ + 2, length() + 4, chk) != this->checksum()) {
-        // checksum error
-        ROS_DEBUG("U-Blox read checksum error: 0x%02x / 0x%02x", classId(), 
-                  messageId());
-        return false;
-      }
-      // serialize  msg  from memory
-      Serializer<T>::read(data_ + options_.header_length, length(), message);
-    }
-    else // for UM982
-    {
-      uint32_t len = length()+options_.header_length;
-      uint32_t crc32 = CalculateCRC32(data_,len);
-      uint32_t msg_crc = this->checksum();
-      //ROS_DEBUG("unicore msg_crc=0x%08x crc32=0x%08x, len=%d",msg_crc,crc32,len);
-      if(crc32!= msg_crc )
-      {
-        // checksum error
-        ROS_ERROR("unicore msg read checksum error: 0x%02x / 0x%02x msg_crc %04x calcuted crc %04x ", classId(), 
-                  messageId(),msg_crc,crc32);
-        return false;
-      }
-      
-      if (0) {
-        // Print the received bytes
-        std::ostringstream oss;
-        for (int j = 0 ;j< len;j++)
-        {
-          oss << boost::format("%02x") % static_cast<unsigned int>(*(data_+j)) << " ";
-          if (j == 67) { // lat_std
-            oss << "\n";
-          }
-        }
-        ROS_DEBUG("unicore Serializer  \n%s", oss.str().c_str());
-      }
-      len-=options_.header_skip;
-      // serialize  msg , skip first four byte  of header for UM982
-      //ROS_DEBUG("serializer len=%d",len);
-      Serializer<T>::read(data_ + options_.header_skip,len, message);
-    }
-    return true;
-  }
-
-  /**
-   * @brief Can the given message type decode the current message in the buffer?
-   * @return whether the given message type can decode the current message in 
-   * the buffer
-   */
-  template <typename T> 
-  bool hasType() {
-    if (!found()) return false;
-    return Message<T>::canDecode(classId(), messageId());
-  }
-
-  /**
-   * @brief Does the u-blox message have the given class and message ID?
-   * @return Whether or not the u-blox message has the given class and message 
-   * ID
-   */
-  bool isMessage(uint8_t class_id, uint32_t message_id) {
-    if (!found()) return false;
-    return (classId() == class_id && messageId() == message_id);
-  }
-  
-  const std::string& getUnusedData() const { return unused_data_; }
-
- protected:
-  //! The buffer of message bytes
-  const uint8_t *data_;
-  //! Unused data from the read buffer, contains nmea messages.
-  std::string unused_data_;
-  //! the number of bytes in the buffer, //! decrement as the buffer is read
-  uint32_t count_; 
-  //! Whether or not a message has been found
-  bool found_; 
-  //! Options representing the sync char values, etc.
-  Options options_; 
+template <typename T>
+void deserialize(const FrameView &frame,
+                 typename boost::call_traits<T>::reference message) {
+  Serializer<T>::read(messageData(frame), messageLength(frame), message);
+}
 
-  //! set true if not ublx devices, map oem msg with ubx
-  bool ubloxDev;
-};
+/**
+ * @brief Decode the message in a frame found by the Framer.
+ * @param frame a valid UBX or Unicore binary frame
+ * @param message the output message
+ * @return false if the message type can not decode the frame
+ */
+template <typename T>
+bool decode(const FrameView &frame,
+            typename boost::call_traits<T>::reference message) {
+  if (!Message<T>::canDecode(frame.class_id, frame.message_id)) return false;
+  deserialize<T>(frame, message);
+  return true;
+}
 
 /** 
  * @brief Encodes a u-blox ROS message as a byte array.
@@ -491,179 +318,6 @@ class Writer {
   Options options_; 
 };
 
-/** 
- * @brief Decodes byte messages into unicore ROS messages.
- */
-class ReaderUnicore : public Reader{
- public:
-  /**
-   * @param data a buffer containing Unicore messages
-   * @param count the size of the buffer
-   * @param options A struct containing the parameters sync_a and sync_b  
-   * which represent the sync bytes indicating the beginning of the message
-   */
-  ReaderUnicore(const uint8_t *data, uint32_t count, 
-         const Options &options = Options()) : Reader(data,count,options)
-  {
-          unused_data_.reserve(1024);
-          //update opions base one unicore
-          options_.sync_a = 0xAA;
-          options_.sync_b = 0x44;
-          options_.header_skip = 3;
-          // options.header_length is  UMOEN headlen=24  UMBIN headlen=28
-          options_.header_length =  28;// default
-          options_.checksum_length = 4;
-          ubloxDev = false;
-          //ROS_INFO(" create readerunicore for UM982");
-  }
-
-  //typedef const uint8_t *iterator;
-
-  /**
-   * @brief Search the buffer for the beginning of the next 
-   *        unicore message
-   * @return a pointer to the start of the next unicore message
-   */
-  iterator search()
-  {
-    if (found_) next();
-    // Search for a message header
-    for( ; count_ > 0; --count_, ++data_) {
-      if (data_[0] == options_.sync_a && 
-          (count_ == 1 || data_[1] == options_.sync_b)) {
-        // Ignore messages which exceed the maximum payload length
-        if (length() > options_.max_payload_length) {
-          // Message exceeds maximum payload length
-          ROS_ERROR("unicore message exceeds maximum payload length %u: "
-	            "0x%02x / 0x%02x", options_.max_payload_length,
-                    classId(), messageId());
-          continue;
-        }
-        //ROS_DEBUG("HIT UNICORE HEADER");
-        break;
-      }
-      else {
-          unused_data_.push_back(data_[0]);
-      }
-    }
-
-    return data_;
-  }
-
-  /**
-   * @brief Has a u-blox message been found in the buffer?
-   * @returns true if A message with the correct header & length has been found
-   */
-  bool found()
-  {
-    if (found_) return true;
-    // Verify message is long enough to have sync chars, id, length & checksum
-    if (count_ < options_.wrapper_length()) return false;
-    // Verify the header bits
-    if (data_[0] != options_.sync_a || data_[1] != options_.sync_b) 
-      return false;
-    // Verify that the buffer length is long enough based on the received
-    // message length
-    // for UM980
-    
-    if (count_ < length() + options_.wrapper_length()) return false;
-
-    found_ = true;
-    return true;
-  }
-
-  /**
-   * @brief Go to the start of the next message based on the received message 
-   * length.
-   *
-   * @details Warning: Does not go to the correct byte location if the received 
-   * message length is incorrect. If this is the case, search must be called.
-   */
-  iterator next() {
-    if (found()) {
-      uint32_t size = length() + options_.wrapper_length();
-      ROS_DEBUG("ReaderUnicore NEXT size=%d",size);
-      data_ += size; count_ -= size;
-    }
-    found_ = false;
-    return data_;
-  }
-
-  /**
-   * @brief Get the current position in the read buffer.
-   * @return the current position of the read buffer
-   */
-  iterator pos() {
-    return data_;
-  }
-
-  iterator end() {
-    return data_ + count_;
-  }
-  // for unicore
-  uint8_t classId() { return data_[2]; } // 0x12 or 0xb5
-  // for unicore
-  uint32_t messageId() {
-    if (data_[2] == 0xb5) {
-      return (data_[5] << 8) + data_[4];
-    }
-    else if (data_[2] == 0x12)
-    {
-      return (data_[5] << 8) + data_[4];
-    }
-    else
-    {
-      ROS_INFO("worng sync3 for unicore:0x%02x",data_[2] );
-      return 0;
-    }
-  }
-  uint8_t const *data() { return data_ + options_.header_skip; }
-  /**
-   * @brief Get the length of the u-blox message payload.
-   *
-   * @details Payload length does not include the header or checksum length.
-   * Determines the length from the header of the u-blox message.
-   * @return the length of the message payload
-   */
-  uint32_t length() {
-    if (count_ < 10) return 0u;
-    if (data_[2] == 0xb5) {
-      //ROS_INFO("Header is UINOCRE OEM");
-      // for UMOEM
-      options_.header_length = 24;
-      return (data_[7] << 8) + data_[6];
-    }
-    else if (data_[2] == 0x12) {
-      //ROS_INFO("Header is UINOCRE BIN");
-      // for UMBIN
-      options_.header_length = 28;
-      return (data_[9] << 8) + data_[8];
-    }
-    else
-    {
-      ROS_ERROR("unicore message wrong sync3 = 0x%02x ",data_[2]);
-      return 0u;
-    }
-  }
-  
-  /**
-   * @brief Get the checksum of the unicore message.
-   *
-   * @return the checksum of the unicore message
-   */
-  uint32_t checksum() { 
-    const uint8_t *pcrc =  data_ + options_.header_length + length();
-                                              
-    uint32_t crc =  *reinterpret_cast<const uint32_t *>(pcrc); 
-    return crc;
-  }
-
-  uint32_t headLen()
-  {
-    return options_.header_length;
-  }
-};
-
 } // namespace ublox
 
 // Use to declare u-blox messages and message serializers
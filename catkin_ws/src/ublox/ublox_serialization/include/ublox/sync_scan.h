@@ -0,0 +1,313 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_SYNC_SCAN_H
+#define UBLOX_SYNC_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UBLOX_SYNC_HAVE_AVX2 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#define UBLOX_SYNC_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || (defined(__ARM_NEON) && defined(__ARM_NEON__))
+#define UBLOX_SYNC_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+///
+/// This file implements the scanner which locates the first character of any
+/// frame recognized by the Framer in the read buffer.
+///
+/// The vector kernels compare 16 (SSE2, NEON) or 32 (AVX2) positions at once,
+/// so line noise and partial frames after a reconnect or a checksum error
+/// are skipped without touching every byte in a loop. The fastest kernel
+/// supported by the CPU is selected on first use.
+///
+
+namespace ublox {
+namespace sync {
+
+//! Sync scanner kernel implementations
+enum Kernel {
+  KERNEL_SCALAR,  //!< Byte-wise loop, the reference implementation
+  KERNEL_SSE2,    //!< 16 positions per iteration
+  KERNEL_AVX2,    //!< 32 positions per iteration
+  KERNEL_NEON,    //!< 16 positions per iteration
+  KERNEL_COUNT
+};
+
+/**
+ * @brief Whether the given byte can start a frame, i.e. the first sync
+ * character of UBX (0xB5), Unicore binary (0xAA) and RTCM 3 (0xD3) frames or
+ * the start of a NMEA sentence ('$') or a Unicore ASCII message ('#').
+ */
+inline bool isFrameStart(uint8_t c) {
+  return c == 0xB5 || c == 0xAA || c == 0xD3 || c == '$' || c == '#';
+}
+
+/**
+ * @brief Signature of a frame start kernel.
+ *
+ * @details Returns the first position p in [begin, end) with
+ * isFrameStart(*p), or end if there is none.
+ */
+typedef const uint8_t *(*FindStartFunction)(const uint8_t *begin,
+                                            const uint8_t *end);
+
+/**
+ * @brief Byte-wise frame start scan, also used for the tail of the vector
+ * kernels.
+ */
+inline const uint8_t *findStartScalar(const uint8_t *begin,
+                                      const uint8_t *end) {
+  for (const uint8_t *p = begin; p < end; ++p) {
+    if (isFrameStart(*p))
+      return p;
+  }
+  return end;
+}
+
+#ifdef UBLOX_SYNC_HAVE_SSE2
+/**
+ * @brief Compare 16 positions per iteration against the frame start set.
+ */
+inline const uint8_t *findStartSse2(const uint8_t *begin, const uint8_t *end) {
+  const __m128i ubx = _mm_set1_epi8(static_cast<char>(0xB5));
+  const __m128i unicore = _mm_set1_epi8(static_cast<char>(0xAA));
+  const __m128i rtcm = _mm_set1_epi8(static_cast<char>(0xD3));
+  const __m128i nmea = _mm_set1_epi8('$');
+  const __m128i ascii = _mm_set1_epi8('#');
+  const uint8_t *p = begin;
+  for (; end - p >= 16; p += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hit = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(x, ubx), _mm_cmpeq_epi8(x, unicore)),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, rtcm),
+                                  _mm_cmpeq_epi8(x, nmea)),
+                     _mm_cmpeq_epi8(x, ascii)));
+    int mask = _mm_movemask_epi8(hit);
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+  return findStartScalar(p, end);
+}
+#endif
+
+#ifdef UBLOX_SYNC_HAVE_AVX2
+/**
+ * @brief Compare 32 positions per iteration against the frame start set.
+ */
+__attribute__((target("avx2")))
+inline const uint8_t *findStartAvx2(const uint8_t *begin, const uint8_t *end) {
+  const __m256i ubx = _mm256_set1_epi8(static_cast<char>(0xB5));
+  const __m256i unicore = _mm256_set1_epi8(static_cast<char>(0xAA));
+  const __m256i rtcm = _mm256_set1_epi8(static_cast<char>(0xD3));
+  const __m256i nmea = _mm256_set1_epi8('$');
+  const __m256i ascii = _mm256_set1_epi8('#');
+  const uint8_t *p = begin;
+  for (; end - p >= 32; p += 32) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hit = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, ubx),
+                        _mm256_cmpeq_epi8(x, unicore)),
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, rtcm),
+                                        _mm256_cmpeq_epi8(x, nmea)),
+                        _mm256_cmpeq_epi8(x, ascii)));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+  return findStartScalar(p, end);
+}
+#endif
+
+#ifdef UBLOX_SYNC_HAVE_NEON
+/**
+ * @brief Compare 16 positions per iteration against the frame start set.
+ */
+inline const uint8_t *findStartNeon(const uint8_t *begin, const uint8_t *end) {
+  const uint8x16_t ubx = vdupq_n_u8(0xB5);
+  const uint8x16_t unicore = vdupq_n_u8(0xAA);
+  const uint8x16_t rtcm = vdupq_n_u8(0xD3);
+  const uint8x16_t nmea = vdupq_n_u8('$');
+  const uint8x16_t ascii = vdupq_n_u8('#');
+  const uint8_t *p = begin;
+  for (; end - p >= 16; p += 16) {
+    uint8x16_t x = vld1q_u8(p);
+    uint8x16_t hit = vorrq_u8(
+        vorrq_u8(vceqq_u8(x, ubx), vceqq_u8(x, unicore)),
+        vorrq_u8(vorrq_u8(vceqq_u8(x, rtcm), vceqq_u8(x, nmea)),
+                 vceqq_u8(x, ascii)));
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+        vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+    if (mask)
+      return p + (__builtin_ctzll(mask) >> 2);
+  }
+  return findStartScalar(p, end);
+}
+#endif
+
+/**
+ * @brief Whether the given kernel can run on this CPU.
+ */
+inline bool isSupported(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR:
+      return true;
+    case KERNEL_SSE2:
+#ifdef UBLOX_SYNC_HAVE_SSE2
+      return true;
+#else
+      return false;
+#endif
+    case KERNEL_AVX2: {
+#ifdef UBLOX_SYNC_HAVE_AVX2
+      unsigned int eax, ebx, ecx, edx;
+      if (__get_cpuid_max(0, 0) < 7) return false;
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      if (!(ebx & bit_AVX2)) return false;
+      // The OS must save the YMM registers
+      __cpuid(1, eax, ebx, ecx, edx);
+      if (!(ecx & bit_OSXSAVE)) return false;
+      uint32_t xcr0_lo, xcr0_hi;
+      __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+      return (xcr0_lo & 0x6) == 0x6;
+#else
+      return false;
+#endif
+    }
+    case KERNEL_NEON:
+#ifdef UBLOX_SYNC_HAVE_NEON
+      return true;
+#else
+      return false;
+#endif
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Get the frame start implementation of the given kernel.
+ * @return the kernel function, or 0 if it is not compiled in
+ */
+inline FindStartFunction startKernelFunction(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR: return &findStartScalar;
+#ifdef UBLOX_SYNC_HAVE_SSE2
+    case KERNEL_SSE2: return &findStartSse2;
+#endif
+#ifdef UBLOX_SYNC_HAVE_AVX2
+    case KERNEL_AVX2: return &findStartAvx2;
+#endif
+#ifdef UBLOX_SYNC_HAVE_NEON
+    case KERNEL_NEON: return &findStartNeon;
+#endif
+    default: return 0;
+  }
+}
+
+/**
+ * @brief Get a human readable name of the kernel.
+ */
+inline const char *kernelName(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE2: return "sse2";
+    case KERNEL_AVX2: return "avx2";
+    case KERNEL_NEON: return "neon";
+    default: return "unknown";
+  }
+}
+
+/**
+ * @brief Select the fastest kernel supported by this CPU.
+ */
+inline Kernel bestKernel() {
+  if (isSupported(KERNEL_AVX2) && startKernelFunction(KERNEL_AVX2))
+    return KERNEL_AVX2;
+  if (isSupported(KERNEL_SSE2) && startKernelFunction(KERNEL_SSE2))
+    return KERNEL_SSE2;
+  if (isSupported(KERNEL_NEON) && startKernelFunction(KERNEL_NEON))
+    return KERNEL_NEON;
+  return KERNEL_SCALAR;
+}
+
+/**
+ * @brief The kernel currently used by findStart().
+ */
+inline Kernel &activeKernel() {
+  static Kernel kernel = bestKernel();
+  return kernel;
+}
+
+/**
+ * @brief The kernel function currently used by findStart().
+ */
+inline FindStartFunction &activeStartFunction() {
+  static FindStartFunction function = startKernelFunction(activeKernel());
+  return function;
+}
+
+/**
+ * @brief Force the scanner to use the given kernel.
+ *
+ * @details Intended for tests and benchmarks. Must not be called while other
+ * threads are scanning.
+ * @return false if the kernel is not supported on this CPU
+ */
+inline bool setKernel(Kernel kernel) {
+  if (!isSupported(kernel) || !startKernelFunction(kernel)) return false;
+  activeKernel() = kernel;
+  activeStartFunction() = startKernelFunction(kernel);
+  return true;
+}
+
+/**
+ * @brief Find the next byte which can start a frame.
+ * @param begin the start of the data
+ * @param end the end of the data
+ * @return the first position p with isFrameStart(*p); end if there is none
+ */
+inline const uint8_t *findStart(const uint8_t *begin, const uint8_t *end) {
+  return activeStartFunction()(begin, end);
+}
+
+} // namespace sync
+} // namespace ublox
+
+#endif // UBLOX_SYNC_SCAN_H
@@ -0,0 +1,142 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef UBLOX_VIEW_H
+#define UBLOX_VIEW_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "framer.h"
+
+///
+/// This file defines the helpers of the message views and serializers
+/// generated by ublox_msgs. A view reads the fields of a message directly
+/// from the bytes of a frame instead of decoding the message into a ROS
+/// message first.
+///
+
+namespace ublox {
+
+//! The number of bytes of the Unicore header which are not part of the
+//! message, i.e. the sync characters
+static const uint32_t kUnicoreSyncLength = 3;
+
+/**
+ * @brief Read a little endian value from an unaligned address.
+ * @param data the first byte of the value
+ */
+template <typename T>
+inline T load(const uint8_t *data) {
+  T value;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  uint8_t bytes[sizeof(T)];
+  for (uint32_t i = 0; i < sizeof(T); ++i)
+    bytes[i] = data[sizeof(T) - 1 - i];
+  memcpy(&value, bytes, sizeof(T));
+#else
+  memcpy(&value, data, sizeof(T));
+#endif
+  return value;
+}
+
+/**
+ * @brief Write a value little endian to an unaligned address.
+ * @param data the first byte of the value
+ * @param value the value
+ */
+template <typename T>
+inline void store(uint8_t *data, T value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  uint8_t bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));
+  for (uint32_t i = 0; i < sizeof(T); ++i)
+    data[i] = bytes[sizeof(T) - 1 - i];
+#else
+  memcpy(data, &value, sizeof(T));
+#endif
+}
+
+/**
+ * @brief Read an array of little endian values.
+ * @param data the first byte of the array
+ * @param n the number of values
+ * @param out the values
+ */
+template <typename T>
+inline void loadArray(const uint8_t *data, uint32_t n, T *out) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  for (uint32_t i = 0; i < n; ++i)
+    out[i] = load<T>(data + i * sizeof(T));
+#else
+  if (n > 0)
+    memcpy(out, data, n * sizeof(T));
+#endif
+}
+
+/**
+ * @brief Read one field of an array of records into the member of an array
+ * of structures.
+ *
+ * @details Reading the records field by field keeps the loop free of
+ * branches with a constant stride, which the compiler can unroll and, where
+ * a byte swap is needed, vectorize.
+ * @param data the field of the first record
+ * @param n the number of records
+ * @param stride the size of a record
+ * @param out the structures
+ * @param member the member of the structures to fill
+ */
+template <typename T, typename Struct>
+inline void loadColumn(const uint8_t *data, uint32_t n, uint32_t stride,
+                       Struct *out, T Struct::*member) {
+  for (uint32_t i = 0; i < n; ++i, data += stride)
+    out[i].*member = load<T>(data);
+}
+
+/**
+ * @brief Get the start of the message in the frame, i.e. the payload of UBX
+ * messages and the header after the sync characters of Unicore messages,
+ * which are part of the Unicore ROS messages.
+ */
+inline const uint8_t *messageData(const FrameView &frame) {
+  return frame.protocol == PROTOCOL_UBX ?
+      frame.payload : frame.data + kUnicoreSyncLength;
+}
+
+/**
+ * @brief Get the number of bytes from messageData() to the checksum.
+ */
+inline uint32_t messageLength(const FrameView &frame) {
+  return frame.protocol == PROTOCOL_UBX ? frame.payload_length :
+      frame.header_length + frame.payload_length - kUnicoreSyncLength;
+}
+
+}  // namespace ublox
+
+#endif  // UBLOX_VIEW_H
@@ -0,0 +1,102 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "ublox/crc32.h"
+
+using namespace ublox;
+
+namespace {
+
+std::vector<uint8_t> randomBytes(size_t size, unsigned int seed) {
+  std::vector<uint8_t> data(size);
+  srand(seed);
+  for (size_t i = 0; i < size; ++i)
+    data[i] = static_cast<uint8_t>(rand());
+  return data;
+}
+
+}  // namespace
+
+TEST(Crc32, CheckValue)
+{
+  // CRC-32 check value with the usual pre and post inversion
+  const char *check = "123456789";
+  for (int k = 0; k < crc32::KERNEL_COUNT; ++k) {
+    crc32::UpdateFunction update =
+        crc32::kernelFunction(static_cast<crc32::Kernel>(k));
+    if (!update || !crc32::isSupported(static_cast<crc32::Kernel>(k)))
+      continue;
+    EXPECT_EQ(~update(~0U, reinterpret_cast<const uint8_t *>(check), 9),
+              0xCBF43926U) << crc32::kernelName(static_cast<crc32::Kernel>(k));
+  }
+}
+
+TEST(Crc32, KernelsMatchTable)
+{
+  std::vector<uint8_t> data = randomBytes(4096 + 64, 42);
+  for (int k = 0; k < crc32::KERNEL_COUNT; ++k) {
+    crc32::Kernel kernel = static_cast<crc32::Kernel>(k);
+    crc32::UpdateFunction update = crc32::kernelFunction(kernel);
+    if (!update || !crc32::isSupported(kernel))
+      continue;
+    // Every length up to a few folding blocks, at unaligned offsets
+    for (size_t size = 0; size < 300; ++size) {
+      for (size_t offset = 0; offset < 8; ++offset) {
+        ASSERT_EQ(update(0, data.data() + offset, size),
+                  crc32::updateTable(0, data.data() + offset, size))
+            << crc32::kernelName(kernel) << " size " << size
+            << " offset " << offset;
+      }
+    }
+    // A large OBSVM-like frame
+    EXPECT_EQ(update(0x12345678, data.data(), 4096),
+              crc32::updateTable(0x12345678, data.data(), 4096))
+        << crc32::kernelName(kernel);
+  }
+}
+
+TEST(Crc32, Incremental)
+{
+  std::vector<uint8_t> data = randomBytes(2500, 7);
+  const uint32_t expected = crc32::updateTable(0, data.data(), data.size());
+  for (size_t split = 0; split <= data.size(); split += 37) {
+    uint32_t crc = crc32::update(0, data.data(), split);
+    crc = crc32::update(crc, data.data() + split, data.size() - split);
+    ASSERT_EQ(crc, expected) << "split " << split;
+  }
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,331 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ublox/framer.h"
+
+using namespace ublox;
+
+namespace {
+
+const uint32_t kMaxPayload = 8184;
+
+void append(std::vector<uint8_t> &buffer, const std::string &text) {
+  buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+void appendUbx(std::vector<uint8_t> &buffer, uint8_t class_id, uint8_t id,
+               uint16_t length) {
+  size_t start = buffer.size();
+  const uint8_t header[] = {0xB5, 0x62, class_id, id,
+                            static_cast<uint8_t>(length),
+                            static_cast<uint8_t>(length >> 8)};
+  buffer.insert(buffer.end(), header, header + sizeof(header));
+  buffer.resize(buffer.size() + length, 0x5A);
+  uint8_t ck_a, ck_b;
+  calculateChecksum(&buffer[start + 2], length + 4, ck_a, ck_b);
+  buffer.push_back(ck_a);
+  buffer.push_back(ck_b);
+}
+
+void appendUnicore(std::vector<uint8_t> &buffer, uint8_t sync_c,
+                   uint16_t id, uint16_t length) {
+  size_t start = buffer.size();
+  size_t header_length = sync_c == 0x12 ? 28 : 24;
+  buffer.resize(start + header_length + length, 0xA5);
+  buffer[start] = 0xAA;
+  buffer[start + 1] = 0x44;
+  buffer[start + 2] = sync_c;
+  buffer[start + 4] = id & 0xFF;
+  buffer[start + 5] = id >> 8;
+  size_t length_offset = sync_c == 0x12 ? 8 : 6;
+  buffer[start + length_offset] = length & 0xFF;
+  buffer[start + length_offset + 1] = length >> 8;
+  uint32_t crc = CalculateCRC32(&buffer[start], header_length + length);
+  for (int i = 0; i < 4; ++i)
+    buffer.push_back(crc >> (8 * i));
+}
+
+void appendRtcm3(std::vector<uint8_t> &buffer, uint16_t length) {
+  size_t start = buffer.size();
+  buffer.push_back(0xD3);
+  buffer.push_back(length >> 8);
+  buffer.push_back(length & 0xFF);
+  buffer.resize(buffer.size() + length, 0x3E);
+  uint32_t crc = calculateCrc24q(&buffer[start], length + 3);
+  buffer.push_back(crc >> 16);
+  buffer.push_back(crc >> 8);
+  buffer.push_back(crc);
+}
+
+std::vector<FrameView> frames(const std::vector<uint8_t> &buffer,
+                              size_t *consumed = 0) {
+  Framer framer(buffer.data(), buffer.size(), kMaxPayload);
+  std::vector<FrameView> result;
+  FrameView frame;
+  while (framer.next(frame))
+    result.push_back(frame);
+  if (consumed) *consumed = framer.pos() - buffer.data();
+  return result;
+}
+
+}  // namespace
+
+TEST(Framer, MixedProtocols)
+{
+  std::vector<uint8_t> buffer;
+  append(buffer, "$GNGGA,000000.00,,,,,0,00,99.99,,,,,,*78\r\n");
+  appendUnicore(buffer, 0x12, 42, 72);
+  append(buffer, "#BESTNAVA,COM1,0,55.0,FINESTEERING;SOL_COMPUTED*3c6a4b2f\r\n");
+  appendUbx(buffer, 0x01, 0x07, 92);
+  appendRtcm3(buffer, 19);
+  appendUnicore(buffer, 0xB5, 1276, 232);
+  append(buffer, "$command,unlog com1,response: OK*75\r\n");
+
+  size_t consumed;
+  std::vector<FrameView> result = frames(buffer, &consumed);
+  ASSERT_EQ(result.size(), 7u);
+  EXPECT_EQ(result[0].protocol, PROTOCOL_NMEA);
+  EXPECT_EQ(result[1].protocol, PROTOCOL_UNICORE_BIN);
+  EXPECT_EQ(result[1].size, 28u + 72 + 4);
+  EXPECT_EQ(result[2].protocol, PROTOCOL_UNICORE_ASCII);
+  EXPECT_EQ(result[3].protocol, PROTOCOL_UBX);
+  EXPECT_EQ(result[3].size, 6u + 92 + 2);
+  EXPECT_EQ(result[4].protocol, PROTOCOL_RTCM3);
+  EXPECT_EQ(result[4].size, 3u + 19 + 3);
+  EXPECT_EQ(result[5].protocol, PROTOCOL_UNICORE_OEM);
+  EXPECT_EQ(result[5].size, 24u + 232 + 4);
+  EXPECT_EQ(result[6].protocol, PROTOCOL_NMEA);
+  EXPECT_EQ(consumed, buffer.size());
+
+  size_t offset = 0;
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i].data, buffer.data() + offset);
+    offset += result[i].size;
+  }
+}
+
+TEST(Framer, DescribesHeader)
+{
+  std::vector<uint8_t> buffer;
+  appendUbx(buffer, 0x01, 0x07, 92);
+  appendUnicore(buffer, 0x12, 42, 72);
+  appendUnicore(buffer, 0xB5, 1276, 232);
+  appendRtcm3(buffer, 19);
+  append(buffer, "$GNHDT,123.4,T*2F\r\n");
+
+  Framer framer(buffer.data(), buffer.size(), kMaxPayload);
+  framer.reset(buffer.data(), buffer.size(), 12.5);
+  std::vector<FrameView> result;
+  FrameView frame;
+  while (framer.next(frame))
+    result.push_back(frame);
+  ASSERT_EQ(result.size(), 5u);
+
+  EXPECT_EQ(result[0].class_id, 0x01);
+  EXPECT_EQ(result[0].message_id, 0x07u);
+  EXPECT_EQ(result[0].header_length, 6u);
+  EXPECT_EQ(result[0].payload, result[0].data + 6);
+  EXPECT_EQ(result[0].payload_length, 92u);
+  EXPECT_EQ(result[0].checksum,
+            static_cast<uint32_t>(result[0].data[98] | (result[0].data[99] << 8)));
+
+  EXPECT_EQ(result[1].class_id, 0x12);
+  EXPECT_EQ(result[1].message_id, 42u);
+  EXPECT_EQ(result[1].header_length, 28u);
+  EXPECT_EQ(result[1].payload_length, 72u);
+  EXPECT_EQ(result[1].checksum, CalculateCRC32(result[1].data, 28 + 72));
+
+  EXPECT_EQ(result[2].class_id, 0xB5);
+  EXPECT_EQ(result[2].message_id, 1276u);
+  EXPECT_EQ(result[2].header_length, 24u);
+  EXPECT_EQ(result[2].payload_length, 232u);
+
+  EXPECT_EQ(result[3].message_id, 0x3E3u);
+  EXPECT_EQ(result[3].payload_length, 19u);
+
+  EXPECT_EQ(result[4].protocol, PROTOCOL_NMEA);
+  EXPECT_EQ(result[4].payload, result[4].data);
+  EXPECT_EQ(result[4].payload_length, result[4].size);
+  for (size_t i = 0; i < result.size(); ++i)
+    EXPECT_EQ(result[i].stamp, 12.5);
+}
+
+TEST(Framer, IncompleteFrameIsKept)
+{
+  std::vector<uint8_t> buffer;
+  append(buffer, "$GNHDT,123.4,T*2F\r\n");
+  size_t complete = buffer.size();
+  appendUnicore(buffer, 0xB5, 12, 400);
+  // Every split of the binary frame must be kept for the next read
+  for (size_t size = complete; size < buffer.size(); ++size) {
+    std::vector<uint8_t> partial(buffer.begin(), buffer.begin() + size);
+    size_t consumed;
+    std::vector<FrameView> result = frames(partial, &consumed);
+    ASSERT_EQ(result.size(), 1u) << size;
+    EXPECT_EQ(consumed, complete) << size;
+  }
+}
+
+TEST(Framer, GarbageIsSkipped)
+{
+  std::vector<uint8_t> buffer;
+  // Noise containing sync characters which do not start a frame
+  const uint8_t noise[] = {0x00, 0xAA, 0x00, 0xB5, 0x00, 0xD3, 0xFF, 0x13};
+  buffer.insert(buffer.end(), noise, noise + sizeof(noise));
+  // A sentence cut off by a binary frame
+  append(buffer, "$GNRMC,0000");
+  appendUbx(buffer, 0x05, 0x01, 2);
+  // RTCM 3 frame with a broken CRC
+  appendRtcm3(buffer, 10);
+  buffer.back() ^= 1;
+  append(buffer, "$GNVTG,,T,,M,0.0,N,0.0,K,N*32\r\n");
+
+  Framer framer(buffer.data(), buffer.size(), kMaxPayload);
+  FrameView frame;
+  ASSERT_TRUE(framer.next(frame));
+  EXPECT_EQ(frame.protocol, PROTOCOL_UBX);
+  ASSERT_TRUE(framer.next(frame));
+  EXPECT_EQ(frame.protocol, PROTOCOL_NMEA);
+  EXPECT_FALSE(framer.next(frame));
+  EXPECT_EQ(framer.pos(), framer.end());
+  EXPECT_EQ(framer.skipped(), sizeof(noise) + 11 + 16u);
+}
+
+TEST(Framer, ResumesAcrossReads)
+{
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < 20; ++i) {
+    appendUnicore(stream, 0xB5, 12, 400 + i);
+    append(stream, "$GNGGA,000000.00,,,,,0,00,99.99,,,,,,*78\r\n");
+    appendUbx(stream, 0x01, 0x07, 92);
+    appendRtcm3(stream, 19 + i);
+    appendUnicore(stream, 0x12, 42, 72);
+  }
+  const size_t expected = frames(stream).size();
+
+  // Feed the stream in chunks of varying size, the unprocessed bytes are kept
+  // at the front of the buffer like the input buffer of the worker does
+  Framer framer(kMaxPayload);
+  std::vector<uint8_t> buffer;
+  size_t offset = 0, count = 0, chunk = 1;
+  while (offset < stream.size()) {
+    size_t size = std::min(chunk, stream.size() - offset);
+    buffer.insert(buffer.end(), stream.begin() + offset,
+                  stream.begin() + offset + size);
+    offset += size;
+    chunk = chunk * 7 % 509 + 1;
+
+    framer.reset(buffer.data(), buffer.size());
+    FrameView frame;
+    while (framer.next(frame))
+      ++count;
+    EXPECT_EQ(framer.skipped(), 0u);
+    buffer.erase(buffer.begin(), buffer.begin() + (framer.pos() - buffer.data()));
+  }
+  EXPECT_EQ(count, expected);
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(Framer, BadChecksum)
+{
+  std::vector<uint8_t> buffer;
+  appendUnicore(buffer, 0x12, 42, 72);
+  buffer[40] ^= 0xFF;
+  appendUbx(buffer, 0x01, 0x07, 92);
+  buffer[buffer.size() - 10] ^= 0xFF;
+
+  appendRtcm3(buffer, 19);
+
+  // Frames with a wrong checksum are dropped
+  Framer framer(buffer.data(), buffer.size(), kMaxPayload);
+  FrameView frame;
+  ASSERT_TRUE(framer.next(frame));
+  EXPECT_EQ(frame.protocol, PROTOCOL_RTCM3);
+  EXPECT_FALSE(framer.next(frame));
+  EXPECT_EQ(framer.checksumErrors(), 2u);
+  EXPECT_EQ(framer.frames(), 1u);
+  EXPECT_EQ(framer.skipped(), 28u + 72 + 4 + 6 + 92 + 2);
+  EXPECT_EQ(framer.discarded(), framer.skipped());
+}
+
+TEST(Framer, NmeaChecksum)
+{
+  std::vector<uint8_t> buffer;
+  append(buffer, "$GNHDT,123.4,T*2F\r\n");
+  append(buffer, "$GNHDT,123.5,T*2F\r\n");
+  append(buffer, "$GNHDT,123.4,T*2f\n");
+  // Sentences without a checksum are passed on
+  append(buffer, "$GNHDT,123.4,T\r\n");
+
+  std::vector<FrameView> result = frames(buffer);
+  ASSERT_EQ(result.size(), 3u);
+  EXPECT_EQ(result[0].checksum, 0x2Fu);
+  EXPECT_EQ(result[1].size, 18u);
+  EXPECT_EQ(result[2].checksum, 0u);
+
+  const std::string sentence = "GNGGA,000000.00,,,,,0,00,99.99,,,,,,";
+  EXPECT_EQ(calculateNmeaChecksum(
+                reinterpret_cast<const uint8_t *>(sentence.data()),
+                sentence.size()), 0x78);
+}
+
+TEST(Framer, ResynchronizesAfterCorruptLength)
+{
+  // The length of the first frame is corrupt and covers the frames which
+  // follow it, they are found again after its checksum fails
+  std::vector<uint8_t> buffer;
+  appendUnicore(buffer, 0x12, 42, 72);
+  buffer[9] = 0x01;
+  appendUbx(buffer, 0x01, 0x07, 92);
+  appendUnicore(buffer, 0xB5, 1276, 100);
+  append(buffer, "$GNGGA,000000.00,,,,,0,00,99.99,,,,,,*78\r\n");
+  buffer.resize(buffer.size() + 256 + 72, 0x00);
+
+  Framer framer(buffer.data(), buffer.size(), kMaxPayload);
+  FrameView frame;
+  ASSERT_TRUE(framer.next(frame));
+  EXPECT_EQ(frame.protocol, PROTOCOL_UBX);
+  EXPECT_EQ(frame.data, buffer.data() + 28 + 72 + 4);
+  ASSERT_TRUE(framer.next(frame));
+  EXPECT_EQ(frame.protocol, PROTOCOL_UNICORE_OEM);
+  ASSERT_TRUE(framer.next(frame));
+  EXPECT_EQ(frame.protocol, PROTOCOL_NMEA);
+  EXPECT_FALSE(framer.next(frame));
+  EXPECT_EQ(framer.checksumErrors(), 1u);
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
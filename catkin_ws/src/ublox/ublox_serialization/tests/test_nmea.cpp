@@ -0,0 +1,160 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "ublox/nmea.h"
+
+using namespace ublox;
+
+TEST(Nmea, Fields)
+{
+  NmeaFields f;
+  ASSERT_TRUE(f.split("$GNHDT,123.4,T*2F\r\n"));
+  ASSERT_EQ(f.size(), 3u);
+  EXPECT_EQ(f[0], "GNHDT");
+  EXPECT_EQ(f[2], "T");
+  EXPECT_TRUE(f[3].empty());
+  EXPECT_EQ(f.talker(), "GN");
+  EXPECT_EQ(f.type(), NMEA_HDT);
+  EXPECT_FALSE(f.split("#BESTNAVA,COM1*3c6a4b2f\r\n"));
+
+  double value;
+  EXPECT_TRUE(parseNmea("-12.0625", value));
+  EXPECT_EQ(value, -12.0625);
+  EXPECT_TRUE(parseNmea("7", value));
+  EXPECT_EQ(value, 7.0);
+  EXPECT_FALSE(parseNmea("", value));
+  EXPECT_TRUE(std::isnan(value));
+  EXPECT_FALSE(parseNmea("1.2.3", value));
+}
+
+TEST(Nmea, GgaAndGst)
+{
+  NmeaFields f;
+  NmeaGGA gga;
+  ASSERT_TRUE(f.split("$GPGGA,123519.50,4807.038,N,01131.000,W,4,08,0.9,"
+                      "545.4,M,46.9,M,1.5,0000*47\r\n"));
+  ASSERT_EQ(f.type(), NMEA_GGA);
+  ASSERT_TRUE(decodeNmea(f, gga));
+  EXPECT_DOUBLE_EQ(gga.time, 12 * 3600 + 35 * 60 + 19.5);
+  EXPECT_DOUBLE_EQ(gga.latitude, 48 + 7.038 / 60);
+  EXPECT_DOUBLE_EQ(gga.longitude, -(11 + 31.0 / 60));
+  EXPECT_EQ(gga.quality, 4u);
+  EXPECT_EQ(gga.num_satellites, 8u);
+  EXPECT_DOUBLE_EQ(gga.altitude, 545.4);
+  EXPECT_DOUBLE_EQ(gga.geoid_separation, 46.9);
+  EXPECT_DOUBLE_EQ(gga.age, 1.5);
+
+  // No fix yet, the empty fields are NaN
+  ASSERT_TRUE(f.split("$GNGGA,000000.00,,,,,0,00,99.99,,,,,,*78\r\n"));
+  ASSERT_TRUE(decodeNmea(f, gga));
+  EXPECT_EQ(gga.quality, 0u);
+  EXPECT_TRUE(std::isnan(gga.latitude));
+  EXPECT_TRUE(std::isnan(gga.altitude));
+
+  NmeaGST gst;
+  ASSERT_TRUE(f.split("$GPGST,172814.0,0.006,0.023,0.020,273.6,0.023,0.020,"
+                      "0.031*6A\r\n"));
+  ASSERT_EQ(f.type(), NMEA_GST);
+  ASSERT_TRUE(decodeNmea(f, gst));
+  EXPECT_DOUBLE_EQ(gst.sigma_latitude, 0.023);
+  EXPECT_DOUBLE_EQ(gst.sigma_longitude, 0.020);
+  EXPECT_DOUBLE_EQ(gst.sigma_altitude, 0.031);
+}
+
+TEST(Nmea, Velocity)
+{
+  NmeaFields f;
+  NmeaRMC rmc;
+  ASSERT_TRUE(f.split("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,"
+                      "230394,003.1,W,D*6A\r\n"));
+  ASSERT_EQ(f.type(), NMEA_RMC);
+  ASSERT_TRUE(decodeNmea(f, rmc));
+  EXPECT_TRUE(rmc.valid);
+  EXPECT_DOUBLE_EQ(rmc.speed, 22.4 * kKnotsToMps);
+  EXPECT_DOUBLE_EQ(rmc.course, 84.4);
+  EXPECT_EQ(rmc.date, 230394u);
+  EXPECT_EQ(rmc.mode, 'D');
+
+  NmeaVTG vtg;
+  ASSERT_TRUE(f.split("$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K,A*28\r\n"));
+  ASSERT_EQ(f.type(), NMEA_VTG);
+  ASSERT_TRUE(decodeNmea(f, vtg));
+  EXPECT_DOUBLE_EQ(vtg.course, 54.7);
+  EXPECT_DOUBLE_EQ(vtg.speed, 10.2 / 3.6);
+  EXPECT_EQ(vtg.mode, 'A');
+}
+
+TEST(Nmea, Gsv)
+{
+  NmeaFields f;
+  NmeaGSV gsv;
+  ASSERT_TRUE(f.split("$GPGSV,3,3,11,22,42,067,42,24,14,311,43,27,05,244,00,"
+                      ",,,*4D\r\n"));
+  ASSERT_EQ(f.type(), NMEA_GSV);
+  ASSERT_TRUE(decodeNmea(f, gsv));
+  EXPECT_EQ(gsv.num_sentences, 3u);
+  EXPECT_EQ(gsv.sentence, 3u);
+  EXPECT_EQ(gsv.num_in_view, 11u);
+  ASSERT_EQ(gsv.num_satellites, 3u);
+  EXPECT_EQ(gsv.satellites[1].id, 24u);
+  EXPECT_DOUBLE_EQ(gsv.satellites[1].azimuth, 311);
+  EXPECT_DOUBLE_EQ(gsv.satellites[2].snr, 0);
+
+  // NMEA 4.1 with the signal ID and a satellite which is not tracked
+  ASSERT_TRUE(f.split("$GAGSV,1,1,02,04,10,120,,11,45,300,38,7*75\r\n"));
+  ASSERT_TRUE(decodeNmea(f, gsv));
+  ASSERT_EQ(gsv.num_satellites, 2u);
+  EXPECT_TRUE(std::isnan(gsv.satellites[0].snr));
+  EXPECT_DOUBLE_EQ(gsv.satellites[1].snr, 38);
+}
+
+TEST(Nmea, CommandResponse)
+{
+  NmeaCommandResponse m;
+  ASSERT_TRUE(parseCommandResponse(
+      "$command,unlog com1,response: OK*75\r\n", m));
+  EXPECT_EQ(m.command, "unlog com1");
+  EXPECT_TRUE(m.ok());
+
+  ASSERT_TRUE(parseCommandResponse(
+      "$command,log com1,gpgga,response: PARSING FAILD NO MATCHING FUNC "
+      "*4C\r\n", m));
+  EXPECT_EQ(m.command, "log com1,gpgga");
+  EXPECT_EQ(m.response, "PARSING FAILD NO MATCHING FUNC");
+  EXPECT_FALSE(m.ok());
+
+  EXPECT_FALSE(parseCommandResponse("$GNHDT,123.4,T*2F\r\n", m));
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
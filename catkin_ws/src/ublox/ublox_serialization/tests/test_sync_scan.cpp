@@ -0,0 +1,95 @@
+//==============================================================================
+// Copyright (c) 2012, Johannes Meyer, TU Darmstadt
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the Flight Systems and Automatic Control group,
+//       TU Darmstadt, nor the names of its contributors may be used to
+//       endorse or promote products derived from this software without
+//       specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "ublox/sync_scan.h"
+
+using namespace ublox;
+
+namespace {
+
+std::vector<uint8_t> randomBytes(size_t size, unsigned int seed) {
+  std::vector<uint8_t> data(size);
+  srand(seed);
+  for (size_t i = 0; i < size; ++i)
+    data[i] = static_cast<uint8_t>(rand());
+  return data;
+}
+
+}  // namespace
+
+TEST(SyncScan, StartKernelsMatchScalar)
+{
+  // Dense start characters, so that they hit every lane of a vector
+  const uint8_t starts[] = {0xB5, 0xAA, 0xD3, '$', '#'};
+  std::vector<uint8_t> data = randomBytes(1024, 5);
+  for (size_t i = 0; i < data.size(); ++i)
+    if (data[i] % 16 == 0)
+      data[i] = starts[(data[i] >> 4) % 5];
+
+  for (int k = 0; k < sync::KERNEL_COUNT; ++k) {
+    sync::Kernel kernel = static_cast<sync::Kernel>(k);
+    sync::FindStartFunction find = sync::startKernelFunction(kernel);
+    if (!find || !sync::isSupported(kernel))
+      continue;
+    for (size_t begin = 0; begin < 70; ++begin) {
+      for (size_t end = begin; end < begin + 100; ++end) {
+        const uint8_t *b = data.data() + begin, *e = data.data() + end;
+        ASSERT_EQ(find(b, e), sync::findStartScalar(b, e))
+            << sync::kernelName(kernel) << " [" << begin << ", " << end << ")";
+      }
+    }
+  }
+}
+
+TEST(SyncScan, FrameStarts)
+{
+  const char text[] = "\x01\x02 line noise without any start character\r\n"
+                      "\xD3\x00\x13";
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(text);
+  const size_t size = sizeof(text) - 1;
+  for (int k = 0; k < sync::KERNEL_COUNT; ++k) {
+    sync::Kernel kernel = static_cast<sync::Kernel>(k);
+    sync::FindStartFunction find = sync::startKernelFunction(kernel);
+    if (!find || !sync::isSupported(kernel))
+      continue;
+    EXPECT_EQ(find(data, data + size) - data, size - 3)
+        << sync::kernelName(kernel);
+    EXPECT_EQ(find(data, data + size - 3), data + size - 3)
+        << sync::kernelName(kernel);
+  }
+}
+
+int main(int argc, char **argv){
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}